@@ -0,0 +1,257 @@
+#include "BridgeServer.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace Gaia::CameraService
+{
+    namespace
+    {
+        /// Copy the text into a fixed length zero terminated name field, longer text is truncated.
+        void CopyName(char (&field)[Bridge::MaxNameLength], const std::string& text)
+        {
+            auto length = std::min(text.size(), Bridge::MaxNameLength - 1);
+            std::memcpy(field, text.data(), length);
+            field[length] = '\0';
+        }
+    }
+
+    /// Connect to the camera and listen on the given port.
+    BridgeServer::BridgeServer(const std::string &camera_type, unsigned int index, unsigned int listen_port,
+                               std::chrono::microseconds poll_interval, unsigned int port, const std::string &ip) :
+        PollInterval(poll_interval)
+    {
+        sw::redis::ConnectionOptions connection_options;
+        connection_options.host = ip;
+        connection_options.port = static_cast<int>(port);
+        connection_options.type = sw::redis::ConnectionType::TCP;
+        // Every session keeps polling, so every session thread should have its own connection.
+        sw::redis::ConnectionPoolOptions pool_options;
+        pool_options.size = 16;
+        Connection = std::make_shared<sw::redis::Redis>(connection_options, pool_options);
+        Client = std::make_unique<CameraClient>(camera_type, index, Connection);
+        Logger = std::make_unique<LogService::LogClient>(Connection);
+        Logger->Author = Client->GetDeviceName() + ".bridge";
+
+        ListenDescriptor = socket(AF_INET, SOCK_STREAM, 0);
+        if (ListenDescriptor < 0) throw std::runtime_error("Failed to create the listening socket.");
+        int enabled = 1;
+        setsockopt(ListenDescriptor, SOL_SOCKET, SO_REUSEADDR, &enabled, sizeof(enabled));
+        sockaddr_in address {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(static_cast<std::uint16_t>(listen_port));
+        if (bind(ListenDescriptor, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            listen(ListenDescriptor, 8) != 0)
+        {
+            close(ListenDescriptor);
+            ListenDescriptor = -1;
+            throw std::runtime_error("Failed to listen on port " + std::to_string(listen_port) + ": " +
+                                     std::strerror(errno));
+        }
+    }
+
+    /// Stop serving and close all connections.
+    BridgeServer::~BridgeServer()
+    {
+        Stop();
+        for (auto& session : Sessions)
+        {
+            if (session->Worker.joinable()) session->Worker.join();
+        }
+        Sessions.clear();
+        if (ListenDescriptor >= 0)
+        {
+            close(ListenDescriptor);
+        }
+    }
+
+    /// Stop accepting and serving subscribers.
+    void BridgeServer::Stop()
+    {
+        LifeFlag = false;
+    }
+
+    /// Accept and serve subscribers.
+    void BridgeServer::Launch()
+    {
+        LifeFlag = true;
+        Logger->RecordMilestone("Bridge of camera " + Client->GetDeviceName() + " is serving.");
+        while (LifeFlag)
+        {
+            pollfd listen_poll {ListenDescriptor, POLLIN, 0};
+            if (poll(&listen_poll, 1, 100) > 0 && (listen_poll.revents & POLLIN))
+            {
+                sockaddr_in address {};
+                socklen_t address_length = sizeof(address);
+                auto descriptor = accept(ListenDescriptor, reinterpret_cast<sockaddr*>(&address), &address_length);
+                if (descriptor >= 0)
+                {
+                    int enabled = 1;
+                    setsockopt(descriptor, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+                    char address_text[INET_ADDRSTRLEN] {};
+                    inet_ntop(AF_INET, &address.sin_addr, address_text, sizeof(address_text));
+
+                    auto session = std::make_unique<Session>();
+                    session->Descriptor = descriptor;
+                    session->Address = std::string(address_text) + ":" + std::to_string(ntohs(address.sin_port));
+                    auto* session_pointer = session.get();
+                    session->Worker = std::thread([this, session_pointer]{
+                        this->ServeSession(*session_pointer);
+                        session_pointer->Finished = true;
+                    });
+                    Sessions.push_back(std::move(session));
+                }
+            }
+
+            // Join finished sessions.
+            for (auto iterator = Sessions.begin(); iterator != Sessions.end();)
+            {
+                if ((*iterator)->Finished)
+                {
+                    (*iterator)->Worker.join();
+                    iterator = Sessions.erase(iterator);
+                }
+                else ++iterator;
+            }
+        }
+    }
+
+    /// Serve a subscriber.
+    void BridgeServer::ServeSession(Session& session)
+    {
+        const auto& device_name = Client->GetDeviceName();
+        try
+        {
+            timeval receive_timeout {5, 0};
+            setsockopt(session.Descriptor, SOL_SOCKET, SO_RCVTIMEO, &receive_timeout, sizeof(receive_timeout));
+            Bridge::SubscribeRequest request {};
+            if (!Bridge::ReceiveAll(session.Descriptor, &request, sizeof(request)) ||
+                request.Magic != Bridge::RequestMagic || request.Version != Bridge::ProtocolVersion)
+            {
+                throw std::runtime_error("invalid subscribe request");
+            }
+
+            std::vector<std::string> picture_names;
+            auto available_names = Client->GetPictures();
+            for (std::uint32_t picture_index = 0;
+                 picture_index < std::min<std::size_t>(request.PicturesCount, Bridge::MaxPicturesCount);
+                 ++picture_index)
+            {
+                request.Pictures[picture_index][Bridge::MaxNameLength - 1] = '\0';
+                std::string name(request.Pictures[picture_index]);
+                if (available_names.count(name)) picture_names.push_back(name);
+            }
+            if (request.PicturesCount == 0)
+            {
+                picture_names.assign(available_names.begin(), available_names.end());
+                std::sort(picture_names.begin(), picture_names.end());
+                if (picture_names.size() > Bridge::MaxPicturesCount) picture_names.resize(Bridge::MaxPicturesCount);
+            }
+
+            Bridge::StreamDescription description {};
+            description.Magic = Bridge::DescriptionMagic;
+            description.Version = Bridge::ProtocolVersion;
+            CopyName(description.DeviceName, device_name);
+            description.PicturesCount = static_cast<std::uint32_t>(picture_names.size());
+            std::vector<CameraReader> readers;
+            for (std::size_t picture_index = 0; picture_index < picture_names.size(); ++picture_index)
+            {
+                const auto& name = picture_names[picture_index];
+                readers.push_back(Client->GetReader(name));
+                // Frames are found and validated through stamps, so servers without them can not be bridged.
+                if (!readers.back().GetStamps())
+                    throw std::runtime_error("picture " + name + " does not publish picture stamps");
+                auto header = readers.back().GetPictureHeader();
+                auto& picture = description.Pictures[picture_index];
+                CopyName(picture.Name, name);
+                CopyName(picture.Format, Connection->get(
+                        "cameras/" + device_name + "/pictures/" + name + "/format").value_or("BGR"));
+                picture.PixelType = readers.back().GetPixelType();
+                picture.Width = header.Width;
+                picture.Height = header.Height;
+            }
+            iovec description_buffer {&description, sizeof(description)};
+            if (!Bridge::SendAll(session.Descriptor, &description_buffer, 1) || picture_names.empty())
+            {
+                throw std::runtime_error("no picture is subscribed");
+            }
+            Logger->RecordMessage("Subscriber " + session.Address + " subscribed " +
+                                  std::to_string(picture_names.size()) + " pictures.");
+
+            // Frames on the grid of the decimation are sent, so skipped frames are the gaps beyond it.
+            const std::uint64_t decimation = std::max<std::uint32_t>(request.Decimation, 1);
+            std::vector<std::uint64_t> sent_sequences(picture_names.size(), 0);
+            std::vector<iovec> buffers;
+            while (LifeFlag)
+            {
+                bool updated = false;
+                for (std::size_t picture_index = 0; picture_index < picture_names.size(); ++picture_index)
+                {
+                    const auto& reader = readers[picture_index];
+                    const auto* stamps = reader.GetStamps();
+                    const auto count = stamps->GetCount();
+                    const auto sequence = count - count % decimation;
+                    if (sequence == 0 || sequence <= sent_sequences[picture_index]) continue;
+                    auto stamp = stamps->Read(sequence);
+                    if (!stamp || count - sequence + 1 >= stamps->GetDepth()) continue;
+                    sent_sequences[picture_index] = sequence;
+                    updated = true;
+
+                    // Pixels are sent straight from the mapped block, row by row if rows are padded.
+                    auto picture = reader.ViewBlock(stamp->BlockID);
+                    const auto row_length = static_cast<std::size_t>(picture.cols) * picture.elemSize();
+                    Bridge::FrameHeader header {};
+                    header.Magic = Bridge::FrameMagic;
+                    header.PictureIndex = static_cast<std::uint32_t>(picture_index);
+                    header.Flags = stamp->Flags;
+                    header.Sequence = sequence;
+                    header.Timestamp = stamp->Timestamp;
+                    header.MonotonicTimestamp = stamp->MonotonicTimestamp;
+                    header.DeviceTimestamp = stamp->DeviceTimestamp;
+                    header.Exposure = stamp->Exposure;
+                    header.Gain = stamp->Gain;
+                    header.PayloadSize = row_length * static_cast<std::size_t>(picture.rows);
+                    buffers.clear();
+                    buffers.push_back({&header, sizeof(header)});
+                    if (picture.isContinuous())
+                    {
+                        buffers.push_back({picture.data, header.PayloadSize});
+                    }
+                    else
+                    {
+                        for (int row = 0; row < picture.rows; ++row)
+                        {
+                            buffers.push_back({picture.ptr(row), row_length});
+                        }
+                    }
+                    if (!Bridge::SendAll(session.Descriptor, buffers.data(), buffers.size()))
+                    {
+                        throw std::runtime_error("connection is closed");
+                    }
+                    // The block is only leased while it stays within the depth, otherwise the sent pixels are torn.
+                    Bridge::FrameTrailer trailer {Bridge::TrailerMagic, 0};
+                    if (stamps->GetCount() - sequence + 1 >= stamps->GetDepth()) trailer.Flags |= Bridge::TornFlag;
+                    iovec trailer_buffer {&trailer, sizeof(trailer)};
+                    if (!Bridge::SendAll(session.Descriptor, &trailer_buffer, 1))
+                    {
+                        throw std::runtime_error("connection is closed");
+                    }
+                }
+                if (!updated) std::this_thread::sleep_for(PollInterval);
+            }
+        }catch (std::exception& error)
+        {
+            Logger->RecordWarning("Subscriber " + session.Address + " is disconnected: " + error.what());
+        }
+        close(session.Descriptor);
+        session.Descriptor = -1;
+    }
+}
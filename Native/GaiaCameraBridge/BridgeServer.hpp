@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <sw/redis++/redis++.h>
+#include <GaiaLogClient/GaiaLogClient.hpp>
+#include <GaiaCameraClient/GaiaCameraClient.hpp>
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Bridge which streams pictures of a local camera to remote subscribers over TCP.
+     * @details
+     *  Every subscriber is served by its own thread, which polls stamp rings of subscribed pictures
+     *  and sends new frames in the framed protocol described in BridgeProtocol.hpp,
+     *  with sequence numbers and capture times of the camera.
+     *  Pixels are sent with scatter-gather I/O straight from the mapped swap chain blocks,
+     *  without being copied into an intermediate buffer, and frames whose blocks are rewritten
+     *  while being sent are flagged as torn in their trailers.
+     *  Only the latest frame is sent when the link is slower than the camera,
+     *  and subscribers can ask for only frames whose sequences are multiples of N.
+     */
+    class BridgeServer
+    {
+    private:
+        /// Connection to a subscriber.
+        struct Session
+        {
+            /// Descriptor of the connected socket.
+            int Descriptor {-1};
+            /// Address of the subscriber, used in logs.
+            std::string Address;
+            /// Thread which serves this session.
+            std::thread Worker;
+            /// Whether the session is finished and can be joined.
+            std::atomic_bool Finished {false};
+        };
+
+        /// Connection to the Redis server.
+        std::shared_ptr<sw::redis::Redis> Connection;
+        /// Client of the bridged camera.
+        std::unique_ptr<CameraClient> Client;
+        /// Logger of connections and failures of subscribers.
+        std::unique_ptr<LogService::LogClient> Logger;
+
+        /// Descriptor of the listening socket.
+        int ListenDescriptor {-1};
+        /// Life flag of the accepting loop and sessions.
+        std::atomic_bool LifeFlag {false};
+
+        /// Sessions of connected subscribers.
+        std::list<std::unique_ptr<Session>> Sessions;
+
+        /// Interval to wait when no picture is updated.
+        std::chrono::microseconds PollInterval;
+
+        /// Serve a subscriber until it disconnects or the bridge stops.
+        void ServeSession(Session& session);
+
+    public:
+        /**
+         * @brief Connect to the camera and listen on the given port.
+         * @param camera_type Type name of the camera.
+         * @param index Index of the camera.
+         * @param listen_port TCP port to listen on.
+         * @param poll_interval Interval to wait when no picture is updated.
+         * @param port Port of the Redis server.
+         * @param ip IP address of the Redis server.
+         * @throw std::runtime_error If the camera can not be found or the port can not be listened on.
+         */
+        BridgeServer(const std::string& camera_type, unsigned int index, unsigned int listen_port,
+                     std::chrono::microseconds poll_interval = std::chrono::microseconds(1000),
+                     unsigned int port = 6379, const std::string& ip = "127.0.0.1");
+        /// Stop serving and close all connections.
+        ~BridgeServer();
+
+        BridgeServer(const BridgeServer&) = delete;
+        BridgeServer& operator=(const BridgeServer&) = delete;
+
+        /// Accept and serve subscribers, blocks until Stop() is invoked.
+        void Launch();
+        /// Stop accepting and serving subscribers.
+        void Stop();
+    };
+}
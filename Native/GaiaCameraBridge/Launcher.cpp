@@ -0,0 +1,58 @@
+#include <iostream>
+#include <csignal>
+#include <boost/program_options.hpp>
+#include "BridgeServer.hpp"
+
+namespace
+{
+    /// Bridge to stop when an interrupt signal is received.
+    Gaia::CameraService::BridgeServer* RunningBridge = nullptr;
+}
+
+int main(int arguments_count, char** arguments)
+{
+    using namespace Gaia::CameraService;
+    using namespace boost::program_options;
+
+    options_description options("Options");
+
+    options.add_options()
+            ("help,?", "show help message.")
+            ("device,d", value<std::string>()->default_value("daheng"),
+             "type of the device to bridge.")
+            ("index,i", value<unsigned int>()->default_value(0),
+             "index of the device to bridge.")
+            ("port,p", value<unsigned int>()->default_value(9700),
+             "TCP port to listen on.")
+            ("interval", value<unsigned int>()->default_value(1000),
+             "microseconds to wait when no picture is updated.")
+            ("redis-port", value<unsigned int>()->default_value(6379),
+             "port of the Redis server.")
+            ("redis-ip", value<std::string>()->default_value("127.0.0.1"),
+             "IP address of the Redis server.");
+    variables_map variables;
+    store(parse_command_line(arguments_count, arguments, options), variables);
+    notify(variables);
+
+    if (variables.count("help"))
+    {
+        std::cout << options << std::endl;
+        return 0;
+    }
+
+    BridgeServer bridge(variables["device"].as<std::string>(), variables["index"].as<unsigned int>(),
+                        variables["port"].as<unsigned int>(),
+                        std::chrono::microseconds(variables["interval"].as<unsigned int>()),
+                        variables["redis-port"].as<unsigned int>(), variables["redis-ip"].as<std::string>());
+    RunningBridge = &bridge;
+    std::signal(SIGINT, [](int){
+        if (RunningBridge) RunningBridge->Stop();
+    });
+    std::signal(SIGTERM, [](int){
+        if (RunningBridge) RunningBridge->Stop();
+    });
+    bridge.Launch();
+    RunningBridge = nullptr;
+
+    return 0;
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace Gaia::CameraService::Bridge
+{
+    /**
+     * @brief Framed protocol between the camera bridge and its subscribers over TCP.
+     * @details
+     *  A subscriber sends one SubscribeRequest after connecting,
+     *  the bridge replies with one StreamDescription of the subscribed pictures,
+     *  and then sends frames, each of them is a FrameHeader immediately followed by the raw pixels
+     *  and a FrameTrailer, which tells whether the pixels were overwritten by the camera while being sent.
+     *  All integers are in the byte order of the host, the bridge is meant to connect hosts of the same kind.
+     */
+
+    /// Magic number of subscribe requests, "GCBR".
+    constexpr std::uint32_t RequestMagic = 0x52424347;
+    /// Magic number of stream descriptions, "GCBD".
+    constexpr std::uint32_t DescriptionMagic = 0x44424347;
+    /// Magic number of frame headers, "GCBF".
+    constexpr std::uint32_t FrameMagic = 0x46424347;
+    /// Magic number of frame trailers, "GCBT".
+    constexpr std::uint32_t TrailerMagic = 0x54424347;
+    /// Version of the protocol.
+    constexpr std::uint32_t ProtocolVersion = 3;
+
+    /// Flag of frame trailers whose pixels were overwritten while being sent, they should be dropped.
+    constexpr std::uint32_t TornFlag = 1;
+
+    /// Max count of pictures in a stream.
+    constexpr std::size_t MaxPicturesCount = 16;
+    /// Max length of names, including the terminating zero.
+    constexpr std::size_t MaxNameLength = 64;
+
+    /// Request sent by a subscriber right after connecting.
+    struct SubscribeRequest
+    {
+        std::uint32_t Magic;
+        std::uint32_t Version;
+        /// Only every N-th frame of each picture is sent, 0 and 1 mean every frame.
+        std::uint32_t Decimation;
+        /// Count of valid entries in Pictures, 0 means all pictures of the camera.
+        std::uint32_t PicturesCount;
+        /// Names of subscribed pictures, zero terminated.
+        char Pictures[MaxPicturesCount][MaxNameLength];
+    };
+
+    /// Description of a streamed picture.
+    struct PictureDescription
+    {
+        /// Name of the picture, zero terminated.
+        char Name[MaxNameLength];
+        /// Color format of the picture, such as "BGR", zero terminated.
+        char Format[MaxNameLength];
+        /// OpenCV type of the pixels, such as CV_8UC3.
+        std::int32_t PixelType;
+        std::uint32_t Width;
+        std::uint32_t Height;
+        std::uint32_t Reserved;
+    };
+
+    /// Reply of the bridge to a subscribe request.
+    struct StreamDescription
+    {
+        std::uint32_t Magic;
+        std::uint32_t Version;
+        /// Name of the camera device, zero terminated.
+        char DeviceName[MaxNameLength];
+        /// Count of valid entries in Pictures, 0 means the request is rejected.
+        std::uint32_t PicturesCount;
+        std::uint32_t Reserved;
+        /// Descriptions of streamed pictures, frames refer to them by index.
+        PictureDescription Pictures[MaxPicturesCount];
+    };
+
+    /// Header of a frame, followed by the raw pixels.
+    struct FrameHeader
+    {
+        std::uint32_t Magic;
+        /// Index of the picture in the stream description.
+        std::uint32_t PictureIndex;
+        /// Flags of the picture stamp, such as PictureStamp::UnchangedFlag.
+        std::uint32_t Flags;
+        /// Exposure time in microseconds when the frame is captured.
+        std::uint32_t Exposure;
+        /// Sequence number of the frame in the swap chain of the camera, gaps beyond the decimation mean skips.
+        std::uint64_t Sequence;
+        /// Capture time of the frame in nanoseconds since epoch.
+        std::uint64_t Timestamp;
+        /// Capture time of the frame in CLOCK_MONOTONIC_RAW nanoseconds of the host of the camera.
+        std::uint64_t MonotonicTimestamp;
+        /// Capture time stamped by the device in device ticks, 0 if the device does not provide one.
+        std::uint64_t DeviceTimestamp;
+        /// Digital gain when the frame is captured.
+        double Gain;
+        /// Size of the raw pixels in bytes, rows are tightly packed.
+        std::uint64_t PayloadSize;
+    };
+
+    /// Trailer of a frame, sent right after the raw pixels.
+    struct FrameTrailer
+    {
+        std::uint32_t Magic;
+        /// Flags of the sent frame, such as TornFlag.
+        std::uint32_t Flags;
+    };
+
+    /**
+     * @brief Send all data in the buffers with one system call per partial send.
+     * @param descriptor Descriptor of a connected socket.
+     * @param buffers Buffers to send, they are modified to track the progress.
+     * @param buffers_count Count of buffers.
+     * @return True if all data is sent, false if the connection is broken.
+     */
+    inline bool SendAll(int descriptor, iovec* buffers, std::size_t buffers_count)
+    {
+        while (buffers_count > 0)
+        {
+            msghdr message {};
+            message.msg_iov = buffers;
+            // Rows of padded pictures are separate buffers, which may be more than one call accepts.
+            message.msg_iovlen = std::min<std::size_t>(buffers_count, IOV_MAX);
+            auto result = sendmsg(descriptor, &message, MSG_NOSIGNAL);
+            if (result < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            auto sent_size = static_cast<std::size_t>(result);
+            while (buffers_count > 0 && sent_size >= buffers->iov_len)
+            {
+                sent_size -= buffers->iov_len;
+                ++buffers;
+                --buffers_count;
+            }
+            if (buffers_count > 0)
+            {
+                buffers->iov_base = static_cast<std::uint8_t*>(buffers->iov_base) + sent_size;
+                buffers->iov_len -= sent_size;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Receive exactly the given size of data.
+     * @param descriptor Descriptor of a connected socket.
+     * @param buffer Buffer to receive into.
+     * @param size Size of data to receive in bytes.
+     * @return True if all data is received, false if the connection is closed or broken.
+     */
+    inline bool ReceiveAll(int descriptor, void* buffer, std::size_t size)
+    {
+        auto* position = static_cast<std::uint8_t*>(buffer);
+        while (size > 0)
+        {
+            auto result = recv(descriptor, position, size, MSG_WAITALL);
+            if (result < 0)
+            {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            if (result == 0) return false;
+            position += result;
+            size -= static_cast<std::size_t>(result);
+        }
+        return true;
+    }
+}
@@ -50,6 +50,104 @@ namespace Gaia::CameraService
         return CameraReader(Connection, DeviceName, picture_name);
     }
 
+    /// Get the reader for the compressed preview picture.
+    CameraReader CameraClient::GetPreviewReader()
+    {
+        if (!Connection) throw std::runtime_error("Connection to Redis is null.");
+        if (!Connection->sismember("cameras/" + DeviceName + "/pictures", "preview"))
+        {
+            throw std::runtime_error("Preview is not enabled on camera " + DeviceName);
+        }
+        return CameraReader(Connection, DeviceName, "preview");
+    }
+
+    /// Get the encoding of the preview picture.
+    std::string CameraClient::GetPreviewFormat()
+    {
+        if (!Connection) throw std::runtime_error("Connection to Redis is null.");
+        return Connection->get("cameras/" + DeviceName + "/pictures/preview/format").value_or("");
+    }
+
+    /// Read pictures of the same frame set.
+    FrameSet CameraClient::ReadFrameSet(const std::vector<std::string>& picture_names)
+    {
+        if (picture_names.empty()) throw std::invalid_argument("No picture is required to read as a frame set.");
+
+        // Resolve the frame set and prepare readers.
+        std::string frame_set_name;
+        unsigned int min_blocks_count = 0;
+        for (const auto& picture_name : picture_names)
+        {
+            auto name_finder = FrameSetNames.find(picture_name);
+            if (name_finder == FrameSetNames.end())
+            {
+                auto optional_name = Connection->get("cameras/" + DeviceName + "/pictures/" + picture_name + "/frameset");
+                if (!optional_name)
+                    throw std::runtime_error("Picture " + picture_name + " of camera " + DeviceName +
+                                             " does not belong to any frame set.");
+                name_finder = FrameSetNames.emplace(picture_name, *optional_name).first;
+            }
+            if (frame_set_name.empty())
+            {
+                frame_set_name = name_finder->second;
+            }
+            else if (frame_set_name != name_finder->second)
+            {
+                throw std::runtime_error("Pictures of camera " + DeviceName + " do not belong to the same frame set.");
+            }
+
+            auto reader_finder = FrameSetReaders.find(picture_name);
+            if (reader_finder == FrameSetReaders.end())
+            {
+                reader_finder = FrameSetReaders.emplace(picture_name, GetReader(picture_name)).first;
+            }
+            auto blocks_count = reader_finder->second.GetBlocksCount();
+            if (min_blocks_count == 0 || blocks_count < min_blocks_count) min_blocks_count = blocks_count;
+        }
+
+        auto sequence_key = "cameras/" + DeviceName + "/framesets/" + frame_set_name + "/sequence";
+        std::vector<std::string> keys;
+        keys.reserve(picture_names.size() + 1);
+        keys.push_back(sequence_key);
+        for (const auto& picture_name : picture_names)
+        {
+            keys.push_back("cameras/" + DeviceName + "/pictures/" + picture_name + "/id");
+        }
+
+        // Retry if the swap chain wraps around while pictures are being copied.
+        constexpr unsigned int max_attempts = 3;
+        for (auto attempt = 0u; attempt < max_attempts; ++attempt)
+        {
+            std::vector<sw::redis::OptionalString> values;
+            values.reserve(keys.size());
+            Connection->mget(keys.begin(), keys.end(), std::back_inserter(values));
+            for (const auto& value : values)
+            {
+                if (!value) throw std::runtime_error("Frame set " + frame_set_name + " of camera " +
+                                                     DeviceName + " is not committed yet.");
+            }
+
+            FrameSet frame_set;
+            frame_set.Sequence = std::stoul(*values[0]);
+            for (std::size_t picture_index = 0; picture_index < picture_names.size(); ++picture_index)
+            {
+                const auto& picture_name = picture_names[picture_index];
+                auto block_id = static_cast<unsigned int>(std::stoul(*values[picture_index + 1]));
+                frame_set.Pictures[picture_name] = FrameSetReaders.at(picture_name).ReadBlock(block_id);
+            }
+
+            auto latest_sequence_text = Connection->get(sequence_key);
+            auto latest_sequence = latest_sequence_text ? std::stoul(*latest_sequence_text) : frame_set.Sequence;
+            // The block being written is never the committed one, so (blocks count - 1) commits are safe.
+            if (latest_sequence - frame_set.Sequence + 1 < min_blocks_count)
+            {
+                return frame_set;
+            }
+        }
+        throw std::runtime_error("Failed to read a consistent frame set " + frame_set_name + " of camera " +
+                                 DeviceName + ", readers are too slow.");
+    }
+
     /// Get current frames per second.
     int CameraClient::GetFPS()
     {
@@ -81,6 +179,12 @@ namespace Gaia::CameraService
         Connection->publish(CommandChannelName, "update_white_balance");
     }
 
+    /// Open the parameter queue of the camera.
+    std::unique_ptr<ParameterQueue> CameraClient::OpenParameterQueue()
+    {
+        return std::make_unique<ParameterQueue>(ParameterQueue::GenerateBlockName(DeviceName));
+    }
+
     /// Auto adjust the exposure for once.
     void CameraClient::AutoAdjustExposure()
     {
@@ -98,4 +202,45 @@ namespace Gaia::CameraService
     {
         Connection->publish(CommandChannelName, "auto_white_balance");
     }
-}
\ No newline at end of file
+
+    /// Start the built-in recorder.
+    void CameraClient::StartRecording()
+    {
+        Connection->publish(CommandChannelName, "record_start");
+    }
+
+    /// Stop the built-in recorder.
+    void CameraClient::StopRecording()
+    {
+        Connection->publish(CommandChannelName, "record_stop");
+    }
+
+    /// Start the built-in video encoder.
+    void CameraClient::StartEncoding()
+    {
+        Connection->publish(CommandChannelName, "encode_start");
+    }
+
+    /// Stop the built-in video encoder.
+    void CameraClient::StopEncoding()
+    {
+        Connection->publish(CommandChannelName, "encode_stop");
+    }
+
+    /// Ask the camera server to publish a region.
+    void CameraClient::AddRegion(const std::string &name, const std::string &picture_name, const cv::Rect &area,
+                                 double scale)
+    {
+        Connection->set(ConfigurationPrefix + "Region." + name,
+                        picture_name + "," + std::to_string(area.x) + "," + std::to_string(area.y) + "," +
+                        std::to_string(area.width) + "," + std::to_string(area.height) + "," +
+                        std::to_string(scale));
+        Connection->publish(CommandChannelName, "add_region " + name);
+    }
+
+    /// Ask the camera server to stop publishing a region.
+    void CameraClient::RemoveRegion(const std::string &name)
+    {
+        Connection->publish(CommandChannelName, "remove_region " + name);
+    }
+}
@@ -3,13 +3,25 @@
 #include <string>
 #include <memory>
 #include <unordered_set>
+#include <unordered_map>
+#include <vector>
 #include <sw/redis++/redis++.h>
 #include <GaiaSharedMemory/GaiaSharedMemory.hpp>
 
 #include "CameraReader.hpp"
+#include "ParameterQueue.hpp"
 
 namespace Gaia::CameraService
 {
+    /// Pictures captured at the same time, committed under one sequence number.
+    struct FrameSet
+    {
+        /// Sequence number of this frame set.
+        unsigned long Sequence {0};
+        /// Pictures in this frame set, indexed by picture names.
+        std::unordered_map<std::string, cv::Mat> Pictures;
+    };
+
     /**
      * @brief Client for camera service, provides function to get the picture in OpenCV matrix format.
      */
@@ -27,6 +39,11 @@ namespace Gaia::CameraService
         /// Connection to the Redis server.
         std::shared_ptr<sw::redis::Redis> Connection;
 
+        /// Readers for pictures read through frame sets, indexed by picture names.
+        std::unordered_map<std::string, CameraReader> FrameSetReaders;
+        /// Names of frame sets which pictures belong to, indexed by picture names.
+        std::unordered_map<std::string, std::string> FrameSetNames;
+
     public:
         /**
          * @brief Reuse the connection to connect to a Redis server and connect to the given camera.
@@ -46,6 +63,12 @@ namespace Gaia::CameraService
         CameraClient(const std::string& camera_type, unsigned int index,
                      unsigned int port = 6379, const std::string& ip = "127.0.0.1");
 
+        /// Get the name of the connected camera device, such as "daheng.0".
+        [[nodiscard]] inline const std::string& GetDeviceName() const noexcept
+        {
+            return DeviceName;
+        }
+
         /// Get names set of pictures.
         std::unordered_set<std::string> GetPictures();
 
@@ -56,6 +79,29 @@ namespace Gaia::CameraService
          */
         CameraReader GetReader(std::string picture_name = "*");
 
+        /**
+         * @brief Get the reader for the compressed preview picture.
+         * @return Reader for the picture "preview".
+         * @details
+         *  The read picture is a 1xN 8 bits matrix holding the encoded bytes,
+         *  decode it with cv::imdecode. Its encoding is given by GetPreviewFormat().
+         *  Exception will be thrown if the preview is not enabled on the server.
+         */
+        CameraReader GetPreviewReader();
+
+        /// Get the encoding of the preview picture, "JPEG" or "WebP", empty if the preview is not enabled.
+        std::string GetPreviewFormat();
+
+        /**
+         * @brief Read pictures of the same frame set which are captured at the same time.
+         * @param picture_names Names of pictures to read, they must belong to the same frame set.
+         * @return Frame set which only contains the required pictures.
+         * @details
+         *  Block IDs of all member pictures and the frame set sequence are fetched in one round trip,
+         *  and only the required pictures are copied out of the shared memory.
+         */
+        FrameSet ReadFrameSet(const std::vector<std::string>& picture_names);
+
         /// Get current frames per second.
         [[nodiscard]] int GetFPS();
 
@@ -76,6 +122,16 @@ namespace Gaia::CameraService
          * @param blue_ratio Value of the blue channel.
          */
         void SetWhiteBalance(double red_ratio, double green_ratio, double blue_ratio);
+        /**
+         * @brief Open the parameter queue of the camera, and claim its producer role.
+         * @return Queue to push parameter changes which are applied between frames.
+         * @details
+         *  Unlike the setters above, changes pushed into the queue bypass Redis and are not saved into
+         *  the configuration. Exception will be thrown if the queue is not enabled on the server,
+         *  or if another process is pushing into it. The queue survives restarts of the server,
+         *  but should be reopened if ParameterQueue::IsServerAlive() stays false.
+         */
+        std::unique_ptr<ParameterQueue> OpenParameterQueue();
         /**
          * @brief Auto adjust the exposure for once.
          * @details
@@ -94,5 +150,37 @@ namespace Gaia::CameraService
          *  The adjusted white balance value not be saved into configuration.
          */
         void AutoAdjustWhiteBalance();
+        /**
+         * @brief Start the built-in recorder of the camera server.
+         * @details
+         *  Recorded pictures, the directory and the segment size are read from configurations
+         *  "RecordPictures", "RecordPath" and "RecordSegmentSize" of the camera.
+         */
+        void StartRecording();
+        /// Stop the built-in recorder of the camera server.
+        void StopRecording();
+        /**
+         * @brief Start the built-in video encoder of the camera server.
+         * @details
+         *  Encoded pictures, the codec and the directory are read from configurations
+         *  "EncodePictures", "EncodeCodec" and "EncodePath" of the camera.
+         */
+        void StartEncoding();
+        /// Stop the built-in video encoder of the camera server.
+        void StopEncoding();
+        /**
+         * @brief Ask the camera server to publish a region of a picture as a standalone picture.
+         * @param name Name of the region picture, it should not contain '/', '.' or spaces.
+         * @param picture_name Name of the source picture.
+         * @param area Area to crop in the source picture.
+         * @param scale Scale of the region picture, 1 means no scaling.
+         * @details
+         *  The region will be readable through GetReader(name) once the server publishes it,
+         *  and it will be restored when the server restarts until it is removed.
+         */
+        void AddRegion(const std::string& name, const std::string& picture_name, const cv::Rect& area,
+                       double scale = 1.0);
+        /// Ask the camera server to stop publishing the region with the given name.
+        void RemoveRegion(const std::string& name);
     };
 }
\ No newline at end of file
@@ -0,0 +1,229 @@
+#include "CameraGroupReader.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace Gaia::CameraService
+{
+    namespace
+    {
+        /// Get the absolute difference between two timestamps.
+        std::uint64_t GetDistance(std::uint64_t first, std::uint64_t second)
+        {
+            return first > second ? first - second : second - first;
+        }
+    }
+
+    /// Follow stamp rings of member pictures.
+    CameraGroupReader::CameraGroupReader(const std::vector<CameraReader> &readers,
+                                         std::chrono::nanoseconds tolerance) :
+        Tolerance(tolerance)
+    {
+        if (readers.empty()) throw std::invalid_argument("Camera group reader requires at least one picture.");
+        if (tolerance.count() < 0)
+            throw std::invalid_argument("Tolerance of camera group reader must not be negative.");
+        Members.reserve(readers.size());
+        for (const auto& reader : readers)
+        {
+            // Stamp rings are mapped by the copied readers, so they are not mapped again.
+            auto& member = Members.emplace_back(Member{reader});
+            member.Stamps = member.Reader.GetStamps();
+            if (!member.Stamps)
+                throw std::runtime_error("Server of picture " + reader.PictureName + " of camera " +
+                                         reader.DeviceName + " does not publish picture stamps.");
+            member.ConsumedSequence = member.Stamps->GetCount();
+        }
+        Statistics.UnmatchedCounts.assign(Members.size(), 0);
+    }
+
+    /// Drop pictures which may be overwritten before they are copied.
+    std::uint64_t CameraGroupReader::SkipStalePictures(std::size_t member_index)
+    {
+        auto& member = Members[member_index];
+        // The block of sequence s is rewritten once (count - s + 1) reaches the count of blocks.
+        const std::uint64_t blocks_count = std::min(member.Reader.GetBlocksCount(), member.Stamps->GetCapacity());
+        const auto count = member.Stamps->GetCount();
+        const auto oldest_sequence = count + 2 > blocks_count ? count + 2 - blocks_count : 1;
+        if (member.ConsumedSequence + 1 < oldest_sequence) Consume(member_index, oldest_sequence - 1, false);
+        return member.ConsumedSequence + 1;
+    }
+
+    /// Find the buffered picture nearest in time.
+    std::optional<PictureStamp> CameraGroupReader::FindNearest(std::size_t member_index,
+                                                               std::uint64_t timestamp) const
+    {
+        const auto& member = Members[member_index];
+        const auto count = member.Stamps->GetCount();
+        std::optional<PictureStamp> nearest;
+        for (auto sequence = member.ConsumedSequence + 1; sequence <= count; ++sequence)
+        {
+            auto stamp = member.Stamps->Read(sequence);
+            if (!stamp) continue;
+            if (!nearest || GetDistance(stamp->MonotonicTimestamp, timestamp) <
+                            GetDistance(nearest->MonotonicTimestamp, timestamp))
+            {
+                nearest = stamp;
+            }
+            // Captures only grow, so later pictures are farther.
+            if (stamp->MonotonicTimestamp >= timestamp) break;
+        }
+        return nearest;
+    }
+
+    /// Mark pictures up to the given sequence as consumed.
+    void CameraGroupReader::Consume(std::size_t member_index, std::uint64_t sequence, bool delivered)
+    {
+        auto& member = Members[member_index];
+        if (sequence <= member.ConsumedSequence) return;
+        Statistics.UnmatchedCounts[member_index] += sequence - member.ConsumedSequence - (delivered ? 1 : 0);
+        member.ConsumedSequence = sequence;
+    }
+
+    /// Wait for and read a group frame.
+    std::optional<CameraGroupReader::GroupFrame> CameraGroupReader::Read(std::chrono::milliseconds timeout)
+    {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        const auto tolerance = static_cast<std::uint64_t>(Tolerance.count());
+        while (true)
+        {
+            // Every member requires a picture which is not consumed yet.
+            for (auto& member : Members)
+            {
+                if (!member.Stamps->WaitNewer(member.ConsumedSequence, deadline - std::chrono::steady_clock::now()))
+                {
+                    PublishStatistics();
+                    return std::nullopt;
+                }
+            }
+
+            // The member whose latest capture is the oldest gives the reference picture.
+            std::optional<PictureStamp> reference;
+            std::size_t reference_index = 0;
+            bool overwritten = false;
+            for (std::size_t member_index = 0; member_index < Members.size() && !overwritten; ++member_index)
+            {
+                SkipStalePictures(member_index);
+                auto latest = Members[member_index].Stamps->Read(Members[member_index].Stamps->GetCount());
+                overwritten = !latest;
+                if (latest && (!reference || latest->MonotonicTimestamp < reference->MonotonicTimestamp))
+                {
+                    reference = latest;
+                    reference_index = member_index;
+                }
+            }
+            if (overwritten) continue;
+
+            std::vector<PictureStamp> stamps(Members.size());
+            bool matched = true;
+            for (std::size_t member_index = 0; member_index < Members.size(); ++member_index)
+            {
+                auto nearest = member_index == reference_index ?
+                        reference : FindNearest(member_index, reference->MonotonicTimestamp);
+                if (!nearest || GetDistance(nearest->MonotonicTimestamp, reference->MonotonicTimestamp) > tolerance)
+                {
+                    matched = false;
+                    break;
+                }
+                stamps[member_index] = *nearest;
+            }
+
+            if (!matched)
+            {
+                // Later references are not older than this one, so pictures out of its tolerance are dropped.
+                Consume(reference_index, reference->Sequence, false);
+                for (std::size_t member_index = 0; member_index < Members.size(); ++member_index)
+                {
+                    if (member_index == reference_index) continue;
+                    auto& member = Members[member_index];
+                    auto last_stale_sequence = member.ConsumedSequence;
+                    const auto count = member.Stamps->GetCount();
+                    for (auto sequence = member.ConsumedSequence + 1; sequence <= count; ++sequence)
+                    {
+                        auto stamp = member.Stamps->Read(sequence);
+                        if (stamp && stamp->MonotonicTimestamp + tolerance >= reference->MonotonicTimestamp) break;
+                        last_stale_sequence = sequence;
+                    }
+                    Consume(member_index, last_stale_sequence, false);
+                }
+                continue;
+            }
+
+            GroupFrame frame;
+            frame.Pictures.reserve(Members.size());
+            frame.Timestamps.reserve(Members.size());
+            frame.MonotonicTimestamps.reserve(Members.size());
+            frame.Sequences.reserve(Members.size());
+            for (std::size_t member_index = 0; member_index < Members.size(); ++member_index)
+            {
+                frame.Pictures.push_back(Members[member_index].Reader.ReadBlock(stamps[member_index].BlockID));
+                frame.Timestamps.push_back(stamps[member_index].Timestamp);
+                frame.MonotonicTimestamps.push_back(stamps[member_index].MonotonicTimestamp);
+                frame.Sequences.push_back(stamps[member_index].Sequence);
+            }
+            // Pictures whose blocks are rewritten during the copy are torn, so the whole group frame is discarded.
+            for (std::size_t member_index = 0; member_index < Members.size(); ++member_index)
+            {
+                const auto& member = Members[member_index];
+                const std::uint64_t blocks_count = std::min(member.Reader.GetBlocksCount(),
+                                                            member.Stamps->GetCapacity());
+                if (member.Stamps->GetCount() - stamps[member_index].Sequence + 1 >= blocks_count) overwritten = true;
+            }
+            for (std::size_t member_index = 0; member_index < Members.size(); ++member_index)
+            {
+                Consume(member_index, stamps[member_index].Sequence, !overwritten);
+            }
+            if (overwritten)
+            {
+                ++Statistics.OverwrittenCount;
+                continue;
+            }
+
+            auto [earliest, latest] = std::minmax_element(frame.MonotonicTimestamps.begin(),
+                                                          frame.MonotonicTimestamps.end());
+            frame.Skew = *latest - *earliest;
+            ++Statistics.MatchedCount;
+            Statistics.LastSkew = frame.Skew;
+            Statistics.MaxSkew = std::max(Statistics.MaxSkew, frame.Skew);
+            Statistics.MeanSkew += (static_cast<double>(frame.Skew) - Statistics.MeanSkew) /
+                    static_cast<double>(Statistics.MatchedCount);
+            PublishStatistics();
+            return frame;
+        }
+    }
+
+    /// Publish statistics to status keys of member pictures.
+    void CameraGroupReader::PublishStatistics()
+    {
+        auto current_time_point = std::chrono::steady_clock::now();
+        if (current_time_point - LastPublishTimePoint < std::chrono::seconds(1)) return;
+        LastPublishTimePoint = current_time_point;
+        // Keys expire like heartbeats, so statistics of finished group readers disappear.
+        const auto ttl = std::chrono::seconds(3);
+        for (std::size_t member_index = 0; member_index < Members.size(); ++member_index)
+        {
+            const auto& reader = Members[member_index].Reader;
+            const auto key_prefix = "cameras/" + reader.DeviceName + "/pictures/" + reader.PictureName + "/group_";
+            try
+            {
+                auto pipeline = reader.Connection->pipeline();
+                pipeline.set(key_prefix + "matched", std::to_string(Statistics.MatchedCount), ttl);
+                pipeline.set(key_prefix + "overwritten", std::to_string(Statistics.OverwrittenCount), ttl);
+                pipeline.set(key_prefix + "unmatched", std::to_string(Statistics.UnmatchedCounts[member_index]), ttl);
+                pipeline.set(key_prefix + "skew", std::to_string(static_cast<std::uint64_t>(Statistics.MeanSkew)),
+                             ttl);
+                pipeline.set(key_prefix + "skew_max", std::to_string(Statistics.MaxSkew), ttl);
+                pipeline.exec();
+            }catch (sw::redis::Error& error)
+            {
+                // Statistics are informative, so a failed publication does not fail the read.
+            }
+        }
+    }
+
+    /// Reset statistics of matching.
+    void CameraGroupReader::ResetStatistics()
+    {
+        Statistics = MatchStatistics();
+        Statistics.UnmatchedCounts.assign(Members.size(), 0);
+    }
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "CameraReader.hpp"
+#include "PictureStampRing.hpp"
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Reader of pictures from several cameras which are captured at the same time.
+     * @details
+     *  Capture times of every picture still buffered in the swap chains are read from the stamp rings
+     *  published by the camera servers, so matching takes no Redis round trip and has nanosecond resolution.
+     *  Pictures are matched by their capture times in the monotonic host clock, which are mapped from
+     *  device clocks for cameras which stamp their pictures, so NTP adjustments do not affect matching.
+     *  A group frame is matched around the picture whose latest capture is the oldest among all members:
+     *  every other member takes its buffered picture nearest in time to it.
+     *  Since captures of every member only grow, a picture which can not be matched at this point
+     *  will never be matched, so it is dropped instead of waited for.
+     *  Statistics of matching are published at most once per second to expiring status keys of every member
+     *  picture: "group_matched", "group_overwritten", "group_unmatched", "group_skew" and "group_skew_max".
+     *  This reader is not thread safe, use one reader per consuming thread.
+     */
+    class CameraGroupReader
+    {
+    public:
+        /// Pictures of all members captured at the same time.
+        struct GroupFrame
+        {
+            /// Pictures in the order of readers given to the constructor.
+            std::vector<cv::Mat> Pictures;
+            /// Capture times of pictures in nanoseconds since epoch.
+            std::vector<std::uint64_t> Timestamps;
+            /// Capture times of pictures in CLOCK_MONOTONIC_RAW nanoseconds of the host, which are matched.
+            std::vector<std::uint64_t> MonotonicTimestamps;
+            /// Sequence numbers of pictures in their swap chains.
+            std::vector<std::uint64_t> Sequences;
+            /// Difference between the latest and the earliest capture time in nanoseconds.
+            std::uint64_t Skew {0};
+        };
+
+        /// Statistics of matching since the reader is constructed or the statistics are reset.
+        struct MatchStatistics
+        {
+            /// Count of delivered group frames.
+            std::uint64_t MatchedCount {0};
+            /// Count of group frames discarded because a block was overwritten while it was copied.
+            std::uint64_t OverwrittenCount {0};
+            /// Count of pictures of every member which are not delivered in any group frame.
+            std::vector<std::uint64_t> UnmatchedCounts;
+            /// Skew of the latest delivered group frame in nanoseconds.
+            std::uint64_t LastSkew {0};
+            /// Maximum skew of delivered group frames in nanoseconds.
+            std::uint64_t MaxSkew {0};
+            /// Mean skew of delivered group frames in nanoseconds.
+            double MeanSkew {0.0};
+        };
+
+    private:
+        /// Member picture of the group.
+        struct Member
+        {
+            /// Reader of the picture.
+            CameraReader Reader;
+            /// Capture times of the picture, owned by the reader.
+            const PictureStampRing* Stamps {nullptr};
+            /// Sequence number of the latest picture which is delivered or dropped.
+            std::uint64_t ConsumedSequence {0};
+        };
+
+        /// Members of the group.
+        std::vector<Member> Members;
+        /// Maximum difference between capture times of pictures in a group frame.
+        const std::chrono::nanoseconds Tolerance;
+        /// Statistics of matching.
+        MatchStatistics Statistics;
+        /// Time point of the latest publication of statistics.
+        std::chrono::steady_clock::time_point LastPublishTimePoint {};
+
+        /// Publish statistics to status keys of member pictures if they are not published in the last second.
+        void PublishStatistics();
+
+        /**
+         * @brief Get the oldest sequence of a member whose picture can be matched and copied.
+         * @details Older pictures are dropped and counted as unmatched.
+         */
+        std::uint64_t SkipStalePictures(std::size_t member_index);
+
+        /**
+         * @brief Find the buffered picture of a member whose capture time is nearest to the given one.
+         * @return Stamp of the picture, or std::nullopt if no picture is buffered.
+         */
+        [[nodiscard]] std::optional<PictureStamp> FindNearest(std::size_t member_index,
+                                                              std::uint64_t timestamp) const;
+
+        /// Mark pictures of a member up to the given sequence as consumed, skipped ones are counted as unmatched.
+        void Consume(std::size_t member_index, std::uint64_t sequence, bool delivered);
+
+    public:
+        /**
+         * @brief Follow stamp rings of the given pictures.
+         * @param readers Readers of member pictures, which can be got from clients of different cameras.
+         * @param tolerance Maximum difference between capture times of pictures in a group frame.
+         * @details Pictures committed before the construction are not delivered.
+         * @throw std::runtime_error If the server of a member picture does not publish picture stamps.
+         */
+        CameraGroupReader(const std::vector<CameraReader>& readers, std::chrono::nanoseconds tolerance);
+
+        /**
+         * @brief Wait for pictures of all members captured within the tolerance, and read them.
+         * @param timeout Time to wait at most.
+         * @return Matched group frame, or std::nullopt if no group frame is matched before the timeout.
+         */
+        std::optional<GroupFrame> Read(std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+
+        /// Get the count of member pictures.
+        [[nodiscard]] inline std::size_t GetMembersCount() const noexcept
+        {
+            return Members.size();
+        }
+
+        /// Get statistics of matching.
+        [[nodiscard]] inline const MatchStatistics& GetStatistics() const noexcept
+        {
+            return Statistics;
+        }
+
+        /// Reset statistics of matching.
+        void ResetStatistics();
+    };
+}
@@ -1,6 +1,18 @@
 #include "CameraReader.hpp"
 
+#include <algorithm>
+#include <cstdint>
 #include <exception>
+#include <limits>
+#include <thread>
+#include <ctime>
+#include <type_traits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "MemoryHints.hpp"
 
 namespace Gaia::CameraService
 {
@@ -9,8 +21,9 @@ namespace Gaia::CameraService
                                const std::string& picture_name) :
         Connection(std::move(connection)), MemoryBlockName(device_name + "." + picture_name),
         StatusTimestampKeyName("cameras/" + device_name + "/pictures/" + picture_name + "/timestamp"),
-        StatusFPSKeyName("cameras/" + device_name + "/pictures/" + picture_name + "/timestamp"),
         StatusBlockIDKeyName("cameras/" + device_name + "/pictures/" + picture_name + "/id"),
+        StatusFPSKeyName("cameras/" + device_name + "/pictures/" + picture_name + "/timestamp"),
+        HeartbeatKeyName("cameras/" + device_name + "/pictures/" + picture_name + "/heartbeat"),
         DeviceName(device_name), PictureName(picture_name)
     {
         InitializeReaders(device_name, picture_name);
@@ -20,22 +33,436 @@ namespace Gaia::CameraService
     CameraReader::CameraReader(const CameraReader &target) :
         Connection(target.Connection), MemoryBlockName(target.MemoryBlockName),
         StatusTimestampKeyName(target.StatusTimestampKeyName),
+        StatusBlockIDKeyName(target.StatusBlockIDKeyName),
         StatusFPSKeyName(target.StatusFPSKeyName),
+        HeartbeatKeyName(target.HeartbeatKeyName),
         DeviceName(target.DeviceName), PictureName(target.PictureName)
     {
         InitializeReaders(DeviceName, PictureName);
     }
 
-    /// Read the current picture.
-    cv::Mat CameraReader::Read() const
+    namespace
+    {
+        /// Count of attempts to copy the latest picture before a read fails.
+        constexpr unsigned int ReadAttemptsCount = 3;
+
+        /// Get the OpenCV type of pixels described by the picture header.
+        int ResolvePixelType(const SharedPicture::PictureHeader& header)
+        {
+            using PixelTypes = SharedPicture::PictureHeader::PixelTypes;
+            auto bits = static_cast<unsigned int>(header.PixelBits);
+            int depth = CV_8U;
+            switch (header.PixelType)
+            {
+                case PixelTypes::Unsigned:
+                    depth = bits == 16 ? CV_16U : CV_8U;
+                    break;
+                case PixelTypes::Signed:
+                    depth = bits == 32 ? CV_32S : bits == 16 ? CV_16S : CV_8S;
+                    break;
+                case PixelTypes::Float:
+                    depth = bits == 64 ? CV_64F : CV_32F;
+                    break;
+            }
+            return CV_MAKETYPE(depth, static_cast<int>(header.Channels));
+        }
+
+        /**
+         * @brief Resolve the source area and the size of the tensor.
+         * @param width Width of the picture.
+         * @param height Height of the picture.
+         */
+        void ResolveTensorGeometry(int width, int height, const CameraReader::TensorOptions& options,
+                                   cv::Rect& area, cv::Size& size)
+        {
+            const cv::Rect picture_area(0, 0, width, height);
+            area = options.Area.empty() ? picture_area : options.Area & picture_area;
+            if (area.empty()) throw std::runtime_error("Area to read is outside of the picture.");
+            size = options.Size.empty() ? area.size() : options.Size;
+        }
+
+        #ifdef __SSE2__
+        /// Interpolate 8 unsigned 16 bits values of two rows into floats.
+        inline void BlendWords(__m128i top, __m128i bottom, __m128 weights, float* target)
+        {
+            const auto zero = _mm_setzero_si128();
+            auto top_low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(top, zero));
+            auto top_high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(top, zero));
+            auto bottom_low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(bottom, zero));
+            auto bottom_high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(bottom, zero));
+            _mm_storeu_ps(target, _mm_add_ps(top_low, _mm_mul_ps(_mm_sub_ps(bottom_low, top_low), weights)));
+            _mm_storeu_ps(target + 4, _mm_add_ps(top_high, _mm_mul_ps(_mm_sub_ps(bottom_high, top_high), weights)));
+        }
+        #endif
+
+        /// Interpolate two rows into a row of floats, with SSE2 if it is available.
+        template <typename Pixel>
+        void BlendRows(const Pixel* top, const Pixel* bottom, float weight, float* target, std::size_t length)
+        {
+            std::size_t index = 0;
+            #ifdef __SSE2__
+            const auto weights = _mm_set1_ps(weight);
+            if constexpr (std::is_same_v<Pixel, std::uint8_t>)
+            {
+                const auto zero = _mm_setzero_si128();
+                for (; index + 16 <= length; index += 16)
+                {
+                    auto top_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + index));
+                    auto bottom_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + index));
+                    BlendWords(_mm_unpacklo_epi8(top_bytes, zero), _mm_unpacklo_epi8(bottom_bytes, zero),
+                               weights, target + index);
+                    BlendWords(_mm_unpackhi_epi8(top_bytes, zero), _mm_unpackhi_epi8(bottom_bytes, zero),
+                               weights, target + index + 8);
+                }
+            }
+            else
+            {
+                for (; index + 8 <= length; index += 8)
+                {
+                    BlendWords(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top + index)),
+                               _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + index)),
+                               weights, target + index);
+                }
+            }
+            #endif
+            for (; index < length; ++index)
+            {
+                auto top_value = static_cast<float>(top[index]);
+                target[index] = top_value + (static_cast<float>(bottom[index]) - top_value) * weight;
+            }
+        }
+
+        /// Convert the area of the picture into a float CHW tensor in one pass.
+        template <typename Pixel>
+        void ConvertToTensor(const cv::Mat& picture, const cv::Rect& area, const cv::Size& size,
+                             const CameraReader::TensorOptions& options, float* destination)
+        {
+            const int source_channels = picture.channels();
+            const int channels = source_channels == 1 ? 1 : 3;
+            // (value * scale - mean) / std is folded into value * gain + bias.
+            std::array<float, 3> gains {};
+            std::array<float, 3> biases {};
+            std::array<int, 3> channel_map {0, 1, 2};
+            for (int channel = 0; channel < channels; ++channel)
+            {
+                gains[channel] = options.Scale / options.Std[channel];
+                biases[channel] = -options.Mean[channel] / options.Std[channel];
+            }
+            if (channels == 3 && options.SwapRedBlue) channel_map = {2, 1, 0};
+            const auto plane_size = static_cast<std::size_t>(size.area());
+
+            if (size == area.size())
+            {
+                for (int row = 0; row < size.height; ++row)
+                {
+                    const auto* source_row = picture.ptr<Pixel>(area.y + row) + area.x * source_channels;
+                    for (int channel = 0; channel < channels; ++channel)
+                    {
+                        auto* target_row = destination + channel * plane_size +
+                                static_cast<std::size_t>(row) * size.width;
+                        const auto* source_pixel = source_row + channel_map[channel];
+                        const auto gain = gains[channel];
+                        const auto bias = biases[channel];
+                        for (int column = 0; column < size.width; ++column)
+                        {
+                            target_row[column] =
+                                    static_cast<float>(source_pixel[column * source_channels]) * gain + bias;
+                        }
+                    }
+                }
+                return;
+            }
+
+            // Bilinear sampling with pixel centers aligned, horizontal offsets and weights are shared by all rows.
+            const auto horizontal_ratio = static_cast<float>(area.width) / static_cast<float>(size.width);
+            const auto vertical_ratio = static_cast<float>(area.height) / static_cast<float>(size.height);
+            std::vector<int> left_offsets(size.width);
+            std::vector<int> right_offsets(size.width);
+            std::vector<float> right_weights(size.width);
+            for (int column = 0; column < size.width; ++column)
+            {
+                auto position = std::clamp((static_cast<float>(column) + 0.5f) * horizontal_ratio - 0.5f,
+                                           0.0f, static_cast<float>(area.width - 1));
+                auto left = static_cast<int>(position);
+                left_offsets[column] = left * source_channels;
+                right_offsets[column] = std::min(left + 1, area.width - 1) * source_channels;
+                right_weights[column] = position - static_cast<float>(left);
+            }
+            // Every output row blends its two source rows once, then all planes are sampled from the blended row.
+            const auto blended_length = static_cast<std::size_t>(area.width) * source_channels;
+            std::vector<float> blended_row(blended_length);
+            for (int row = 0; row < size.height; ++row)
+            {
+                auto position = std::clamp((static_cast<float>(row) + 0.5f) * vertical_ratio - 0.5f,
+                                           0.0f, static_cast<float>(area.height - 1));
+                auto top = static_cast<int>(position);
+                const auto* top_row = picture.ptr<Pixel>(area.y + top) + area.x * source_channels;
+                const auto* bottom_row = picture.ptr<Pixel>(area.y + std::min(top + 1, area.height - 1)) +
+                        area.x * source_channels;
+                BlendRows(top_row, bottom_row, position - static_cast<float>(top), blended_row.data(),
+                          blended_length);
+
+                std::array<float*, 3> target_rows {};
+                std::array<const float*, 3> source_rows {};
+                for (int channel = 0; channel < channels; ++channel)
+                {
+                    target_rows[channel] = destination + channel * plane_size +
+                            static_cast<std::size_t>(row) * size.width;
+                    source_rows[channel] = blended_row.data() + channel_map[channel];
+                }
+                int column = 0;
+                #ifdef __SSE2__
+                // SSE2 has no gather, so 4 columns are gathered by scalar loads and interpolated at once.
+                for (; column + 4 <= size.width; column += 4)
+                {
+                    const auto* lefts = left_offsets.data() + column;
+                    const auto* rights = right_offsets.data() + column;
+                    const auto weights = _mm_loadu_ps(right_weights.data() + column);
+                    for (int channel = 0; channel < channels; ++channel)
+                    {
+                        const auto* source = source_rows[channel];
+                        auto left_values = _mm_set_ps(source[lefts[3]], source[lefts[2]],
+                                                      source[lefts[1]], source[lefts[0]]);
+                        auto right_values = _mm_set_ps(source[rights[3]], source[rights[2]],
+                                                       source[rights[1]], source[rights[0]]);
+                        auto values = _mm_add_ps(left_values,
+                                                 _mm_mul_ps(_mm_sub_ps(right_values, left_values), weights));
+                        _mm_storeu_ps(target_rows[channel] + column,
+                                      _mm_add_ps(_mm_mul_ps(values, _mm_set1_ps(gains[channel])),
+                                                 _mm_set1_ps(biases[channel])));
+                    }
+                }
+                #endif
+                for (; column < size.width; ++column)
+                {
+                    const auto left = left_offsets[column];
+                    const auto right = right_offsets[column];
+                    const auto weight = right_weights[column];
+                    for (int channel = 0; channel < channels; ++channel)
+                    {
+                        const auto* source = source_rows[channel];
+                        auto value = source[left] + (source[right] - source[left]) * weight;
+                        target_rows[channel][column] = value * gains[channel] + biases[channel];
+                    }
+                }
+            }
+        }
+    }
+
+    /// Read the ID of the latest committed block.
+    unsigned int CameraReader::ReadBlockID() const
     {
         auto block_id_text = Connection->get(StatusBlockIDKeyName);
         if (!block_id_text.has_value())
             throw std::runtime_error("Picture swap chain id is empty.");
-        auto block_id = std::stoi(*block_id_text);
+        return static_cast<unsigned int>(std::stoul(*block_id_text));
+    }
+
+    /// Get a matrix header over the picture in the given block.
+    cv::Mat CameraReader::ViewBlock(unsigned int block_id) const
+    {
+        PrepareReader(block_id);
+        UpdateHeartbeat();
+        ReadingSequence = FindSequence(block_id);
+        auto& reader = *Readers[block_id];
+        auto header = reader.GetHeader();
+        auto* data = static_cast<std::uint8_t*>(reader.GetPointer()) + PictureOffset;
+        if (RowStride == 0)
+        {
+            return {static_cast<int>(header.Height), static_cast<int>(header.Width), ResolvePixelType(header), data};
+        }
+        return {static_cast<int>(header.Height), static_cast<int>(header.Width), ResolvePixelType(header), data,
+                RowStride};
+    }
+
+    /// Read the current picture.
+    cv::Mat CameraReader::Read() const
+    {
+        cv::Mat picture;
+        ReadInto(picture);
+        return picture;
+    }
+
+    /// Read the given area of the current picture.
+    cv::Mat CameraReader::Read(const cv::Rect &area) const
+    {
+        cv::Mat picture;
+        ReadInto(picture, area);
+        return picture;
+    }
+
+    /// Read the current picture into the given matrix.
+    void CameraReader::ReadInto(cv::Mat &destination) const
+    {
+        // copyTo() only reallocates the destination when its size or type differs.
+        ReadLatest([&destination](const cv::Mat& view){
+            view.copyTo(destination);
+        });
+    }
+
+    /// Read the given area of the current picture into the given matrix.
+    void CameraReader::ReadInto(cv::Mat &destination, const cv::Rect &area) const
+    {
+        ReadLatest([&destination, &area](const cv::Mat& view){
+            auto clipped_area = area & cv::Rect(0, 0, view.cols, view.rows);
+            if (clipped_area.empty()) throw std::runtime_error("Area to read is outside of the picture.");
+            view(clipped_area).copyTo(destination);
+        });
+    }
+
+    /// Read the picture in the given swap chain block.
+    cv::Mat CameraReader::ReadBlock(unsigned int block_id) const
+    {
+        PrepareReader(block_id);
+        cv::Mat picture;
+        // Blocks written with aligned rows are copied into a packed picture.
+        if (RowStride != 0)
+        {
+            picture = ViewBlock(block_id).clone();
+        }
+        else
+        {
+            UpdateHeartbeat();
+            ReadingSequence = FindSequence(block_id);
+            picture = Readers[block_id]->Read();
+        }
+        FinishRead();
+        return picture;
+    }
+
+    /// Consume pictures in order through the cursor.
+    void CameraReader::EnableCursor()
+    {
+        if (!Stamps || !Lags) throw std::runtime_error("Server of picture " + PictureName + " of camera " +
+                                                       DeviceName + " does not track readers.");
+        if (!Lags->IsRegistered()) throw std::runtime_error("No reader slot of picture " + PictureName +
+                                                            " of camera " + DeviceName + " is free.");
+        Cursor = Stamps->GetCount();
+        MissedFramesCount = 0;
+        Lags->EnableCursor(Cursor);
+        CursorEnabled = true;
+    }
+
+    /// Stop consuming pictures through the cursor.
+    void CameraReader::DisableCursor()
+    {
+        if (Lags) Lags->DisableCursor();
+        CursorEnabled = false;
+    }
+
+    /// Let ReadNext() return only every N-th picture.
+    void CameraReader::SetDecimation(unsigned int interval)
+    {
+        if (interval == 0) throw std::invalid_argument("Decimation interval must be at least 1.");
+        DecimationInterval = interval;
+    }
+
+    /// Let ReadNext() return at most the given count of pictures per second.
+    void CameraReader::SetRateLimit(double frames_per_second)
+    {
+        if (frames_per_second < 0) throw std::invalid_argument("Rate limit must not be negative.");
+        RatePeriod = frames_per_second > 0 ? static_cast<std::uint64_t>(1e9 / frames_per_second) : 0;
+        LastRateSlot = 0;
+    }
+
+    /// Estimate the interval between commits.
+    std::uint64_t CameraReader::EstimateFrameInterval() const
+    {
+        constexpr std::uint64_t span = 8;
+        const auto count = Stamps->GetCount();
+        if (count < 2) return 0;
+        const auto first_sequence = count > span ? count - span : 1;
+        auto latest = Stamps->Read(count);
+        auto first = Stamps->Read(first_sequence);
+        if (!latest || !first || latest->MonotonicTimestamp <= first->MonotonicTimestamp) return 0;
+        return (latest->MonotonicTimestamp - first->MonotonicTimestamp) / (count - first_sequence);
+    }
+
+    /// Wait until the picture with the given sequence is committed.
+    bool CameraReader::WaitForSequence(std::uint64_t sequence, std::chrono::steady_clock::time_point deadline)
+    {
+        while (true)
+        {
+            const auto count = Stamps->GetCount();
+            if (count >= sequence) return true;
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline) return false;
+            // Sleeping until just before the previous commit wakes up twice per picture instead of once per commit.
+            const auto interval = EstimateFrameInterval();
+            if (sequence - count > 1 && interval > 0)
+            {
+                std::this_thread::sleep_until(std::min(deadline, now + std::chrono::nanoseconds(
+                        (sequence - count - 1) * interval * 9 / 10)));
+                continue;
+            }
+            Stamps->WaitNewer(count, deadline - now);
+        }
+    }
+
+    /// Sleep until the next rate limit slot begins.
+    bool CameraReader::WaitForRateSlot(std::chrono::steady_clock::time_point deadline)
+    {
+        if (RatePeriod == 0 || LastRateSlot == 0) return true;
+        timespec time {};
+        clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+        const auto now = static_cast<std::uint64_t>(time.tv_sec) * 1000000000ull +
+                         static_cast<std::uint64_t>(time.tv_nsec);
+        const auto slot_begin = (LastRateSlot + 1) * RatePeriod;
+        if (slot_begin <= now) return true;
+        const auto wake_time = std::chrono::steady_clock::now() + std::chrono::nanoseconds(slot_begin - now);
+        // Pictures before the slot are not wanted, so the server does not wait for this cursor meanwhile.
+        if (CursorEnabled) Lags->AdvanceCursor(std::numeric_limits<std::uint64_t>::max() / 2);
+        std::this_thread::sleep_until(std::min(wake_time, deadline));
+        return wake_time <= deadline;
+    }
+
+    /// Copy the next picture which passes the decimation and the rate limit.
+    std::optional<CameraReader::CursorFrame> CameraReader::ReadNext(std::chrono::milliseconds timeout)
+    {
+        if (!Stamps) throw std::runtime_error("Server of picture " + PictureName + " of camera " + DeviceName +
+                                              " does not publish picture stamps.");
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        std::uint64_t missed_count = 0;
+        while (true)
+        {
+            if (!WaitForRateSlot(deadline)) return std::nullopt;
+            const auto target_sequence = Cursor + DecimationInterval;
+            // Pictures before the target are skipped anyway, so the server does not wait for them.
+            if (CursorEnabled) Lags->AdvanceCursor(target_sequence - 1);
+            if (!WaitForSequence(target_sequence, deadline)) return std::nullopt;
+
+            // Pictures older than the safe depth may be rewritten, so the cursor skips them as missed.
+            const auto count = Stamps->GetCount();
+            const std::uint64_t depth = Stamps->GetDepth();
+            const auto oldest_sequence = count + 2 > depth ? count + 2 - depth : 1;
+            const auto sequence = CursorEnabled ? std::max(target_sequence, oldest_sequence) : count;
+            auto stamp = Stamps->Read(sequence);
+            if (!stamp) continue;
+            if (RatePeriod != 0 && stamp->MonotonicTimestamp / RatePeriod <= LastRateSlot)
+            {
+                if (CursorEnabled) missed_count += sequence - target_sequence;
+                Cursor = sequence;
+                continue;
+            }
+
+            CursorFrame frame;
+            auto view = ViewBlock(stamp->BlockID);
+            ReadingSequence = sequence;
+            frame.Picture = view.clone();
+            if (Stamps->GetCount() - sequence + 1 >= Stamps->GetDepth()) continue;
+            FinishRead();
 
-        if (block_id >= Readers.size()) throw std::runtime_error("Swap chain block ID out of range.");
-        return Readers[block_id]->Read();
+            frame.Sequence = sequence;
+            frame.Timestamp = stamp->Timestamp;
+            frame.MonotonicTimestamp = stamp->MonotonicTimestamp;
+            frame.Unchanged = (stamp->Flags & PictureStamp::UnchangedFlag) != 0;
+            if (CursorEnabled) frame.MissedCount = missed_count + sequence - target_sequence;
+            MissedFramesCount += frame.MissedCount;
+            Cursor = sequence;
+            if (RatePeriod != 0) LastRateSlot = stamp->MonotonicTimestamp / RatePeriod;
+            if (CursorEnabled) Lags->AdvanceCursor(Cursor);
+            return frame;
+        }
     }
 
     /// Get the timestamp of the current picture.
@@ -56,6 +483,16 @@ namespace Gaia::CameraService
         return 0;
     }
 
+    /// Refresh the heartbeat of this picture.
+    void CameraReader::UpdateHeartbeat() const
+    {
+        auto current_time_point = std::chrono::steady_clock::now();
+        if (current_time_point - LastHeartbeatTimePoint < std::chrono::seconds(1)) return;
+        // The server checks heartbeats every second, so it expires after missing a few of them.
+        Connection->set(HeartbeatKeyName, "1", std::chrono::seconds(3));
+        LastHeartbeatTimePoint = current_time_point;
+    }
+
     /// Initialize the readers.
     void CameraReader::InitializeReaders(const std::string& device_name, const std::string& picture_name)
     {
@@ -63,15 +500,199 @@ namespace Gaia::CameraService
         if (!count_text.has_value()) throw std::runtime_error("Picture " + picture_name + " of camera " +
             device_name + " has not defined blocks count.");
         auto count = std::stoi(*count_text);
+        // Blocks of servers which do not publish the layout are tightly packed.
+        auto key_prefix = "cameras/" + device_name + "/pictures/" + picture_name;
+        auto offset_text = Connection->get(key_prefix + "/offset");
+        auto stride_text = Connection->get(key_prefix + "/stride");
+        PictureOffset = offset_text ? std::stoul(*offset_text) : 0;
+        RowStride = stride_text ? std::stoul(*stride_text) : 0;
+
+        // Servers which do not publish stamps or track readers are still readable, without lag reports.
+        // Stamps are opened before blocks, so generations of blocks are known when they are mapped.
+        try
+        {
+            Stamps = std::make_unique<PictureStampRing>(PictureStampRing::GenerateBlockName(device_name, picture_name));
+            Lags = std::make_unique<ReaderLagTable>(ReaderLagTable::GenerateBlockName(device_name, picture_name));
+        }catch (std::runtime_error&)
+        {
+            Stamps.reset();
+            Lags.reset();
+        }
 
         Readers.clear();
-        Readers.reserve(count);
-        for (auto chain_index = 0; chain_index < count; ++chain_index)
+        ReaderGenerations.clear();
+        if (count > 0) ExtendReaders(static_cast<unsigned int>(count - 1));
+    }
+
+    /// Map the swap chain blocks up to the given ID.
+    void CameraReader::ExtendReaders(unsigned int block_id) const
+    {
+        Readers.reserve(block_id + 1);
+        ReaderGenerations.reserve(block_id + 1);
+        for (auto chain_index = static_cast<unsigned int>(Readers.size()); chain_index <= block_id; ++chain_index)
+        {
+            Readers.emplace_back();
+            ReaderGenerations.emplace_back(0);
+            try
+            {
+                MapReader(chain_index);
+            }catch (std::runtime_error&)
+            {
+                Readers.pop_back();
+                ReaderGenerations.pop_back();
+                throw;
+            }
+        }
+    }
+
+    /// Map the swap chain block with the given ID.
+    void CameraReader::MapReader(unsigned int block_id) const
+    {
+        // The generation is taken before mapping, so a block recreated meanwhile is only remapped once more.
+        auto generation = Stamps ? Stamps->GetBlockGeneration(block_id) : 0;
+        std::unique_ptr<SharedPicture::PictureReader> reader;
+        try
+        {
+            reader = std::make_unique<SharedPicture::PictureReader>(MemoryBlockName + "." + std::to_string(block_id));
+        }catch (std::exception&)
+        {
+            throw std::runtime_error("Swap chain block ID out of range.");
+        }
+        // Mapped with the same hints as the server, so huge pages of the server are mapped as huge pages here,
+        // and page tables are filled now instead of on the first read. Both are ignored if unsupported.
+        auto block_size = static_cast<std::size_t>(reader->GetMaxSize());
+        AdviseHugePages(reader->GetPointer(), block_size);
+        PrefaultMemory(reader->GetPointer(), block_size, false);
+        Readers[block_id] = std::move(reader);
+        ReaderGenerations[block_id] = generation;
+    }
+
+    /// Make sure the reader of the given block maps the current shared block.
+    void CameraReader::PrepareReader(unsigned int block_id) const
+    {
+        if (block_id >= Readers.size())
+        {
+            ExtendReaders(block_id);
+            return;
+        }
+        if (Stamps && Stamps->GetBlockGeneration(block_id) != ReaderGenerations[block_id]) MapReader(block_id);
+    }
+
+    /// Find the sequence of the picture in the given block.
+    std::uint64_t CameraReader::FindSequence(unsigned int block_id) const
+    {
+        if (!Stamps) return 0;
+        // The picture being read is usually the latest one, so stamps are searched from the latest.
+        const auto count = Stamps->GetCount();
+        for (auto sequence = count; sequence > 0 && count - sequence < Stamps->GetCapacity(); --sequence)
+        {
+            auto stamp = Stamps->Read(sequence);
+            if (!stamp) break;
+            if (stamp->BlockID == block_id) return sequence;
+        }
+        return 0;
+    }
+
+    /// Report the lag of the finished read.
+    void CameraReader::FinishRead() const
+    {
+        if (!Lags || ReadingSequence == 0) return;
+        Lags->RecordRead(Stamps->GetCount() - ReadingSequence);
+        ReadingSequence = 0;
+    }
+
+    /// Check whether the picture in the given block is not rewritten yet.
+    bool CameraReader::IsBlockIntact(unsigned int block_id, std::uint64_t sequence) const
+    {
+        // Pictures without stamps can not be validated.
+        if (!Stamps || sequence == 0) return true;
+        return Stamps->GetBlockGeneration(block_id) == ReaderGenerations[block_id] &&
+               Stamps->GetCount() - sequence + 1 < Stamps->GetDepth();
+    }
+
+    /// Copy the latest picture, again if its block is rewritten during the copy.
+    void CameraReader::ReadLatest(const std::function<void(const cv::Mat&)>& copy) const
+    {
+        for (unsigned int attempt = 0; attempt < ReadAttemptsCount; ++attempt)
+        {
+            const auto block_id = ReadBlockID();
+            auto view = ViewBlock(block_id);
+            const auto sequence = ReadingSequence;
+            copy(view);
+            if (IsBlockIntact(block_id, sequence))
+            {
+                FinishRead();
+                return;
+            }
+        }
+        ReadingSequence = 0;
+        throw std::runtime_error("Picture " + PictureName + " of camera " + DeviceName +
+                                 " is rewritten during every attempt to read it.");
+    }
+
+    /// Get the header of the picture.
+    SharedPicture::PictureHeader CameraReader::GetPictureHeader() const
+    {
+        if (Readers.empty()) throw std::runtime_error("Picture has no swap chain block.");
+        return Readers.front()->GetHeader();
+    }
+
+    /// Get the OpenCV type of pixels of the picture.
+    int CameraReader::GetPixelType() const
+    {
+        return ResolvePixelType(GetPictureHeader());
+    }
+
+    /// Get the shape of tensors converted from this picture.
+    std::array<int, 3> CameraReader::GetTensorShape(const TensorOptions &options) const
+    {
+        auto header = GetPictureHeader();
+        cv::Rect area;
+        cv::Size size;
+        ResolveTensorGeometry(static_cast<int>(header.Width), static_cast<int>(header.Height), options, area, size);
+        return {header.Channels == 1 ? 1 : 3, size.height, size.width};
+    }
+
+    /// Read this picture as a float CHW tensor.
+    void CameraReader::ReadAsTensor(float *destination, const TensorOptions &options) const
+    {
+        ReadLatest([destination, &options](const cv::Mat& view){
+            if (view.channels() == 2 || view.channels() > 4)
+                throw std::runtime_error("Picture with " + std::to_string(view.channels()) +
+                                         " channels can not be read as a tensor.");
+            cv::Rect area;
+            cv::Size size;
+            ResolveTensorGeometry(view.cols, view.rows, options, area, size);
+            switch (view.depth())
+            {
+                case CV_8U:
+                    ConvertToTensor<std::uint8_t>(view, area, size, options, destination);
+                    break;
+                case CV_16U:
+                    ConvertToTensor<std::uint16_t>(view, area, size, options, destination);
+                    break;
+                default:
+                    throw std::runtime_error("Only 8 bits and 16 bits pictures can be read as tensors.");
+            }
+        });
+    }
+
+    /// Read pictures of several readers as a float NCHW tensor batch.
+    void CameraReader::ReadBatchAsTensor(const std::vector<const CameraReader*> &readers, float *destination,
+                                         const TensorOptions &options)
+    {
+        if (readers.empty()) return;
+        auto shape = readers.front()->GetTensorShape(options);
+        for (const auto* reader : readers)
+        {
+            if (reader->GetTensorShape(options) != shape)
+                throw std::invalid_argument("Pictures of a batch must give tensors of the same shape.");
+        }
+        const auto tensor_size = static_cast<std::size_t>(shape[0]) * shape[1] * shape[2];
+        for (const auto* reader : readers)
         {
-            auto reader = std::make_unique<SharedPicture::PictureReader>(
-                    device_name + "." + picture_name +
-                    "." + std::to_string(chain_index));
-            Readers.emplace_back(std::move(reader));
+            reader->ReadAsTensor(destination, options);
+            destination += tensor_size;
         }
     }
-}
\ No newline at end of file
+}
@@ -2,11 +2,18 @@
 
 #include <string>
 #include <memory>
+#include <chrono>
+#include <functional>
 #include <sw/redis++/redis++.h>
 #include <GaiaSharedMemory/GaiaSharedMemory.hpp>
 #include <GaiaSharedPicture/GaiaSharedPicture.hpp>
 #include <opencv2/opencv.hpp>
 #include <vector>
+#include <array>
+#include <optional>
+
+#include "PictureStampRing.hpp"
+#include "ReaderLagTable.hpp"
 
 namespace Gaia::CameraService
 {
@@ -17,12 +24,76 @@ namespace Gaia::CameraService
     class CameraReader
     {
         friend class CameraClient;
+        friend class CameraGroupReader;
+
+    public:
+        /**
+         * @brief Options of converting pictures into float tensors.
+         * @details
+         *  Every element is computed as (pixel * Scale - Mean[c]) / Std[c] of the output channel c.
+         */
+        struct TensorOptions
+        {
+            /// Area of the picture to convert, empty means the whole picture.
+            cv::Rect Area {};
+            /// Size of the tensor, the area is resized with bilinear interpolation, empty means no resizing.
+            cv::Size Size {};
+            /// Whether to swap the first and the third channel, which converts BGR pictures into RGB tensors.
+            bool SwapRedBlue {true};
+            /// Scale applied to raw pixel values before normalization.
+            float Scale {1.0f / 255.0f};
+            /// Mean values of output channels.
+            std::array<float, 3> Mean {0.0f, 0.0f, 0.0f};
+            /// Standard deviations of output channels.
+            std::array<float, 3> Std {1.0f, 1.0f, 1.0f};
+        };
+
+        /// Picture returned by ReadNext().
+        struct CursorFrame
+        {
+            /// Copied picture with tightly packed rows.
+            cv::Mat Picture;
+            /// Sequence number of the picture in the swap chain.
+            std::uint64_t Sequence {0};
+            /// Capture time in nanoseconds since epoch.
+            std::uint64_t Timestamp {0};
+            /// Capture time in CLOCK_MONOTONIC_RAW nanoseconds of the host.
+            std::uint64_t MonotonicTimestamp {0};
+            /// Whether change detection of the server found no difference from the previous changed picture.
+            bool Unchanged {false};
+            /**
+             * @brief Count of pictures missed right before this one in the cursor mode,
+             *        their sequences are [Sequence - MissedCount, Sequence).
+             * @details Pictures skipped by the decimation or the rate limit are not missed.
+             */
+            std::uint64_t MissedCount {0};
+        };
 
     protected:
         /// Connection to the Redis server.
         std::shared_ptr<sw::redis::Redis> Connection;
-        /// Reader for the picture in a shared memory block.
-        std::vector<std::unique_ptr<SharedPicture::PictureReader>> Readers;
+        /// Reader for the picture in a shared memory block, extended when the server deepens the swap chain.
+        mutable std::vector<std::unique_ptr<SharedPicture::PictureReader>> Readers;
+        /// Generations of mapped blocks in the stamp ring, a block is remapped once its generation changes.
+        mutable std::vector<std::uint32_t> ReaderGenerations;
+        /// Capture times of committed blocks, nullptr if the server does not publish them.
+        std::unique_ptr<PictureStampRing> Stamps;
+        /// Slot which reports lags of this reader to the server, nullptr if the server does not track readers.
+        std::unique_ptr<ReaderLagTable> Lags;
+        /// Sequence of the picture being read, 0 if it is unknown.
+        mutable std::uint64_t ReadingSequence {0};
+        /// Whether pictures are consumed in order through the cursor.
+        bool CursorEnabled {false};
+        /// Sequence of the latest picture returned or skipped by ReadNext().
+        std::uint64_t Cursor {0};
+        /// Count of pictures missed by the cursor since it is enabled.
+        std::uint64_t MissedFramesCount {0};
+        /// ReadNext() returns pictures at least this count of sequences apart.
+        unsigned int DecimationInterval {1};
+        /// Length of rate limit slots of capture time in nanoseconds, 0 means no rate limit.
+        std::uint64_t RatePeriod {0};
+        /// Index of the rate limit slot of the latest returned picture.
+        std::uint64_t LastRateSlot {0};
 
         /// Name of the memory block to store the picture.
         const std::string MemoryBlockName;
@@ -32,6 +103,14 @@ namespace Gaia::CameraService
         const std::string StatusBlockIDKeyName;
         /// Name for the timestamp of this picture.
         const std::string StatusFPSKeyName;
+        /// Name of the expiring key which tells the server that this picture is being read.
+        const std::string HeartbeatKeyName;
+        /// Time point of the last heartbeat.
+        mutable std::chrono::steady_clock::time_point LastHeartbeatTimePoint {};
+        /// Bytes from the picture data of a block to the first row.
+        std::size_t PictureOffset {0};
+        /// Bytes from the beginning of a row to the next one, 0 means rows are tightly packed.
+        std::size_t RowStride {0};
 
         const std::string DeviceName;
         const std::string PictureName;
@@ -39,6 +118,53 @@ namespace Gaia::CameraService
     private:
         /// Initialize readers list.
         void InitializeReaders(const std::string& device_name, const std::string& picture_name);
+        /// Map the swap chain blocks up to the given ID, which are added after the readers are initialized.
+        void ExtendReaders(unsigned int block_id) const;
+        /// Map the swap chain block with the given ID, and record its generation.
+        void MapReader(unsigned int block_id) const;
+        /**
+         * @brief Make sure the reader of the given block maps the current shared block.
+         * @details Blocks beyond the mapped ones are mapped, and blocks recreated by the server are remapped.
+         */
+        void PrepareReader(unsigned int block_id) const;
+
+        /// Find the sequence of the picture in the given block, 0 if it is unknown.
+        [[nodiscard]] std::uint64_t FindSequence(unsigned int block_id) const;
+        /// Report the lag of the finished read to the server.
+        void FinishRead() const;
+        /// Check whether the picture with the given sequence in the given block is not rewritten yet.
+        [[nodiscard]] bool IsBlockIntact(unsigned int block_id, std::uint64_t sequence) const;
+        /**
+         * @brief Copy the latest picture through the given function.
+         * @details
+         *  The copy is repeated on the next latest picture if the block is rewritten during the copy.
+         * @throw std::runtime_error If the block is rewritten during every attempt.
+         */
+        void ReadLatest(const std::function<void(const cv::Mat&)>& copy) const;
+
+        /**
+         * @brief Estimate the interval between commits from the latest stamps.
+         * @return Interval in nanoseconds, or 0 if less than two pictures are buffered.
+         */
+        [[nodiscard]] std::uint64_t EstimateFrameInterval() const;
+        /**
+         * @brief Wait until the picture with the given sequence is committed.
+         * @details Commits long before it are slept through instead of waking up on each of them.
+         */
+        bool WaitForSequence(std::uint64_t sequence, std::chrono::steady_clock::time_point deadline);
+        /// Sleep until the rate limit slot after the one of the latest returned picture begins.
+        bool WaitForRateSlot(std::chrono::steady_clock::time_point deadline);
+
+        /**
+         * @brief Refresh the heartbeat of this picture at most once per second.
+         * @details
+         *  Pictures computed on demand by the server, such as pyramid levels, are only produced
+         *  while their heartbeats are alive.
+         */
+        void UpdateHeartbeat() const;
+
+        /// Read the ID of the latest committed block.
+        [[nodiscard]] unsigned int ReadBlockID() const;
 
     public:
         /**
@@ -58,6 +184,133 @@ namespace Gaia::CameraService
 
         /// Read the data matrix of this picture.
         [[nodiscard]] cv::Mat Read() const;
+        /**
+         * @brief Read only the given area of this picture.
+         * @param area Area to read, it will be clipped by the picture.
+         * @details Only rows and columns of the area are copied out of the shared memory.
+         */
+        [[nodiscard]] cv::Mat Read(const cv::Rect& area) const;
+        /**
+         * @brief Read this picture into the given matrix.
+         * @param destination Matrix to store the picture.
+         * @details
+         *  The destination is reused if its size and type match the picture, so steady reads do not allocate,
+         *  otherwise it is reallocated. To read into pinned or aligned memory, pass a matrix header
+         *  constructed over that memory with the size and type of the picture.
+         */
+        void ReadInto(cv::Mat& destination) const;
+        /**
+         * @brief Read only the given area of this picture into the given matrix.
+         * @param destination Matrix to store the area, reused if its size and type match the clipped area.
+         * @param area Area to read, it will be clipped by the picture.
+         */
+        void ReadInto(cv::Mat& destination, const cv::Rect& area) const;
+
+        /**
+         * @brief Get the shape of tensors converted from this picture with the given options.
+         * @return Channels, height and width of the tensor. Gray pictures give 1 channel, others give 3 channels.
+         */
+        [[nodiscard]] std::array<int, 3> GetTensorShape(const TensorOptions& options) const;
+        /**
+         * @brief Read this picture as a float CHW tensor.
+         * @param destination Buffer of at least C*H*W floats given by GetTensorShape().
+         * @param options Options of cropping, resizing and normalization.
+         * @details
+         *  Cropping, resizing, channel swapping, normalization and HWC to CHW transposition are done in one pass
+         *  straight out of the shared memory, without any temporary picture.
+         *  Only 8 bits and 16 bits pictures with 1, 3 or 4 channels are supported, the fourth channel is ignored.
+         */
+        void ReadAsTensor(float* destination, const TensorOptions& options) const;
+        /**
+         * @brief Read pictures of several readers as a float NCHW tensor batch.
+         * @param readers Readers of pictures, the N-th one fills the N-th tensor of the batch.
+         * @param destination Buffer of at least N*C*H*W floats.
+         * @param options Options shared by all pictures, they must give the same tensor shape.
+         */
+        static void ReadBatchAsTensor(const std::vector<const CameraReader*>& readers, float* destination,
+                                      const TensorOptions& options);
+        /**
+         * @brief Read the data matrix in the swap chain block with the given ID.
+         * @param block_id ID of the swap chain block.
+         */
+        [[nodiscard]] cv::Mat ReadBlock(unsigned int block_id) const;
+        /**
+         * @brief Get a matrix header over the picture in the swap chain block with the given ID.
+         * @details
+         *  No pixel is copied, the returned matrix points into the shared memory,
+         *  so it is only valid until the writer wraps around to this block:
+         *  check the sequence of the picture against the stamp ring after using it.
+         *  Rows follow the row stride published by the server, so they may be padded.
+         */
+        [[nodiscard]] cv::Mat ViewBlock(unsigned int block_id) const;
+        /// Get the header of the picture, which gives its size and pixel type without reading any pixel.
+        [[nodiscard]] SharedPicture::PictureHeader GetPictureHeader() const;
+        /// Get the OpenCV type of pixels of the picture.
+        [[nodiscard]] int GetPixelType() const;
+        /// Get the stamp ring of the picture, nullptr if the server does not publish picture stamps.
+        [[nodiscard]] inline const PictureStampRing* GetStamps() const noexcept
+        {
+            return Stamps.get();
+        }
+        /**
+         * @brief Get the count of blocks in the swap chain of this picture.
+         * @details
+         *  It is the depth published in the stamp ring, which tells how many commits a picture stays in its block,
+         *  so it follows the server when the depth of the swap chain is adapted.
+         */
+        [[nodiscard]] inline unsigned int GetBlocksCount() const noexcept
+        {
+            return Stamps ? Stamps->GetDepth() : static_cast<unsigned int>(Readers.size());
+        }
+        /**
+         * @brief Consume pictures strictly in order from now on, through a cursor kept in shared memory.
+         * @throws std::runtime_error If the server does not track readers, or no reader slot is free.
+         * @details
+         *  The server may hold back commits for a bounded count of cursors, configured by "BackpressureReaders",
+         *  so these readers never miss a picture; pictures are then dropped at the camera and counted by the server.
+         *  Other cursors skip pictures which are overwritten before they are read, and report them as missed.
+         *  Reading the latest picture by other methods is not affected by the cursor.
+         */
+        void EnableCursor();
+        /// Stop consuming pictures through the cursor, so the server no longer holds back commits for it.
+        void DisableCursor();
+        /**
+         * @brief Wait for and copy the next picture which passes the decimation and the rate limit.
+         * @param timeout Time to wait at most for a new picture.
+         * @return Copied picture, or std::nullopt if no picture is committed before the timeout.
+         * @throws std::runtime_error If the server does not publish picture stamps.
+         * @details
+         *  In the cursor mode, the earliest picture after the cursor is read and the cursor moves onto it,
+         *  otherwise the latest picture newer than the previously returned one is read.
+         *  Skipped pictures are decided by their stamps, so they are never copied,
+         *  and waiting for a picture far ahead sleeps through the commits before it.
+         */
+        std::optional<CursorFrame> ReadNext(std::chrono::milliseconds timeout = std::chrono::milliseconds(1000));
+        /**
+         * @brief Let ReadNext() return only every N-th picture.
+         * @param interval Count of sequences between returned pictures, 1 means every picture.
+         * @throws std::invalid_argument If the interval is 0.
+         */
+        void SetDecimation(unsigned int interval);
+        /**
+         * @brief Let ReadNext() return at most the given count of pictures per second.
+         * @param frames_per_second Maximum rate, 0 means no limit.
+         * @details
+         *  Capture time is divided into slots of 1 / frames_per_second seconds, and at most one picture is
+         *  returned per slot, so returned pictures are aligned to capture times instead of read times.
+         */
+        void SetRateLimit(double frames_per_second);
+        /// Get the sequence of the latest picture returned or skipped by ReadNext().
+        [[nodiscard]] inline std::uint64_t GetCursor() const noexcept
+        {
+            return Cursor;
+        }
+        /// Get the count of pictures missed by the cursor since it is enabled.
+        [[nodiscard]] inline std::uint64_t GetMissedFramesCount() const noexcept
+        {
+            return MissedFramesCount;
+        }
+
         /// Read the timestamp in format of milliseconds since epoch.
         [[nodiscard]] long ReadMillisecondsTimestamp();
         /// Read the timestamp of this picture.
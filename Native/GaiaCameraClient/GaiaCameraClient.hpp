@@ -1,6 +1,13 @@
 #pragma once
 
+#include "SharedBlock.hpp"
+#include "PictureStampRing.hpp"
+#include "ReaderLagTable.hpp"
+#include "ParameterQueue.hpp"
+#include "MemoryHints.hpp"
 #include "CameraClient.hpp"
+#include "CameraGroupReader.hpp"
+#include "BridgeProtocol.hpp"
 
 namespace Gaia::CameraService
 {}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "MemoryHints.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace Gaia::CameraService
+{
+    namespace
+    {
+        #ifdef MADV_POPULATE_READ
+        constexpr int PopulateReadAdvice = MADV_POPULATE_READ;
+        #else
+        constexpr int PopulateReadAdvice = 22;
+        #endif
+        #ifdef MADV_POPULATE_WRITE
+        constexpr int PopulateWriteAdvice = MADV_POPULATE_WRITE;
+        #else
+        constexpr int PopulateWriteAdvice = 23;
+        #endif
+
+        /// Get the size of normal pages.
+        std::uintptr_t GetPageSize()
+        {
+            static const auto page_size = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+            return page_size;
+        }
+
+        /// Extend the range to page boundaries, returns the aligned begin address and the aligned size.
+        std::pair<void*, std::size_t> AlignRange(void* address, std::size_t size)
+        {
+            const auto page_size = GetPageSize();
+            auto begin = reinterpret_cast<std::uintptr_t>(address) & ~(page_size - 1);
+            auto end = (reinterpret_cast<std::uintptr_t>(address) + size + page_size - 1) & ~(page_size - 1);
+            return {reinterpret_cast<void*>(begin), static_cast<std::size_t>(end - begin)};
+        }
+    }
+
+    /// Advise transparent huge pages.
+    bool AdviseHugePages(void* address, std::size_t size)
+    {
+        #ifdef MADV_HUGEPAGE
+        if (!address || size == 0) return false;
+        auto [begin, aligned_size] = AlignRange(address, size);
+        return madvise(begin, aligned_size, MADV_HUGEPAGE) == 0;
+        #else
+        return false;
+        #endif
+    }
+
+    /// Fault in all pages of the range.
+    bool PrefaultMemory(void* address, std::size_t size, bool writable)
+    {
+        if (!address || size == 0) return false;
+        auto [begin, aligned_size] = AlignRange(address, size);
+        if (madvise(begin, aligned_size, writable ? PopulateWriteAdvice : PopulateReadAdvice) == 0) return true;
+
+        // Older kernels reject the advice, so pages are touched one by one.
+        const auto page_size = GetPageSize();
+        auto* bytes = static_cast<volatile std::uint8_t*>(begin);
+        for (std::size_t offset = 0; offset < aligned_size; offset += page_size)
+        {
+            auto value = bytes[offset];
+            if (writable) bytes[offset] = value;
+        }
+        return true;
+    }
+
+    /// Lock the range into RAM.
+    bool LockMemory(void* address, std::size_t size)
+    {
+        if (!address || size == 0) return false;
+        auto [begin, aligned_size] = AlignRange(address, size);
+        return mlock(begin, aligned_size) == 0;
+    }
+}
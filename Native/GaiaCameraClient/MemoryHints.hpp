@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Advise the kernel to back the mapped memory range with transparent huge pages.
+     * @return True if the advice is accepted, false if huge pages are not available for this range.
+     * @details
+     *  Shared memory blocks are backed by huge pages only if "/sys/kernel/mm/transparent_hugepage/shmem_enabled"
+     *  is "advise" or "always", otherwise this is a harmless hint and normal pages are used.
+     *  The range is extended to page boundaries.
+     */
+    bool AdviseHugePages(void* address, std::size_t size);
+
+    /**
+     * @brief Fault in all pages of the mapped memory range, so later accesses do not take page faults.
+     * @param writable Whether to fault in pages for writing, which allocates them, or only map them for reading.
+     * @return True if all pages are faulted in.
+     * @details
+     *  MADV_POPULATE_WRITE and MADV_POPULATE_READ are used if the kernel supports them (Linux 5.14),
+     *  otherwise every page is touched, writing keeps the content unchanged.
+     */
+    bool PrefaultMemory(void* address, std::size_t size, bool writable);
+
+    /**
+     * @brief Lock the mapped memory range into RAM.
+     * @return True if it is locked, false if it exceeds RLIMIT_MEMLOCK or the process lacks CAP_IPC_LOCK.
+     */
+    bool LockMemory(void* address, std::size_t size);
+}
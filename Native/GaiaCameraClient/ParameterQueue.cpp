@@ -0,0 +1,218 @@
+#include "ParameterQueue.hpp"
+
+#include <cerrno>
+#include <ctime>
+#include <stdexcept>
+#include <signal.h>
+#include <unistd.h>
+
+namespace Gaia::CameraService
+{
+    namespace
+    {
+        /// Compute the size of the shared block for the given capacity.
+        std::size_t ComputeQueueSize(std::uint32_t capacity)
+        {
+            return sizeof(ParameterQueue::Header) + sizeof(ParameterQueue::Command) * capacity;
+        }
+    }
+
+    /// Create or reopen a parameter queue.
+    ParameterQueue::ParameterQueue(const std::string &block_name, std::uint32_t capacity) : Consumer(true)
+    {
+        if (capacity == 0) throw std::invalid_argument("Capacity of parameter queue must be at least 1.");
+        if (capacity > (1u << 16)) throw std::invalid_argument("Capacity of parameter queue must be at most 65536.");
+        std::uint32_t rounded_capacity = 1;
+        while (rounded_capacity < capacity) rounded_capacity <<= 1;
+
+        // The block of the previous server is reused, so producers which have mapped it keep working.
+        try
+        {
+            Block = SharedBlock::Open(block_name, true);
+        }catch (std::runtime_error&)
+        {}
+        if (Block && Block->GetSize() >= sizeof(Header))
+        {
+            auto* existing_header = static_cast<Header*>(Block->GetPointer());
+            if (existing_header->Magic == LayoutMagic && existing_header->Version == LayoutVersion)
+            {
+                if (existing_header->Capacity == rounded_capacity &&
+                    Block->GetSize() >= ComputeQueueSize(rounded_capacity))
+                {
+                    QueueHeader = existing_header;
+                }
+                else
+                {
+                    // Producers of the replaced block are told to reopen the queue.
+                    existing_header->ServerAlive.store(0, std::memory_order_release);
+                }
+            }
+        }
+        if (!QueueHeader)
+        {
+            Block = SharedBlock::Create(block_name, ComputeQueueSize(rounded_capacity));
+            QueueHeader = static_cast<Header*>(Block->GetPointer());
+            QueueHeader->Capacity = rounded_capacity;
+            QueueHeader->Version = LayoutVersion;
+            std::atomic_thread_fence(std::memory_order_release);
+            QueueHeader->Magic = LayoutMagic;
+        }
+        Block->Persist();
+        Commands = reinterpret_cast<Command*>(static_cast<std::uint8_t*>(Block->GetPointer()) + sizeof(Header));
+        IndexMask = rounded_capacity - 1;
+        QueueHeader->ServerEpoch.fetch_add(1, std::memory_order_relaxed);
+        QueueHeader->ServerAlive.store(1, std::memory_order_release);
+    }
+
+    /// Open an existing parameter queue and claim the producer role.
+    ParameterQueue::ParameterQueue(const std::string &block_name)
+    {
+        Block = SharedBlock::Open(block_name, true);
+        if (Block->GetSize() < sizeof(Header))
+            throw std::runtime_error("Shared block " + block_name + " is too small for a parameter queue.");
+        QueueHeader = static_cast<Header*>(Block->GetPointer());
+        if (QueueHeader->Magic != LayoutMagic || QueueHeader->Version != LayoutVersion)
+            throw std::runtime_error("Shared block " + block_name + " is not a compatible parameter queue.");
+        const auto capacity = QueueHeader->Capacity;
+        if (capacity == 0 || (capacity & (capacity - 1)) != 0 || Block->GetSize() < ComputeQueueSize(capacity))
+            throw std::runtime_error("Shared block " + block_name + " is smaller than its parameter queue layout.");
+        Commands = reinterpret_cast<Command*>(static_cast<std::uint8_t*>(Block->GetPointer()) + sizeof(Header));
+        IndexMask = capacity - 1;
+
+        // The ring is only safe with one producer, so the role is taken over only from exited processes.
+        const auto process_id = static_cast<std::uint32_t>(getpid());
+        auto owner_id = QueueHeader->ProducerID.load();
+        while (!Producer)
+        {
+            if (owner_id != 0 && !(kill(static_cast<pid_t>(owner_id), 0) != 0 && errno == ESRCH))
+            {
+                throw std::runtime_error("Parameter queue " + block_name + " is taken by process " +
+                                         std::to_string(owner_id) + ".");
+            }
+            Producer = QueueHeader->ProducerID.compare_exchange_strong(owner_id, process_id);
+        }
+    }
+
+    /// Release the producer role, or mark the server as not alive.
+    ParameterQueue::~ParameterQueue()
+    {
+        if (Consumer) QueueHeader->ServerAlive.store(0, std::memory_order_release);
+        if (!Producer) return;
+        auto process_id = static_cast<std::uint32_t>(getpid());
+        QueueHeader->ProducerID.compare_exchange_strong(process_id, 0);
+    }
+
+    /// Generate the name of the shared block of the parameter queue.
+    std::string ParameterQueue::GenerateBlockName(const std::string &device_name)
+    {
+        return device_name + ".parameters";
+    }
+
+    /// Get the current time in CLOCK_MONOTONIC nanoseconds.
+    std::uint64_t ParameterQueue::GetMonotonicTime() noexcept
+    {
+        timespec time {};
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return static_cast<std::uint64_t>(time.tv_sec) * 1000000000ull + static_cast<std::uint64_t>(time.tv_nsec);
+    }
+
+    /// Push a command.
+    bool ParameterQueue::Push(Command command) noexcept
+    {
+        if (!Producer || QueueHeader->ServerAlive.load(std::memory_order_acquire) == 0) return false;
+        auto head = QueueHeader->Head.load(std::memory_order_relaxed);
+        auto tail = QueueHeader->Tail.load(std::memory_order_acquire);
+        if (head - tail > IndexMask) return false;
+        command.Reserved = 0;
+        command.SubmitTime = GetMonotonicTime();
+        Commands[head & IndexMask] = command;
+        QueueHeader->Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Push an exposure change.
+    bool ParameterQueue::PushExposure(unsigned int microseconds) noexcept
+    {
+        return Push({Command::Types::Exposure, 0, 0, {static_cast<double>(microseconds), 0, 0, 0}});
+    }
+
+    /// Push a gain change.
+    bool ParameterQueue::PushGain(double gain) noexcept
+    {
+        return Push({Command::Types::Gain, 0, 0, {gain, 0, 0, 0}});
+    }
+
+    /// Push a white balance change.
+    bool ParameterQueue::PushWhiteBalance(double red, double green, double blue) noexcept
+    {
+        return Push({Command::Types::WhiteBalance, 0, 0, {red, green, blue, 0}});
+    }
+
+    /// Push a region of interest change.
+    bool ParameterQueue::PushRegionOfInterest(int x, int y, int width, int height) noexcept
+    {
+        return Push({Command::Types::RegionOfInterest, 0, 0, {static_cast<double>(x), static_cast<double>(y),
+                                                              static_cast<double>(width),
+                                                              static_cast<double>(height)}});
+    }
+
+    /// Pop the oldest command.
+    std::optional<ParameterQueue::Command> ParameterQueue::Pop() noexcept
+    {
+        auto tail = QueueHeader->Tail.load(std::memory_order_relaxed);
+        // Drained on every commit, so an empty queue costs one load of the shared head.
+        if (tail == QueueHeader->Head.load(std::memory_order_acquire)) return std::nullopt;
+        auto command = Commands[tail & IndexMask];
+        QueueHeader->Tail.store(tail + 1, std::memory_order_release);
+        return command;
+    }
+
+    /// Acknowledge a popped command.
+    void ParameterQueue::Acknowledge(bool applied, std::uint64_t latency) noexcept
+    {
+        if (!applied)
+        {
+            QueueHeader->RejectedCount.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        QueueHeader->LastLatency.store(latency, std::memory_order_relaxed);
+        QueueHeader->AppliedCount.fetch_add(1, std::memory_order_release);
+    }
+
+    /// Check whether a server is consuming the block.
+    bool ParameterQueue::IsServerAlive() const noexcept
+    {
+        return QueueHeader->ServerAlive.load(std::memory_order_acquire) != 0;
+    }
+
+    /// Get the count of times a server starts consuming the block.
+    std::uint32_t ParameterQueue::GetServerEpoch() const noexcept
+    {
+        return QueueHeader->ServerEpoch.load(std::memory_order_acquire);
+    }
+
+    /// Get the count of pending commands.
+    std::uint64_t ParameterQueue::GetPendingCount() const noexcept
+    {
+        auto tail = QueueHeader->Tail.load(std::memory_order_acquire);
+        return QueueHeader->Head.load(std::memory_order_acquire) - tail;
+    }
+
+    /// Get the count of applied commands.
+    std::uint64_t ParameterQueue::GetAppliedCount() const noexcept
+    {
+        return QueueHeader->AppliedCount.load(std::memory_order_acquire);
+    }
+
+    /// Get the count of rejected commands.
+    std::uint64_t ParameterQueue::GetRejectedCount() const noexcept
+    {
+        return QueueHeader->RejectedCount.load(std::memory_order_acquire);
+    }
+
+    /// Get the latency of the latest applied command.
+    std::uint64_t ParameterQueue::GetLastLatency() const noexcept
+    {
+        return QueueHeader->LastLatency.load(std::memory_order_acquire);
+    }
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "SharedBlock.hpp"
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Lock-free queue of parameter changes in a shared block, from one client to the camera server.
+     * @details
+     *  The block is named as "{device_name}.parameters" and created by the camera server
+     *  if the configuration "ParameterQueue" is "true". It is kept when the server stops,
+     *  and a restarted server consumes the same block if its layout is compatible,
+     *  so a client can keep pushing across restarts; commands pushed meanwhile are applied on restart.
+     *  It is a single-producer single-consumer ring: one client process claims the producer role,
+     *  and the server drains it on the capture thread between frames, so parameters can follow every frame
+     *  without the round trip through Redis, which remains the channel of remote and administrative commands.
+     *  Every command carries its submission time, and the server acknowledges applied commands with
+     *  their command-to-effect latency, which is also published as the status of the camera.
+     */
+    class ParameterQueue
+    {
+    public:
+        /// Parameter change carried by the queue.
+        struct Command
+        {
+            /// Types of parameters.
+            enum class Types : std::uint32_t
+            {
+                /// Exposure time, Values[0] is microseconds.
+                Exposure = 1,
+                /// Digital gain, Values[0] is the gain.
+                Gain = 2,
+                /// White balance, Values[0..2] are ratios of red, green and blue channels, negative ones are kept.
+                WhiteBalance = 3,
+                /// Region of interest of the sensor, Values[0..3] are x, y, width and height in pixels.
+                RegionOfInterest = 4
+            };
+
+            /// Type of the parameter.
+            Types Type;
+            /// Reserved for alignment.
+            std::uint32_t Reserved;
+            /// Submission time in CLOCK_MONOTONIC nanoseconds, which is the same in all processes.
+            std::uint64_t SubmitTime;
+            /// Values of the parameter, meaning of which depends on the type.
+            double Values[4];
+        };
+
+        /// Header at the beginning of the shared block.
+        struct Header
+        {
+            /// Magic number to verify the layout.
+            std::uint32_t Magic;
+            /// Version of the layout.
+            std::uint32_t Version;
+            /// Count of commands the ring can hold, which is a power of 2.
+            std::uint32_t Capacity;
+            /// ID of the process which claims the producer role, 0 means the role is free.
+            std::atomic<std::uint32_t> ProducerID;
+            /// Count of times a server starts consuming the block.
+            std::atomic<std::uint32_t> ServerEpoch;
+            /// Whether a server is consuming the block, cleared when the server stops or replaces the block.
+            std::atomic<std::uint32_t> ServerAlive;
+            /// Count of commands ever pushed, only written by the producer.
+            alignas(64) std::atomic<std::uint64_t> Head;
+            /// Count of commands ever popped, only written by the consumer.
+            alignas(64) std::atomic<std::uint64_t> Tail;
+            /// Count of commands applied by the camera.
+            std::atomic<std::uint64_t> AppliedCount;
+            /// Count of commands rejected by the camera.
+            std::atomic<std::uint64_t> RejectedCount;
+            /// Command-to-effect latency of the latest applied command in nanoseconds.
+            std::atomic<std::uint64_t> LastLatency;
+        };
+
+        static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+                "Parameter queue requires lock-free 64 bits atomic integers.");
+
+        /// Magic number of the layout, "GCPQ".
+        static constexpr std::uint32_t LayoutMagic = 0x51504347;
+        /// Version of the layout.
+        static constexpr std::uint32_t LayoutVersion = 2;
+
+    private:
+        /// Shared block which holds the queue.
+        std::unique_ptr<SharedBlock> Block;
+        /// Header in the shared block.
+        Header* QueueHeader {nullptr};
+        /// Commands in the shared block.
+        Command* Commands {nullptr};
+        /// Mask of indices of commands, which is the capacity minus 1.
+        std::uint64_t IndexMask {0};
+        /// Whether this instance claims the producer role.
+        bool Producer {false};
+        /// Whether this instance is the consumer.
+        bool Consumer {false};
+
+    public:
+        /**
+         * @brief Create or reopen a parameter queue, used by the server which is the consumer.
+         * @param block_name Name of the shared block.
+         * @param capacity Count of commands the ring can hold, rounded up to a power of 2.
+         * @details
+         *  An existing block with the same layout and capacity is reused, otherwise it is replaced,
+         *  and producers of the replaced block see the server as not alive.
+         */
+        ParameterQueue(const std::string& block_name, std::uint32_t capacity);
+        /**
+         * @brief Open an existing parameter queue and claim the producer role, used by clients.
+         * @param block_name Name of the shared block.
+         * @throw std::runtime_error If another alive process claims the producer role.
+         */
+        explicit ParameterQueue(const std::string& block_name);
+        /// Release the producer role, or mark the server as not alive for the consumer.
+        ~ParameterQueue();
+
+        ParameterQueue(const ParameterQueue&) = delete;
+        ParameterQueue& operator=(const ParameterQueue&) = delete;
+
+        /// Generate the name of the shared block of the parameter queue of a camera.
+        static std::string GenerateBlockName(const std::string& device_name);
+
+        /// Get the current time in CLOCK_MONOTONIC nanoseconds, which is the clock of submission times.
+        static std::uint64_t GetMonotonicTime() noexcept;
+
+        /**
+         * @brief Push a command, used by the producer.
+         * @param command Command to push, its submission time is stamped now.
+         * @return False if the queue is full or no server is consuming it, the command is not pushed then.
+         * @details
+         *  If the server stays not alive, it may have replaced the block after a restart,
+         *  see IsServerAlive(), and the producer should reopen the queue.
+         */
+        bool Push(Command command) noexcept;
+
+        /// Push an exposure change in microseconds.
+        bool PushExposure(unsigned int microseconds) noexcept;
+        /// Push a gain change.
+        bool PushGain(double gain) noexcept;
+        /// Push a white balance change, negative ratios keep the channels unchanged.
+        bool PushWhiteBalance(double red, double green, double blue) noexcept;
+        /// Push a region of interest change in pixels.
+        bool PushRegionOfInterest(int x, int y, int width, int height) noexcept;
+
+        /**
+         * @brief Pop the oldest command, used by the consumer.
+         * @return The command, or std::nullopt if the queue is empty.
+         */
+        std::optional<Command> Pop() noexcept;
+
+        /**
+         * @brief Acknowledge a popped command, used by the consumer.
+         * @param applied Whether the camera accepted the change.
+         * @param latency Time from the submission until the change is applied in nanoseconds.
+         */
+        void Acknowledge(bool applied, std::uint64_t latency) noexcept;
+
+        /// Check whether this instance claims the producer role.
+        [[nodiscard]] inline bool IsProducer() const noexcept
+        {
+            return Producer;
+        }
+
+        /// Check whether a server is consuming this block.
+        [[nodiscard]] bool IsServerAlive() const noexcept;
+        /// Get the count of times a server starts consuming this block, which changes when the server restarts.
+        [[nodiscard]] std::uint32_t GetServerEpoch() const noexcept;
+
+        /// Get the count of commands which are pushed but not popped yet.
+        [[nodiscard]] std::uint64_t GetPendingCount() const noexcept;
+        /// Get the count of commands applied by the camera.
+        [[nodiscard]] std::uint64_t GetAppliedCount() const noexcept;
+        /// Get the count of commands rejected by the camera.
+        [[nodiscard]] std::uint64_t GetRejectedCount() const noexcept;
+        /// Get the command-to-effect latency of the latest applied command in nanoseconds.
+        [[nodiscard]] std::uint64_t GetLastLatency() const noexcept;
+    };
+}
@@ -0,0 +1,144 @@
+#include "PictureStampRing.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace Gaia::CameraService
+{
+    namespace
+    {
+        /// Compute the size of the shared block for the given capacity.
+        std::size_t ComputeStampRingSize(std::uint32_t capacity)
+        {
+            return sizeof(PictureStampRing::Header) + sizeof(PictureStamp) * capacity +
+                   sizeof(std::atomic<std::uint32_t>) * capacity;
+        }
+
+        /// Get the address of the futex word, it is shared between processes so it is not private.
+        std::uint32_t* GetFutexWord(std::atomic<std::uint32_t>& word)
+        {
+            return reinterpret_cast<std::uint32_t*>(&word);
+        }
+    }
+
+    /// Create a stamp ring.
+    PictureStampRing::PictureStampRing(const std::string &block_name, std::uint32_t capacity)
+    {
+        if (capacity < 2) throw std::invalid_argument("Capacity of picture stamp ring must be at least 2.");
+        Block = SharedBlock::Create(block_name, ComputeStampRingSize(capacity));
+        RingHeader = static_cast<Header*>(Block->GetPointer());
+        RingHeader->Capacity = capacity;
+        RingHeader->Depth.store(capacity);
+        RingHeader->Count.store(0);
+        RingHeader->Signal.store(0);
+        RingHeader->Waiters.store(0);
+        RingHeader->Version = LayoutVersion;
+        std::atomic_thread_fence(std::memory_order_release);
+        RingHeader->Magic = LayoutMagic;
+        Stamps = reinterpret_cast<PictureStamp*>(static_cast<std::uint8_t*>(Block->GetPointer()) + sizeof(Header));
+        Generations = reinterpret_cast<std::atomic<std::uint32_t>*>(Stamps + capacity);
+    }
+
+    /// Open an existing stamp ring.
+    PictureStampRing::PictureStampRing(const std::string &block_name)
+    {
+        // Sleeping readers register themselves in the header, so the block is mapped writable.
+        Block = SharedBlock::Open(block_name, true);
+        if (Block->GetSize() < sizeof(Header))
+            throw std::runtime_error("Shared block " + block_name + " is too small for a picture stamp ring.");
+        RingHeader = static_cast<Header*>(Block->GetPointer());
+        if (RingHeader->Magic != LayoutMagic || RingHeader->Version != LayoutVersion)
+            throw std::runtime_error("Shared block " + block_name + " is not a compatible picture stamp ring.");
+        if (Block->GetSize() < ComputeStampRingSize(RingHeader->Capacity))
+            throw std::runtime_error("Shared block " + block_name + " is smaller than its picture stamp ring layout.");
+        Stamps = reinterpret_cast<PictureStamp*>(static_cast<std::uint8_t*>(Block->GetPointer()) + sizeof(Header));
+        Generations = reinterpret_cast<std::atomic<std::uint32_t>*>(Stamps + RingHeader->Capacity);
+    }
+
+    /// Generate the name of the shared block of stamps.
+    std::string PictureStampRing::GenerateBlockName(const std::string &device_name, const std::string &picture_name)
+    {
+        return device_name + "." + picture_name + ".stamps";
+    }
+
+    /// Append a stamp.
+    void PictureStampRing::Write(const PictureStamp &stamp)
+    {
+        auto count = RingHeader->Count.load(std::memory_order_relaxed);
+        std::memcpy(&Stamps[count % RingHeader->Capacity], &stamp, sizeof(PictureStamp));
+        RingHeader->Count.store(count + 1, std::memory_order_release);
+        RingHeader->Signal.fetch_add(1);
+        if (RingHeader->Waiters.load() > 0)
+        {
+            syscall(SYS_futex, GetFutexWord(RingHeader->Signal), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+        }
+    }
+
+    /// Set the depth of the swap chain.
+    void PictureStampRing::SetDepth(std::uint32_t depth)
+    {
+        RingHeader->Depth.store(std::clamp<std::uint32_t>(depth, 2, RingHeader->Capacity), std::memory_order_release);
+    }
+
+    /// Get the generation of the swap chain block.
+    std::uint32_t PictureStampRing::GetBlockGeneration(std::uint32_t block_id) const noexcept
+    {
+        if (block_id >= RingHeader->Capacity) return 0;
+        return Generations[block_id].load(std::memory_order_acquire);
+    }
+
+    /// Increase the generation of the swap chain block.
+    void PictureStampRing::IncreaseBlockGeneration(std::uint32_t block_id) noexcept
+    {
+        if (block_id >= RingHeader->Capacity) return;
+        Generations[block_id].fetch_add(1, std::memory_order_release);
+    }
+
+    /// Read the stamp with the given sequence number.
+    std::optional<PictureStamp> PictureStampRing::Read(std::uint64_t sequence) const
+    {
+        auto count = RingHeader->Count.load(std::memory_order_acquire);
+        if (sequence == 0 || sequence > count) return std::nullopt;
+        PictureStamp stamp;
+        std::memcpy(&stamp, &Stamps[(sequence - 1) % RingHeader->Capacity], sizeof(PictureStamp));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // The slot of the stamp being written is the one of (count + 1 - capacity), so it is also invalid.
+        if (RingHeader->Count.load(std::memory_order_acquire) - sequence + 1 >= RingHeader->Capacity)
+        {
+            return std::nullopt;
+        }
+        return stamp;
+    }
+
+    /// Sleep until a newer stamp is written.
+    bool PictureStampRing::WaitNewer(std::uint64_t count, std::chrono::nanoseconds timeout) const
+    {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (RingHeader->Count.load(std::memory_order_acquire) <= count)
+        {
+            auto remaining = deadline - std::chrono::steady_clock::now();
+            if (remaining <= std::chrono::nanoseconds::zero()) return false;
+            // Registering before sampling the signal makes sure the writer either sees this waiter,
+            // or has increased the signal before it is sampled, so no wake up is lost.
+            RingHeader->Waiters.fetch_add(1);
+            auto signal = RingHeader->Signal.load();
+            if (RingHeader->Count.load(std::memory_order_acquire) <= count)
+            {
+                auto seconds = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+                auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(remaining - seconds);
+                timespec relative_timeout {static_cast<time_t>(seconds.count()),
+                                           static_cast<long>(nanoseconds.count())};
+                syscall(SYS_futex, GetFutexWord(RingHeader->Signal), FUTEX_WAIT, signal,
+                        &relative_timeout, nullptr, 0);
+            }
+            RingHeader->Waiters.fetch_sub(1);
+        }
+        return true;
+    }
+}
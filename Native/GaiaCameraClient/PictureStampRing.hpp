@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "SharedBlock.hpp"
+
+namespace Gaia::CameraService
+{
+    /// Capture time of a committed picture and the swap chain block which holds it.
+    struct PictureStamp
+    {
+        /// Sequence number of the commit, the first committed picture has sequence 1.
+        std::uint64_t Sequence {0};
+        /// Capture time in nanoseconds since epoch.
+        std::uint64_t Timestamp {0};
+        /// Capture time in CLOCK_MONOTONIC_RAW nanoseconds of the host, which is not slewed by NTP.
+        std::uint64_t MonotonicTimestamp {0};
+        /// Capture time stamped by the device in device ticks, 0 if the device does not provide one.
+        std::uint64_t DeviceTimestamp {0};
+        /// Sequence number of the picture where it is captured, for replayed or mirrored pictures, otherwise 0.
+        std::uint64_t SourceSequence {0};
+        /// ID of the swap chain block which holds the picture.
+        std::uint32_t BlockID {0};
+        /// Flags of the picture, such as UnchangedFlag.
+        std::uint32_t Flags {0};
+        /// Exposure time in microseconds when the picture is captured.
+        std::uint32_t Exposure {0};
+        std::uint32_t Reserved {0};
+        /// Digital gain when the picture is captured.
+        double Gain {0.0};
+
+        /// Flag of pictures which do not differ from the previous changed picture, set by change detection.
+        static constexpr std::uint32_t UnchangedFlag = 1;
+    };
+
+    /**
+     * @brief Ring buffer of picture stamps in a shared block, written by the camera server on every commit.
+     * @details
+     *  The block is named as "{device_name}.{picture_name}.stamps" and keeps one stamp per swap chain block,
+     *  so the capture time of every picture still buffered in the swap chain can be read
+     *  with nanosecond resolution and without any Redis round trip.
+     *  Capture times are taken when the picture is delivered to the server, or mapped from the device clock
+     *  into the host clock if the device stamps its pictures.
+     *  Readers can sleep until a new picture is committed, the writer only issues a wake up system call
+     *  when some reader is sleeping.
+     *  After the stamps, the block keeps a generation per swap chain block, increased whenever the server
+     *  recreates that block, so readers know when their mapping of a block has been unlinked.
+     */
+    class PictureStampRing
+    {
+    public:
+        /// Header at the beginning of the shared block.
+        struct Header
+        {
+            /// Magic number to verify the layout.
+            std::uint32_t Magic;
+            /// Version of the layout.
+            std::uint32_t Version;
+            /// Capacity of the stamps ring.
+            std::uint32_t Capacity;
+            /// Count of swap chain blocks a committed picture stays in before its block is rewritten.
+            std::atomic<std::uint32_t> Depth;
+            /// Count of all stamps written since the block is created.
+            std::atomic<std::uint64_t> Count;
+            /// Futex word increased on every written stamp.
+            std::atomic<std::uint32_t> Signal;
+            /// Count of readers sleeping on the futex word.
+            std::atomic<std::uint32_t> Waiters;
+        };
+
+        static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+                "Picture stamp ring requires lock-free 64 bits atomic integers.");
+        static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t),
+                "Picture stamp ring requires 32 bits atomic integers usable as futex words.");
+
+        /// Magic number of the layout, "GCPS".
+        static constexpr std::uint32_t LayoutMagic = 0x53504347;
+        /// Version of the layout.
+        static constexpr std::uint32_t LayoutVersion = 6;
+
+    private:
+        /// Shared block which holds the ring.
+        std::unique_ptr<SharedBlock> Block;
+        /// Header in the shared block.
+        Header* RingHeader {nullptr};
+        /// Ring of stamps in the shared block.
+        PictureStamp* Stamps {nullptr};
+        /// Generations of swap chain blocks in the shared block, indexed by block IDs.
+        std::atomic<std::uint32_t>* Generations {nullptr};
+
+    public:
+        /**
+         * @brief Create a stamp ring, used by the server.
+         * @param block_name Name of the shared block.
+         * @param capacity Count of stamps to keep, at least the largest count of swap chain blocks.
+         * @details The depth is initialized as the capacity.
+         */
+        PictureStampRing(const std::string& block_name, std::uint32_t capacity);
+        /**
+         * @brief Open an existing stamp ring, used by clients.
+         * @param block_name Name of the shared block.
+         */
+        explicit PictureStampRing(const std::string& block_name);
+
+        /// Generate the name of the shared block of stamps of a picture.
+        static std::string GenerateBlockName(const std::string& device_name, const std::string& picture_name);
+
+        /// Append a stamp and wake up sleeping readers. Only one writer is allowed.
+        void Write(const PictureStamp& stamp);
+
+        /// Get the count of all stamps written, which is also the sequence number of the latest stamp.
+        [[nodiscard]] inline std::uint64_t GetCount() const noexcept
+        {
+            return RingHeader->Count.load(std::memory_order_acquire);
+        }
+
+        /// Get the capacity of the ring.
+        [[nodiscard]] inline std::uint32_t GetCapacity() const noexcept
+        {
+            return RingHeader->Capacity;
+        }
+
+        /**
+         * @brief Get the count of swap chain blocks a committed picture stays in before its block is rewritten.
+         * @details
+         *  The block of sequence s is safe to read until (count - s + 1) reaches the depth.
+         *  It may be lower than the count of blocks while the swap chain is deepened,
+         *  and it never exceeds the capacity.
+         */
+        [[nodiscard]] inline std::uint32_t GetDepth() const noexcept
+        {
+            return RingHeader->Depth.load(std::memory_order_acquire);
+        }
+
+        /// Set the depth of the swap chain, it is clamped into [2, capacity]. Only the writer may set it.
+        void SetDepth(std::uint32_t depth);
+
+        /**
+         * @brief Get the generation of the swap chain block with the given ID.
+         * @return Generation, which is 0 for blocks never recreated, and for IDs beyond the capacity.
+         */
+        [[nodiscard]] std::uint32_t GetBlockGeneration(std::uint32_t block_id) const noexcept;
+        /**
+         * @brief Increase the generation of the swap chain block with the given ID. Only the writer may do it.
+         * @details It must be done before the recreated block is committed into.
+         */
+        void IncreaseBlockGeneration(std::uint32_t block_id) noexcept;
+
+        /**
+         * @brief Read the stamp with the given sequence number.
+         * @return Stamp, or std::nullopt if it is not written yet or has been overwritten.
+         */
+        [[nodiscard]] std::optional<PictureStamp> Read(std::uint64_t sequence) const;
+
+        /**
+         * @brief Sleep until the count of stamps exceeds the given count.
+         * @param count Count of stamps already known by the caller.
+         * @param timeout Time to sleep at most.
+         * @return Whether a newer stamp is written or not.
+         */
+        bool WaitNewer(std::uint64_t count, std::chrono::nanoseconds timeout) const;
+    };
+}
@@ -0,0 +1,166 @@
+#include "ReaderLagTable.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <stdexcept>
+#include <signal.h>
+#include <unistd.h>
+
+namespace Gaia::CameraService
+{
+    namespace
+    {
+        /// Compute the size of the shared block for the given capacity.
+        std::size_t ComputeTableSize(std::uint32_t capacity)
+        {
+            return sizeof(ReaderLagTable::Header) + sizeof(ReaderLagTable::Slot) * capacity;
+        }
+
+        /// Get the current time in CLOCK_MONOTONIC nanoseconds, which is the same in all processes.
+        std::uint64_t GetMonotonicTime()
+        {
+            timespec time {};
+            clock_gettime(CLOCK_MONOTONIC, &time);
+            return static_cast<std::uint64_t>(time.tv_sec) * 1000000000ull + static_cast<std::uint64_t>(time.tv_nsec);
+        }
+    }
+
+    /// Create a reader table.
+    ReaderLagTable::ReaderLagTable(const std::string &block_name, std::uint32_t capacity)
+    {
+        if (capacity == 0) throw std::invalid_argument("Capacity of reader lag table must be at least 1.");
+        Block = SharedBlock::Create(block_name, ComputeTableSize(capacity));
+        TableHeader = static_cast<Header*>(Block->GetPointer());
+        Slots = reinterpret_cast<Slot*>(static_cast<std::uint8_t*>(Block->GetPointer()) + sizeof(Header));
+        TableHeader->Capacity = capacity;
+        TableHeader->Version = LayoutVersion;
+        std::atomic_thread_fence(std::memory_order_release);
+        TableHeader->Magic = LayoutMagic;
+    }
+
+    /// Open an existing reader table and register a slot.
+    ReaderLagTable::ReaderLagTable(const std::string &block_name)
+    {
+        Block = SharedBlock::Open(block_name, true);
+        if (Block->GetSize() < sizeof(Header))
+            throw std::runtime_error("Shared block " + block_name + " is too small for a reader lag table.");
+        TableHeader = static_cast<Header*>(Block->GetPointer());
+        if (TableHeader->Magic != LayoutMagic || TableHeader->Version != LayoutVersion)
+            throw std::runtime_error("Shared block " + block_name + " is not a compatible reader lag table.");
+        if (Block->GetSize() < ComputeTableSize(TableHeader->Capacity))
+            throw std::runtime_error("Shared block " + block_name + " is smaller than its reader lag table layout.");
+        Slots = reinterpret_cast<Slot*>(static_cast<std::uint8_t*>(Block->GetPointer()) + sizeof(Header));
+
+        const auto process_id = static_cast<std::uint32_t>(getpid());
+        for (std::uint32_t slot_index = 0; slot_index < TableHeader->Capacity; ++slot_index)
+        {
+            std::uint32_t free_id = 0;
+            auto& slot = Slots[slot_index];
+            if (!slot.ProcessID.compare_exchange_strong(free_id, process_id)) continue;
+            slot.CursorMode.store(0);
+            slot.Cursor.store(0);
+            slot.MaxLag.store(0);
+            slot.ReadTime.store(0);
+            OwnSlot = &slot;
+            break;
+        }
+    }
+
+    /// Release the registered slot.
+    ReaderLagTable::~ReaderLagTable()
+    {
+        if (!OwnSlot) return;
+        DisableCursor();
+        OwnSlot->ProcessID.store(0);
+    }
+
+    /// Generate the name of the shared block of readers.
+    std::string ReaderLagTable::GenerateBlockName(const std::string &device_name, const std::string &picture_name)
+    {
+        return device_name + "." + picture_name + ".readers";
+    }
+
+    /// Record a read in the registered slot.
+    void ReaderLagTable::RecordRead(std::uint64_t lag) noexcept
+    {
+        if (!OwnSlot) return;
+        auto max_lag = OwnSlot->MaxLag.load(std::memory_order_relaxed);
+        while (lag > max_lag && !OwnSlot->MaxLag.compare_exchange_weak(max_lag, lag)) {}
+        OwnSlot->ReadTime.store(GetMonotonicTime(), std::memory_order_release);
+    }
+
+    /// Switch the registered slot into the cursor mode.
+    void ReaderLagTable::EnableCursor(std::uint64_t cursor) noexcept
+    {
+        if (!OwnSlot) return;
+        OwnSlot->Cursor.store(cursor);
+        OwnSlot->ReadTime.store(GetMonotonicTime());
+        if (OwnSlot->CursorMode.exchange(1) == 0) TableHeader->CursorsCount.fetch_add(1);
+    }
+
+    /// Switch the registered slot back to reading the latest pictures.
+    void ReaderLagTable::DisableCursor() noexcept
+    {
+        if (!OwnSlot) return;
+        if (OwnSlot->CursorMode.exchange(0) == 1) TableHeader->CursorsCount.fetch_sub(1);
+    }
+
+    /// Move the cursor of the registered slot.
+    void ReaderLagTable::AdvanceCursor(std::uint64_t sequence) noexcept
+    {
+        if (!OwnSlot) return;
+        OwnSlot->Cursor.store(sequence, std::memory_order_release);
+        OwnSlot->ReadTime.store(GetMonotonicTime(), std::memory_order_release);
+    }
+
+    /// Get the minimum cursor of readers which hold back commits.
+    std::optional<std::uint64_t> ReaderLagTable::GetMinimumCursor(unsigned int limit,
+                                                                  std::chrono::nanoseconds idle_timeout) const
+    {
+        // Checked on every commit, so tables without any cursor are skipped without scanning slots.
+        if (limit == 0 || TableHeader->CursorsCount.load(std::memory_order_acquire) == 0) return std::nullopt;
+        const auto now = GetMonotonicTime();
+        std::optional<std::uint64_t> minimum_cursor;
+        for (std::uint32_t slot_index = 0; slot_index < TableHeader->Capacity && limit > 0; ++slot_index)
+        {
+            auto& slot = Slots[slot_index];
+            if (slot.ProcessID.load() == 0 || slot.CursorMode.load(std::memory_order_acquire) == 0) continue;
+            --limit;
+            auto read_time = slot.ReadTime.load(std::memory_order_acquire);
+            if (now - std::min(now, read_time) > static_cast<std::uint64_t>(idle_timeout.count())) continue;
+            auto cursor = slot.Cursor.load(std::memory_order_acquire);
+            if (!minimum_cursor || cursor < *minimum_cursor) minimum_cursor = cursor;
+        }
+        return minimum_cursor;
+    }
+
+    /// Collect lags of readers.
+    ReaderLagTable::LagReport ReaderLagTable::Collect(std::chrono::nanoseconds idle_timeout)
+    {
+        LagReport report;
+        const auto now = GetMonotonicTime();
+        for (std::uint32_t slot_index = 0; slot_index < TableHeader->Capacity; ++slot_index)
+        {
+            auto& slot = Slots[slot_index];
+            auto process_id = slot.ProcessID.load();
+            if (process_id == 0) continue;
+            if (kill(static_cast<pid_t>(process_id), 0) != 0 && errno == ESRCH)
+            {
+                if (slot.CursorMode.exchange(0) == 1) TableHeader->CursorsCount.fetch_sub(1);
+                slot.ProcessID.compare_exchange_strong(process_id, 0);
+                continue;
+            }
+            if (slot.CursorMode.load() == 1) ++report.CursorsCount;
+            auto max_lag = slot.MaxLag.exchange(0);
+            auto read_time = slot.ReadTime.load(std::memory_order_acquire);
+            if (read_time == 0 || now - std::min(now, read_time) > static_cast<std::uint64_t>(idle_timeout.count()))
+            {
+                continue;
+            }
+            ++report.ReadersCount;
+            report.HighWater = std::max(report.HighWater, max_lag);
+        }
+        return report;
+    }
+}
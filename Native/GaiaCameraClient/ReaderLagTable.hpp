@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "SharedBlock.hpp"
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Table of readers of a picture in a shared block, which tells the server how far readers fall behind.
+     * @details
+     *  The block is named as "{device_name}.{picture_name}.readers" and created by the camera server.
+     *  Every reader registers itself in a free slot, and after every read it records its lag in frames,
+     *  which is the count of pictures committed from the picture it read until the copy finished:
+     *  a reader whose lag reaches the count of swap chain blocks has its pictures overwritten while copying them.
+     *  Readers which consume every picture in order also keep their cursor, the latest consumed sequence, here,
+     *  so the server can hold back commits which would overwrite pictures they have not consumed yet.
+     *  Slots of processes which exit without releasing them are reclaimed by the server.
+     */
+    class ReaderLagTable
+    {
+    public:
+        /// Header at the beginning of the shared block.
+        struct Header
+        {
+            /// Magic number to verify the layout.
+            std::uint32_t Magic;
+            /// Version of the layout.
+            std::uint32_t Version;
+            /// Count of slots.
+            std::uint32_t Capacity;
+            /// Count of slots in the cursor mode.
+            std::atomic<std::uint32_t> CursorsCount;
+        };
+
+        /// Slot of a registered reader.
+        struct Slot
+        {
+            /// ID of the process which owns this slot, 0 means the slot is free.
+            std::atomic<std::uint32_t> ProcessID;
+            /// Whether the reader consumes every picture in order through its cursor.
+            std::atomic<std::uint32_t> CursorMode;
+            /// Sequence of the latest picture consumed in the cursor mode.
+            std::atomic<std::uint64_t> Cursor;
+            /// Maximum lag in frames since the server collected it.
+            std::atomic<std::uint64_t> MaxLag;
+            /// Time of the latest read in CLOCK_MONOTONIC nanoseconds.
+            std::atomic<std::uint64_t> ReadTime;
+        };
+
+        /// Lags of all active readers collected by the server.
+        struct LagReport
+        {
+            /// Count of readers which have read a picture recently.
+            unsigned int ReadersCount {0};
+            /// Maximum lag in frames among these readers.
+            std::uint64_t HighWater {0};
+            /// Count of readers in the cursor mode.
+            unsigned int CursorsCount {0};
+        };
+
+        static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+                "Reader lag table requires lock-free 64 bits atomic integers.");
+
+        /// Magic number of the layout, "GCRL".
+        static constexpr std::uint32_t LayoutMagic = 0x4C524347;
+        /// Version of the layout.
+        static constexpr std::uint32_t LayoutVersion = 2;
+
+    private:
+        /// Shared block which holds the table.
+        std::unique_ptr<SharedBlock> Block;
+        /// Header in the shared block.
+        Header* TableHeader {nullptr};
+        /// Slots in the shared block.
+        Slot* Slots {nullptr};
+        /// Slot registered by this instance, nullptr for the server or if the table is full.
+        Slot* OwnSlot {nullptr};
+
+    public:
+        /**
+         * @brief Create a reader table, used by the server.
+         * @param block_name Name of the shared block.
+         * @param capacity Count of readers which can be registered at the same time.
+         */
+        ReaderLagTable(const std::string& block_name, std::uint32_t capacity);
+        /**
+         * @brief Open an existing reader table and register a slot in it, used by clients.
+         * @param block_name Name of the shared block.
+         * @details If every slot is taken, this reader is not tracked, and reads are not recorded.
+         */
+        explicit ReaderLagTable(const std::string& block_name);
+        /// Release the registered slot.
+        ~ReaderLagTable();
+
+        ReaderLagTable(const ReaderLagTable&) = delete;
+        ReaderLagTable& operator=(const ReaderLagTable&) = delete;
+
+        /// Generate the name of the shared block of readers of a picture.
+        static std::string GenerateBlockName(const std::string& device_name, const std::string& picture_name);
+
+        /// Check whether this instance owns a slot.
+        [[nodiscard]] inline bool IsRegistered() const noexcept
+        {
+            return OwnSlot != nullptr;
+        }
+
+        /**
+         * @brief Record a finished read in the registered slot.
+         * @param lag Count of pictures committed from the read picture until the read finished.
+         */
+        void RecordRead(std::uint64_t lag) noexcept;
+
+        /**
+         * @brief Switch the registered slot into the cursor mode.
+         * @param cursor Sequence of the latest picture which is regarded as consumed.
+         */
+        void EnableCursor(std::uint64_t cursor) noexcept;
+        /// Switch the registered slot back to reading the latest pictures.
+        void DisableCursor() noexcept;
+        /// Move the cursor of the registered slot to the given consumed sequence.
+        void AdvanceCursor(std::uint64_t sequence) noexcept;
+
+        /**
+         * @brief Get the minimum cursor of readers in the cursor mode which hold back commits, used by the server.
+         * @param limit Count of readers which may hold back commits, the ones in the first slots are chosen.
+         * @param idle_timeout Readers which have not moved their cursors within this time are not waited for.
+         * @return Minimum cursor, or std::nullopt if no reader holds back commits.
+         * @details Readers beyond the limit still read in order, they skip the pictures they missed.
+         */
+        [[nodiscard]] std::optional<std::uint64_t> GetMinimumCursor(unsigned int limit,
+                                                                    std::chrono::nanoseconds idle_timeout) const;
+
+        /**
+         * @brief Collect lags of readers, used by the server.
+         * @param idle_timeout Readers which have not read any picture within this time are ignored.
+         * @details Maximum lags recorded by readers are reset, and slots of exited processes are released.
+         */
+        LagReport Collect(std::chrono::nanoseconds idle_timeout);
+    };
+}
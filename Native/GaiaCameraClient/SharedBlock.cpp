@@ -0,0 +1,85 @@
+#include "SharedBlock.hpp"
+
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace Gaia::CameraService
+{
+    /// Map the block with the given name.
+    SharedBlock::SharedBlock(std::string name, std::size_t size, bool create, bool writable) :
+        Name(std::move(name)), Size(size), Owner(create)
+    {
+        auto shared_name = "/" + Name;
+        int flags = writable ? O_RDWR : O_RDONLY;
+        if (create)
+        {
+            shm_unlink(shared_name.c_str());
+            flags |= O_CREAT | O_EXCL;
+        }
+        auto descriptor = shm_open(shared_name.c_str(), flags, 0666);
+        if (descriptor < 0)
+        {
+            throw std::runtime_error("Failed to open shared block " + Name + ": " + std::strerror(errno));
+        }
+
+        if (create)
+        {
+            if (ftruncate(descriptor, static_cast<off_t>(Size)) != 0)
+            {
+                auto error = errno;
+                close(descriptor);
+                shm_unlink(shared_name.c_str());
+                throw std::runtime_error("Failed to resize shared block " + Name + ": " + std::strerror(error));
+            }
+        }
+        else
+        {
+            struct stat status {};
+            if (fstat(descriptor, &status) != 0 || status.st_size <= 0)
+            {
+                close(descriptor);
+                throw std::runtime_error("Shared block " + Name + " is empty.");
+            }
+            Size = static_cast<std::size_t>(status.st_size);
+        }
+
+        Pointer = mmap(nullptr, Size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, descriptor, 0);
+        close(descriptor);
+        if (Pointer == MAP_FAILED)
+        {
+            Pointer = nullptr;
+            if (create) shm_unlink(shared_name.c_str());
+            throw std::runtime_error("Failed to map shared block " + Name + ": " + std::strerror(errno));
+        }
+    }
+
+    /// Create a shared block.
+    std::unique_ptr<SharedBlock> SharedBlock::Create(const std::string& name, std::size_t size)
+    {
+        return std::unique_ptr<SharedBlock>(new SharedBlock(name, size, true, true));
+    }
+
+    /// Open an existing shared block.
+    std::unique_ptr<SharedBlock> SharedBlock::Open(const std::string& name, bool writable)
+    {
+        return std::unique_ptr<SharedBlock>(new SharedBlock(name, 0, false, writable));
+    }
+
+    /// Unmap and unlink the block.
+    SharedBlock::~SharedBlock()
+    {
+        if (Pointer)
+        {
+            munmap(Pointer, Size);
+        }
+        if (Owner)
+        {
+            shm_unlink(("/" + Name).c_str());
+        }
+    }
+}
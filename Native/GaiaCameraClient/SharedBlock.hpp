@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <cstddef>
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Raw POSIX shared memory block mapped into this process.
+     * @details
+     *  Used for fixed layout structures shared between camera servers and clients,
+     *  which are not pictures and thus are not suitable for shared picture blocks.
+     *  The block created by an owner will be unlinked when the owner is destructed,
+     *  processes which have already mapped it can still use it until they unmap it.
+     */
+    class SharedBlock
+    {
+    private:
+        /// Name of the shared memory block.
+        const std::string Name;
+        /// Address of the mapped memory.
+        void* Pointer {nullptr};
+        /// Size of the mapped memory in bytes.
+        std::size_t Size {0};
+        /// Whether this instance created the block and should unlink it.
+        bool Owner {false};
+
+        /// Map the block with the given name.
+        SharedBlock(std::string name, std::size_t size, bool create, bool writable);
+
+    public:
+        /**
+         * @brief Create a shared block, an existing block with the same name will be replaced.
+         * @param name Name of the shared block.
+         * @param size Size of the shared block in bytes.
+         * @return Created shared block, which will be filled with 0.
+         */
+        static std::unique_ptr<SharedBlock> Create(const std::string& name, std::size_t size);
+        /**
+         * @brief Open an existing shared block.
+         * @param name Name of the shared block.
+         * @param writable Whether this process requires to write the block or not.
+         * @return Opened shared block, whose size is the size of the existing block.
+         * @throw std::runtime_error If the block does not exist.
+         */
+        static std::unique_ptr<SharedBlock> Open(const std::string& name, bool writable = false);
+
+        /// Unmap the block, and unlink it if this instance is the owner.
+        ~SharedBlock();
+
+        SharedBlock(const SharedBlock&) = delete;
+        SharedBlock& operator=(const SharedBlock&) = delete;
+
+        /// Keep the block after this instance is destructed, for blocks which outlive the process created them.
+        inline void Persist() noexcept
+        {
+            Owner = false;
+        }
+
+        /// Get the name of this block.
+        [[nodiscard]] inline const std::string& GetName() const noexcept
+        {
+            return Name;
+        }
+
+        /// Get the address of the mapped memory.
+        [[nodiscard]] inline void* GetPointer() const noexcept
+        {
+            return Pointer;
+        }
+
+        /// Get the size of the mapped memory in bytes.
+        [[nodiscard]] inline std::size_t GetSize() const noexcept
+        {
+            return Size;
+        }
+    };
+}
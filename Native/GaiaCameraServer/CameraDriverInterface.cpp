@@ -1,6 +1,8 @@
 #include "CameraDriverInterface.hpp"
 
+#include <algorithm>
 #include <utility>
+#include <chrono>
 #include "CameraServer.hpp"
 
 namespace Gaia::CameraService
@@ -64,6 +66,51 @@ namespace Gaia::CameraService
         return nullptr;
     }
 
+    /// Get the worker pool lent by the camera host.
+    WorkerPool* CameraDriverInterface::GetWorkerPool() const
+    {
+        if (Server)
+        {
+            return Server->ConversionPool;
+        }
+        return nullptr;
+    }
+
+    /// Write a picture into the writing block in bands.
+    void CameraDriverInterface::WritePicture(SwapChain& chain, const cv::Mat& picture, bool flip)
+    {
+        if (picture.type() != chain.GetPixelType() || picture.cols != static_cast<int>(chain.GetHeader().Width) ||
+            picture.rows != static_cast<int>(chain.GetHeader().Height))
+        {
+            // The writer rewrites the header for pictures which do not match the swap chain.
+            if (flip)
+            {
+                cv::Mat flipped_picture;
+                cv::flip(picture, flipped_picture, -1);
+                chain.Write(flipped_picture);
+            }
+            else chain.Write(picture);
+            return;
+        }
+
+        auto block = chain.ViewWritingBlock();
+        auto write_band = [&picture, &block, flip](std::size_t begin, std::size_t end){
+            auto first_row = static_cast<int>(begin);
+            auto last_row = static_cast<int>(end);
+            cv::Mat destination = block.rowRange(first_row, last_row);
+            if (flip)
+            {
+                cv::flip(picture.rowRange(picture.rows - last_row, picture.rows - first_row), destination, -1);
+            }
+            else picture.rowRange(first_row, last_row).copyTo(destination);
+        };
+        if (auto* pool = GetWorkerPool())
+        {
+            pool->ParallelFor(static_cast<std::size_t>(picture.rows), write_band, 64);
+        }
+        else write_band(0, static_cast<std::size_t>(picture.rows));
+    }
+
     /// Initialize this camera.
     void CameraDriverInterface::Initialize(unsigned int device_index, CameraServer *server)
     {
@@ -90,4 +137,350 @@ namespace Gaia::CameraService
             Server->UpdatePictureBlocksCount(picture_name, blocks_count);
         }
     }
-}
\ No newline at end of file
+
+    /// Create the swap chain for the given picture.
+    SwapChain& CameraDriverInterface::CreateSwapChain(const std::string &picture_name,
+                                                      const SharedPicture::PictureHeader &header,
+                                                      long block_size, unsigned int blocks_count,
+                                                      std::size_t row_alignment)
+    {
+        auto chain = MakeSwapChain(picture_name, header, block_size, blocks_count, row_alignment);
+        auto& chain_reference = *chain;
+        SwapChains[picture_name] = std::move(chain);
+        UpdatePictureBlocksCount(picture_name, chain_reference.GetBlocksCount());
+        if (Server) Server->UpdatePictureLayout(chain_reference);
+        return chain_reference;
+    }
+
+    /// Make a configured swap chain for the given picture.
+    std::unique_ptr<SwapChain> CameraDriverInterface::MakeSwapChain(const std::string &picture_name,
+                                                                    const SharedPicture::PictureHeader &header,
+                                                                    long block_size, unsigned int blocks_count,
+                                                                    std::size_t row_alignment)
+    {
+        auto* configurator = GetConfigurator();
+        if (row_alignment == 0)
+        {
+            row_alignment = configurator ? configurator->Get<unsigned int>("RowAlignment").value_or(64) : 64;
+        }
+        unsigned int max_blocks_count = 0;
+        bool adaptive = false;
+        if (configurator)
+        {
+            // Settings of the picture override the ones of all pictures.
+            auto depth = configurator->Get<unsigned int>("SwapChainDepth." + picture_name);
+            if (!depth) depth = configurator->Get<unsigned int>("SwapChainDepth");
+            if (depth) blocks_count = std::max(*depth, 2u);
+            auto adaptive_text = configurator->Get("SwapChainAdaptive." + picture_name);
+            if (!adaptive_text) adaptive_text = configurator->Get("SwapChainAdaptive");
+            adaptive = adaptive_text.value_or("false") == "true";
+        }
+        if (adaptive)
+        {
+            // The memory cap in megabytes defaults to 4 times the configured depth, at most 64 blocks.
+            auto default_cap = static_cast<unsigned long>(block_size) * blocks_count * 4 / (1024 * 1024) + 1;
+            auto memory_cap = configurator->Get<unsigned long>("SwapChainMemoryCap").value_or(default_cap);
+            auto capped_count = memory_cap * 1024 * 1024 / static_cast<unsigned long>(std::max(block_size, 1L));
+            max_blocks_count = static_cast<unsigned int>(
+                    std::clamp(capped_count, static_cast<unsigned long>(blocks_count), 64ul));
+        }
+        auto chain = std::make_unique<SwapChain>(picture_name, DeviceName + "." + picture_name,
+                                                 header, block_size, blocks_count, row_alignment, max_blocks_count);
+        auto& chain_reference = *chain;
+        // Blocks are only touched by their headers yet, so their pages are allocated on the configured node.
+        for (auto block_id = 0u; block_id < blocks_count && Scheduler.GetNumaNode() >= 0; ++block_id)
+        {
+            auto& block = chain_reference.GetBlock(block_id);
+            if (!Scheduler.BindMemory(block.GetPointer(), static_cast<std::size_t>(block.GetMaxSize())) && Server)
+            {
+                GetLogger()->RecordWarning("Failed to bind picture " + picture_name + " on NUMA node " +
+                                           std::to_string(Scheduler.GetNumaNode()) + ".");
+                break;
+            }
+        }
+        if (configurator)
+        {
+            auto huge_pages = configurator->Get("SwapChainHugePages").value_or("false") == "true";
+            auto prefault = configurator->Get("SwapChainPrefault").value_or("false") == "true";
+            auto lock = configurator->Get("SwapChainLock").value_or("false") == "true";
+            auto state = chain_reference.PrepareMemory(huge_pages, prefault, lock);
+            // Blocks added by the adaptive depth are prepared as the ones which succeeded now.
+            chain_reference.SetBlockPreparer([this, state](SharedPicture::PictureWriter& block) {
+                if (Scheduler.GetNumaNode() >= 0)
+                    Scheduler.BindMemory(block.GetPointer(), static_cast<std::size_t>(block.GetMaxSize()));
+                SwapChain::PrepareBlock(block, state);
+            });
+            if (huge_pages && !state.HugePages)
+                GetLogger()->RecordWarning("Huge pages are not available for picture " + picture_name +
+                                           ", normal pages are used.");
+            if (lock && !state.Locked)
+                GetLogger()->RecordWarning("Failed to lock picture " + picture_name +
+                                           " into memory, check RLIMIT_MEMLOCK.");
+            std::string memory_text;
+            if (state.HugePages) memory_text += "huge_pages,";
+            if (state.Prefaulted) memory_text += "prefaulted,";
+            if (state.Locked) memory_text += "locked,";
+            memory_text = memory_text.empty() ? "normal" : memory_text.substr(0, memory_text.size() - 1);
+            GetDatabase()->set("cameras/" + DeviceName + "/pictures/" + picture_name + "/memory", memory_text);
+        }
+        if (adaptive)
+        {
+            auto quiet_seconds = configurator->Get<unsigned int>("SwapChainQuietSeconds").value_or(30);
+            chain_reference.EnableAdaptiveDepth(blocks_count, std::chrono::seconds(quiet_seconds));
+        }
+        if (configurator)
+        {
+            auto limit = configurator->Get<unsigned int>("BackpressureReaders").value_or(0);
+            auto timeout = configurator->Get<unsigned int>("BackpressureTimeout").value_or(2000);
+            chain_reference.SetBackpressure(limit, std::chrono::milliseconds(timeout));
+
+            auto change_mode = configurator->Get("ChangeDetection." + picture_name);
+            if (!change_mode) change_mode = configurator->Get("ChangeDetection");
+            if (change_mode == "skip" || change_mode == "mark")
+            {
+                auto threshold = configurator->Get<double>("ChangeThreshold").value_or(2.0);
+                auto grid_step = configurator->Get<unsigned int>("ChangeGridStep").value_or(4);
+                auto keyframe_seconds = configurator->Get<double>("ChangeKeyframeSeconds").value_or(1.0);
+                chain_reference.SetChangeDetector(std::make_unique<ChangeDetector>(
+                        change_mode == "skip" ? ChangeDetector::Modes::Skip : ChangeDetector::Modes::Mark,
+                        threshold, std::max(grid_step, 1u),
+                        std::chrono::nanoseconds(static_cast<std::int64_t>(keyframe_seconds * 1e9))));
+            }
+        }
+        return chain;
+    }
+
+    /// Release all swap chains.
+    void CameraDriverInterface::ReleaseSwapChains()
+    {
+        SwapChains.clear();
+    }
+
+    /// Get the swap chain of the given picture.
+    SwapChain* CameraDriverInterface::GetSwapChain(const std::string &picture_name)
+    {
+        auto finder = SwapChains.find(picture_name);
+        if (finder == SwapChains.end()) return nullptr;
+        return finder->second.get();
+    }
+
+    /// Resolve capture times of a picture.
+    FrameMetadata CameraDriverInterface::ResolveCaptureTime(const CaptureTime &capture)
+    {
+        FrameMetadata metadata;
+        metadata.MonotonicTimestamp = capture.HostTimestamp;
+        metadata.DeviceTimestamp = capture.DeviceTimestamp;
+        if (capture.DeviceTimestamp != 0)
+        {
+            DeviceClock.AddSample(capture.DeviceTimestamp, capture.HostTimestamp);
+            // Mapped device time excludes the jitter of the delivery latency.
+            if (auto mapped_timestamp = DeviceClock.Map(capture.DeviceTimestamp))
+            {
+                metadata.MonotonicTimestamp = *mapped_timestamp;
+            }
+        }
+        metadata.Timestamp = ConvertMonotonicToEpoch(metadata.MonotonicTimestamp);
+        return metadata;
+    }
+
+    /// Generate the stamp of a picture.
+    PictureStamp CameraDriverInterface::GenerateStamp(const FrameMetadata &metadata) const
+    {
+        PictureStamp stamp;
+        stamp.Timestamp = metadata.Timestamp;
+        stamp.MonotonicTimestamp = metadata.MonotonicTimestamp;
+        stamp.DeviceTimestamp = metadata.DeviceTimestamp;
+        stamp.SourceSequence = metadata.SourceSequence;
+        stamp.Flags = metadata.Flags;
+        stamp.Exposure = metadata.Exposure;
+        stamp.Gain = metadata.Gain;
+        if (stamp.Exposure == 0 && Server)
+        {
+            stamp.Exposure = Server->CachedExposure;
+            stamp.Gain = Server->CachedGain;
+        }
+        return stamp;
+    }
+
+    /// Swap the writing block unless the picture is dropped or skipped.
+    std::optional<unsigned int> CameraDriverInterface::SwapPicture(SwapChain &chain, const FrameMetadata &metadata)
+    {
+        // The writing block is kept, so the next picture is written over the dropped one.
+        if (chain.IsBackpressured())
+        {
+            chain.DropPicture();
+            return std::nullopt;
+        }
+        auto stamp = GenerateStamp(metadata);
+        // Dropped pictures are not examined, so the reference is always a picture readers have got.
+        if (auto* detector = chain.GetChangeDetector();
+            detector && !detector->Examine(chain.ViewWritingBlock(), metadata.MonotonicTimestamp))
+        {
+            if (detector->GetMode() == ChangeDetector::Modes::Skip) return std::nullopt;
+            stamp.Flags |= PictureStamp::UnchangedFlag;
+        }
+        return chain.Swap(stamp);
+    }
+
+    /// Swap the writing block of a swap chain and publish the committed block.
+    void CameraDriverInterface::PublishPicture(SwapChain &chain, const FrameMetadata &metadata)
+    {
+        auto block_id = SwapPicture(chain, metadata);
+        if (!block_id || !Server) return;
+        Server->UpdatePictureBlockID(chain.GetPictureName(), *block_id);
+        Server->UpdatePictureTimestamp(chain.GetPictureName(), metadata.Timestamp);
+        Server->OnPictureCommitted(chain, *block_id, metadata);
+    }
+
+    /// Commit pictures derived from the same capture and publish them in one pipeline.
+    void CameraDriverInterface::CommitPictures(const std::vector<SwapChain*>& chains, std::uint64_t timestamp)
+    {
+        FrameMetadata metadata;
+        metadata.Timestamp = timestamp;
+        metadata.MonotonicTimestamp = ConvertEpochToMonotonic(timestamp);
+        std::vector<std::tuple<std::string, unsigned int>> picture_blocks;
+        std::vector<SwapChain*> committed_chains;
+        picture_blocks.reserve(chains.size());
+        committed_chains.reserve(chains.size());
+        for (auto* chain : chains)
+        {
+            if (auto block_id = SwapPicture(*chain, metadata))
+            {
+                picture_blocks.emplace_back(chain->GetPictureName(), *block_id);
+                committed_chains.push_back(chain);
+            }
+        }
+        if (Server && !picture_blocks.empty())
+        {
+            Server->UpdatePictures(picture_blocks, timestamp);
+            for (std::size_t index = 0; index < committed_chains.size(); ++index)
+            {
+                Server->OnPictureCommitted(*committed_chains[index], std::get<1>(picture_blocks[index]), metadata);
+            }
+        }
+        ApplyParameters();
+    }
+
+    /// Commit the picture in the writing block.
+    void CameraDriverInterface::CommitPicture(SwapChain &chain)
+    {
+        CommitPicture(chain, CaptureTime::Now());
+    }
+
+    /// Commit the picture in the writing block with the given capture time since epoch.
+    void CameraDriverInterface::CommitPicture(SwapChain &chain, std::uint64_t timestamp)
+    {
+        FrameMetadata metadata;
+        metadata.Timestamp = timestamp;
+        metadata.MonotonicTimestamp = ConvertEpochToMonotonic(timestamp);
+        PublishPicture(chain, metadata);
+        ApplyParameters();
+    }
+
+    /// Commit the picture in the writing block with the given capture time.
+    void CameraDriverInterface::CommitPicture(SwapChain &chain, const CaptureTime &capture)
+    {
+        PublishPicture(chain, ResolveCaptureTime(capture));
+        ApplyParameters();
+    }
+
+    /// Commit the picture in the writing block with resolved capture times.
+    void CameraDriverInterface::CommitPicture(SwapChain &chain, const FrameMetadata &metadata)
+    {
+        PublishPicture(chain, metadata);
+        ApplyParameters();
+    }
+
+    /// Commit pictures in the writing blocks as a frame set.
+    unsigned long CameraDriverInterface::CommitFrameSet(const std::string &frame_set_name,
+                                                        const std::vector<SwapChain*>& chains)
+    {
+        return CommitFrameSet(frame_set_name, chains, CaptureTime::Now());
+    }
+
+    /// Commit pictures in the writing blocks as a frame set with the given capture time.
+    unsigned long CameraDriverInterface::CommitFrameSet(const std::string &frame_set_name,
+                                                        const std::vector<SwapChain*>& chains,
+                                                        const CaptureTime& capture)
+    {
+        auto metadata = ResolveCaptureTime(capture);
+        // Members are committed together or dropped together, so frame sets stay complete.
+        if (std::any_of(chains.begin(), chains.end(), [](SwapChain* chain){ return chain->IsBackpressured(); }))
+        {
+            for (auto* chain : chains) chain->DropPicture();
+            ApplyParameters();
+            return 0;
+        }
+        auto stamp = GenerateStamp(metadata);
+        std::vector<std::tuple<std::string, unsigned int>> picture_blocks;
+        picture_blocks.reserve(chains.size());
+        for (auto* chain : chains)
+        {
+            picture_blocks.emplace_back(chain->GetPictureName(), chain->Swap(stamp));
+        }
+        ApplyParameters();
+        if (!Server) return 0;
+        auto sequence = Server->UpdateFrameSet(frame_set_name, picture_blocks, metadata.Timestamp);
+        for (std::size_t member_index = 0; member_index < chains.size(); ++member_index)
+        {
+            Server->OnPictureCommitted(*chains[member_index], std::get<1>(picture_blocks[member_index]), metadata);
+        }
+        return sequence;
+    }
+
+    /// Apply parameter changes pending in the parameter queue.
+    void CameraDriverInterface::ApplyParameters()
+    {
+        if (!Parameters) return;
+        std::unique_lock lock(ParametersMutex, std::try_to_lock);
+        if (!lock.owns_lock()) return;
+        bool settings_changed = false;
+        while (auto command = Parameters->Pop())
+        {
+            bool applied = false;
+            try
+            {
+                const auto& values = command->Values;
+                switch (command->Type)
+                {
+                    case ParameterQueue::Command::Types::Exposure:
+                        applied = values[0] >= 0 && SetExposure(static_cast<unsigned int>(values[0]));
+                        settings_changed = settings_changed || applied;
+                        break;
+                    case ParameterQueue::Command::Types::Gain:
+                        applied = SetGain(values[0]);
+                        settings_changed = settings_changed || applied;
+                        break;
+                    case ParameterQueue::Command::Types::WhiteBalance:
+                        applied = true;
+                        if (values[0] >= 0) applied = SetWhiteBalanceRed(values[0]) && applied;
+                        if (values[1] >= 0) applied = SetWhiteBalanceGreen(values[1]) && applied;
+                        if (values[2] >= 0) applied = SetWhiteBalanceBlue(values[2]) && applied;
+                        break;
+                    case ParameterQueue::Command::Types::RegionOfInterest:
+                        applied = SetRegionOfInterest(static_cast<int>(values[0]), static_cast<int>(values[1]),
+                                                      static_cast<int>(values[2]), static_cast<int>(values[3]));
+                        break;
+                }
+            }catch (std::exception& error)
+            {
+                if (auto* logger = GetLogger())
+                    logger->RecordError(std::string("Failed to apply a queued parameter change: ") + error.what());
+            }
+            const auto now = ParameterQueue::GetMonotonicTime();
+            const auto latency = now - std::min(now, command->SubmitTime);
+            Parameters->Acknowledge(applied, latency);
+            if (!applied)
+            {
+                ++RejectedParametersCount;
+                continue;
+            }
+            ++AppliedParametersCount;
+            ParametersLatencySum += latency;
+            auto max_latency = ParametersLatencyMax.load(std::memory_order_relaxed);
+            while (latency > max_latency && !ParametersLatencyMax.compare_exchange_weak(max_latency, latency)) {}
+        }
+        // Pictures committed after this carry the new settings, as with changes through Redis.
+        if (settings_changed && Server) Server->UpdateCachedSettings();
+    }
+}
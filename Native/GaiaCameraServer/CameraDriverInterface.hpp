@@ -5,9 +5,21 @@
 #include <vector>
 #include <string>
 #include <atomic>
+#include <cstdint>
+#include <tuple>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 #include <sw/redis++/redis++.h>
 #include <GaiaLogClient/GaiaLogClient.hpp>
 #include <GaiaConfigurationClient/GaiaConfigurationClient.hpp>
+#include <GaiaCameraClient/ParameterQueue.hpp>
+
+#include "SwapChain.hpp"
+#include "PictureObserver.hpp"
+#include "CaptureClock.hpp"
+#include "WorkerPool.hpp"
+#include "ThreadScheduler.hpp"
 
 namespace Gaia::CameraService
 {
@@ -30,6 +42,24 @@ namespace Gaia::CameraService
         std::string DeviceNameSource;
         /// Type name of the device.
         const std::string DeviceTypeName;
+        /// Swap chains of output pictures, indexed by picture names.
+        std::unordered_map<std::string, std::unique_ptr<SwapChain>> SwapChains;
+        /// Model which maps device time stamped by this camera into host time.
+        ClockMapper DeviceClock;
+        /// Scheduling policy of threads and memory of this camera, loaded by the server before Open().
+        ThreadScheduler Scheduler;
+        /// Queue of parameter changes from a client, created by the server before Open() if it is enabled.
+        std::unique_ptr<ParameterQueue> Parameters;
+        /// Mutex which keeps the queue consumed by one thread at a time.
+        std::mutex ParametersMutex;
+        /// Count of applied parameter changes since the server took the statistics.
+        std::atomic<std::uint64_t> AppliedParametersCount {0};
+        /// Count of rejected parameter changes since the server took the statistics.
+        std::atomic<std::uint64_t> RejectedParametersCount {0};
+        /// Sum of command-to-effect latencies of applied parameter changes in nanoseconds.
+        std::atomic<std::uint64_t> ParametersLatencySum {0};
+        /// Maximum command-to-effect latency of applied parameter changes in nanoseconds.
+        std::atomic<std::uint64_t> ParametersLatencyMax {0};
 
         /**
          * @brief Initialize camera settings.
@@ -38,6 +68,40 @@ namespace Gaia::CameraService
          */
         void Initialize(unsigned int device_index, CameraServer* server);
 
+        /// Resolve capture times of a picture, the device time is mapped into host time if it is given.
+        FrameMetadata ResolveCaptureTime(const CaptureTime& capture);
+
+        /// Generate the stamp of a picture, exposure and gain are taken from the server unless they are given.
+        [[nodiscard]] PictureStamp GenerateStamp(const FrameMetadata& metadata) const;
+
+        /**
+         * @brief Swap the writing block of a swap chain without publishing it.
+         * @return ID of the committed block, or std::nullopt if the picture is dropped or skipped.
+         */
+        std::optional<unsigned int> SwapPicture(SwapChain& chain, const FrameMetadata& metadata);
+
+        /// Swap the writing block of a swap chain and publish the committed block.
+        void PublishPicture(SwapChain& chain, const FrameMetadata& metadata);
+
+        /**
+         * @brief Commit pictures derived from the same capture, such as regions of a source picture.
+         * @param chains Swap chains of the pictures.
+         * @param timestamp Capture time of the pictures in nanoseconds since epoch.
+         * @details
+         *  Pictures are dropped or committed one by one like CommitPicture(),
+         *  but block IDs and timestamps of all committed pictures are published in one pipeline.
+         */
+        void CommitPictures(const std::vector<SwapChain*>& chains, std::uint64_t timestamp);
+
+        /**
+         * @brief Apply parameter changes pending in the parameter queue.
+         * @details
+         *  Invoked after every commit, so changes take effect between frames on the capture thread,
+         *  and by the server once per second for cameras which do not deliver frames.
+         *  It returns at once if another thread is draining the queue.
+         */
+        void ApplyParameters();
+
     protected:
         /**
          * @brief Constructor which will generate DeviceName.
@@ -53,12 +117,122 @@ namespace Gaia::CameraService
         /// Update the total amount of swap chain blocks.
         void UpdatePictureBlocksCount(const std::string& picture_name, unsigned int blocks_count);
 
+        /**
+         * @brief Create the swap chain for the picture with the given name, and publish its blocks count.
+         * @details The chain is configured by MakeSwapChain() and then owned by this driver.
+         * @param picture_name Name of the picture.
+         * @param header Header of the picture.
+         * @param block_size Size of every shared block in bytes.
+         * @param blocks_count Count of shared blocks in the swap chain, overridden by the configuration
+         *                     "SwapChainDepth.{picture_name}" or "SwapChainDepth".
+         * @param row_alignment Alignment of rows in bytes, 0 means the configuration "RowAlignment" (default 64),
+         *                      drivers which copy whole packed frames into blocks should use 1.
+         * @return Reference to the created swap chain, which is owned by this driver until released.
+         * @details
+         *  With the configuration "SwapChainAdaptive" (or "SwapChainAdaptive.{picture_name}") set to "true",
+         *  the count of blocks grows with lags of readers up to "SwapChainMemoryCap" megabytes
+         *  (default 4 times the configured depth, at most 64 blocks), and shrinks back after
+         *  "SwapChainQuietSeconds" (default 30) without a lag close to the depth.
+         *  Up to "BackpressureReaders" (default 0) readers in the cursor mode hold back commits which would
+         *  overwrite pictures they have not consumed, unless they have not moved their cursors for
+         *  "BackpressureTimeout" (default 2000) milliseconds.
+         *  With "ChangeDetection" (or "ChangeDetection.{picture_name}") set to "skip" or "mark", pictures whose
+         *  difference from the latest changed picture is below "ChangeThreshold" (default 2.0) are not committed
+         *  or committed with the unchanged flag, sampled every "ChangeGridStep" (default 4) rows and runs,
+         *  and a picture is committed as changed at least every "ChangeKeyframeSeconds" (default 1.0).
+         */
+        SwapChain& CreateSwapChain(const std::string& picture_name, const SharedPicture::PictureHeader& header,
+                                   long block_size, unsigned int blocks_count, std::size_t row_alignment = 0);
+        /**
+         * @brief Make a swap chain configured as the ones created by CreateSwapChain(), without owning it.
+         * @details
+         *  The server makes swap chains of derived pictures, such as regions, by this method,
+         *  so they follow the same depth, memory, backpressure and change detection configurations.
+         * @return Configured swap chain, whose blocks are named "{DeviceName}.{picture_name}".
+         */
+        std::unique_ptr<SwapChain> MakeSwapChain(const std::string& picture_name,
+                                                 const SharedPicture::PictureHeader& header,
+                                                 long block_size, unsigned int blocks_count,
+                                                 std::size_t row_alignment = 0);
+        /// Release all swap chains and their shared blocks.
+        void ReleaseSwapChains();
+        /**
+         * @brief Commit the picture in the writing block of the given swap chain.
+         * @details
+         *  The block ID and the timestamp of the picture will be published.
+         *  The picture is dropped instead if committing it would overwrite a picture which a reader
+         *  in the cursor mode has not consumed, see CreateSwapChain().
+         *  The capture time is taken now, so drivers should prefer the overload with a capture time
+         *  taken at the entry of the capture callback, which does not include the processing time.
+         */
+        void CommitPicture(SwapChain& chain);
+        /**
+         * @brief Commit the picture in the writing block of the given swap chain with the given capture time.
+         * @param timestamp Capture time of the picture in nanoseconds since epoch.
+         */
+        void CommitPicture(SwapChain& chain, std::uint64_t timestamp);
+        /**
+         * @brief Commit the picture in the writing block of the given swap chain with the given capture time.
+         * @param capture Capture time taken by CaptureTime::Now() at the entry of the capture callback.
+         * @details
+         *  If the device time is given, it is fed into the device clock model,
+         *  and the published capture time is mapped from it once the model is fitted.
+         */
+        void CommitPicture(SwapChain& chain, const CaptureTime& capture);
+        /**
+         * @brief Commit the picture in the writing block of the given swap chain with resolved capture times.
+         * @param metadata Capture times of the picture, published as they are.
+         * @details
+         *  Used by drivers which republish pictures captured elsewhere, such as replayed or mirrored pictures,
+         *  whose capture times must not be fed into the device clock model.
+         */
+        void CommitPicture(SwapChain& chain, const FrameMetadata& metadata);
+        /**
+         * @brief Commit pictures in the writing blocks of the given swap chains as a frame set.
+         * @param frame_set_name Name of the frame set.
+         * @param chains Swap chains of the member pictures.
+         * @return Sequence number of the committed frame set.
+         * @details
+         *  Block IDs and timestamps of all member pictures are published atomically under one
+         *  sequence number, so readers can pair pictures from the same capture.
+         *  If any member is held back by readers in the cursor mode, all members are dropped and 0 is returned.
+         */
+        unsigned long CommitFrameSet(const std::string& frame_set_name, const std::vector<SwapChain*>& chains);
+        /**
+         * @brief Commit pictures in the writing blocks of the given swap chains as a frame set.
+         * @param capture Capture time of all member pictures.
+         * @return Sequence number of the committed frame set.
+         */
+        unsigned long CommitFrameSet(const std::string& frame_set_name, const std::vector<SwapChain*>& chains,
+                                     const CaptureTime& capture);
+
         /// Get logger of the host camera server.
         [[nodiscard]] LogService::LogClient* GetLogger() const;
         /// Get configurator of the host camera server.
         [[nodiscard]] ConfigurationService::ConfigurationClient* GetConfigurator() const;
         /// Get connection to the Redis server.
         [[nodiscard]] sw::redis::Redis* GetDatabase() const;
+        /// Get the worker pool shared by cameras in the same process, or nullptr if the server runs alone.
+        [[nodiscard]] WorkerPool* GetWorkerPool() const;
+
+        /**
+         * @brief Apply the configured scheduling policy of the role to the calling thread.
+         * @details Drivers invoke it at the entry of every thread body or SDK callback, it only costs a comparison
+         *          once the policy is applied.
+         */
+        inline void EnterThread(ThreadRole role)
+        {
+            Scheduler.EnterThread(role);
+        }
+
+        /**
+         * @brief Write a picture into the writing block of the given swap chain.
+         * @param flip Whether to rotate the picture by 180 degrees while writing it.
+         * @details
+         *  Rows are copied straight into the shared block without an intermediate picture,
+         *  in bands on the shared worker pool if the camera is hosted with other cameras.
+         */
+        void WritePicture(SwapChain& chain, const cv::Mat& picture, bool flip = false);
 
         /// Count of retrieved pictures, used for calculating FPS.
         std::atomic<unsigned long> RetrievedPicturesCount {0};
@@ -86,6 +260,53 @@ namespace Gaia::CameraService
          */
         virtual std::vector<std::tuple<std::string, std::string>> GetPictureNames() = 0;
 
+        /**
+         * @brief Get names list of all frame sets.
+         * @return List of tuples, first string is frame set name, second list is names of member pictures,
+         *         for example, {{"stereo", {"left", "right", "point_cloud"}}}.
+         * @details
+         *  Pictures in a frame set are always committed together, and a picture belongs to at most one frame set.
+         */
+        virtual std::vector<std::tuple<std::string, std::vector<std::string>>> GetFrameSetNames()
+        {
+            return {};
+        }
+
+        /**
+         * @brief Get the swap chain of the picture with the given name.
+         * @return Pointer to the swap chain, or nullptr if the swap chain of this picture is not created.
+         */
+        [[nodiscard]] SwapChain* GetSwapChain(const std::string& picture_name);
+
+        /// Get the scheduling policy of threads and memory of this camera.
+        [[nodiscard]] inline const ThreadScheduler& GetScheduler() const noexcept
+        {
+            return Scheduler;
+        }
+
+        /// Get the model which maps device time stamped by this camera into host time.
+        [[nodiscard]] inline const ClockMapper& GetDeviceClock() const noexcept
+        {
+            return DeviceClock;
+        }
+
+        /**
+         * @brief Handle a command which is not handled by the host server.
+         * @param command Command received from the command channel.
+         * @return True if the command is handled by this driver, otherwise false.
+         */
+        virtual bool HandleCommand(const std::string& command)
+        {
+            return false;
+        }
+
+        /**
+         * @brief Publish the status of this driver, invoked by the host server once per second.
+         * @param pipeline Status pipeline of the host server, which is executed after all status are added.
+         */
+        virtual void UpdateStatus(sw::redis::Pipeline& pipeline)
+        {}
+
         /// Open the camera on the given index and start acquisition.
         virtual void Open() = 0;
         /// Close the camera on the given index and stop acquisition.
@@ -134,6 +355,11 @@ namespace Gaia::CameraService
         virtual bool SetWhiteBalanceGreen(double ratio) = 0;
         /// Get green channel value of the white balance.
         virtual double GetWhiteBalanceGreen() = 0;
+        /**
+         * @brief Set the region of interest of the sensor.
+         * @return False if the camera can not change its region while capturing, which is the default.
+         */
+        virtual bool SetRegionOfInterest(int x, int y, int width, int height) { return false; }
         /**
          * @brief Auto adjust the exposure for once.
          * @details
@@ -0,0 +1,244 @@
+#include "CameraHost.hpp"
+
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace Gaia::CameraService
+{
+    /// Construct a host without cameras.
+    CameraHost::CameraHost(unsigned int port, std::string ip, unsigned int workers_count, std::string host_name) :
+        HostName(std::move(host_name)), Port(port), IP(std::move(ip)), WorkersCount(workers_count)
+    {}
+
+    /// Close all running cameras.
+    CameraHost::~CameraHost()
+    {
+        for (auto& slot : Slots)
+        {
+            if (!slot->Server) continue;
+            try
+            {
+                slot->Server->Stop();
+            }catch (std::exception& error)
+            {
+                slot->Server->Logger->RecordError(std::string("Failed to close camera: ") + error.what());
+            }
+            slot->Server.reset();
+        }
+        if (Connection && !HostName.empty())
+        {
+            try
+            {
+                Connection->srem("camera_hosts", HostName);
+                Connection->del("camera_hosts/" + HostName + "/cameras");
+                Connection->del("camera_hosts/" + HostName + "/running");
+                Connection->del("camera_hosts/" + HostName + "/restarts");
+            }catch (sw::redis::Error& error)
+            {}
+        }
+    }
+
+    /// Add a camera to host.
+    void CameraHost::AddCamera(DriverFactory factory, unsigned int device_index)
+    {
+        if (Connection) throw std::logic_error("Can not add camera to a launched camera host.");
+        auto slot = std::make_unique<Slot>();
+        slot->Factory = std::move(factory);
+        slot->DeviceIndex = device_index;
+        Slots.emplace_back(std::move(slot));
+    }
+
+    /// Construct and start the server of a camera.
+    void CameraHost::StartCamera(Slot& slot)
+    {
+        try
+        {
+            slot.Server = std::make_unique<CameraServer>(slot.Factory(), slot.DeviceIndex, Connection,
+                                                         ConversionPool.get());
+            slot.Server->RequiredFlip = RequiredFlip;
+            if (slot.DeviceName.empty())
+            {
+                slot.DeviceName = slot.Server->CameraDriver->DeviceName;
+                if (HostName.empty())
+                {
+                    HostName = slot.DeviceName;
+                    Logger->Author = HostName;
+                }
+                auto channel = "cameras/" + slot.DeviceName + "/command";
+                CommandRoutes[channel] = &slot;
+                Subscriber->subscribe(channel);
+            }
+            slot.Server->Start();
+            Logger->RecordMessage("Camera " + slot.DeviceName + " started.");
+        }catch (std::exception& error)
+        {
+            FailCamera(slot, error.what());
+        }
+    }
+
+    /// Close the server of a failed camera and schedule its restart.
+    void CameraHost::FailCamera(Slot& slot, const std::string& reason)
+    {
+        Logger->RecordError("Camera " + (slot.DeviceName.empty() ? std::to_string(slot.DeviceIndex) : slot.DeviceName) +
+                            " crashed and will restart in 1 second, exception: " + reason);
+        if (slot.Server)
+        {
+            slot.Server->Logger->RecordError("Camera crashed: " + reason);
+            try
+            {
+                slot.Server->Stop();
+            }catch (std::exception& error)
+            {
+                slot.Server->Logger->RecordError(std::string("Failed to close crashed camera: ") + error.what());
+            }
+            slot.Server.reset();
+        }
+        slot.RestartTime = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        ++slot.RestartsCount;
+    }
+
+    /// Close the server of a camera which is shut down by command.
+    void CameraHost::FinishCamera(Slot& slot)
+    {
+        try
+        {
+            slot.Server->Stop();
+        }catch (std::exception& error)
+        {
+            slot.Server->Logger->RecordError(std::string("Failed to close camera: ") + error.what());
+        }
+        slot.Server.reset();
+        slot.Finished = true;
+        Logger->RecordMessage("Camera " + slot.DeviceName + " stopped.");
+    }
+
+    /// Publish status of all cameras and of this host.
+    void CameraHost::UpdateStatus()
+    {
+        if (!StatusPipeline)
+        {
+            StatusPipeline = std::make_unique<sw::redis::Pipeline>(Connection->pipeline());
+        }
+        std::stringstream camera_names;
+        unsigned int running_count = 0;
+        unsigned int restarts_count = 0;
+        for (auto& slot : Slots)
+        {
+            restarts_count += slot->RestartsCount;
+            if (slot->Finished) continue;
+            if (!slot->DeviceName.empty())
+            {
+                if (camera_names.tellp() > 0) camera_names << ",";
+                camera_names << slot->DeviceName;
+                StatusPipeline->set("cameras/" + slot->DeviceName + "/status/restarts",
+                                    std::to_string(slot->RestartsCount));
+            }
+            if (!slot->Server) continue;
+            try
+            {
+                slot->Server->UpdateStatus(*StatusPipeline);
+                ++running_count;
+            }catch (std::exception& error)
+            {
+                FailCamera(*slot, error.what());
+            }
+        }
+        if (!HostName.empty())
+        {
+            StatusPipeline->sadd("camera_hosts", HostName);
+            StatusPipeline->set("camera_hosts/" + HostName + "/cameras", camera_names.str());
+            StatusPipeline->set("camera_hosts/" + HostName + "/running", std::to_string(running_count));
+            StatusPipeline->set("camera_hosts/" + HostName + "/restarts", std::to_string(restarts_count));
+        }
+        try
+        {
+            StatusPipeline->exec();
+        }catch (sw::redis::Error& error)
+        {
+            // The connection of the pipeline may be broken, it will be recreated on next update.
+            StatusPipeline.reset();
+            Logger->RecordError(std::string("Failed to publish status: ") + error.what());
+        }
+    }
+
+    /// Open all cameras and run the event loop.
+    void CameraHost::Launch()
+    {
+        if (Slots.empty()) throw std::logic_error("Camera host is launched without cameras.");
+        if (Connection) throw std::logic_error("Camera host is launched twice.");
+
+        // Every server keeps a connection for its frame set transaction, the host keeps one for its pipeline.
+        sw::redis::ConnectionOptions connection_options;
+        connection_options.socket_timeout = std::chrono::milliseconds(100);
+        connection_options.host = IP;
+        connection_options.port = static_cast<int>(Port);
+        connection_options.type = sw::redis::ConnectionType::TCP;
+        sw::redis::ConnectionPoolOptions pool_options;
+        pool_options.size = Slots.size() * 2 + 1;
+        Connection = std::make_shared<sw::redis::Redis>(connection_options, pool_options);
+        Logger = std::make_unique<LogService::LogClient>(Connection);
+        Logger->Author = HostName.empty() ? "camera_host" : HostName;
+        Subscriber = std::make_unique<sw::redis::Subscriber>(Connection->subscriber());
+        Subscriber->on_message([this](const std::string& channel, const std::string& value){
+            auto route = CommandRoutes.find(channel);
+            if (route == CommandRoutes.end() || !route->second->Server) return;
+            try
+            {
+                route->second->Server->HandleCommand(value);
+            }catch (std::exception& error)
+            {
+                FailCamera(*route->second, error.what());
+            }
+        });
+        ConversionPool = std::make_unique<WorkerPool>(WorkersCount);
+
+        for (auto& slot : Slots)
+        {
+            StartCamera(*slot);
+        }
+
+        // Enter main loop.
+        auto last_status_update_time = std::chrono::steady_clock::now();
+        while (true)
+        {
+            bool any_camera = false;
+            for (auto& slot : Slots)
+            {
+                if (slot->Finished) continue;
+                if (slot->Server && !slot->Server->IsRunning())
+                {
+                    FinishCamera(*slot);
+                    continue;
+                }
+                any_camera = true;
+                if (!slot->Server && std::chrono::steady_clock::now() >= slot->RestartTime)
+                {
+                    StartCamera(*slot);
+                }
+            }
+            if (!any_camera) break;
+
+            if (CommandRoutes.empty())
+            {
+                // Nothing is subscribed until a camera is constructed.
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+            else
+            {
+                try
+                {
+                    Subscriber->consume();
+                }catch (sw::redis::TimeoutError& error)
+                {}
+            }
+
+            auto current_time = std::chrono::steady_clock::now();
+            if (current_time - last_status_update_time >= std::chrono::seconds(1))
+            {
+                UpdateStatus();
+                last_status_update_time = current_time;
+            }
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <sw/redis++/redis++.h>
+
+#include "CameraServer.hpp"
+#include "WorkerPool.hpp"
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Host of several camera servers in one process.
+     * @details
+     *  All hosted servers share one Redis connection pool, one subscriber which routes commands from
+     *  "cameras/{device_name}/command" to the server of that camera, one status pipeline executed once per second,
+     *  and one worker pool lent to drivers for converting pictures.
+     *  A camera which throws or stops being alive is closed and restarted after 1 second on its own,
+     *  other cameras keep capturing. A camera which receives the "shutdown" command is closed and not restarted,
+     *  the host exits when no camera is left.
+     *  Per-camera CPU affinity is kept in the configuration of every camera, such as "CaptureCores",
+     *  the event loop is shared, so the "Server" policy of hosted cameras is not applied.
+     *  Names of hosted cameras are stored as "camera_hosts/{host_name}/cameras" (comma separated),
+     *  the count of running cameras as "camera_hosts/{host_name}/running",
+     *  the total count of restarts as "camera_hosts/{host_name}/restarts",
+     *  and the count of restarts of every camera as "cameras/{device_name}/status/restarts".
+     */
+    class CameraHost
+    {
+    public:
+        /// Factory of camera drivers, invoked again on every restart of the camera.
+        using DriverFactory = std::function<std::unique_ptr<CameraDriverInterface>()>;
+
+    private:
+        /// Hosted camera.
+        struct Slot
+        {
+            /// Factory of the driver.
+            DriverFactory Factory;
+            /// Index of the camera device.
+            unsigned int DeviceIndex {0};
+            /// Name of the camera device, known once the server is constructed.
+            std::string DeviceName;
+            /// Running server, null while the camera waits for restarting.
+            std::unique_ptr<CameraServer> Server {nullptr};
+            /// Time to construct the server again.
+            std::chrono::steady_clock::time_point RestartTime {};
+            /// Count of restarts of this camera.
+            unsigned int RestartsCount {0};
+            /// Whether the camera is shut down by command.
+            bool Finished {false};
+        };
+
+        /// Name of this host, the name of its first camera if it is empty.
+        std::string HostName;
+        /// Port of the Redis server.
+        const unsigned int Port;
+        /// IP address of the Redis server.
+        const std::string IP;
+        /// Hosted cameras.
+        std::vector<std::unique_ptr<Slot>> Slots;
+        /// Hosted cameras indexed by their command channels.
+        std::unordered_map<std::string, Slot*> CommandRoutes;
+
+        /// Connection pool shared by all hosted servers.
+        std::shared_ptr<sw::redis::Redis> Connection {nullptr};
+        /// Logger of events of this host, such as starts and crashes of cameras.
+        std::unique_ptr<LogService::LogClient> Logger {nullptr};
+        /// Subscriber of command channels of all hosted cameras.
+        std::unique_ptr<sw::redis::Subscriber> Subscriber {nullptr};
+        /// Reusable pipeline for publishing status of all hosted cameras.
+        std::unique_ptr<sw::redis::Pipeline> StatusPipeline {nullptr};
+        /// Worker pool shared by all hosted drivers.
+        std::unique_ptr<WorkerPool> ConversionPool {nullptr};
+        /// Count of worker threads in the pool.
+        const unsigned int WorkersCount;
+
+        /// Construct and start the server of a camera.
+        void StartCamera(Slot& slot);
+        /// Close the server of a failed camera and schedule its restart.
+        void FailCamera(Slot& slot, const std::string& reason);
+        /// Close the server of a camera which is shut down by command.
+        void FinishCamera(Slot& slot);
+
+        /// Publish status of all running cameras and of this host in one pipeline.
+        void UpdateStatus();
+
+    public:
+        /// Whether hosted servers are required to flip pictures or not.
+        bool RequiredFlip {false};
+
+        /**
+         * @brief Construct a host without cameras.
+         * @param port Port of the Redis server.
+         * @param ip IP address of the Redis server.
+         * @param workers_count Count of conversion worker threads, 0 means the count of hardware threads minus 1.
+         * @param host_name Name of this host, the name of its first camera is used if it is empty.
+         */
+        explicit CameraHost(unsigned int port = 6379, std::string ip = "127.0.0.1",
+                            unsigned int workers_count = 0, std::string host_name = "");
+
+        /// Close all running cameras.
+        ~CameraHost();
+
+        /**
+         * @brief Add a camera to host.
+         * @param factory Factory of the camera driver.
+         * @param device_index Index of the camera device.
+         * @pre The host is not launched.
+         */
+        void AddCamera(DriverFactory factory, unsigned int device_index);
+
+        /**
+         * @brief Open all cameras and run the event loop.
+         * @details
+         *  This function will block the invoker thread until all cameras receive the "shutdown" command.
+         *  Failures of cameras are isolated, only failures of the Redis connection are thrown.
+         */
+        void Launch();
+    };
+}
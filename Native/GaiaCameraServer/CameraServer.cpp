@@ -1,9 +1,30 @@
 #include "CameraServer.hpp"
 
+#include <algorithm>
+#include <iterator>
 #include <thread>
+#include <ctime>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <cctype>
 
 namespace Gaia::CameraService
 {
+    namespace
+    {
+        /// Generate the local time text used in names of recorded files.
+        std::string GenerateTimeText()
+        {
+            auto time = std::time(nullptr);
+            std::tm local_time {};
+            localtime_r(&time, &local_time);
+            char time_text[32];
+            std::strftime(time_text, sizeof(time_text), "%Y%m%d-%H%M%S", &local_time);
+            return time_text;
+        }
+    }
+
     /// Connect to the Redis server.
     CameraServer::CameraServer(std::unique_ptr<CameraDriverInterface>&& camera_driver,
                                unsigned int device_index,
@@ -25,6 +46,23 @@ namespace Gaia::CameraService
            this->HandleCommand(value);
         });
 
+        InitializeServices();
+    }
+
+    /// Share the connection and the worker pool of the camera host.
+    CameraServer::CameraServer(std::unique_ptr<CameraDriverInterface>&& camera_driver, unsigned int device_index,
+                               std::shared_ptr<sw::redis::Redis> connection, WorkerPool* pool) :
+        CameraDriver(std::move(camera_driver)), ConversionPool(pool), Connection(std::move(connection))
+    {
+        if (!CameraDriver) throw std::runtime_error("Null camera driver.");
+        if (!Connection) throw std::runtime_error("Null Redis connection.");
+        CameraDriver->Initialize(device_index, this);
+        InitializeServices();
+    }
+
+    /// Create clients of services and picture observers.
+    void CameraServer::InitializeServices()
+    {
         Logger = std::make_unique<LogService::LogClient>(Connection);
         Logger->Author = CameraDriver->DeviceName;
 
@@ -32,11 +70,69 @@ namespace Gaia::CameraService
 
         NameResolver = std::make_unique<NameService::NameClient>(Connection);
         NameResolver->RegisterName(CameraDriver->DeviceName);
+
+        PictureRecorder = std::make_unique<Recorder>(Logger.get());
+        PictureObservers.push_back(PictureRecorder.get());
+        PictureEncoder = std::make_unique<VideoEncoder>(Logger.get());
+        PictureObservers.push_back(PictureEncoder.get());
+        Previewer = std::make_unique<PreviewGenerator>(Logger.get());
+        PictureObservers.push_back(Previewer.get());
+        LevelGenerator = std::make_unique<PyramidGenerator>(Logger.get());
+        PictureObservers.push_back(LevelGenerator.get());
+        Cropper = std::make_unique<RegionCropper>(
+                Logger.get(), [this](const std::vector<SwapChain*>& chains, std::uint64_t timestamp){
+            CameraDriver->CommitPictures(chains, timestamp);
+        }, [this](const std::string& name, const SharedPicture::PictureHeader& header, long block_size,
+                  unsigned int blocks_count, std::size_t row_alignment){
+            return CameraDriver->MakeSwapChain(name, header, block_size, blocks_count, row_alignment);
+        });
+        PictureObservers.push_back(Cropper.get());
+
+        // The ring is preallocated before the camera starts, so observers never change during capturing.
+        if (Configurator->Get<double>("DashcamSeconds").value_or(0.0) > 0.0)
+        {
+            auto memory_size = static_cast<std::size_t>(
+                    Configurator->Get<unsigned int>("DashcamMemory").value_or(1024)) * 1024 * 1024;
+            auto huge_pages = Configurator->Get("DashcamHugePages").value_or("false") == "true";
+            try
+            {
+                Dashcam = std::make_unique<DashcamRing>(Logger.get(), memory_size, huge_pages);
+                PictureObservers.push_back(Dashcam.get());
+            }catch (std::exception& error)
+            {
+                Logger->RecordError(std::string("Dashcam is disabled: ") + error.what());
+            }
+        }
     }
 
     /// Stop the updater if it's still running.
     CameraServer::~CameraServer()
     {
+        // Observers read swap chains of the driver, so they should be stopped first.
+        if (PictureRecorder)
+        {
+            PictureRecorder->Stop();
+        }
+        if (PictureEncoder)
+        {
+            PictureEncoder->Stop();
+        }
+        if (Previewer)
+        {
+            Previewer->Stop();
+        }
+        if (LevelGenerator)
+        {
+            LevelGenerator->Stop();
+        }
+        if (Cropper)
+        {
+            Cropper->Clear();
+        }
+        if (Dashcam)
+        {
+            Dashcam->Stop();
+        }
         // Close camera device.
         if (CameraDriver)
         {
@@ -44,17 +140,30 @@ namespace Gaia::CameraService
         }
     }
 
-    /// Launch the Daheng camera server.
-    void CameraServer::Launch()
+    /// Open the camera and register it.
+    void CameraServer::Start()
     {
         if (LifeFlag)
         {
-            Logger->RecordError("Launch() is invoked when life flag is true.");
+            Logger->RecordError("Camera server is started when life flag is true.");
             return;
         }
 
         LifeFlag = true;
 
+        // Scheduling policies are read before opening, so swap chains and threads of the camera follow them.
+        CameraDriver->Scheduler.Load(*Configurator);
+        if (Subscriber) CameraDriver->Scheduler.Apply(ThreadRole::Server);
+
+        // The parameter queue is created before opening, so it is drained from the first frame.
+        if (Configurator->Get("ParameterQueue").value_or("false") == "true")
+        {
+            CameraDriver->Parameters = std::make_unique<ParameterQueue>(
+                    ParameterQueue::GenerateBlockName(CameraDriver->DeviceName),
+                    Configurator->Get<unsigned int>("ParameterQueueCapacity").value_or(64));
+            Logger->RecordMessage("Parameter queue enabled.");
+        }
+
         // Open camera.
         Logger->RecordMilestone("Try to open the camera " + CameraDriver->DeviceName + "...");
         CameraDriver->Open();
@@ -75,6 +184,7 @@ namespace Gaia::CameraService
         if (balance_green) CameraDriver->SetWhiteBalanceGreen(*balance_green);
         auto balance_blue = Configurator->Get<double>("WhiteBalanceBlue");
         if (balance_blue) CameraDriver->SetWhiteBalanceBlue(*balance_blue);
+        UpdateCachedSettings();
         Logger->RecordMilestone("Camera configured.");
 
         auto pictures_list_key ="cameras/" + CameraDriver->DeviceName + "/pictures";
@@ -88,8 +198,178 @@ namespace Gaia::CameraService
             Connection->set("cameras/" + CameraDriver->DeviceName + "/pictures/" + name + "/format",
                             color_format);
         }
+        auto frame_sets_list_key = "cameras/" + CameraDriver->DeviceName + "/framesets";
+        for (const auto& [frame_set_name, member_names] : CameraDriver->GetFrameSetNames())
+        {
+            // Register frame sets.
+            Connection->sadd(frame_sets_list_key, frame_set_name);
+            for (const auto& member_name : member_names)
+            {
+                Connection->set("cameras/" + CameraDriver->DeviceName + "/pictures/" + member_name + "/frameset",
+                                frame_set_name);
+            }
+        }
         Logger->RecordMilestone("Picture information registered.");
 
+        if (Configurator->Get("Preview").value_or("false") == "true") StartPreview();
+        if (Configurator->Get<unsigned int>("PyramidLevels").value_or(0) > 0) StartPyramids();
+        auto region_names = Configurator->Get("Regions");
+        if (region_names)
+        {
+            std::stringstream names_stream(*region_names);
+            std::string region_name;
+            while (std::getline(names_stream, region_name, ','))
+            {
+                if (!region_name.empty()) AddRegion(region_name);
+            }
+        }
+        if (Dashcam) StartDashcam();
+    }
+
+    /// Publish the status of the camera.
+    void CameraServer::UpdateStatus(sw::redis::Pipeline &pipeline)
+    {
+        if (!CameraDriver->IsAlive())
+        {
+            throw std::runtime_error("Camera is not alive.");
+        }
+        pipeline.set("cameras/" + CameraDriver->DeviceName + "/status/fps",
+                        std::to_string(CameraDriver->RetrievedPicturesCount));
+        CameraDriver->RetrievedPicturesCount = 0;
+        UpdateCachedSettings();
+        if (PictureRecorder->IsRecording())
+        {
+            pipeline.set("cameras/" + CameraDriver->DeviceName + "/status/record_frames",
+                            std::to_string(PictureRecorder->GetRecordedFramesCount()));
+            pipeline.set("cameras/" + CameraDriver->DeviceName + "/status/record_dropped",
+                            std::to_string(PictureRecorder->GetDroppedFramesCount()));
+        }
+        if (PictureEncoder->IsEncoding())
+        {
+            auto encoded_frames_count = PictureEncoder->GetEncodedFramesCount();
+            pipeline.set("cameras/" + CameraDriver->DeviceName + "/status/encode_fps",
+                            std::to_string(encoded_frames_count - LastEncodedFramesCount));
+            LastEncodedFramesCount = encoded_frames_count;
+            pipeline.set("cameras/" + CameraDriver->DeviceName + "/status/encode_queue",
+                            std::to_string(PictureEncoder->GetQueueDepth()));
+            pipeline.set("cameras/" + CameraDriver->DeviceName + "/status/encode_dropped",
+                            std::to_string(PictureEncoder->GetDroppedFramesCount()));
+        }
+        if (LevelGenerator->IsActive())
+        {
+            UpdatePyramidDemands();
+        }
+        if (Previewer->IsActive())
+        {
+            auto preview_count = Previewer->GetGeneratedCount();
+            pipeline.set("cameras/" + CameraDriver->DeviceName + "/status/preview_fps",
+                            std::to_string(preview_count - LastPreviewCount));
+            LastPreviewCount = preview_count;
+        }
+        for (auto [role_name, report] : CameraDriver->GetScheduler().GetReports())
+        {
+            std::transform(role_name.begin(), role_name.end(), role_name.begin(), ::tolower);
+            pipeline.set("cameras/" + CameraDriver->DeviceName + "/status/scheduling_" + role_name, report);
+        }
+        if (auto clock_model = CameraDriver->GetDeviceClock().GetModel())
+        {
+            UpdateClockStatus(pipeline, *clock_model);
+        }
+        UpdateSwapChainStatus(pipeline);
+        CameraDriver->UpdateStatus(pipeline);
+        if (CameraDriver->Parameters)
+        {
+            // Changes are also applied here, in case the camera does not deliver frames.
+            CameraDriver->ApplyParameters();
+            auto applied_count = CameraDriver->AppliedParametersCount.exchange(0);
+            auto latency_sum = CameraDriver->ParametersLatencySum.exchange(0);
+            auto status_prefix = "cameras/" + CameraDriver->DeviceName + "/status/";
+            pipeline.set(status_prefix + "parameter_rate", std::to_string(applied_count));
+            pipeline.set(status_prefix + "parameter_rejected",
+                            std::to_string(CameraDriver->RejectedParametersCount.exchange(0)));
+            pipeline.set(status_prefix + "parameter_latency",
+                            std::to_string(applied_count > 0 ? latency_sum / applied_count / 1000 : 0));
+            pipeline.set(status_prefix + "parameter_latency_max",
+                            std::to_string(CameraDriver->ParametersLatencyMax.exchange(0) / 1000));
+        }
+        if (Dashcam && Dashcam->IsActive())
+        {
+            auto status_prefix = "cameras/" + CameraDriver->DeviceName + "/status/";
+            pipeline.set(status_prefix + "dashcam_memory", std::to_string(Dashcam->GetUsedSize()));
+            pipeline.set(status_prefix + "dashcam_capacity", std::to_string(Dashcam->GetCapacity()));
+            pipeline.set(status_prefix + "dashcam_duration",
+                            std::to_string(Dashcam->GetBufferedDuration() / 1000000));
+            pipeline.set(status_prefix + "dashcam_dropped",
+                            std::to_string(Dashcam->GetDroppedFramesCount()));
+        }
+        NameResolver->Update();
+    }
+
+    /// Unregister and close the camera.
+    void CameraServer::Stop()
+    {
+        LifeFlag = false;
+
+        // Unregister camera.
+        Connection->srem("cameras", CameraDriver->DeviceName);
+
+        // Unregister pictures, all keys are deleted in one round trip.
+        const auto key_prefix = "cameras/" + CameraDriver->DeviceName;
+        std::vector<std::string> keys {key_prefix + "/pictures", key_prefix + "/framesets"};
+        for (const auto& [picture_name, color_format] : CameraDriver->GetPictureNames())
+        {
+            CollectPictureKeys(picture_name, keys);
+        }
+        CollectPictureKeys("preview", keys);
+        for (const auto& [source, level_names] : PyramidLevelNames)
+        {
+            for (const auto& level_name : level_names)
+            {
+                CollectPictureKeys(level_name, keys);
+            }
+        }
+        for (const auto& region_name : Cropper->GetRegionNames())
+        {
+            CollectPictureKeys(region_name, keys);
+        }
+        for (const auto& [frame_set_name, member_names] : CameraDriver->GetFrameSetNames())
+        {
+            keys.push_back(key_prefix + "/framesets/" + frame_set_name + "/sequence");
+        }
+        for (const auto* status_name : {"record_frames", "record_dropped", "encode_fps", "encode_queue",
+                                        "encode_dropped", "preview_fps", "dashcam_memory", "dashcam_capacity",
+                                        "dashcam_duration", "dashcam_dropped", "parameter_rate",
+                                        "parameter_rejected", "parameter_latency", "parameter_latency_max"})
+        {
+            keys.push_back(key_prefix + "/status/" + status_name);
+        }
+        for (std::size_t role_index = 0; role_index < ThreadScheduler::RolesCount; ++role_index)
+        {
+            std::string role_name = ThreadScheduler::GetRoleName(static_cast<ThreadRole>(role_index));
+            std::transform(role_name.begin(), role_name.end(), role_name.begin(), ::tolower);
+            keys.push_back(key_prefix + "/status/scheduling_" + role_name);
+        }
+        Connection->del(keys.begin(), keys.end());
+        Logger->RecordMilestone("Picture information unregistered.");
+
+        // Close camera.
+        StopRecording();
+        StopEncoding();
+        Previewer->Stop();
+        LevelGenerator->Stop();
+        Cropper->Clear();
+        if (Dashcam) Dashcam->Stop();
+        CameraDriver->Close();
+        CameraDriver->Parameters.reset();
+        Logger->RecordMilestone("Camera closed.");
+    }
+
+    /// Launch the camera server.
+    void CameraServer::Launch()
+    {
+        if (!Subscriber) throw std::logic_error("Camera server hosted by a camera host can not be launched alone.");
+        Start();
+
         // Enter main loop.
         auto last_status_update_time = std::chrono::system_clock::now();
         while (LifeFlag)
@@ -106,35 +386,25 @@ namespace Gaia::CameraService
                     current_time - last_status_update_time).count();
             if (elapsed_time >= 1000)
             {
-                if (!CameraDriver->IsAlive())
+                if (!StatusPipeline)
                 {
-                    throw std::runtime_error("Camera is not alive.");
+                    StatusPipeline = std::make_unique<sw::redis::Pipeline>(Connection->pipeline());
+                }
+                UpdateStatus(*StatusPipeline);
+                try
+                {
+                    StatusPipeline->exec();
+                }catch (sw::redis::Error& error)
+                {
+                    // The connection of the pipeline may be broken, it will be recreated on next update.
+                    StatusPipeline.reset();
+                    Logger->RecordError(std::string("Failed to publish status: ") + error.what());
                 }
-                Connection->set("cameras/" + CameraDriver->DeviceName + "/status/fps",
-                                std::to_string(CameraDriver->RetrievedPicturesCount));
-                CameraDriver->RetrievedPicturesCount = 0;
-                NameResolver->Update();
                 last_status_update_time = current_time;
             }
         }
 
-        // Unregister camera.
-        Connection->srem("cameras", CameraDriver->DeviceName);
-
-        // Unregister pictures.
-        Connection->del("cameras/" + CameraDriver->DeviceName + "/pictures");
-
-        for (const auto& [picture_name, color_format] : CameraDriver->GetPictureNames())
-        {
-            Connection->del("cameras/" + CameraDriver->DeviceName + "/pictures/" + picture_name + "/fps");
-            Connection->del("cameras/" + CameraDriver->DeviceName + "/pictures/" + picture_name + "/format");
-            Connection->del("cameras/" + CameraDriver->DeviceName + "/pictures/" + picture_name + "/timestamp");
-        }
-        Logger->RecordMilestone("Picture information unregistered.");
-
-        // Close camera.
-        CameraDriver->Close();
-        Logger->RecordMilestone("Camera closed.");
+        Stop();
     }
 
     /// Handle command.
@@ -142,8 +412,27 @@ namespace Gaia::CameraService
     {
         if (command == "shutdown") {
             Logger->RecordMilestone("Shutdown command received.");
+            StopRecording();
+            StopEncoding();
+            Previewer->Stop();
+            LevelGenerator->Stop();
+            if (Dashcam) Dashcam->Stop();
             CameraDriver->Close();
             LifeFlag = false;
+        } else if (command == "record_start") {
+            StartRecording();
+        } else if (command == "record_stop") {
+            StopRecording();
+        } else if (command == "encode_start") {
+            StartEncoding();
+        } else if (command == "encode_stop") {
+            StopEncoding();
+        } else if (command == "dump") {
+            DumpDashcam();
+        } else if (command.rfind("add_region ", 0) == 0) {
+            AddRegion(command.substr(std::string("add_region ").size()));
+        } else if (command.rfind("remove_region ", 0) == 0) {
+            RemoveRegion(command.substr(std::string("remove_region ").size()));
         } else if (command == "save") {
             Configurator->Apply();
             Logger->RecordMessage("Configuration saved.");
@@ -153,6 +442,7 @@ namespace Gaia::CameraService
             {
                 if (CameraDriver->SetExposure(*exposure))
                 {
+                    UpdateCachedSettings();
                     Logger->RecordMessage("Exposure is updated to " + std::to_string(*exposure));
                 }
                 else
@@ -170,6 +460,7 @@ namespace Gaia::CameraService
             {
                 if (CameraDriver->SetGain(*gain))
                 {
+                    UpdateCachedSettings();
                     Logger->RecordMessage("Gain is updated to " + std::to_string(*gain));
                 }
                 else
@@ -268,20 +559,534 @@ namespace Gaia::CameraService
                 Logger->RecordError("Failed to auto adjust white balance.");
             }
         }
-        else
+        else if (!CameraDriver->HandleCommand(command))
         {
             Logger->RecordWarning("Unknown command '" + command + "' received.");
         }
     }
 
+    /// Start recording pictures.
+    void CameraServer::StartRecording()
+    {
+        if (PictureRecorder->IsRecording())
+        {
+            Logger->RecordWarning("Recording is required to start, but it is already started.");
+            return;
+        }
+        // Finish the recording stopped by errors.
+        PictureRecorder->Stop();
+
+        auto pictures = SelectPictures(Configurator->Get("RecordPictures"));
+        if (pictures.empty())
+        {
+            Logger->RecordError("Recording is required to start, but there is no picture to record.");
+            return;
+        }
+
+        auto path_prefix = Configurator->Get("RecordPath").value_or(".") + "/" +
+                CameraDriver->DeviceName + "." + GenerateTimeText();
+        auto segment_size = static_cast<std::uint64_t>(
+                Configurator->Get<unsigned int>("RecordSegmentSize").value_or(2048)) * 1024 * 1024;
+
+        try
+        {
+            PictureRecorder->Start(path_prefix, CameraDriver->DeviceName, pictures, segment_size);
+            Logger->RecordMessage("Recording started, segments are saved as " + path_prefix + ".*.gcr");
+        }catch (std::exception& error)
+        {
+            Logger->RecordError(std::string("Failed to start recording: ") + error.what());
+        }
+    }
+
+    /// Stop recording pictures.
+    void CameraServer::StopRecording()
+    {
+        if (!PictureRecorder->IsRecording()) return;
+        PictureRecorder->Stop();
+        Logger->RecordMessage("Recording stopped, " + std::to_string(PictureRecorder->GetRecordedFramesCount()) +
+                              " frames recorded, " + std::to_string(PictureRecorder->GetDroppedFramesCount()) +
+                              " frames dropped.");
+    }
+
+    /// Start encoding pictures.
+    void CameraServer::StartEncoding()
+    {
+        if (PictureEncoder->IsEncoding())
+        {
+            Logger->RecordWarning("Encoding is required to start, but it is already started.");
+            return;
+        }
+        auto pictures = SelectPictures(Configurator->Get("EncodePictures"));
+        if (pictures.empty())
+        {
+            Logger->RecordError("Encoding is required to start, but there is no picture to encode.");
+            return;
+        }
+
+        VideoEncoder::Settings settings;
+        settings.Codec = Configurator->Get("EncodeCodec").value_or("MJPG");
+        // MJPEG is not supported by MP4 containers.
+        settings.Extension = settings.Codec == "MJPG" ? ".avi" : ".mp4";
+        settings.FrameRate = Configurator->Get<double>("EncodeFPS").value_or(
+                Configurator->Get<double>("FPS").value_or(30.0));
+        settings.SegmentDuration = static_cast<std::uint64_t>(
+                Configurator->Get<double>("EncodeSegmentSeconds").value_or(600.0) * 1e9);
+        settings.SegmentSize = static_cast<std::uint64_t>(
+                Configurator->Get<unsigned int>("EncodeSegmentSize").value_or(0)) * 1024 * 1024;
+        settings.WorkersCount = Configurator->Get<unsigned int>("EncodeWorkers").value_or(1);
+        settings.QueueCapacity = Configurator->Get<unsigned int>("EncodeQueue").value_or(8);
+        settings.Policy = Configurator->Get("EncodeDropPolicy").value_or("oldest") == "newest" ?
+                VideoEncoder::DropPolicy::SkipNewest : VideoEncoder::DropPolicy::DropOldest;
+
+        auto directory = Configurator->Get("EncodePath");
+        if (!directory) directory = Configurator->Get("RecordPath");
+        auto path_prefix = directory.value_or(".") + "/" + CameraDriver->DeviceName + "." + GenerateTimeText();
+        try
+        {
+            PictureEncoder->Start(path_prefix, pictures, settings);
+            LastEncodedFramesCount = 0;
+            Logger->RecordMessage("Encoding started, videos are saved as " + path_prefix + ".*" +
+                                  settings.Extension);
+        }catch (std::exception& error)
+        {
+            Logger->RecordError(std::string("Failed to start encoding: ") + error.what());
+        }
+    }
+
+    /// Stop encoding pictures.
+    void CameraServer::StopEncoding()
+    {
+        if (!PictureEncoder->IsEncoding()) return;
+        PictureEncoder->Stop();
+        Logger->RecordMessage("Encoding stopped, " + std::to_string(PictureEncoder->GetEncodedFramesCount()) +
+                              " frames encoded, " + std::to_string(PictureEncoder->GetDroppedFramesCount()) +
+                              " frames dropped.");
+    }
+
+    /// Select swap chains of pictures by names.
+    std::vector<std::tuple<SwapChain*, std::string>>
+    CameraServer::SelectPictures(const std::optional<std::string>& names, bool prefer_raw)
+    {
+        std::vector<std::string> selected_names;
+        if (names)
+        {
+            std::stringstream names_stream(*names);
+            std::string name;
+            while (std::getline(names_stream, name, ','))
+            {
+                if (!name.empty()) selected_names.push_back(name);
+            }
+        }
+        if (selected_names.empty() && prefer_raw)
+        {
+            for (const auto& [picture_name, color_format] : CameraDriver->GetPictureNames())
+            {
+                if (color_format.rfind("Bayer", 0) == 0) selected_names.push_back(picture_name);
+            }
+        }
+        std::vector<std::tuple<SwapChain*, std::string>> pictures;
+        for (const auto& [picture_name, color_format] : CameraDriver->GetPictureNames())
+        {
+            if (!selected_names.empty() &&
+                std::find(selected_names.begin(), selected_names.end(), picture_name) == selected_names.end())
+                continue;
+            auto* chain = CameraDriver->GetSwapChain(picture_name);
+            if (!chain)
+            {
+                Logger->RecordWarning("Picture " + picture_name + " has no swap chain, it will not be selected.");
+                continue;
+            }
+            pictures.emplace_back(chain, color_format);
+        }
+        return pictures;
+    }
+
+    /// Create the preview swap chain and start generating previews.
+    void CameraServer::StartPreview()
+    {
+        auto source_name = Configurator->Get("PreviewSource");
+        if (!source_name && !CameraDriver->GetPictureNames().empty())
+        {
+            source_name = std::get<0>(CameraDriver->GetPictureNames().front());
+        }
+        auto pictures = SelectPictures(source_name);
+        if (pictures.empty() || !source_name)
+        {
+            Logger->RecordError("Preview is enabled, but there is no picture to preview.");
+            return;
+        }
+        auto [source, source_format] = pictures.front();
+
+        PreviewGenerator::Settings settings;
+        settings.LongestSide = Configurator->Get<unsigned int>("PreviewSize").value_or(640);
+        settings.Encoding = Configurator->Get("PreviewFormat").value_or("JPEG");
+        settings.Quality = Configurator->Get<int>("PreviewQuality").value_or(80);
+        settings.Interval = static_cast<std::uint64_t>(
+                1e9 / std::max(0.1, Configurator->Get<double>("PreviewFPS").value_or(5.0)));
+        try
+        {
+            // Blocks are sized for an uncompressed preview, which no encoded preview exceeds in practice.
+            auto preview_size = PreviewGenerator::ComputePreviewSize(*source, settings.LongestSide);
+            auto block_size = static_cast<long>(preview_size.area()) * 3 + 4096;
+            auto header = SwapChain::GenerateHeader(CV_8UC1, static_cast<unsigned int>(block_size), 1);
+            auto& chain = CameraDriver->CreateSwapChain("preview", header, block_size, 4, 1);
+            Previewer->Start(*source, source_format, chain, [this](SwapChain& chain, std::uint64_t timestamp){
+                CameraDriver->CommitPicture(chain, timestamp);
+            }, settings);
+            Connection->sadd("cameras/" + CameraDriver->DeviceName + "/pictures", "preview");
+            Connection->set("cameras/" + CameraDriver->DeviceName + "/pictures/preview/format", settings.Encoding);
+        }catch (std::exception& error)
+        {
+            Logger->RecordError(std::string("Failed to start preview: ") + error.what());
+        }
+    }
+
+    /// Create swap chains of levels and start generating them.
+    void CameraServer::StartPyramids()
+    {
+        auto source_names = Configurator->Get("PyramidPictures");
+        if (!source_names && !CameraDriver->GetPictureNames().empty())
+        {
+            source_names = std::get<0>(CameraDriver->GetPictureNames().front());
+        }
+        auto pictures = SelectPictures(source_names);
+        if (pictures.empty() || !source_names)
+        {
+            Logger->RecordError("Pyramid is enabled, but there is no picture to downscale.");
+            return;
+        }
+        auto levels_count = Configurator->Get<unsigned int>("PyramidLevels").value_or(0);
+
+        std::vector<std::tuple<SwapChain*, std::string, std::vector<SwapChain*>>> pyramids;
+        PyramidLevelNames.clear();
+        try
+        {
+            for (const auto& [source, source_format] : pictures)
+            {
+                std::vector<SwapChain*> levels;
+                std::vector<std::string> level_names;
+                auto level_format = PyramidGenerator::GetLevelFormat(source_format);
+                for (unsigned int level = 1; level <= levels_count; ++level)
+                {
+                    auto header = PyramidGenerator::GenerateLevelHeader(*source, source_format, level);
+                    if (header.Width == 0 || header.Height == 0) break;
+                    auto level_name = PyramidGenerator::GenerateLevelName(source->GetPictureName(), level);
+                    auto block_size = static_cast<long>(header.Width) * header.Height * header.Channels *
+                            (static_cast<long>(header.PixelBits) / 8);
+                    levels.push_back(&CameraDriver->CreateSwapChain(level_name, header, block_size,
+                                                                    source->GetBlocksCount()));
+                    Connection->sadd("cameras/" + CameraDriver->DeviceName + "/pictures", level_name);
+                    Connection->set("cameras/" + CameraDriver->DeviceName + "/pictures/" + level_name + "/format",
+                                    level_format);
+                    level_names.push_back(std::move(level_name));
+                }
+                pyramids.emplace_back(source, source_format, std::move(levels));
+                PyramidLevelNames.emplace_back(source, std::move(level_names));
+            }
+            LevelGenerator->Start(pyramids, [this](SwapChain& chain, std::uint64_t timestamp){
+                CameraDriver->CommitPicture(chain, timestamp);
+            });
+            Logger->RecordMessage("Pyramid started, " + std::to_string(levels_count) + " levels of " +
+                                  std::to_string(pyramids.size()) + " pictures are available.");
+        }catch (std::exception& error)
+        {
+            Logger->RecordError(std::string("Failed to start pyramid: ") + error.what());
+        }
+    }
+
+    /// Demand levels which have been read recently.
+    void CameraServer::UpdatePyramidDemands()
+    {
+        std::vector<std::string> heartbeat_keys;
+        for (const auto& [source, level_names] : PyramidLevelNames)
+        {
+            for (const auto& level_name : level_names)
+            {
+                heartbeat_keys.push_back("cameras/" + CameraDriver->DeviceName + "/pictures/" + level_name +
+                                         "/heartbeat");
+            }
+        }
+        if (heartbeat_keys.empty()) return;
+        std::vector<std::optional<std::string>> heartbeats;
+        heartbeats.reserve(heartbeat_keys.size());
+        Connection->mget(heartbeat_keys.begin(), heartbeat_keys.end(), std::back_inserter(heartbeats));
+
+        // A deep level is computed from shallower ones, so they are all computed down to the deepest read one.
+        std::size_t heartbeat_index = 0;
+        for (const auto& [source, level_names] : PyramidLevelNames)
+        {
+            unsigned int demanded_levels = 0;
+            for (unsigned int level = 1; level <= level_names.size(); ++level, ++heartbeat_index)
+            {
+                if (heartbeat_index < heartbeats.size() && heartbeats[heartbeat_index]) demanded_levels = level;
+            }
+            LevelGenerator->SetDemandedLevels(*source, demanded_levels);
+        }
+    }
+
+    /// Adapt and publish depths of swap chains.
+    void CameraServer::UpdateSwapChainStatus(sw::redis::Pipeline &pipeline)
+    {
+        auto update_chain = [this, &pipeline](const std::string& picture_name, SwapChain* chain){
+            auto key_prefix = "cameras/" + CameraDriver->DeviceName + "/pictures/" + picture_name;
+            // Readers which have not read for 3 seconds do not hold any block.
+            auto report = chain->GetReaderLags().Collect(std::chrono::seconds(3));
+            try
+            {
+                if (chain->AdaptDepth(report.HighWater))
+                {
+                    // Readers map blocks by this count, so it is published before the writer reaches new blocks.
+                    UpdatePictureBlocksCount(picture_name,
+                                             std::max(chain->GetBlocksCount(), chain->GetTargetBlocksCount()));
+                    Logger->RecordMessage("Depth of picture " + picture_name + " is changed to " +
+                                          std::to_string(chain->GetTargetBlocksCount()) + " for a lag of " +
+                                          std::to_string(report.HighWater) + " frames.");
+                }
+            }catch (std::exception& error)
+            {
+                Logger->RecordError("Failed to change depth of picture " + picture_name + ": " + error.what());
+            }
+            // Observers of the server may still hold pictures in blocks which are just removed.
+            if (chain->ReleaseRetiredBlocks(std::chrono::seconds(5)) > 0)
+            {
+                UpdatePictureBlocksCount(picture_name,
+                                         std::max(chain->GetBlocksCount(), chain->GetTargetBlocksCount()));
+            }
+            pipeline.set(key_prefix + "/depth", std::to_string(chain->GetBlocksCount()));
+            pipeline.set(key_prefix + "/lag", std::to_string(report.HighWater));
+            pipeline.set(key_prefix + "/readers", std::to_string(report.ReadersCount));
+            pipeline.set(key_prefix + "/cursors", std::to_string(report.CursorsCount));
+            pipeline.set(key_prefix + "/dropped", std::to_string(chain->GetDroppedCount()));
+            if (auto* detector = chain->GetChangeDetector())
+            {
+                pipeline.set(key_prefix + "/changed_fps", std::to_string(detector->TakeChangedCount()));
+                pipeline.set(key_prefix + "/unchanged_fps", std::to_string(detector->TakeUnchangedCount()));
+                pipeline.set(key_prefix + "/difference", std::to_string(detector->GetLastDifference()));
+            }
+        };
+        for (auto& [picture_name, chain] : CameraDriver->SwapChains)
+        {
+            update_chain(picture_name, chain.get());
+        }
+        // Region chains are configured by the driver as well, so their depths adapt and are published alike.
+        Cropper->ForEachRegion([&update_chain](const std::string& picture_name, SwapChain& chain){
+            update_chain(picture_name, &chain);
+        });
+    }
+
+    /// Publish the model which maps device time into host time.
+    void CameraServer::UpdateClockStatus(sw::redis::Pipeline &pipeline, const ClockMapper::Model &model)
+    {
+        auto status_prefix = "cameras/" + CameraDriver->DeviceName + "/status/";
+        // The slope is close to the nominal tick period, its drift is only visible in many digits.
+        std::ostringstream slope_text;
+        slope_text << std::setprecision(17) << model.Slope;
+        auto monotonic_now = GetMonotonicRawTime();
+        auto epoch_offset = static_cast<std::int64_t>(ConvertMonotonicToEpoch(monotonic_now) - monotonic_now);
+        pipeline.set(status_prefix + "clock_device_anchor", std::to_string(model.DeviceAnchor));
+        pipeline.set(status_prefix + "clock_host_anchor", std::to_string(model.HostAnchor));
+        pipeline.set(status_prefix + "clock_slope", slope_text.str());
+        pipeline.set(status_prefix + "clock_residual", std::to_string(std::llround(model.Residual)));
+        pipeline.set(status_prefix + "clock_epoch_offset", std::to_string(epoch_offset));
+    }
+
+    /// Publish the region defined by the configuration as a picture.
+    void CameraServer::AddRegion(const std::string &name)
+    {
+        if (name.empty() || name.find_first_of("/. ") != std::string::npos)
+        {
+            Logger->RecordWarning("Region name \"" + name + "\" is invalid.");
+            return;
+        }
+        if (CameraDriver->GetSwapChain(name) || Cropper->HasRegion(name))
+        {
+            Logger->RecordWarning("Region " + name + " is required, but picture " + name + " already exists.");
+            return;
+        }
+        auto definition = Configurator->Get("Region." + name);
+        if (!definition)
+        {
+            Logger->RecordWarning("Region " + name + " is required, but its configuration value is missing.");
+            return;
+        }
+
+        std::stringstream definition_stream(*definition);
+        std::string source_name;
+        std::getline(definition_stream, source_name, ',');
+        std::vector<double> values;
+        std::string value_text;
+        try
+        {
+            while (std::getline(definition_stream, value_text, ','))
+            {
+                values.push_back(std::stod(value_text));
+            }
+        }catch (std::exception& error)
+        {
+            values.clear();
+        }
+        if (values.size() != 4 && values.size() != 5)
+        {
+            Logger->RecordError("Definition \"" + *definition + "\" of region " + name + " is invalid.");
+            return;
+        }
+        auto pictures = SelectPictures(source_name);
+        if (source_name.empty() || pictures.empty())
+        {
+            Logger->RecordError("Source picture " + source_name + " of region " + name + " does not exist.");
+            return;
+        }
+        auto [source, source_format] = pictures.front();
+
+        try
+        {
+            cv::Rect area(static_cast<int>(values[0]), static_cast<int>(values[1]),
+                          static_cast<int>(values[2]), static_cast<int>(values[3]));
+            auto& chain = Cropper->AddRegion(name, *source, source_format, area,
+                                             values.size() == 5 ? values[4] : 1.0);
+            UpdatePictureBlocksCount(name, chain.GetBlocksCount());
+            UpdatePictureLayout(chain);
+            Connection->sadd("cameras/" + CameraDriver->DeviceName + "/pictures", name);
+            Connection->set("cameras/" + CameraDriver->DeviceName + "/pictures/" + name + "/format", source_format);
+            UpdateRegionNames();
+            Logger->RecordMessage("Region " + name + " of picture " + source_name + " is published, " +
+                                  std::to_string(chain.GetHeader().Width) + "x" +
+                                  std::to_string(chain.GetHeader().Height) + ".");
+        }catch (std::exception& error)
+        {
+            Logger->RecordError("Failed to add region " + name + ": " + error.what());
+        }
+    }
+
+    /// Stop publishing the region.
+    void CameraServer::RemoveRegion(const std::string &name)
+    {
+        if (!Cropper->RemoveRegion(name))
+        {
+            Logger->RecordWarning("Region " + name + " is required to remove, but it does not exist.");
+            return;
+        }
+        Connection->srem("cameras/" + CameraDriver->DeviceName + "/pictures", name);
+        std::vector<std::string> keys;
+        CollectPictureKeys(name, keys);
+        Connection->del(keys.begin(), keys.end());
+        UpdateRegionNames();
+        Logger->RecordMessage("Region " + name + " is removed.");
+    }
+
+    /// Append keys of the metadata and the status of the picture.
+    void CameraServer::CollectPictureKeys(const std::string &picture_name, std::vector<std::string> &keys) const
+    {
+        const auto key_prefix = "cameras/" + CameraDriver->DeviceName + "/pictures/" + picture_name + "/";
+        for (const auto* key_name : {"id", "blocks", "timestamp", "format", "memory", "offset", "stride", "fps",
+                                     "depth", "lag", "readers", "cursors", "dropped", "changed_fps", "unchanged_fps",
+                                     "difference", "frameset"})
+        {
+            keys.push_back(key_prefix + key_name);
+        }
+    }
+
+    /// Store names of regions into the configuration.
+    void CameraServer::UpdateRegionNames()
+    {
+        std::string names_text;
+        for (const auto& region_name : Cropper->GetRegionNames())
+        {
+            if (!names_text.empty()) names_text += ",";
+            names_text += region_name;
+        }
+        Configurator->Set("Regions", names_text);
+    }
+
+    /// Start buffering pictures into the dashcam ring.
+    void CameraServer::StartDashcam()
+    {
+        auto pictures = SelectPictures(Configurator->Get("DashcamPictures"), true);
+        if (pictures.empty())
+        {
+            Logger->RecordError("Dashcam is enabled, but there is no picture to buffer.");
+            return;
+        }
+        auto pre_seconds = Configurator->Get<double>("DashcamSeconds").value_or(0.0);
+        auto post_seconds = Configurator->Get<double>("DashcamPostSeconds").value_or(5.0);
+        try
+        {
+            Dashcam->Start(CameraDriver->DeviceName, pictures,
+                           static_cast<std::uint64_t>(pre_seconds * 1e9),
+                           static_cast<std::uint64_t>(post_seconds * 1e9));
+            Logger->RecordMessage("Dashcam started, " + std::to_string(Dashcam->GetCapacity() / 1024 / 1024) +
+                                  "MB memory" + (Dashcam->IsHugePagesBacked() ? " backed by huge pages." : "."));
+        }catch (std::exception& error)
+        {
+            Logger->RecordError(std::string("Failed to start dashcam: ") + error.what());
+        }
+    }
+
+    /// Dump the dashcam ring.
+    void CameraServer::DumpDashcam()
+    {
+        if (!Dashcam || !Dashcam->IsActive())
+        {
+            Logger->RecordWarning("Dump is required, but dashcam is not enabled.");
+            return;
+        }
+        auto directory = Configurator->Get("DashcamPath");
+        if (!directory) directory = Configurator->Get("RecordPath");
+        // A dump is a single segment of a recording, so it can be replayed as recordings.
+        auto path = directory.value_or(".") + "/" + CameraDriver->DeviceName + ".dashcam." +
+                GenerateTimeText() + ".0.gcr";
+        try
+        {
+            if (Dashcam->Dump(path))
+            {
+                Logger->RecordMessage("Dashcam dump started, saved as " + path);
+            }
+            else
+            {
+                Logger->RecordMessage("Dashcam dump is running, it is extended.");
+            }
+        }catch (std::exception& error)
+        {
+            Logger->RecordError(std::string("Failed to dump dashcam: ") + error.what());
+        }
+    }
+
+    /// Refresh the cached exposure and gain.
+    void CameraServer::UpdateCachedSettings()
+    {
+        CachedExposure = CameraDriver->GetExposure();
+        CachedGain = CameraDriver->GetGain();
+    }
+
+    /// Notify observers of a committed picture.
+    void CameraServer::OnPictureCommitted(SwapChain &chain, unsigned int block_id, FrameMetadata metadata)
+    {
+        // Drivers which republish pictures give their original settings.
+        if (metadata.Exposure == 0)
+        {
+            metadata.Exposure = CachedExposure;
+            metadata.Gain = CachedGain;
+        }
+        for (auto* observer : PictureObservers)
+        {
+            observer->OnPictureCommitted(chain, block_id, metadata);
+        }
+    }
+
     /// Update the timestamp of the target picture.
     void CameraServer::UpdatePictureTimestamp(const std::string &picture_name)
     {
-        // A long integer.
-        auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
                 std::chrono::system_clock::now().time_since_epoch()).count();
+        UpdatePictureTimestamp(picture_name, static_cast<std::uint64_t>(timestamp));
+    }
+
+    /// Update the timestamp of the target picture with the given time.
+    void CameraServer::UpdatePictureTimestamp(const std::string &picture_name, std::uint64_t timestamp)
+    {
+        // A long integer in milliseconds.
         Connection->set("cameras/" + CameraDriver->DeviceName + "/pictures/" + picture_name + "/timestamp",
-                        std::to_string(timestamp));
+                        std::to_string(timestamp / 1000000));
     }
 
     /// Update the swap chain id of the target picture.
@@ -297,4 +1102,77 @@ namespace Gaia::CameraService
         Connection->set("cameras/" + CameraDriver->DeviceName + "/pictures/" + picture_name + "/blocks",
                         std::to_string(blocks_count));
     }
+
+    /// Update the layout of pictures in blocks of the swap chain.
+    void CameraServer::UpdatePictureLayout(const SwapChain &chain)
+    {
+        auto key_prefix = "cameras/" + CameraDriver->DeviceName + "/pictures/" + chain.GetPictureName();
+        Connection->set(key_prefix + "/offset", std::to_string(chain.GetPictureOffset()));
+        Connection->set(key_prefix + "/stride", std::to_string(chain.GetRowStride()));
+    }
+
+    /// Atomically update block IDs and timestamps of all pictures in the frame set.
+    unsigned long CameraServer::UpdateFrameSet(const std::string& frame_set_name,
+                                               const std::vector<std::tuple<std::string, unsigned int>>& picture_blocks,
+                                               std::uint64_t timestamp)
+    {
+        // A long integer in milliseconds.
+        auto timestamp_text = std::to_string(timestamp / 1000000);
+        auto key_prefix = "cameras/" + CameraDriver->DeviceName + "/";
+
+        std::unique_lock lock(FrameSetMutex);
+        auto sequence = ++FrameSetSequences[frame_set_name];
+        try
+        {
+            if (!FrameSetTransaction)
+            {
+                FrameSetTransaction = std::make_unique<sw::redis::Transaction>(Connection->transaction());
+            }
+            for (const auto& [picture_name, block_id] : picture_blocks)
+            {
+                FrameSetTransaction->set(key_prefix + "pictures/" + picture_name + "/id",
+                                         std::to_string(block_id));
+                FrameSetTransaction->set(key_prefix + "pictures/" + picture_name + "/timestamp",
+                                         timestamp_text);
+            }
+            FrameSetTransaction->set(key_prefix + "framesets/" + frame_set_name + "/sequence",
+                                     std::to_string(sequence));
+            FrameSetTransaction->exec();
+        }catch (sw::redis::Error& error)
+        {
+            // The connection of the transaction may be broken, it will be recreated on next commit.
+            FrameSetTransaction.reset();
+            Logger->RecordError("Failed to commit frame set " + frame_set_name + ": " + error.what());
+        }
+        return sequence;
+    }
+
+    /// Update block IDs and timestamps of pictures in one pipeline.
+    void CameraServer::UpdatePictures(const std::vector<std::tuple<std::string, unsigned int>>& picture_blocks,
+                                      std::uint64_t timestamp)
+    {
+        // A long integer in milliseconds.
+        auto timestamp_text = std::to_string(timestamp / 1000000);
+        auto key_prefix = "cameras/" + CameraDriver->DeviceName + "/pictures/";
+
+        std::unique_lock lock(PicturesMutex);
+        try
+        {
+            if (!PicturesPipeline)
+            {
+                PicturesPipeline = std::make_unique<sw::redis::Pipeline>(Connection->pipeline());
+            }
+            for (const auto& [picture_name, block_id] : picture_blocks)
+            {
+                PicturesPipeline->set(key_prefix + picture_name + "/id", std::to_string(block_id));
+                PicturesPipeline->set(key_prefix + picture_name + "/timestamp", timestamp_text);
+            }
+            PicturesPipeline->exec();
+        }catch (sw::redis::Error& error)
+        {
+            // The connection of the pipeline may be broken, it will be recreated on next commit.
+            PicturesPipeline.reset();
+            Logger->RecordError(std::string("Failed to publish derived pictures: ") + error.what());
+        }
+    }
 }
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include <string>
 #include <atomic>
 #include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
 #include <sw/redis++/redis++.h>
 #include <GaiaBackground/GaiaBackground.hpp>
 #include <GaiaLogClient/GaiaLogClient.hpp>
@@ -12,6 +15,14 @@
 #include <GaiaSharedMemory/GaiaSharedMemory.hpp>
 
 #include "CameraDriverInterface.hpp"
+#include "Recorder.hpp"
+#include "DashcamRing.hpp"
+#include "VideoEncoder.hpp"
+#include "PreviewGenerator.hpp"
+#include "PyramidGenerator.hpp"
+#include "RegionCropper.hpp"
+#include "PictureObserver.hpp"
+#include "WorkerPool.hpp"
 
 namespace Gaia::CameraService
 {
@@ -32,19 +43,211 @@ namespace Gaia::CameraService
      *  and "cameras/daheng_camera.0/pictures/main/format".
      *  Formats are "BGR", "Gray", "BayerRG", "BayerBG", etc.
      *  The default destination format of pictures sent from this server is "BGR".
+     *  Names of frame sets like "stereo" will be added to the set named "cameras/daheng_camera.0/framesets",
+     *  the frame set of a picture will be stored as "cameras/daheng_camera.0/pictures/left/frameset",
+     *  and the sequence number of the latest frame set will be stored as
+     *  "cameras/daheng_camera.0/framesets/stereo/sequence".
+     *  Commands "record_start" and "record_stop" control the built-in recorder, which records pictures
+     *  listed in the configuration "RecordPictures" (comma separated, default is all pictures)
+     *  into segment files under the configuration "RecordPath",
+     *  each segment file is at most "RecordSegmentSize" megabytes.
+     *  Counts of recorded and dropped frames are stored as "cameras/daheng_camera.0/status/record_frames"
+     *  and "cameras/daheng_camera.0/status/record_dropped".
+     *  When the configuration "DashcamSeconds" is positive, the latest seconds of pictures listed in
+     *  "DashcamPictures" (comma separated, default is raw Bayer pictures if any, otherwise all pictures)
+     *  are kept in a memory ring of "DashcamMemory" megabytes (default 1024), backed by huge pages
+     *  if "DashcamHugePages" is "true".
+     *  Command "dump" writes them and pictures of the following "DashcamPostSeconds" seconds (default 5)
+     *  into a segment file under "DashcamPath" (default is "RecordPath"), overlapping dumps are merged.
+     *  Usage of the ring is stored as "cameras/daheng_camera.0/status/dashcam_memory",
+     *  "dashcam_capacity", "dashcam_duration" (milliseconds) and "dashcam_dropped".
+     *  Commands "encode_start" and "encode_stop" control the built-in video encoder, which encodes pictures
+     *  listed in "EncodePictures" (comma separated, default is all pictures) with the FourCC "EncodeCodec"
+     *  (default "MJPG") into video files under "EncodePath" (default is "RecordPath") on "EncodeWorkers"
+     *  threads (default 1), video files are rolled every "EncodeSegmentSeconds" seconds (default 600)
+     *  or "EncodeSegmentSize" megabytes (default unlimited).
+     *  At most "EncodeQueue" frames (default 8) are queued for every thread, "EncodeDropPolicy" decides
+     *  whether the "oldest" queued frame (default) or the "newest" frame is dropped when the queue is full.
+     *  Encoder FPS, queue depth and dropped frames are stored as "cameras/daheng_camera.0/status/encode_fps",
+     *  "encode_queue" and "encode_dropped".
+     *  When the configuration "Preview" is "true", the picture "PreviewSource" (default is the first picture)
+     *  is downscaled to at most "PreviewSize" pixels on the longest side (default 640), encoded as
+     *  "PreviewFormat" ("JPEG" by default or "WebP") with "PreviewQuality" (default 80) at most "PreviewFPS"
+     *  times per second (default 5), and published as the picture "preview" whose format is the encoding.
+     *  Blocks of the preview are 1xN 8 bits pictures holding the encoded bytes.
+     *  Count of previews generated in the last second is stored as "cameras/daheng_camera.0/status/preview_fps".
+     *  When the configuration "PyramidLevels" is positive, pictures listed in "PyramidPictures"
+     *  (comma separated, default is the first picture) get that many downscaled levels, published as pictures
+     *  named like "main@2" and "main@4" for half and quarter sizes. Levels of Bayer pictures are "BGR".
+     *  Levels are only computed while they are read: readers refresh the expiring key
+     *  "cameras/daheng_camera.0/pictures/main@2/heartbeat", and levels down to the deepest read one are computed.
+     *  Command "add_region lane" publishes the region defined by the configuration "Region.lane" as the picture
+     *  "lane", the definition is "{picture},{x},{y},{width},{height}" with an optional ",{scale}".
+     *  Regions are cropped right after their source pictures are committed, command "remove_region lane"
+     *  removes it, and names of regions in the configuration "Regions" are restored when the camera is opened.
+     *  Blocks of swap chains are backed by transparent huge pages if "SwapChainHugePages" is "true",
+     *  faulted in before the camera starts if "SwapChainPrefault" is "true", and locked into RAM if
+     *  "SwapChainLock" is "true", the applied preparation is stored as "cameras/daheng_camera.0/pictures/main/memory".
+     *  Rows of pictures are aligned to "RowAlignment" bytes (default 64), the first row begins
+     *  "cameras/daheng_camera.0/pictures/main/offset" bytes after the picture data of a block,
+     *  and every row takes "cameras/daheng_camera.0/pictures/main/stride" bytes. Pictures without these keys are
+     *  tightly packed.
+     *  Threads of the camera follow the scheduling policy read by ThreadScheduler from the configuration
+     *  when the camera is opened, the applied policy of every role is stored as
+     *  "cameras/daheng_camera.0/status/scheduling_capture", "scheduling_convert", etc.
+     *  Servers constructed with a shared connection are hosted by a CameraHost, which drives several cameras
+     *  in one process with one event loop, and lends its worker pool to drivers for converting pictures.
      */
     class CameraServer
     {
         /// Allow camera interface to invoke basic functions.
         friend class CameraDriverInterface;
+        /// Allow camera host to drive the server in its event loop.
+        friend class CameraHost;
 
     private:
         /// Driver for the specific camera.
         std::unique_ptr<CameraDriverInterface> CameraDriver;
+        /// Worker pool lent by the camera host for converting pictures, null if the server runs alone.
+        WorkerPool* ConversionPool {nullptr};
 
         /// Life flag for the main loop.
         std::atomic<bool> LifeFlag {false};
 
+        /// Mutex for the frame set transaction and sequence numbers.
+        std::mutex FrameSetMutex;
+        /// Reusable transaction for committing frame sets.
+        std::unique_ptr<sw::redis::Transaction> FrameSetTransaction {nullptr};
+        /// Sequence numbers of the latest committed frame sets.
+        std::unordered_map<std::string, unsigned long> FrameSetSequences;
+
+        /// Mutex for the pipeline of derived pictures.
+        std::mutex PicturesMutex;
+        /// Reusable pipeline for publishing pictures derived from the same capture.
+        std::unique_ptr<sw::redis::Pipeline> PicturesPipeline {nullptr};
+
+        /// Reusable pipeline for publishing status when the server runs alone.
+        std::unique_ptr<sw::redis::Pipeline> StatusPipeline {nullptr};
+
+        /// Recorder of committed pictures.
+        std::unique_ptr<Recorder> PictureRecorder {nullptr};
+
+        /// Video encoder of committed pictures.
+        std::unique_ptr<VideoEncoder> PictureEncoder {nullptr};
+        /// Count of encoded frames at the last status update.
+        unsigned long LastEncodedFramesCount {0};
+
+        /// Generator of the compressed preview picture.
+        std::unique_ptr<PreviewGenerator> Previewer {nullptr};
+        /// Count of generated previews at the last status update.
+        unsigned long LastPreviewCount {0};
+
+        /// Generator of downscaled levels of pictures.
+        std::unique_ptr<PyramidGenerator> LevelGenerator {nullptr};
+        /// Source swap chains with names of their levels, from level 1.
+        std::vector<std::tuple<SwapChain*, std::vector<std::string>>> PyramidLevelNames;
+
+        /// Publisher of regions of pictures.
+        std::unique_ptr<RegionCropper> Cropper {nullptr};
+
+        /// Pre-trigger ring of committed pictures, null if it is disabled.
+        std::unique_ptr<DashcamRing> Dashcam {nullptr};
+
+        /// Observers notified of every committed picture, fixed once the server is constructed.
+        std::vector<PictureObserver*> PictureObservers;
+
+        /// Exposure reported by the driver, attached to committed pictures.
+        std::atomic<unsigned int> CachedExposure {0};
+        /// Gain reported by the driver, attached to committed pictures.
+        std::atomic<double> CachedGain {0.0};
+
+        /// Refresh the cached exposure and gain from the driver.
+        void UpdateCachedSettings();
+
+        /// Create clients of services and picture observers on the connection.
+        void InitializeServices();
+
+        /// Open the camera device, register the camera and its pictures, and start configured observers.
+        void Start();
+        /**
+         * @brief Queue the status of the camera into the given pipeline.
+         * @throws std::runtime_error If the camera is not alive.
+         */
+        void UpdateStatus(sw::redis::Pipeline& pipeline);
+        /// Unregister the camera and its pictures, and close the camera device.
+        void Stop();
+
+        /**
+         * @brief Select swap chains of pictures by the comma separated names.
+         * @param names Comma separated picture names, all pictures are selected if it is empty.
+         * @param prefer_raw Select only raw Bayer pictures when names are empty and there is any.
+         * @return List of tuples, first is the swap chain of the picture, second is its color format.
+         */
+        std::vector<std::tuple<SwapChain*, std::string>> SelectPictures(const std::optional<std::string>& names,
+                                                                        bool prefer_raw = false);
+
+        /// Create the preview swap chain and start generating previews according to the configuration.
+        void StartPreview();
+
+        /// Create swap chains of levels and start generating them according to the configuration.
+        void StartPyramids();
+        /// Demand levels which have been read recently, according to heartbeats of readers.
+        void UpdatePyramidDemands();
+
+        /**
+         * @brief Publish the model which maps device time into host time.
+         * @param pipeline Status pipeline to publish into.
+         * @param model Fitted model of the device clock.
+         * @details
+         *  Host time of a device time is "clock_host_anchor" + "clock_slope" * (device - "clock_device_anchor")
+         *  in CLOCK_MONOTONIC_RAW nanoseconds, adding "clock_epoch_offset" converts it into nanoseconds since epoch.
+         */
+        void UpdateClockStatus(sw::redis::Pipeline& pipeline, const ClockMapper::Model& model);
+
+        /**
+         * @brief Collect lags of readers of every swap chain, adapt depths and publish them.
+         * @details
+         *  "pictures/{name}/depth" is the count of blocks the writer cycles through,
+         *  "pictures/{name}/lag" is the highest lag in frames of readers since the previous update,
+         *  "pictures/{name}/readers" is the count of readers which have read the picture recently,
+         *  "pictures/{name}/cursors" is the count of readers in the cursor mode,
+         *  "pictures/{name}/dropped" is the count of pictures dropped before commit because of backpressure,
+         *  and with change detection, "pictures/{name}/changed_fps" and "pictures/{name}/unchanged_fps" are
+         *  counts of changed and unchanged pictures per second, "pictures/{name}/difference" is the difference
+         *  of the latest examined picture.
+         */
+        void UpdateSwapChainStatus(sw::redis::Pipeline& pipeline);
+
+        /**
+         * @brief Publish the region defined by the configuration "Region.{name}" as a picture.
+         * @param name Name of the region picture.
+         */
+        void AddRegion(const std::string& name);
+        /// Stop publishing the region with the given name.
+        void RemoveRegion(const std::string& name);
+        /// Store names of regions into the configuration "Regions".
+        void UpdateRegionNames();
+        /**
+         * @brief Append keys of the metadata and the status of the picture with the given name to the list.
+         * @details Keys are deleted together with one multi-key DEL, keys which do not exist are ignored by it.
+         */
+        void CollectPictureKeys(const std::string& picture_name, std::vector<std::string>& keys) const;
+
+        /// Start buffering pictures into the dashcam ring according to the configuration.
+        void StartDashcam();
+        /// Dump the dashcam ring to a new file, or extend the running dump.
+        void DumpDashcam();
+
+        /// Start encoding pictures according to the configuration.
+        void StartEncoding();
+        /// Stop encoding pictures.
+        void StopEncoding();
+
+        /// Start recording pictures according to the configuration.
+        void StartRecording();
+        /// Stop recording pictures.
+        void StopRecording();
+
     protected:
         /// Connection to the Redis server.
         std::shared_ptr<sw::redis::Redis> Connection {nullptr};
@@ -62,6 +265,11 @@ namespace Gaia::CameraService
 
         /// Update the timestamp of the target picture.
         void UpdatePictureTimestamp(const std::string& picture_name);
+        /**
+         * @brief Update the timestamp of the target picture with the given time.
+         * @param timestamp Nanoseconds since epoch, published in milliseconds.
+         */
+        void UpdatePictureTimestamp(const std::string& picture_name, std::uint64_t timestamp);
 
         /// Update the chain id of the shared picture block.
         void UpdatePictureBlockID(const std::string& picture_name, unsigned int chain_id);
@@ -69,6 +277,37 @@ namespace Gaia::CameraService
         /// Update the total amount of swap chain blocks.
         void UpdatePictureBlocksCount(const std::string& picture_name, unsigned int blocks_count);
 
+        /// Update the offset of the first row and the row stride of pictures in blocks of the swap chain.
+        void UpdatePictureLayout(const SwapChain& chain);
+
+        /**
+         * @brief Handle a committed picture, invoked by the committing thread of the driver.
+         * @param chain Swap chain of the picture.
+         * @param block_id ID of the committed block.
+         * @param metadata Capture times of the picture, exposure and gain are filled by this server
+         *                 unless the driver gives them.
+         */
+        void OnPictureCommitted(SwapChain& chain, unsigned int block_id, FrameMetadata metadata);
+
+        /**
+         * @brief Atomically update block IDs and timestamps of all pictures in the frame set.
+         * @param frame_set_name Name of the frame set.
+         * @param picture_blocks List of tuples, first is picture name, second is ID of the committed block.
+         * @param timestamp Capture time of the frame set in nanoseconds since epoch.
+         * @return Sequence number of the committed frame set.
+         */
+        unsigned long UpdateFrameSet(const std::string& frame_set_name,
+                                     const std::vector<std::tuple<std::string, unsigned int>>& picture_blocks,
+                                     std::uint64_t timestamp);
+
+        /**
+         * @brief Update block IDs and timestamps of pictures in one pipeline.
+         * @param picture_blocks List of tuples, first is picture name, second is ID of the committed block.
+         * @param timestamp Capture time of the pictures in nanoseconds since epoch.
+         */
+        void UpdatePictures(const std::vector<std::tuple<std::string, unsigned int>>& picture_blocks,
+                            std::uint64_t timestamp);
+
     public:
         /// Whether user require the camera to flip the picture or not.
         bool RequiredFlip {false};
@@ -100,6 +339,15 @@ namespace Gaia::CameraService
                 std::unique_ptr<CameraDriverInterface>&& camera_driver,
                 unsigned int device_index = 0,
                 unsigned int port = 6379, const std::string& ip = "127.0.0.1");
+        /**
+         * @brief Construct a server hosted by a camera host, commands are routed by the host.
+         * @param camera_driver Camera driver instance.
+         * @param device_index Index of the camera device to open, beginning from 0.
+         * @param connection Connection to the Redis server shared by all hosted servers.
+         * @param pool Worker pool shared by all hosted servers, or nullptr to convert pictures on the driver thread.
+         */
+        CameraServer(std::unique_ptr<CameraDriverInterface>&& camera_driver, unsigned int device_index,
+                     std::shared_ptr<sw::redis::Redis> connection, WorkerPool* pool = nullptr);
 
         /// Destructor which will stop the updater.
         ~CameraServer();
@@ -108,7 +356,14 @@ namespace Gaia::CameraService
          * @brief Open the camera device and launch the server.
          * @details
          *  This function will block the invoker thread until receive "shutdown" command.
+         *  Servers hosted by a camera host are launched by the host instead.
          */
         void Launch();
+
+        /// Check whether the server is running, it stops running once the "shutdown" command is received.
+        [[nodiscard]] inline bool IsRunning() const noexcept
+        {
+            return LifeFlag;
+        }
     };
 }
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include "CaptureClock.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ctime>
+#include <stdexcept>
+
+namespace Gaia::CameraService
+{
+    namespace
+    {
+        /// Count of accepted samples before the model is used.
+        constexpr std::uint64_t MinimumSamplesCount = 16;
+        /// Residuals larger than this multiple of the residual root mean square are outliers.
+        constexpr double OutlierResidualRatio = 6.0;
+        /// Residuals within this bound in nanoseconds are never outliers, so a quiet model does not reject jitter.
+        constexpr double OutlierResidualFloor = 200000.0;
+        /// Count of consecutive outliers which means the device clock is reset.
+        constexpr unsigned int MaximumRejectedCount = 32;
+        /// Smoothing factor of the squared residual.
+        constexpr double ResidualSmoothing = 0.05;
+
+        /// Get the current time in nanoseconds since epoch.
+        std::int64_t GetEpochTime()
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+
+        /// Get the signed difference of two unsigned time points as a floating number.
+        double GetDifference(std::uint64_t time_point, std::uint64_t origin)
+        {
+            return static_cast<double>(static_cast<std::int64_t>(time_point - origin));
+        }
+    }
+
+    /// Get the current host time.
+    std::uint64_t GetMonotonicRawTime()
+    {
+        timespec time {};
+        clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+        return static_cast<std::uint64_t>(time.tv_sec) * 1000000000ull + static_cast<std::uint64_t>(time.tv_nsec);
+    }
+
+    /// Convert a monotonic time point into nanoseconds since epoch.
+    std::uint64_t ConvertMonotonicToEpoch(std::uint64_t monotonic_timestamp)
+    {
+        auto monotonic_now = GetMonotonicRawTime();
+        auto epoch_now = GetEpochTime();
+        return static_cast<std::uint64_t>(epoch_now - static_cast<std::int64_t>(monotonic_now - monotonic_timestamp));
+    }
+
+    /// Convert a time point in nanoseconds since epoch into monotonic time.
+    std::uint64_t ConvertEpochToMonotonic(std::uint64_t epoch_timestamp)
+    {
+        auto monotonic_now = GetMonotonicRawTime();
+        auto epoch_now = static_cast<std::uint64_t>(GetEpochTime());
+        return monotonic_now - static_cast<std::uint64_t>(static_cast<std::int64_t>(epoch_now - epoch_timestamp));
+    }
+
+    /// Stamp a capture with the current host time.
+    CaptureTime CaptureTime::Now(std::uint64_t device_timestamp)
+    {
+        return CaptureTime{GetMonotonicRawTime(), device_timestamp};
+    }
+
+    /// Construct an empty model.
+    ClockMapper::ClockMapper(double forgetting_factor) : ForgettingFactor(forgetting_factor)
+    {
+        if (forgetting_factor <= 0.0 || forgetting_factor >= 1.0)
+            throw std::invalid_argument("Forgetting factor of clock mapper must be in (0, 1).");
+    }
+
+    /// Check whether the model can map device times.
+    bool ClockMapper::IsFitted() const noexcept
+    {
+        return SamplesCount >= MinimumSamplesCount && DeviceDeviation > 0.0;
+    }
+
+    /// Map a relative device time into a relative host time.
+    double ClockMapper::Predict(double device_time) const noexcept
+    {
+        return HostMean + CrossDeviation / DeviceDeviation * (device_time - DeviceMean);
+    }
+
+    /// Drop all samples.
+    void ClockMapper::Restart() noexcept
+    {
+        Weight = 0.0;
+        DeviceMean = 0.0;
+        HostMean = 0.0;
+        DeviceDeviation = 0.0;
+        CrossDeviation = 0.0;
+        ResidualSquare = 0.0;
+        SamplesCount = 0;
+        RejectedCount = 0;
+    }
+
+    /// Add a pair of device time and host time.
+    void ClockMapper::AddSample(std::uint64_t device_timestamp, std::uint64_t host_timestamp)
+    {
+        std::unique_lock lock(FittingMutex);
+        if (SamplesCount > 0)
+        {
+            if (device_timestamp == LastDeviceTimestamp) return;
+            if (device_timestamp < LastDeviceTimestamp) Restart();
+        }
+        if (SamplesCount == 0)
+        {
+            DeviceOrigin = device_timestamp;
+            HostOrigin = host_timestamp;
+        }
+        LastDeviceTimestamp = device_timestamp;
+
+        auto device_time = GetDifference(device_timestamp, DeviceOrigin);
+        auto host_time = GetDifference(host_timestamp, HostOrigin);
+        if (IsFitted())
+        {
+            const auto residual = host_time - Predict(device_time);
+            const auto bound = std::max(OutlierResidualRatio * std::sqrt(ResidualSquare), OutlierResidualFloor);
+            if (std::abs(residual) <= bound)
+            {
+                ResidualSquare += ResidualSmoothing * (residual * residual - ResidualSquare);
+            }
+            else if (++RejectedCount < MaximumRejectedCount)
+            {
+                return;
+            }
+            else
+            {
+                // The device clock has jumped, fit from this sample again.
+                Restart();
+                DeviceOrigin = device_timestamp;
+                HostOrigin = host_timestamp;
+                device_time = 0.0;
+                host_time = 0.0;
+            }
+        }
+        RejectedCount = 0;
+
+        // Weighted Welford update, which keeps the fit precise over long runs.
+        Weight = ForgettingFactor * Weight + 1.0;
+        const auto device_delta = device_time - DeviceMean;
+        DeviceMean += device_delta / Weight;
+        HostMean += (host_time - HostMean) / Weight;
+        DeviceDeviation = ForgettingFactor * DeviceDeviation + device_delta * (device_time - DeviceMean);
+        CrossDeviation = ForgettingFactor * CrossDeviation + device_delta * (host_time - HostMean);
+        ++SamplesCount;
+    }
+
+    /// Map a device time into host time.
+    std::optional<std::uint64_t> ClockMapper::Map(std::uint64_t device_timestamp) const
+    {
+        std::unique_lock lock(FittingMutex);
+        if (!IsFitted()) return std::nullopt;
+        auto host_time = Predict(GetDifference(device_timestamp, DeviceOrigin));
+        return HostOrigin + static_cast<std::uint64_t>(std::llround(host_time));
+    }
+
+    /// Get the snapshot of the fitted model.
+    std::optional<ClockMapper::Model> ClockMapper::GetModel() const
+    {
+        std::unique_lock lock(FittingMutex);
+        if (!IsFitted()) return std::nullopt;
+        Model model;
+        auto device_anchor = std::llround(DeviceMean);
+        model.DeviceAnchor = DeviceOrigin + static_cast<std::uint64_t>(device_anchor);
+        model.HostAnchor = HostOrigin + static_cast<std::uint64_t>(
+                std::llround(Predict(static_cast<double>(device_anchor))));
+        model.Slope = CrossDeviation / DeviceDeviation;
+        model.Residual = std::sqrt(ResidualSquare);
+        model.SamplesCount = SamplesCount;
+        return model;
+    }
+
+    /// Drop all samples.
+    void ClockMapper::Reset()
+    {
+        std::unique_lock lock(FittingMutex);
+        Restart();
+    }
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+
+namespace Gaia::CameraService
+{
+    /// Get the current host time, in CLOCK_MONOTONIC_RAW nanoseconds which are not slewed by NTP.
+    std::uint64_t GetMonotonicRawTime();
+
+    /// Convert a CLOCK_MONOTONIC_RAW time point into nanoseconds since epoch.
+    std::uint64_t ConvertMonotonicToEpoch(std::uint64_t monotonic_timestamp);
+
+    /// Convert a time point in nanoseconds since epoch into CLOCK_MONOTONIC_RAW nanoseconds.
+    std::uint64_t ConvertEpochToMonotonic(std::uint64_t epoch_timestamp);
+
+    /// Capture time of a picture, taken by the driver as soon as the picture is delivered.
+    struct CaptureTime
+    {
+        /// Host time at the entry of the capture callback, in CLOCK_MONOTONIC_RAW nanoseconds.
+        std::uint64_t HostTimestamp {0};
+        /// Time stamped by the device in device ticks, 0 if the device does not provide one.
+        std::uint64_t DeviceTimestamp {0};
+
+        /**
+         * @brief Stamp a capture with the current host time.
+         * @param device_timestamp Time stamped by the device in device ticks, 0 if there is not one.
+         */
+        static CaptureTime Now(std::uint64_t device_timestamp = 0);
+    };
+
+    /**
+     * @brief Continuously fitted linear model which maps device time into host time.
+     * @details
+     *  Host time is modeled as HostAnchor + Slope * (device - DeviceAnchor), where the slope is the count of
+     *  host nanoseconds per device tick, so it covers both the tick period and the drift of the device clock.
+     *  The model is fitted by exponentially weighted least squares, so it follows slow drift.
+     *  Host stamps are late by the delivery latency, samples far later than the model are rejected as outliers;
+     *  a long run of rejected samples or a device time going backwards means the device clock is reset,
+     *  and the model starts over.
+     */
+    class ClockMapper
+    {
+    public:
+        /// Snapshot of the fitted model.
+        struct Model
+        {
+            /// Device time of the anchor in device ticks.
+            std::uint64_t DeviceAnchor {0};
+            /// Host time of the anchor in CLOCK_MONOTONIC_RAW nanoseconds.
+            std::uint64_t HostAnchor {0};
+            /// Host nanoseconds per device tick.
+            double Slope {1.0};
+            /// Root mean square of residuals of accepted samples in nanoseconds.
+            double Residual {0.0};
+            /// Count of accepted samples since the model starts.
+            std::uint64_t SamplesCount {0};
+        };
+
+    private:
+        /// Mutex for the fitting state, samples are added by the capture thread and read by the status thread.
+        mutable std::mutex FittingMutex;
+        /// Weight of the previous state when a sample is added.
+        const double ForgettingFactor;
+
+        /// Device time of the first sample, device times are fitted relative to it.
+        std::uint64_t DeviceOrigin {0};
+        /// Host time of the first sample, host times are fitted relative to it.
+        std::uint64_t HostOrigin {0};
+        /// Device time of the latest sample.
+        std::uint64_t LastDeviceTimestamp {0};
+        /// Sum of weights of samples.
+        double Weight {0.0};
+        /// Weighted mean of relative device times.
+        double DeviceMean {0.0};
+        /// Weighted mean of relative host times.
+        double HostMean {0.0};
+        /// Weighted sum of squared deviations of device times.
+        double DeviceDeviation {0.0};
+        /// Weighted sum of products of deviations of device and host times.
+        double CrossDeviation {0.0};
+        /// Smoothed square of residuals.
+        double ResidualSquare {0.0};
+        /// Count of accepted samples.
+        std::uint64_t SamplesCount {0};
+        /// Count of consecutively rejected samples.
+        unsigned int RejectedCount {0};
+
+        /// Check whether the model can map device times, the mutex should be held.
+        [[nodiscard]] bool IsFitted() const noexcept;
+        /// Map a relative device time into a relative host time, the mutex should be held.
+        [[nodiscard]] double Predict(double device_time) const noexcept;
+        /// Drop all samples, the mutex should be held.
+        void Restart() noexcept;
+
+    public:
+        /**
+         * @brief Construct an empty model.
+         * @param forgetting_factor Weight of the previous state when a sample is added,
+         *                          about 1 / (1 - factor) latest samples are effectively fitted.
+         */
+        explicit ClockMapper(double forgetting_factor = 0.999);
+
+        /**
+         * @brief Add a pair of device time and host time of the same capture.
+         * @details Samples with the same device time as the previous one, such as pictures of one capture, are ignored.
+         */
+        void AddSample(std::uint64_t device_timestamp, std::uint64_t host_timestamp);
+
+        /**
+         * @brief Map a device time into host time.
+         * @return Host time in CLOCK_MONOTONIC_RAW nanoseconds, or std::nullopt if the model is not fitted yet.
+         */
+        [[nodiscard]] std::optional<std::uint64_t> Map(std::uint64_t device_timestamp) const;
+
+        /// Get the snapshot of the fitted model, or std::nullopt if the model is not fitted yet.
+        [[nodiscard]] std::optional<Model> GetModel() const;
+
+        /// Drop all samples.
+        void Reset();
+    };
+}
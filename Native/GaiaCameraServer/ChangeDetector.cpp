@@ -0,0 +1,122 @@
+#include "ChangeDetector.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Gaia::CameraService
+{
+    namespace
+    {
+        /// Length of a sampled run of bytes, which is one SSE2 register.
+        constexpr std::size_t RunLength = 16;
+
+        /// Sum absolute differences of two runs of bytes.
+        std::uint64_t SumDifferences(const std::uint8_t* current, const std::uint8_t* reference, std::size_t length)
+        {
+            std::uint64_t sum = 0;
+            std::size_t index = 0;
+            #ifdef __SSE2__
+            for (; index + RunLength <= length; index += RunLength)
+            {
+                auto current_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + index));
+                auto reference_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(reference + index));
+                // Two partial sums of 8 bytes each are left in the low 16 bits of both 64 bits lanes.
+                auto sums = _mm_sad_epu8(current_bytes, reference_bytes);
+                sum += static_cast<std::uint64_t>(_mm_cvtsi128_si32(sums)) +
+                       static_cast<std::uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+            }
+            #endif
+            for (; index < length; ++index)
+            {
+                sum += current[index] > reference[index] ? current[index] - reference[index] :
+                        reference[index] - current[index];
+            }
+            return sum;
+        }
+    }
+
+    /// Construct a detector.
+    ChangeDetector::ChangeDetector(Modes mode, double threshold, unsigned int grid_step,
+                                   std::chrono::nanoseconds keyframe_interval) :
+        Mode(mode), Threshold(threshold), GridStep(grid_step),
+        KeyframeInterval(static_cast<std::uint64_t>(std::max<std::int64_t>(keyframe_interval.count(), 0)))
+    {
+        if (grid_step == 0) throw std::invalid_argument("Grid step of change detector must be at least 1.");
+        if (threshold < 0) throw std::invalid_argument("Threshold of change detector must not be negative.");
+    }
+
+    /// Compare the picture with the latest changed picture.
+    bool ChangeDetector::Examine(const cv::Mat &picture, std::uint64_t timestamp)
+    {
+        const auto row_length = static_cast<std::size_t>(picture.cols) * picture.elemSize();
+        const auto run_step = RunLength * GridStep;
+        // Every sampled row takes runs at the same offsets, the last run may be shorter.
+        std::size_t row_samples = 0;
+        for (std::size_t offset = 0; offset < row_length; offset += run_step)
+        {
+            row_samples += std::min(RunLength, row_length - offset);
+        }
+        const auto sampled_rows = (static_cast<std::size_t>(picture.rows) + GridStep - 1) / GridStep;
+        const auto samples_count = sampled_rows * row_samples;
+
+        const auto reference_age = timestamp - std::min(timestamp, ReferenceTimestamp);
+        bool changed = Reference.size() != samples_count || samples_count == 0 ||
+                       (KeyframeInterval != 0 && reference_age >= KeyframeInterval);
+        if (!changed)
+        {
+            std::uint64_t sum = 0;
+            const auto* reference = Reference.data();
+            for (int row = 0; row < picture.rows; row += static_cast<int>(GridStep))
+            {
+                const auto* current = picture.ptr<std::uint8_t>(row);
+                for (std::size_t offset = 0; offset < row_length; offset += run_step)
+                {
+                    auto length = std::min(RunLength, row_length - offset);
+                    sum += SumDifferences(current + offset, reference, length);
+                    reference += length;
+                }
+            }
+            auto difference = static_cast<double>(sum) / static_cast<double>(samples_count);
+            LastDifference = difference;
+            changed = difference >= Threshold;
+        }
+        if (!changed)
+        {
+            ++UnchangedCount;
+            return false;
+        }
+
+        Reference.resize(samples_count);
+        auto* reference = Reference.data();
+        for (int row = 0; row < picture.rows; row += static_cast<int>(GridStep))
+        {
+            const auto* current = picture.ptr<std::uint8_t>(row);
+            for (std::size_t offset = 0; offset < row_length; offset += run_step)
+            {
+                auto length = std::min(RunLength, row_length - offset);
+                std::memcpy(reference, current + offset, length);
+                reference += length;
+            }
+        }
+        ReferenceTimestamp = timestamp;
+        ++ChangedCount;
+        return true;
+    }
+
+    /// Take the count of changed pictures.
+    std::uint64_t ChangeDetector::TakeChangedCount() noexcept
+    {
+        return ChangedCount.exchange(0);
+    }
+
+    /// Take the count of unchanged pictures.
+    std::uint64_t ChangeDetector::TakeUnchangedCount() noexcept
+    {
+        return UnchangedCount.exchange(0);
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Detector of pictures which do not change since the latest changed picture.
+     * @details
+     *  Pictures are compared on a grid: every N-th row is sampled, and in a sampled row every N-th run of 16 bytes,
+     *  so a comparison touches about 1/N of the rows and 1/N^2 of the bytes of a picture.
+     *  The difference is the mean absolute difference of sampled bytes, summed with SSE2 if it is available.
+     *  Sampled bytes of changed pictures are kept as the reference, so slow changes accumulate against it
+     *  until they exceed the threshold, instead of slipping under it frame by frame.
+     *  A picture is always regarded as changed once the keyframe interval has passed since the latest changed one.
+     *  It is used by the capture thread of one swap chain, counters can be taken by other threads.
+     */
+    class ChangeDetector
+    {
+    public:
+        /// What to do with unchanged pictures.
+        enum class Modes
+        {
+            /// Unchanged pictures are not committed.
+            Skip,
+            /// Unchanged pictures are committed with the unchanged flag in their stamps.
+            Mark
+        };
+
+    private:
+        /// What to do with unchanged pictures.
+        const Modes Mode;
+        /// Minimum mean absolute difference of sampled bytes of a changed picture.
+        const double Threshold;
+        /// Step of sampled rows and of sampled runs of bytes in a row.
+        const unsigned int GridStep;
+        /// Time after the latest changed picture when the next one is regarded as changed anyway, 0 means never.
+        const std::uint64_t KeyframeInterval;
+
+        /// Sampled bytes of the latest changed picture.
+        std::vector<std::uint8_t> Reference;
+        /// Capture time of the latest changed picture in CLOCK_MONOTONIC_RAW nanoseconds.
+        std::uint64_t ReferenceTimestamp {0};
+        /// Difference of the latest examined picture.
+        std::atomic<double> LastDifference {0.0};
+        /// Count of changed pictures since the counters are taken.
+        std::atomic<std::uint64_t> ChangedCount {0};
+        /// Count of unchanged pictures since the counters are taken.
+        std::atomic<std::uint64_t> UnchangedCount {0};
+
+    public:
+        /**
+         * @brief Construct a detector.
+         * @param mode What to do with unchanged pictures.
+         * @param threshold Minimum mean absolute difference of sampled bytes of a changed picture.
+         * @param grid_step Step of sampled rows and of sampled runs of bytes in a row, at least 1.
+         * @param keyframe_interval Time after the latest changed picture when the next one is changed anyway,
+         *                          0 means pictures are only changed by their differences.
+         */
+        ChangeDetector(Modes mode, double threshold, unsigned int grid_step,
+                       std::chrono::nanoseconds keyframe_interval);
+
+        /**
+         * @brief Compare the picture with the latest changed picture.
+         * @param picture Picture to examine, which may have padded rows.
+         * @param timestamp Capture time of the picture in CLOCK_MONOTONIC_RAW nanoseconds.
+         * @return Whether the picture is changed, in which case it becomes the reference.
+         */
+        bool Examine(const cv::Mat& picture, std::uint64_t timestamp);
+
+        /// Get what to do with unchanged pictures.
+        [[nodiscard]] inline Modes GetMode() const noexcept
+        {
+            return Mode;
+        }
+
+        /// Get the difference of the latest examined picture.
+        [[nodiscard]] inline double GetLastDifference() const noexcept
+        {
+            return LastDifference.load();
+        }
+
+        /// Take the count of changed pictures since the previous call.
+        std::uint64_t TakeChangedCount() noexcept;
+        /// Take the count of unchanged pictures since the previous call.
+        std::uint64_t TakeUnchangedCount() noexcept;
+    };
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <opencv2/opencv.hpp>
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Get the OpenCV code to convert pictures of the given Bayer format into BGR.
+     * @param format Color format of the picture, such as "BayerRG".
+     * @return Conversion code for cv::cvtColor, or -1 if the format is not a Bayer format.
+     */
+    inline int GetBayerConversion(const std::string& format)
+    {
+        // Formats are named by the layout of the first row, while OpenCV names them by the second row.
+        if (format == "BayerRG") return cv::COLOR_BayerBG2BGR;
+        if (format == "BayerGR") return cv::COLOR_BayerGB2BGR;
+        if (format == "BayerBG") return cv::COLOR_BayerRG2BGR;
+        if (format == "BayerGB") return cv::COLOR_BayerGR2BGR;
+        return -1;
+    }
+
+    /// Positions of the red and the blue pixel in a 2x2 Bayer quad, the other two pixels are green.
+    struct BayerLayout
+    {
+        unsigned int RedRow;
+        unsigned int RedColumn;
+        unsigned int BlueRow;
+        unsigned int BlueColumn;
+    };
+
+    /**
+     * @brief Get the layout of 2x2 quads of the given Bayer format.
+     * @param format Color format of the picture, such as "BayerRG".
+     * @return Layout of quads, or empty if the format is not a Bayer format.
+     */
+    inline std::optional<BayerLayout> GetBayerLayout(const std::string& format)
+    {
+        if (format == "BayerRG") return BayerLayout{0, 0, 1, 1};
+        if (format == "BayerGR") return BayerLayout{0, 1, 1, 0};
+        if (format == "BayerBG") return BayerLayout{1, 1, 0, 0};
+        if (format == "BayerGB") return BayerLayout{1, 0, 0, 1};
+        return std::nullopt;
+    }
+}
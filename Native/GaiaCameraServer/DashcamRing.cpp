@@ -0,0 +1,455 @@
+#include "DashcamRing.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace Gaia::CameraService
+{
+    namespace
+    {
+        /// Get current time in nanoseconds since epoch.
+        std::uint64_t GetCurrentTimestamp()
+        {
+            return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count());
+        }
+    }
+
+    /// Preallocate the ring memory.
+    DashcamRing::DashcamRing(LogService::LogClient *logger, std::size_t capacity, bool huge_pages) :
+        Logger(logger), Capacity(Recording::AlignRecordSize(capacity)),
+        Copier([this](const std::atomic_bool& flag){
+            while (flag)
+            {
+                this->CopyPendingFrame();
+            }
+        }),
+        Dumper([this](const std::atomic_bool& flag){
+            while (flag)
+            {
+                this->DumpNextRecord();
+            }
+        })
+    {
+        if (Capacity == 0) throw std::invalid_argument("Capacity of dashcam ring must be positive.");
+
+        void* address = MAP_FAILED;
+        #ifdef MAP_HUGETLB
+        if (huge_pages)
+        {
+            constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+            auto huge_capacity = (Capacity + huge_page_size - 1) / huge_page_size * huge_page_size;
+            address = mmap(nullptr, huge_capacity, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+            if (address != MAP_FAILED)
+            {
+                Capacity = huge_capacity;
+                HugePagesBacked = true;
+            }
+            else
+            {
+                Logger->RecordWarning("Huge pages are not available for the dashcam ring, normal pages are used.");
+            }
+        }
+        #endif
+        if (address == MAP_FAILED)
+        {
+            // Populate pages in advance, so buffering never page faults.
+            address = mmap(nullptr, Capacity, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+            if (address == MAP_FAILED)
+            {
+                auto message = std::string("Failed to allocate dashcam ring: ") + std::strerror(errno);
+                Logger->RecordError(message);
+                throw std::runtime_error(message);
+            }
+            #ifdef MADV_HUGEPAGE
+            if (huge_pages) madvise(address, Capacity, MADV_HUGEPAGE);
+            #endif
+        }
+        Memory = static_cast<std::uint8_t*>(address);
+    }
+
+    /// Stop buffering and release the ring memory.
+    DashcamRing::~DashcamRing()
+    {
+        Stop();
+        munmap(Memory, Capacity);
+    }
+
+    /// Start buffering frames.
+    void DashcamRing::Start(const std::string &device_name,
+                            const std::vector<std::tuple<SwapChain*, std::string>> &pictures,
+                            std::uint64_t pre_trigger_duration, std::uint64_t post_trigger_duration)
+    {
+        if (Started) throw std::logic_error("Dashcam ring is already started.");
+        if (pictures.empty()) throw std::invalid_argument("No picture to buffer.");
+        if (pictures.size() > Recording::MaxPicturesCount)
+            throw std::invalid_argument("Too many pictures to buffer, at most " +
+                                        std::to_string(Recording::MaxPicturesCount) + " pictures are supported.");
+
+        Chains.clear();
+        Pictures.clear();
+        std::size_t pending_capacity = 0;
+        for (const auto& [chain, format] : pictures)
+        {
+            Chains.push_back(chain);
+            Pictures.emplace_back(chain->GetPictureName(), format);
+            pending_capacity += chain->GetMaxBlocksCount() - 1;
+        }
+        PendingCapacity = pending_capacity;
+        PendingFrames.clear();
+
+        DeviceName = device_name;
+        PreTriggerDuration = pre_trigger_duration;
+        PostTriggerDuration = post_trigger_duration;
+        Slots.clear();
+        SlotsBaseIndex = 0;
+        Head = 0;
+        UsedSize = 0;
+        DroppedFramesCount = 0;
+
+        Started = true;
+        Dumper.Start();
+        Copier.Start();
+        ActiveFlag = true;
+    }
+
+    /// Stop buffering.
+    void DashcamRing::Stop()
+    {
+        if (!Started) return;
+        ActiveFlag = false;
+        Copier.Stop();
+
+        // The running dump finishes once it has written all buffered frames.
+        std::unique_lock lock(RingMutex);
+        RingCondition.wait(lock, [this]{
+            return !Dumping;
+        });
+        lock.unlock();
+        Dumper.Stop();
+        Started = false;
+    }
+
+    /// Enqueue a committed frame.
+    void DashcamRing::OnPictureCommitted(SwapChain &chain, unsigned int block_id, const FrameMetadata &metadata)
+    {
+        if (!ActiveFlag) return;
+        auto finder = std::find(Chains.begin(), Chains.end(), &chain);
+        if (finder == Chains.end()) return;
+
+        PendingFrame frame {static_cast<unsigned int>(finder - Chains.begin()), block_id,
+                            chain.GetCommittedCount(), metadata};
+        std::unique_lock lock(PendingMutex);
+        if (PendingFrames.size() >= PendingCapacity)
+        {
+            ++DroppedFramesCount;
+            return;
+        }
+        PendingFrames.push_back(frame);
+        lock.unlock();
+        PendingCondition.notify_one();
+    }
+
+    /// Evict the oldest record.
+    bool DashcamRing::EvictOldestRecord()
+    {
+        if (Dumping && SlotsBaseIndex >= DumpCursor) return false;
+        UsedSize -= Slots.front().Size;
+        Slots.pop_front();
+        ++SlotsBaseIndex;
+        return true;
+    }
+
+    /// Copy a pending frame into the ring.
+    bool DashcamRing::CopyPendingFrame()
+    {
+        std::unique_lock pending_lock(PendingMutex);
+        if (!PendingCondition.wait_for(pending_lock, std::chrono::milliseconds(100), [this]{
+            return !PendingFrames.empty();
+        })) return false;
+        auto frame = PendingFrames.front();
+        PendingFrames.pop_front();
+        pending_lock.unlock();
+
+        auto* chain = Chains[frame.PictureIndex];
+        auto& block = chain->GetBlock(frame.BlockID);
+        auto payload_size = chain->GetPictureSize();
+        auto record_size = Recording::AlignRecordSize(sizeof(Recording::FrameHeader) + payload_size);
+        if (payload_size > static_cast<std::size_t>(block.GetMaxSize()) || record_size > Capacity)
+        {
+            ++DroppedFramesCount;
+            return true;
+        }
+
+        // Reserve space for the record.
+        std::uint64_t offset;
+        {
+            std::unique_lock lock(RingMutex);
+            while (!Slots.empty() && Slots.front().Timestamp + PreTriggerDuration < frame.Metadata.Timestamp)
+            {
+                if (!EvictOldestRecord()) break;
+            }
+            bool reserved = true;
+            offset = Head;
+            if (offset + record_size > Capacity)
+            {
+                // Records after the head are older than records before it, so they are evicted before wrapping.
+                while (reserved && !Slots.empty() && Slots.front().Offset >= Head)
+                {
+                    reserved = EvictOldestRecord();
+                }
+                offset = 0;
+            }
+            while (reserved && !Slots.empty() && Slots.front().Offset < offset + record_size &&
+                   offset < Slots.front().Offset + Slots.front().Size)
+            {
+                reserved = EvictOldestRecord();
+            }
+            if (!reserved)
+            {
+                ++DroppedFramesCount;
+                return true;
+            }
+        }
+
+        auto* record = Memory + offset;
+        Recording::FrameHeader frame_header {};
+        frame_header.Magic = Recording::FrameMagic;
+        frame_header.PictureIndex = frame.PictureIndex;
+        frame_header.Sequence = frame.Sequence;
+        frame_header.Timestamp = frame.Metadata.Timestamp;
+        frame_header.MonotonicTimestamp = frame.Metadata.MonotonicTimestamp;
+        frame_header.DeviceTimestamp = frame.Metadata.DeviceTimestamp;
+        frame_header.Exposure = frame.Metadata.Exposure;
+        frame_header.Gain = frame.Metadata.Gain;
+        frame_header.PixelType = chain->GetPixelType();
+        frame_header.Width = chain->GetHeader().Width;
+        frame_header.Height = chain->GetHeader().Height;
+        frame_header.PayloadSize = payload_size;
+        std::memcpy(record, &frame_header, sizeof(Recording::FrameHeader));
+        // Recordings keep rows packed, padding of aligned rows is dropped.
+        chain->CopyPacked(frame.BlockID, record + sizeof(Recording::FrameHeader));
+        std::memset(record + sizeof(Recording::FrameHeader) + payload_size, 0,
+                    record_size - sizeof(Recording::FrameHeader) - payload_size);
+
+        // The writer starts to overwrite the block once the writing index wraps around to it.
+        if (chain->GetCommittedCount() - frame.Sequence + 1 >= chain->GetSafeDepth())
+        {
+            ++DroppedFramesCount;
+            return true;
+        }
+
+        std::unique_lock lock(RingMutex);
+        Slots.push_back({offset, record_size, frame.Sequence, frame.Metadata.Timestamp, frame.PictureIndex});
+        Head = offset + record_size;
+        UsedSize += record_size;
+        lock.unlock();
+        RingCondition.notify_all();
+        return true;
+    }
+
+    /// Start a dump or extend the running one.
+    bool DashcamRing::Dump(const std::string &path)
+    {
+        std::unique_lock dump_lock(DumpMutex);
+        auto current_timestamp = GetCurrentTimestamp();
+        std::unique_lock lock(RingMutex);
+        if (Dumping)
+        {
+            DumpEndTimestamp = std::max(DumpEndTimestamp, current_timestamp + PostTriggerDuration);
+            return false;
+        }
+        if (!ActiveFlag) throw std::runtime_error("Dashcam ring is not buffering.");
+        lock.unlock();
+
+        // The file is created and its header is written without blocking the copier and the dumper,
+        // the header block is allocated first so a failed allocation leaves nothing to clean up.
+        void* header_block = nullptr;
+        if (posix_memalign(&header_block, Recording::RecordAlignment, Recording::RecordAlignment) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        std::unique_ptr<void, decltype(&std::free)> header_guard(header_block, &std::free);
+        std::memset(header_block, 0, Recording::RecordAlignment);
+        Recording::FillSegmentHeader(*static_cast<Recording::SegmentHeader*>(header_block), 0,
+                                     current_timestamp, DeviceName, Pictures);
+
+        int descriptor = -1;
+        #ifdef O_DIRECT
+        descriptor = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        #endif
+        if (descriptor < 0)
+        {
+            descriptor = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+        if (descriptor < 0)
+        {
+            auto message = "Failed to create dashcam dump " + path + ": " + std::strerror(errno);
+            Logger->RecordError(message);
+            throw std::runtime_error(message);
+        }
+        if (!WriteDump(descriptor, path, header_block, Recording::RecordAlignment, 0))
+        {
+            close(descriptor);
+            throw std::runtime_error("Failed to write dashcam dump " + path);
+        }
+        header_guard.reset();
+
+        lock.lock();
+        // The ring may be stopped meanwhile, and then no dumper thread would finish this dump.
+        if (!ActiveFlag)
+        {
+            lock.unlock();
+            close(descriptor);
+            unlink(path.c_str());
+            throw std::runtime_error("Dashcam ring is stopped before dump " + path + " starts.");
+        }
+        DumpDescriptor = descriptor;
+        DumpPath = path;
+        DumpEntries.clear();
+        DumpOffset = Recording::RecordAlignment;
+
+        // Begin with frames in the pre-trigger duration.
+        DumpCursor = SlotsBaseIndex;
+        while (DumpCursor < SlotsBaseIndex + Slots.size() &&
+               Slots[DumpCursor - SlotsBaseIndex].Timestamp + PreTriggerDuration < current_timestamp)
+        {
+            ++DumpCursor;
+        }
+        DumpEndTimestamp = current_timestamp + PostTriggerDuration;
+        Dumping = true;
+        lock.unlock();
+        RingCondition.notify_all();
+        return true;
+    }
+
+    /// Write the next record of the running dump.
+    bool DashcamRing::DumpNextRecord()
+    {
+        std::unique_lock lock(RingMutex);
+        if (!RingCondition.wait_for(lock, std::chrono::milliseconds(100), [this]{
+            return Dumping;
+        })) return false;
+
+        if (DumpCursor < SlotsBaseIndex + Slots.size())
+        {
+            auto slot = Slots[DumpCursor - SlotsBaseIndex];
+            if (slot.Timestamp > DumpEndTimestamp)
+            {
+                FinishDump();
+                return true;
+            }
+            // The slot is protected from eviction until the cursor passes it.
+            lock.unlock();
+            auto written = WriteDump(DumpDescriptor, DumpPath, Memory + slot.Offset, slot.Size, DumpOffset);
+            lock.lock();
+            if (!written)
+            {
+                FinishDump();
+                return true;
+            }
+            const auto* frame = reinterpret_cast<const Recording::FrameHeader*>(Memory + slot.Offset);
+            DumpEntries.push_back({DumpOffset, slot.Sequence, slot.Timestamp, frame->MonotonicTimestamp,
+                                   frame->DeviceTimestamp, slot.PictureIndex, 0});
+            DumpOffset += slot.Size;
+            ++DumpCursor;
+            return true;
+        }
+        if (!ActiveFlag || GetCurrentTimestamp() > DumpEndTimestamp)
+        {
+            FinishDump();
+            return true;
+        }
+        RingCondition.wait_for(lock, std::chrono::milliseconds(100));
+        return false;
+    }
+
+    /// Append the index and the footer to the running dump and close it.
+    void DashcamRing::FinishDump()
+    {
+        auto entries_size = DumpEntries.size() * sizeof(Recording::IndexEntry);
+        auto index_size = Recording::AlignRecordSize(entries_size);
+        void* tail = nullptr;
+        if (posix_memalign(&tail, Recording::RecordAlignment, index_size + Recording::RecordAlignment) == 0)
+        {
+            std::memset(tail, 0, index_size + Recording::RecordAlignment);
+            std::memcpy(tail, DumpEntries.data(), entries_size);
+            auto* footer = reinterpret_cast<Recording::Footer*>(static_cast<std::uint8_t*>(tail) + index_size);
+            footer->Magic = Recording::FooterMagic;
+            footer->Version = Recording::FormatVersion;
+            footer->IndexOffset = DumpOffset;
+            footer->EntriesCount = DumpEntries.size();
+            WriteDump(DumpDescriptor, DumpPath, tail, index_size + Recording::RecordAlignment, DumpOffset);
+            std::free(tail);
+        }
+        close(DumpDescriptor);
+        DumpDescriptor = -1;
+        Dumping = false;
+        Logger->RecordMessage("Dashcam dump " + DumpPath + " finished, " +
+                              std::to_string(DumpEntries.size()) + " frames.");
+        DumpEntries.clear();
+        RingCondition.notify_all();
+    }
+
+    /// Write aligned data into the running dump.
+    bool DashcamRing::WriteDump(int descriptor, const std::string &path, const void *data, std::size_t size,
+                                std::uint64_t offset)
+    {
+        std::size_t written_size = 0;
+        while (written_size < size)
+        {
+            auto result = pwrite(descriptor, static_cast<const std::uint8_t*>(data) + written_size,
+                                 size - written_size, static_cast<off_t>(offset + written_size));
+            if (result < 0)
+            {
+                auto error = errno;
+                if (error == EINTR) continue;
+                #ifdef O_DIRECT
+                // Some file systems accept O_DIRECT on open but reject direct writes.
+                auto flags = fcntl(descriptor, F_GETFL);
+                if (error == EINVAL && flags >= 0 && (flags & O_DIRECT))
+                {
+                    fcntl(descriptor, F_SETFL, flags & ~O_DIRECT);
+                    continue;
+                }
+                #endif
+                Logger->RecordError("Failed to write dashcam dump " + path + ": " + std::strerror(error));
+                return false;
+            }
+            written_size += static_cast<std::size_t>(result);
+        }
+        return true;
+    }
+
+    /// Get the total size of buffered records.
+    std::uint64_t DashcamRing::GetUsedSize()
+    {
+        std::unique_lock lock(RingMutex);
+        return UsedSize;
+    }
+
+    /// Get the duration between the oldest and the latest buffered frames.
+    std::uint64_t DashcamRing::GetBufferedDuration()
+    {
+        std::unique_lock lock(RingMutex);
+        if (Slots.empty()) return 0;
+        return Slots.back().Timestamp - Slots.front().Timestamp;
+    }
+
+    /// Whether a dump is running or not.
+    bool DashcamRing::IsDumping()
+    {
+        std::unique_lock lock(RingMutex);
+        return Dumping;
+    }
+}
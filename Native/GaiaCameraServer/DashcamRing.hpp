@@ -0,0 +1,205 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <GaiaBackground/GaiaBackground.hpp>
+#include <GaiaLogClient/GaiaLogClient.hpp>
+
+#include "SwapChain.hpp"
+#include "PictureObserver.hpp"
+#include "RecordingFormat.hpp"
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Pre-trigger ring which keeps the latest frames in memory and dumps them to disk on demand.
+     * @details
+     *  Frames are kept as recording frame records in a preallocated memory region, optionally backed by
+     *  huge pages, and frames older than the buffered duration or in the way of new frames are evicted.
+     *  A dump writes all buffered frames and frames committed in the following post-trigger duration
+     *  into a recording segment, directly from the ring memory with direct I/O on a background thread.
+     *  A dump requested while another one is running extends the running one instead.
+     *  Frames which have not been written by the running dump are never evicted, if the dump falls behind,
+     *  new frames are dropped from the ring instead.
+     */
+    class DashcamRing : public PictureObserver
+    {
+    private:
+        /// Frame waiting to be copied into the ring.
+        struct PendingFrame
+        {
+            unsigned int PictureIndex;
+            unsigned int BlockID;
+            unsigned long Sequence;
+            FrameMetadata Metadata;
+        };
+
+        /// Frame record in the ring.
+        struct RecordSlot
+        {
+            /// Offset of the record in the ring memory.
+            std::uint64_t Offset;
+            /// Size of the record in bytes.
+            std::uint64_t Size;
+            std::uint64_t Sequence;
+            std::uint64_t Timestamp;
+            std::uint32_t PictureIndex;
+        };
+
+        /// Logger of the host server.
+        LogService::LogClient* Logger;
+
+        /// Preallocated memory of the ring.
+        std::uint8_t* Memory {nullptr};
+        /// Size of the ring memory in bytes.
+        std::size_t Capacity {0};
+        /// Whether the ring memory is backed by huge pages or not.
+        bool HugePagesBacked {false};
+
+        /// Whether committed frames should be enqueued or not.
+        std::atomic_bool ActiveFlag {false};
+        /// Whether buffering is started and not stopped yet, only accessed by the controlling thread.
+        bool Started {false};
+        /// Swap chains of buffered pictures, the index is the picture index in frame records.
+        std::vector<SwapChain*> Chains;
+        /// Names and formats of buffered pictures.
+        std::vector<std::tuple<std::string, std::string>> Pictures;
+        /// Name of the device.
+        std::string DeviceName;
+        /// Buffered duration before a trigger, in nanoseconds.
+        std::uint64_t PreTriggerDuration {0};
+        /// Recorded duration after a trigger, in nanoseconds.
+        std::uint64_t PostTriggerDuration {0};
+
+        /// Mutex for pending frames.
+        std::mutex PendingMutex;
+        /// Notified when a frame is enqueued.
+        std::condition_variable PendingCondition;
+        /// Frames waiting to be copied.
+        std::deque<PendingFrame> PendingFrames;
+        /// Max count of pending frames.
+        std::size_t PendingCapacity {16};
+
+        /// Mutex which serializes Dump(), held while the dump file is created outside the ring mutex.
+        std::mutex DumpMutex;
+        /// Mutex for record slots and the dump state.
+        std::mutex RingMutex;
+        /// Notified when a record is appended or a dump is requested.
+        std::condition_variable RingCondition;
+        /// Records in the ring, from the oldest to the latest.
+        std::deque<RecordSlot> Slots;
+        /// Monotonic index of the oldest record in the ring.
+        std::uint64_t SlotsBaseIndex {0};
+        /// Offset to append the next record at.
+        std::uint64_t Head {0};
+        /// Total size of records in the ring.
+        std::uint64_t UsedSize {0};
+
+        /// Whether a dump is running or not.
+        bool Dumping {false};
+        /// Monotonic index of the next record to dump, records from it on can not be evicted.
+        std::uint64_t DumpCursor {0};
+        /// Frames committed after this timestamp are not included in the running dump.
+        std::uint64_t DumpEndTimestamp {0};
+        /// Descriptor of the file of the running dump.
+        int DumpDescriptor {-1};
+        /// Path of the file of the running dump.
+        std::string DumpPath;
+        /// Offset of the next record in the file of the running dump.
+        std::uint64_t DumpOffset {0};
+        /// Index entries of the running dump.
+        std::vector<Recording::IndexEntry> DumpEntries;
+
+        /// Count of frames dropped from the ring.
+        std::atomic<unsigned long> DroppedFramesCount {0};
+
+        /// Background thread which copies frames into the ring.
+        Background::BackgroundWorker Copier;
+        /// Background thread which writes dumps.
+        Background::BackgroundWorker Dumper;
+
+        /// Copy a pending frame into the ring, return false if no frame is pending.
+        bool CopyPendingFrame();
+        /// Write the next record of the running dump, return false if there is nothing to do.
+        bool DumpNextRecord();
+        /// Evict the oldest record, return false if it is protected by the running dump.
+        bool EvictOldestRecord();
+        /// Append the index and the footer to the file of the running dump and close it.
+        void FinishDump();
+        /// Write the given aligned data into the dump file with the given descriptor and path.
+        bool WriteDump(int descriptor, const std::string& path, const void* data, std::size_t size,
+                       std::uint64_t offset);
+
+    public:
+        /**
+         * @brief Preallocate the ring memory.
+         * @param logger Logger of the host server.
+         * @param capacity Size of the ring memory in bytes.
+         * @param huge_pages Whether to try to back the ring memory with huge pages or not.
+         * @throw std::runtime_error If the memory can not be allocated.
+         */
+        DashcamRing(LogService::LogClient* logger, std::size_t capacity, bool huge_pages);
+        /// Stop buffering and release the ring memory.
+        ~DashcamRing() override;
+
+        DashcamRing(const DashcamRing&) = delete;
+        DashcamRing& operator=(const DashcamRing&) = delete;
+
+        /**
+         * @brief Start buffering frames.
+         * @param device_name Name of the camera device.
+         * @param pictures List of tuples, first is the swap chain of the picture, second is its color format.
+         * @param pre_trigger_duration Buffered duration before a trigger in nanoseconds.
+         * @param post_trigger_duration Recorded duration after a trigger in nanoseconds.
+         */
+        void Start(const std::string& device_name, const std::vector<std::tuple<SwapChain*, std::string>>& pictures,
+                   std::uint64_t pre_trigger_duration, std::uint64_t post_trigger_duration);
+        /// Stop buffering, the running dump will be finished with frames already buffered.
+        void Stop();
+
+        /// Whether this ring is buffering frames or not.
+        [[nodiscard]] inline bool IsActive() const noexcept
+        {
+            return ActiveFlag;
+        }
+
+        /**
+         * @brief Dump buffered frames and frames in the post-trigger duration.
+         * @param path Path of the dump file, ignored if a dump is running.
+         * @return True if a new dump is started, false if the running dump is extended.
+         * @throw std::runtime_error If the dump file can not be created.
+         */
+        bool Dump(const std::string& path);
+
+        /// Enqueue a committed frame, frames of pictures not being buffered are ignored.
+        void OnPictureCommitted(SwapChain& chain, unsigned int block_id, const FrameMetadata& metadata) override;
+
+        /// Get the size of the ring memory in bytes.
+        [[nodiscard]] inline std::size_t GetCapacity() const noexcept
+        {
+            return Capacity;
+        }
+        /// Whether the ring memory is backed by huge pages or not.
+        [[nodiscard]] inline bool IsHugePagesBacked() const noexcept
+        {
+            return HugePagesBacked;
+        }
+        /// Get the total size of buffered records in bytes.
+        [[nodiscard]] std::uint64_t GetUsedSize();
+        /// Get the duration between the oldest and the latest buffered frames in nanoseconds.
+        [[nodiscard]] std::uint64_t GetBufferedDuration();
+        /// Whether a dump is running or not.
+        [[nodiscard]] bool IsDumping();
+        /// Get the count of frames dropped from the ring.
+        [[nodiscard]] inline unsigned long GetDroppedFramesCount() const noexcept
+        {
+            return DroppedFramesCount;
+        }
+    };
+}
@@ -1,7 +1,21 @@
 #pragma once
 
+#include "SwapChain.hpp"
 #include "CameraDriverInterface.hpp"
 #include "CameraServer.hpp"
+#include "CameraHost.hpp"
+#include "WorkerPool.hpp"
+#include "StageExecutor.hpp"
+#include "PictureObserver.hpp"
+#include "RecordingFormat.hpp"
+#include "Recorder.hpp"
+#include "RecordingReader.hpp"
+#include "DashcamRing.hpp"
+#include "ColorFormat.hpp"
+#include "VideoEncoder.hpp"
+#include "PreviewGenerator.hpp"
+#include "PyramidGenerator.hpp"
+#include "RegionCropper.hpp"
 #include "Launcher.hpp"
 
 namespace Gaia::CameraService
@@ -3,7 +3,9 @@
 #include <boost/program_options.hpp>
 #include <string>
 #include <iostream>
+#include <vector>
 #include "CameraServer.hpp"
+#include "CameraHost.hpp"
 
 namespace Gaia::CameraService
 {
@@ -14,6 +16,7 @@ namespace Gaia::CameraService
      * @param constructor_arguments Arguments to pass to camera driver constructor.
      * @details
      *  This function will block until the server receive a shutdown command and exit normally.
+     *  If several device indices are given, all cameras are hosted in this process by a camera host.
      */
     template <typename CameraClass, typename... ArgumentTypes>
     void LaunchServer(int command_line_counts, char** command_line, ArgumentTypes... constructor_arguments)
@@ -28,8 +31,10 @@ namespace Gaia::CameraService
                  "ip address of the Redis server.")
                 ("port,p", value<unsigned int>()->default_value(6379),
                  "port of the Redis server.")
-                ("device,d", value<unsigned int>()->default_value(0),
-                 "index of the device to open.")
+                ("device,d", value<std::vector<unsigned int>>()->multitoken()->default_value({0}, "0"),
+                 "indices of the devices to open, several cameras are hosted in this process.")
+                ("workers,w", value<unsigned int>()->default_value(0),
+                 "count of conversion workers shared by hosted cameras, 0 means hardware threads minus 1.")
                 ("flip,f", "flip the picture.");
         variables_map variables;
         store(parse_command_line(command_line_counts, command_line, options), variables);
@@ -43,7 +48,43 @@ namespace Gaia::CameraService
 
         auto option_host = variables["host"].as<std::string>();
         auto option_port = variables["port"].as<unsigned int>();
-        auto option_device = variables["device"].as<unsigned int>();
+        auto option_devices = variables["device"].as<std::vector<unsigned int>>();
+        auto option_workers = variables["workers"].as<unsigned int>();
+
+        if (option_devices.size() > 1)
+        {
+            bool host_crashed;
+            do
+            {
+                try
+                {
+                    host_crashed = false;
+                    std::cout << "Launching camera host on " << option_devices.size() << " devices"
+                        << ", with Redis server on " << option_host << ":" << option_port << "..." << std::endl;
+
+                    Gaia::CameraService::CameraHost host(option_port, option_host, option_workers);
+                    host.RequiredFlip = variables.count("flip") > 0;
+                    for (auto device_index : option_devices)
+                    {
+                        host.AddCamera([constructor_arguments...]{
+                            return std::make_unique<CameraClass>(constructor_arguments...);
+                        }, device_index);
+                    }
+                    std::cout << "Camera host launching..." << std::endl;
+                    host.Launch();
+                    std::cout << "Camera host stopped." << std::endl;
+                }catch (std::exception& error)
+                {
+                    host_crashed = true;
+                    std::cout << "Camera host crashed, exception:" << std::endl;
+                    std::cout << error.what() << std::endl;
+                    std::cout << "Camera host will restart in 1 second." << std::endl;
+                    std::this_thread::sleep_for(std::chrono::seconds(1));
+                }
+            } while (host_crashed);
+            return;
+        }
+        auto option_device = option_devices.front();
 
         bool crashed;
         do
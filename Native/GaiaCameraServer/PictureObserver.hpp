@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+#include "SwapChain.hpp"
+
+namespace Gaia::CameraService
+{
+    /// Metadata of a committed picture.
+    struct FrameMetadata
+    {
+        /// Capture time in nanoseconds since epoch.
+        std::uint64_t Timestamp {0};
+        /// Capture time in CLOCK_MONOTONIC_RAW nanoseconds of the host.
+        std::uint64_t MonotonicTimestamp {0};
+        /// Capture time stamped by the device in device ticks, 0 if the device does not provide one.
+        std::uint64_t DeviceTimestamp {0};
+        /// Sequence number of the picture where it is captured, for replayed or mirrored pictures, otherwise 0.
+        std::uint64_t SourceSequence {0};
+        /// Flags of the picture stamp given by the driver, such as PictureStamp::UnchangedFlag.
+        std::uint32_t Flags {0};
+        /// Exposure time in microseconds, as given by the driver or as last reported by it if it is 0.
+        unsigned int Exposure {0};
+        /// Digital gain, as given by the driver or as last reported by it if the exposure is 0.
+        double Gain {0.0};
+    };
+
+    /**
+     * @brief Interface for server components which consume committed pictures.
+     * @details
+     *  Observers are invoked on the committing thread of the driver right after a block is committed,
+     *  so they should only enqueue the block and do the heavy work on their own threads.
+     *  The committed block stays valid until the swap chain wraps around to it.
+     */
+    class PictureObserver
+    {
+    public:
+        /// Virtual destructor for derived classes.
+        virtual ~PictureObserver() = default;
+
+        /**
+         * @brief Invoked when a picture is committed.
+         * @param chain Swap chain of the picture.
+         * @param block_id ID of the committed block.
+         * @param metadata Metadata of the picture.
+         */
+        virtual void OnPictureCommitted(SwapChain& chain, unsigned int block_id, const FrameMetadata& metadata) = 0;
+    };
+}
@@ -0,0 +1,153 @@
+#include "PreviewGenerator.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <stdexcept>
+
+#include "ColorFormat.hpp"
+
+namespace Gaia::CameraService
+{
+    /// Bind the logger.
+    PreviewGenerator::PreviewGenerator(LogService::LogClient *logger) : Logger(logger),
+        Generator([this](const std::atomic_bool& flag){
+            while (flag)
+            {
+                this->GeneratePreview();
+            }
+        })
+    {}
+
+    /// Stop generating.
+    PreviewGenerator::~PreviewGenerator()
+    {
+        Stop();
+    }
+
+    /// Compute the size of previews of the source picture.
+    cv::Size PreviewGenerator::ComputePreviewSize(const SwapChain &source, unsigned int longest_side)
+    {
+        const auto& header = source.GetHeader();
+        auto width = static_cast<double>(header.Width);
+        auto height = static_cast<double>(header.Height);
+        auto scale = std::min(1.0, static_cast<double>(longest_side) / std::max(width, height));
+        return {std::max(1, static_cast<int>(width * scale)), std::max(1, static_cast<int>(height * scale))};
+    }
+
+    /// Start generating previews.
+    void PreviewGenerator::Start(SwapChain &source, const std::string &source_format, SwapChain &target,
+                                 Committer committer, const Settings &settings)
+    {
+        if (Started) throw std::logic_error("Preview generator is already started.");
+        if (CV_MAT_DEPTH(source.GetPixelType()) != CV_8U)
+            throw std::invalid_argument("Picture " + source.GetPictureName() + " is not a 8 bits picture.");
+        if (settings.Encoding != "JPEG" && settings.Encoding != "WebP")
+            throw std::invalid_argument("Unsupported preview encoding " + settings.Encoding + ".");
+
+        Source = &source;
+        SourceFormat = source_format;
+        Target = &target;
+        Commit = std::move(committer);
+        CurrentSettings = settings;
+        PreviewSize = ComputePreviewSize(source, settings.LongestSide);
+        Pending.reset();
+        LastAcceptedTimestamp = 0;
+        GeneratedCount = 0;
+
+        Started = true;
+        Generator.Start();
+        ActiveFlag = true;
+        Logger->RecordMessage("Preview of picture " + source.GetPictureName() + " started, " +
+                              std::to_string(PreviewSize.width) + "x" + std::to_string(PreviewSize.height) +
+                              " " + settings.Encoding + ".");
+    }
+
+    /// Stop generating previews.
+    void PreviewGenerator::Stop()
+    {
+        if (!Started) return;
+        ActiveFlag = false;
+        Generator.Stop();
+        Pending.reset();
+        Started = false;
+    }
+
+    /// Accept a committed frame of the source picture if the preview is due.
+    void PreviewGenerator::OnPictureCommitted(SwapChain &chain, unsigned int block_id,
+                                              const FrameMetadata &metadata)
+    {
+        if (!ActiveFlag || &chain != Source) return;
+        if (LastAcceptedTimestamp != 0 && metadata.Timestamp >= LastAcceptedTimestamp &&
+            metadata.Timestamp - LastAcceptedTimestamp < CurrentSettings.Interval) return;
+        LastAcceptedTimestamp = metadata.Timestamp;
+
+        std::unique_lock lock(PendingMutex);
+        Pending = PendingFrame{block_id, chain.GetCommittedCount(), metadata.Timestamp};
+        lock.unlock();
+        PendingCondition.notify_one();
+    }
+
+    /// Generate a preview of the pending frame.
+    bool PreviewGenerator::GeneratePreview()
+    {
+        std::unique_lock lock(PendingMutex);
+        if (!PendingCondition.wait_for(lock, std::chrono::milliseconds(100), [this]{
+            return Pending.has_value();
+        })) return false;
+        auto frame = *Pending;
+        Pending.reset();
+        lock.unlock();
+
+        // Downscaling reads the block directly, the result is discarded if the block is overwritten meanwhile.
+        auto block_picture = Source->ViewBlock(frame.BlockID);
+        auto bayer_conversion = GetBayerConversion(SourceFormat);
+        if (bayer_conversion >= 0)
+        {
+            // Demosaicing must happen at the full resolution, or the Bayer pattern would be mixed up.
+            cv::cvtColor(block_picture, ConvertedFrame, bayer_conversion);
+            cv::resize(ConvertedFrame, ScaledFrame, PreviewSize, 0, 0, cv::INTER_AREA);
+        }
+        else
+        {
+            cv::resize(block_picture, ConvertedFrame, PreviewSize, 0, 0, cv::INTER_AREA);
+            if (ConvertedFrame.channels() == 4)
+            {
+                cv::cvtColor(ConvertedFrame, ScaledFrame, cv::COLOR_BGRA2BGR);
+            }
+            else
+            {
+                std::swap(ConvertedFrame, ScaledFrame);
+            }
+        }
+        if (Source->GetCommittedCount() - frame.Sequence + 1 >= Source->GetSafeDepth())
+        {
+            return true;
+        }
+
+        const auto is_jpeg = CurrentSettings.Encoding == "JPEG";
+        if (!cv::imencode(is_jpeg ? ".jpg" : ".webp", ScaledFrame, EncodedBytes,
+                          {is_jpeg ? cv::IMWRITE_JPEG_QUALITY : cv::IMWRITE_WEBP_QUALITY,
+                           CurrentSettings.Quality}))
+        {
+            Logger->RecordError("Failed to encode the preview of picture " + Source->GetPictureName() + ".");
+            return true;
+        }
+        auto& writer = Target->GetWriter();
+        if (EncodedBytes.size() > static_cast<std::size_t>(writer.GetMaxSize()))
+        {
+            Logger->RecordWarning("Encoded preview of " + std::to_string(EncodedBytes.size()) +
+                                  " bytes does not fit in the preview block, it is discarded.");
+            return true;
+        }
+
+        std::memcpy(writer.GetPointer(), EncodedBytes.data(), EncodedBytes.size());
+        auto preview_header = Target->GetHeader();
+        preview_header.Width = static_cast<decltype(preview_header.Width)>(EncodedBytes.size());
+        preview_header.Height = 1;
+        writer.SetHeader(preview_header);
+        Commit(*Target, frame.Timestamp);
+        ++GeneratedCount;
+        return true;
+    }
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <GaiaBackground/GaiaBackground.hpp>
+#include <GaiaLogClient/GaiaLogClient.hpp>
+
+#include "SwapChain.hpp"
+#include "PictureObserver.hpp"
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Generator of a compressed low resolution preview of a picture.
+     * @details
+     *  At most one frame of the source picture is pending at a time, and frames committed faster than
+     *  the preview rate are ignored, so generating previews costs a bounded share of the capture rate.
+     *  A background thread downscales the pending frame, encodes it as JPEG or WebP,
+     *  and commits the encoded bytes into the preview swap chain as a 1xN 8 bits picture,
+     *  whose width in the block header is the size of the encoded bytes.
+     */
+    class PreviewGenerator : public PictureObserver
+    {
+    public:
+        /// Settings of previews.
+        struct Settings
+        {
+            /// Length of the longest side of previews in pixels.
+            unsigned int LongestSide {640};
+            /// Encoding of previews, "JPEG" or "WebP".
+            std::string Encoding {"JPEG"};
+            /// Encoding quality from 1 to 100.
+            int Quality {80};
+            /// Min interval between previews in nanoseconds.
+            std::uint64_t Interval {200000000};
+        };
+
+        /// Function to commit the writing block of the preview swap chain with the source capture time.
+        using Committer = std::function<void(SwapChain& chain, std::uint64_t timestamp)>;
+
+    private:
+        /// Frame waiting to be previewed.
+        struct PendingFrame
+        {
+            unsigned int BlockID;
+            unsigned long Sequence;
+            std::uint64_t Timestamp;
+        };
+
+        /// Logger of the host server.
+        LogService::LogClient* Logger;
+
+        /// Whether committed frames should be accepted or not.
+        std::atomic_bool ActiveFlag {false};
+        /// Whether generating is started and not stopped yet, only accessed by the controlling thread.
+        bool Started {false};
+
+        /// Swap chain of the source picture.
+        SwapChain* Source {nullptr};
+        /// Color format of the source picture.
+        std::string SourceFormat;
+        /// Swap chain of the preview picture.
+        SwapChain* Target {nullptr};
+        /// Function to commit previews.
+        Committer Commit;
+        /// Settings of previews.
+        Settings CurrentSettings;
+        /// Size of previews.
+        cv::Size PreviewSize;
+
+        /// Mutex for the pending frame.
+        std::mutex PendingMutex;
+        /// Notified when a frame is pending.
+        std::condition_variable PendingCondition;
+        /// The latest accepted frame, replaced by newer frames until it is taken.
+        std::optional<PendingFrame> Pending;
+        /// Capture time of the latest accepted frame, only accessed by the committing thread.
+        std::uint64_t LastAcceptedTimestamp {0};
+
+        /// Downscaled frame.
+        cv::Mat ScaledFrame;
+        /// Converted frame.
+        cv::Mat ConvertedFrame;
+        /// Encoded bytes.
+        std::vector<unsigned char> EncodedBytes;
+
+        /// Count of generated previews.
+        std::atomic<unsigned long> GeneratedCount {0};
+
+        /// Background thread which generates previews.
+        Background::BackgroundWorker Generator;
+
+        /// Generate a preview of the pending frame, return false if no frame is pending.
+        bool GeneratePreview();
+
+    public:
+        /// Bind the logger.
+        explicit PreviewGenerator(LogService::LogClient* logger);
+        /// Stop generating.
+        ~PreviewGenerator() override;
+
+        PreviewGenerator(const PreviewGenerator&) = delete;
+        PreviewGenerator& operator=(const PreviewGenerator&) = delete;
+
+        /**
+         * @brief Compute the size of previews of the source picture.
+         * @param source Swap chain of the source picture.
+         * @param longest_side Length of the longest side of previews in pixels.
+         */
+        static cv::Size ComputePreviewSize(const SwapChain& source, unsigned int longest_side);
+
+        /**
+         * @brief Start generating previews.
+         * @param source Swap chain of the source picture, it should be 8 bits.
+         * @param source_format Color format of the source picture, such as "BGR" or "BayerRG".
+         * @param target Swap chain of the preview, whose blocks should hold an uncompressed preview.
+         * @param committer Function to commit previews.
+         * @param settings Settings of previews.
+         */
+        void Start(SwapChain& source, const std::string& source_format, SwapChain& target, Committer committer,
+                   const Settings& settings);
+        /// Stop generating previews.
+        void Stop();
+
+        /// Whether this generator is generating previews or not.
+        [[nodiscard]] inline bool IsActive() const noexcept
+        {
+            return ActiveFlag;
+        }
+
+        /// Accept a committed frame of the source picture if the preview is due.
+        void OnPictureCommitted(SwapChain& chain, unsigned int block_id, const FrameMetadata& metadata) override;
+
+        /// Get the count of generated previews.
+        [[nodiscard]] inline unsigned long GetGeneratedCount() const noexcept
+        {
+            return GeneratedCount;
+        }
+    };
+}
@@ -0,0 +1,286 @@
+#include "PyramidGenerator.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Gaia::CameraService
+{
+    namespace
+    {
+        /// Sum two rows of 8 bits values into 16 bits values.
+        void SumRows(const std::uint8_t* upper, const std::uint8_t* lower, std::uint16_t* sums, std::size_t length)
+        {
+            std::size_t index = 0;
+            #ifdef __SSE2__
+            const auto zero = _mm_setzero_si128();
+            for (; index + 16 <= length; index += 16)
+            {
+                auto upper_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(upper + index));
+                auto lower_bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lower + index));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + index),
+                                 _mm_add_epi16(_mm_unpacklo_epi8(upper_bytes, zero),
+                                               _mm_unpacklo_epi8(lower_bytes, zero)));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(sums + index + 8),
+                                 _mm_add_epi16(_mm_unpackhi_epi8(upper_bytes, zero),
+                                               _mm_unpackhi_epi8(lower_bytes, zero)));
+            }
+            #endif
+            for (; index < length; ++index)
+            {
+                sums[index] = static_cast<std::uint16_t>(upper[index] + lower[index]);
+            }
+        }
+
+        /// Average every two horizontally adjacent pixels of summed rows, with rounding.
+        void HalveRow(const std::uint16_t* sums, std::uint8_t* target, unsigned int target_width,
+                      unsigned int channels)
+        {
+            for (unsigned int column = 0; column < target_width; ++column)
+            {
+                const auto* left = sums + column * channels * 2;
+                auto* pixel = target + column * channels;
+                for (unsigned int channel = 0; channel < channels; ++channel)
+                {
+                    pixel[channel] = static_cast<std::uint8_t>((left[channel] + left[channel + channels] + 2) >> 2);
+                }
+            }
+        }
+
+        /// Take a BGR pixel from every 2x2 quad of two Bayer rows.
+        void HalveBayerRows(const std::uint8_t* upper, const std::uint8_t* lower, std::uint8_t* target,
+                            unsigned int target_width, const BayerLayout& layout)
+        {
+            const std::uint8_t* rows[2] = {upper, lower};
+            const auto* red_row = rows[layout.RedRow] + layout.RedColumn;
+            const auto* blue_row = rows[layout.BlueRow] + layout.BlueColumn;
+            const auto* first_green_row = rows[layout.RedRow] + layout.BlueColumn;
+            const auto* second_green_row = rows[layout.BlueRow] + layout.RedColumn;
+            for (unsigned int column = 0; column < target_width; ++column)
+            {
+                auto offset = column * 2;
+                auto* pixel = target + column * 3;
+                pixel[0] = blue_row[offset];
+                pixel[1] = static_cast<std::uint8_t>((first_green_row[offset] + second_green_row[offset] + 1) >> 1);
+                pixel[2] = red_row[offset];
+            }
+        }
+    }
+
+    /// Bind the logger.
+    PyramidGenerator::PyramidGenerator(LogService::LogClient *logger) : Logger(logger),
+        Generator([this](const std::atomic_bool& flag){
+            while (flag)
+            {
+                this->GeneratePendingLevels();
+            }
+        })
+    {}
+
+    /// Stop generating.
+    PyramidGenerator::~PyramidGenerator()
+    {
+        Stop();
+    }
+
+    /// Generate the picture name of a level.
+    std::string PyramidGenerator::GenerateLevelName(const std::string &picture_name, unsigned int level)
+    {
+        return picture_name + "@" + std::to_string(1u << level);
+    }
+
+    /// Get the color format of levels.
+    std::string PyramidGenerator::GetLevelFormat(const std::string &source_format)
+    {
+        return GetBayerLayout(source_format) ? "BGR" : source_format;
+    }
+
+    /// Compute the header of a level.
+    SharedPicture::PictureHeader PyramidGenerator::GenerateLevelHeader(const SwapChain &source,
+                                                                     const std::string &source_format,
+                                                                     unsigned int level)
+    {
+        auto header = source.GetHeader();
+        if (GetBayerLayout(source_format)) header.Channels = 3;
+        header.Width >>= level;
+        header.Height >>= level;
+        return header;
+    }
+
+    /// Start generating levels.
+    void PyramidGenerator::Start(
+            const std::vector<std::tuple<SwapChain*, std::string, std::vector<SwapChain*>>> &pyramids,
+            Committer committer)
+    {
+        if (Started) throw std::logic_error("Pyramid generator is already started.");
+
+        auto pyramids_list = std::make_shared<PyramidList>();
+        std::size_t max_row_length = 0;
+        for (const auto& [source, source_format, levels] : pyramids)
+        {
+            if (CV_MAT_DEPTH(source->GetPixelType()) != CV_8U)
+            {
+                Logger->RecordWarning("Picture " + source->GetPictureName() +
+                                      " is not a 8 bits picture, its levels will not be generated.");
+                continue;
+            }
+            if (levels.empty()) continue;
+            auto pyramid = std::make_unique<Pyramid>();
+            pyramid->Source = source;
+            pyramid->Layout = GetBayerLayout(source_format);
+            pyramid->Levels = levels;
+            // Rows of level 1 of a Bayer picture are longer than rows of the source.
+            const auto& header = source->GetHeader();
+            const auto& first_header = levels.front()->GetHeader();
+            max_row_length = std::max({max_row_length, static_cast<std::size_t>(header.Width) * header.Channels,
+                                       static_cast<std::size_t>(first_header.Width) * first_header.Channels * 2});
+            pyramids_list->push_back(std::move(pyramid));
+        }
+        if (pyramids_list->empty()) throw std::invalid_argument("No picture to generate levels of.");
+        RowSums.assign(max_row_length, 0);
+        Commit = std::move(committer);
+        NextPyramidIndex = 0;
+        GeneratedCount = 0;
+
+        std::atomic_store(&Pyramids, std::move(pyramids_list));
+        Started = true;
+        Generator.Start();
+        ActiveFlag = true;
+    }
+
+    /// Stop generating levels.
+    void PyramidGenerator::Stop()
+    {
+        if (!Started) return;
+        ActiveFlag = false;
+        Generator.Stop();
+        // Committing threads may still hold the snapshot, the pyramids are released after them.
+        std::atomic_store(&Pyramids, std::shared_ptr<PyramidList>());
+        Started = false;
+    }
+
+    /// Set the count of levels to compute for a source picture.
+    void PyramidGenerator::SetDemandedLevels(const SwapChain &source, unsigned int levels_count)
+    {
+        auto pyramids = std::atomic_load(&Pyramids);
+        if (!pyramids) return;
+        for (auto& pyramid : *pyramids)
+        {
+            if (pyramid->Source != &source) continue;
+            pyramid->DemandedLevels = std::min(levels_count, static_cast<unsigned int>(pyramid->Levels.size()));
+        }
+    }
+
+    /// Accept a committed frame of a source picture.
+    void PyramidGenerator::OnPictureCommitted(SwapChain &chain, unsigned int block_id,
+                                              const FrameMetadata &metadata)
+    {
+        if (!ActiveFlag) return;
+        auto pyramids = std::atomic_load(&Pyramids);
+        if (!pyramids) return;
+        auto finder = std::find_if(pyramids->begin(), pyramids->end(),
+                                   [&chain](const std::unique_ptr<Pyramid>& pyramid){
+            return pyramid->Source == &chain;
+        });
+        if (finder == pyramids->end() || (*finder)->DemandedLevels == 0) return;
+
+        std::unique_lock lock(PendingMutex);
+        (*finder)->Pending = PendingFrame{block_id, chain.GetCommittedCount(), metadata.Timestamp};
+        lock.unlock();
+        PendingCondition.notify_one();
+    }
+
+    /// Compute levels of a pending frame.
+    bool PyramidGenerator::GeneratePendingLevels()
+    {
+        auto pyramids = std::atomic_load(&Pyramids);
+        if (!pyramids) return false;
+        std::unique_lock lock(PendingMutex);
+        auto has_pending = [&pyramids]{
+            return std::any_of(pyramids->begin(), pyramids->end(), [](const std::unique_ptr<Pyramid>& pyramid){
+                return pyramid->Pending.has_value();
+            });
+        };
+        if (!PendingCondition.wait_for(lock, std::chrono::milliseconds(100), has_pending)) return false;
+        Pyramid* pyramid = nullptr;
+        for (std::size_t offset = 0; offset < pyramids->size() && !pyramid; ++offset)
+        {
+            auto index = (NextPyramidIndex + offset) % pyramids->size();
+            if (!(*pyramids)[index]->Pending) continue;
+            pyramid = (*pyramids)[index].get();
+            NextPyramidIndex = index + 1;
+        }
+        auto frame = *pyramid->Pending;
+        pyramid->Pending.reset();
+        lock.unlock();
+
+        auto deepest_level = std::min(pyramid->DemandedLevels.load(),
+                                      static_cast<unsigned int>(pyramid->Levels.size()));
+        if (deepest_level == 0) return true;
+
+        auto* source = pyramid->Source;
+        std::vector<std::uint8_t*> levels;
+        levels.reserve(deepest_level + 1);
+        levels.push_back(source->ViewBlock(frame.BlockID).data);
+        for (unsigned int level = 1; level <= deepest_level; ++level)
+        {
+            levels.push_back(pyramid->Levels[level - 1]->ViewWritingBlock().data);
+        }
+
+        // Level 1 is computed from the source row by row, deeper levels follow as soon as their rows are ready.
+        const auto& first_header = pyramid->Levels[0]->GetHeader();
+        const auto source_row_stride = source->GetRowStride();
+        const auto first_row_length = static_cast<std::size_t>(first_header.Width) * first_header.Channels;
+        const auto first_row_stride = pyramid->Levels[0]->GetRowStride();
+        for (unsigned int row = 0; row < first_header.Height; ++row)
+        {
+            const auto* upper = levels[0] + 2 * row * source_row_stride;
+            const auto* lower = upper + source_row_stride;
+            auto* target = levels[1] + row * first_row_stride;
+            if (pyramid->Layout)
+            {
+                HalveBayerRows(upper, lower, target, first_header.Width, *pyramid->Layout);
+            }
+            else
+            {
+                SumRows(upper, lower, RowSums.data(), first_row_length * 2);
+                HalveRow(RowSums.data(), target, first_header.Width, first_header.Channels);
+            }
+            PropagateRow(*pyramid, levels, 1, row, deepest_level);
+        }
+
+        // Levels computed from an overwritten block are discarded.
+        if (source->GetCommittedCount() - frame.Sequence + 1 >= source->GetSafeDepth())
+        {
+            return true;
+        }
+        for (unsigned int level = 1; level <= deepest_level; ++level)
+        {
+            Commit(*pyramid->Levels[level - 1], frame.Timestamp);
+        }
+        ++GeneratedCount;
+        return true;
+    }
+
+    /// Compute the row of the next level once both of its source rows are computed.
+    void PyramidGenerator::PropagateRow(const Pyramid &pyramid, const std::vector<std::uint8_t*> &levels,
+                                        unsigned int level, unsigned int row, unsigned int deepest_level)
+    {
+        if (level >= deepest_level || row % 2 == 0) return;
+
+        const auto& next_header = pyramid.Levels[level]->GetHeader();
+        const auto row_stride = pyramid.Levels[level - 1]->GetRowStride();
+        const auto next_row_length = static_cast<std::size_t>(next_header.Width) * next_header.Channels;
+        const auto next_row = row / 2;
+        if (next_row >= next_header.Height) return;
+
+        const auto* upper = levels[level] + (row - 1) * row_stride;
+        SumRows(upper, upper + row_stride, RowSums.data(), next_row_length * 2);
+        HalveRow(RowSums.data(), levels[level + 1] + next_row * pyramid.Levels[level]->GetRowStride(),
+                 next_header.Width, next_header.Channels);
+        PropagateRow(pyramid, levels, level + 1, next_row, deepest_level);
+    }
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <GaiaBackground/GaiaBackground.hpp>
+#include <GaiaLogClient/GaiaLogClient.hpp>
+
+#include "SwapChain.hpp"
+#include "PictureObserver.hpp"
+#include "ColorFormat.hpp"
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Generator of downscaled levels of pictures, shared by all readers.
+     * @details
+     *  Level N of a picture is downscaled by 2^N with a 2x2 box kernel, the odd last row and column are dropped.
+     *  All levels are computed in one pass over the source: every two rows of a level produce one row of
+     *  the next level while they are still in the cache, and rows are written straight into the writing
+     *  blocks of level swap chains.
+     *  The first level of a Bayer picture is a BGR picture, whose pixels are taken from 2x2 Bayer quads.
+     *  Only levels up to the deepest demanded one are computed, and nothing is computed if none is demanded.
+     *  At most one frame of every source is pending, frames committed during computing replace it.
+     *  Committing threads work on a snapshot of the pyramids list, so stopping while capturing only releases
+     *  pyramids after the last commit which is using them.
+     */
+    class PyramidGenerator : public PictureObserver
+    {
+    public:
+        /// Function to commit the writing block of a level swap chain with the source capture time.
+        using Committer = std::function<void(SwapChain& chain, std::uint64_t timestamp)>;
+
+        /**
+         * @brief Generate the picture name of a level.
+         * @param picture_name Name of the source picture.
+         * @param level Level beginning from 1.
+         * @return Name like "main@2" for level 1 and "main@4" for level 2.
+         */
+        static std::string GenerateLevelName(const std::string& picture_name, unsigned int level);
+
+        /// Get the color format of levels of a picture with the given format.
+        static std::string GetLevelFormat(const std::string& source_format);
+
+        /**
+         * @brief Compute the header of a level.
+         * @param source Swap chain of the source picture.
+         * @param source_format Color format of the source picture.
+         * @param level Level beginning from 1.
+         */
+        static SharedPicture::PictureHeader GenerateLevelHeader(const SwapChain& source,
+                                                                const std::string& source_format,
+                                                                unsigned int level);
+
+    private:
+        /// Frame waiting to be downscaled.
+        struct PendingFrame
+        {
+            unsigned int BlockID;
+            unsigned long Sequence;
+            std::uint64_t Timestamp;
+        };
+
+        /// Levels of a source picture.
+        struct Pyramid
+        {
+            /// Swap chain of the source picture.
+            SwapChain* Source {nullptr};
+            /// Quad layout of the source picture, empty if it is not a Bayer picture.
+            std::optional<BayerLayout> Layout;
+            /// Swap chains of levels, the first one is level 1.
+            std::vector<SwapChain*> Levels;
+            /// Count of levels to compute, from level 1.
+            std::atomic<unsigned int> DemandedLevels {0};
+            /// The latest committed frame, replaced by newer frames until it is taken.
+            std::optional<PendingFrame> Pending;
+        };
+        using PyramidList = std::vector<std::unique_ptr<Pyramid>>;
+
+        /// Logger of the host server.
+        LogService::LogClient* Logger;
+
+        /// Whether committed frames should be accepted or not.
+        std::atomic_bool ActiveFlag {false};
+        /// Whether generating is started and not stopped yet, only accessed by the controlling thread.
+        bool Started {false};
+
+        /// Snapshot of pyramids of source pictures, nullptr if not started, replaced by the controlling thread.
+        std::shared_ptr<PyramidList> Pyramids;
+        /// Function to commit levels.
+        Committer Commit;
+
+        /// Mutex for pending frames.
+        std::mutex PendingMutex;
+        /// Index of the pyramid to check first for a pending frame, so all sources are served in turn.
+        std::size_t NextPyramidIndex {0};
+        /// Notified when a frame is pending.
+        std::condition_variable PendingCondition;
+
+        /// Vertical sums of two rows.
+        std::vector<std::uint16_t> RowSums;
+
+        /// Count of generated pyramids.
+        std::atomic<unsigned long> GeneratedCount {0};
+
+        /// Background thread which computes levels.
+        Background::BackgroundWorker Generator;
+
+        /// Compute levels of a pending frame, return false if no frame is pending.
+        bool GeneratePendingLevels();
+        /**
+         * @brief Compute the row of the next level once both of its source rows are computed, and so on.
+         * @param pyramid Pyramid being computed.
+         * @param levels Pointers to pictures of all levels, the first one is the source.
+         * @param level Level of the computed row.
+         * @param row Index of the computed row.
+         * @param deepest_level Deepest level to compute.
+         */
+        void PropagateRow(const Pyramid& pyramid, const std::vector<std::uint8_t*>& levels,
+                          unsigned int level, unsigned int row, unsigned int deepest_level);
+
+    public:
+        /// Bind the logger.
+        explicit PyramidGenerator(LogService::LogClient* logger);
+        /// Stop generating.
+        ~PyramidGenerator() override;
+
+        PyramidGenerator(const PyramidGenerator&) = delete;
+        PyramidGenerator& operator=(const PyramidGenerator&) = delete;
+
+        /**
+         * @brief Start generating levels.
+         * @param pyramids List of tuples, first is the swap chain of the source picture,
+         *                 second is its color format, third is the swap chains of its levels.
+         *                 Sources should be 8 bits, levels should be created with GenerateLevelHeader().
+         * @param committer Function to commit levels.
+         * @details Nothing is computed until levels are demanded.
+         */
+        void Start(const std::vector<std::tuple<SwapChain*, std::string, std::vector<SwapChain*>>>& pyramids,
+                   Committer committer);
+        /// Stop generating levels.
+        void Stop();
+
+        /**
+         * @brief Set the count of levels to compute for a source picture.
+         * @param source Swap chain of the source picture.
+         * @param levels_count Levels from 1 to this count will be computed, 0 means none.
+         */
+        void SetDemandedLevels(const SwapChain& source, unsigned int levels_count);
+
+        /// Whether this generator is started or not.
+        [[nodiscard]] inline bool IsActive() const noexcept
+        {
+            return ActiveFlag;
+        }
+
+        /// Accept a committed frame of a source picture if any of its levels is demanded.
+        void OnPictureCommitted(SwapChain& chain, unsigned int block_id, const FrameMetadata& metadata) override;
+
+        /// Get the count of generated pyramids.
+        [[nodiscard]] inline unsigned long GetGeneratedCount() const noexcept
+        {
+            return GeneratedCount;
+        }
+    };
+}
@@ -0,0 +1,403 @@
+#include "Recorder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace Gaia::CameraService
+{
+    /// Close the segment file.
+    Recorder::SegmentFile::~SegmentFile()
+    {
+        if (Descriptor >= 0)
+        {
+            close(Descriptor);
+        }
+    }
+
+    /// Allocate the aligned memory.
+    Recorder::AlignedBuffer::AlignedBuffer(std::size_t capacity) :
+        Capacity(Recording::AlignRecordSize(capacity))
+    {
+        void* address = nullptr;
+        if (posix_memalign(&address, Recording::RecordAlignment, Capacity) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        Data = static_cast<std::uint8_t*>(address);
+    }
+
+    /// Free the aligned memory.
+    Recorder::AlignedBuffer::~AlignedBuffer()
+    {
+        std::free(Data);
+    }
+
+    /// Allocate buffers.
+    Recorder::Recorder(LogService::LogClient* logger, std::size_t buffer_size, unsigned int buffers_count) :
+        Logger(logger), BufferSize(Recording::AlignRecordSize(std::max<std::size_t>(buffer_size, 1))),
+        Copier([this](const std::atomic_bool& flag){
+            // The session is only replaced while the copier is stopped, so it is loaded once.
+            auto session = std::atomic_load(&this->CurrentSession);
+            while (flag && session)
+            {
+                this->CopyPendingFrame(*session);
+            }
+        }),
+        Writer([this](const std::atomic_bool& flag){
+            while (flag)
+            {
+                this->WriteFilledBuffer();
+            }
+        })
+    {
+        buffers_count = std::max(buffers_count, 2u);
+        for (auto buffer_index = 0u; buffer_index < buffers_count; ++buffer_index)
+        {
+            FreeBuffers.emplace_back(std::make_unique<AlignedBuffer>(BufferSize));
+        }
+    }
+
+    /// Stop recording.
+    Recorder::~Recorder()
+    {
+        Stop();
+    }
+
+    /// Start recording.
+    void Recorder::Start(const std::string& path_prefix, const std::string& device_name,
+                         const std::vector<std::tuple<SwapChain*, std::string>>& pictures,
+                         std::uint64_t segment_size)
+    {
+        if (std::atomic_load(&CurrentSession)) throw std::logic_error("Recorder is already started.");
+        if (pictures.empty()) throw std::invalid_argument("No picture to record.");
+        if (pictures.size() > Recording::MaxPicturesCount)
+            throw std::invalid_argument("Too many pictures to record, at most " +
+                std::to_string(Recording::MaxPicturesCount) + " pictures are supported.");
+
+        // The session is immutable once it is published, except for its queue of pending frames.
+        auto session = std::make_shared<Session>();
+        for (const auto& [chain, format] : pictures)
+        {
+            session->Chains.push_back(chain);
+            session->Formats.push_back(format);
+            // Frames queued more than the blocks count would have been overwritten before they are copied.
+            session->PendingCapacity += chain->GetMaxBlocksCount() - 1;
+        }
+        session->DeviceName = device_name;
+        session->PathPrefix = path_prefix;
+        session->SegmentSizeLimit = segment_size;
+        session->RecordingTimestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        SegmentIndex = 0;
+        RecordedFramesCount = 0;
+        DroppedFramesCount = 0;
+
+        OpenSegment(*session);
+
+        std::atomic_store(&CurrentSession, session);
+        Writer.Start();
+        Copier.Start();
+        RecordingFlag = true;
+    }
+
+    /// Stop recording.
+    void Recorder::Stop()
+    {
+        auto session = std::atomic_exchange(&CurrentSession, std::shared_ptr<Session>());
+        if (!session) return;
+        RecordingFlag = false;
+        Copier.Stop();
+
+        // Write remaining frames and finish the last segment.
+        // Committing threads may still hold the session and enqueue frames, which are discarded with it.
+        while (CopyPendingFrame(*session))
+        {}
+        if (Segment) FinishSegment();
+
+        std::unique_lock lock(BuffersMutex);
+        BuffersCondition.wait(lock, [this]{
+            return FilledBuffers.empty() && WritingBuffersCount == 0;
+        });
+        lock.unlock();
+        Writer.Stop();
+    }
+
+    /// Enqueue a committed frame.
+    void Recorder::OnPictureCommitted(SwapChain& chain, unsigned int block_id, const FrameMetadata& metadata)
+    {
+        if (!RecordingFlag) return;
+        auto session = std::atomic_load(&CurrentSession);
+        if (!session) return;
+        const auto& chains = session->Chains;
+        auto finder = std::find(chains.begin(), chains.end(), &chain);
+        if (finder == chains.end()) return;
+
+        PendingFrame frame {static_cast<unsigned int>(finder - chains.begin()), block_id,
+                            chain.GetCommittedCount(), metadata};
+        std::unique_lock lock(session->PendingMutex);
+        if (session->PendingFrames.size() >= session->PendingCapacity)
+        {
+            ++DroppedFramesCount;
+            return;
+        }
+        session->PendingFrames.push_back(frame);
+        lock.unlock();
+        session->PendingCondition.notify_one();
+    }
+
+    /// Copy a pending frame into the filling buffer.
+    bool Recorder::CopyPendingFrame(Session& session)
+    {
+        std::unique_lock lock(session.PendingMutex);
+        if (!session.PendingCondition.wait_for(lock, std::chrono::milliseconds(100), [&session]{
+            return !session.PendingFrames.empty();
+        })) return false;
+        auto frame = session.PendingFrames.front();
+        session.PendingFrames.pop_front();
+        lock.unlock();
+
+        auto* chain = session.Chains[frame.PictureIndex];
+        auto& block = chain->GetBlock(frame.BlockID);
+        auto payload_size = chain->GetPictureSize();
+        if (payload_size > static_cast<std::size_t>(block.GetMaxSize()))
+        {
+            ++DroppedFramesCount;
+            return true;
+        }
+
+        if (!Segment)
+        {
+            try
+            {
+                OpenSegment(session);
+            }catch (std::runtime_error& error)
+            {
+                // The error is already logged, stop enqueueing frames which can not be written.
+                RecordingFlag = false;
+                ++DroppedFramesCount;
+                return true;
+            }
+        }
+        auto record_size = Recording::AlignRecordSize(sizeof(Recording::FrameHeader) + payload_size);
+        auto* record = ReserveBuffer(record_size);
+
+        Recording::FrameHeader frame_header {};
+        frame_header.Magic = Recording::FrameMagic;
+        frame_header.PictureIndex = frame.PictureIndex;
+        frame_header.Sequence = frame.Sequence;
+        frame_header.Timestamp = frame.Metadata.Timestamp;
+        frame_header.MonotonicTimestamp = frame.Metadata.MonotonicTimestamp;
+        frame_header.DeviceTimestamp = frame.Metadata.DeviceTimestamp;
+        frame_header.Exposure = frame.Metadata.Exposure;
+        frame_header.Gain = frame.Metadata.Gain;
+        frame_header.PixelType = chain->GetPixelType();
+        frame_header.Width = chain->GetHeader().Width;
+        frame_header.Height = chain->GetHeader().Height;
+        frame_header.PayloadSize = payload_size;
+        std::memcpy(record, &frame_header, sizeof(Recording::FrameHeader));
+        // Recordings keep rows packed, padding of aligned rows is dropped.
+        chain->CopyPacked(frame.BlockID, record + sizeof(Recording::FrameHeader));
+        std::memset(record + sizeof(Recording::FrameHeader) + payload_size, 0,
+                    record_size - sizeof(Recording::FrameHeader) - payload_size);
+
+        // The writer starts to overwrite the block once the writing index wraps around to it.
+        if (chain->GetCommittedCount() - frame.Sequence + 1 >= chain->GetSafeDepth())
+        {
+            ++DroppedFramesCount;
+            return true;
+        }
+
+        FillingBuffer->Size += record_size;
+        SegmentEntries.push_back({SegmentOffset, frame.Sequence, frame.Metadata.Timestamp,
+                                  frame.Metadata.MonotonicTimestamp, frame.Metadata.DeviceTimestamp,
+                                  frame.PictureIndex, 0});
+        SegmentOffset += record_size;
+        ++RecordedFramesCount;
+
+        if (SegmentOffset >= session.SegmentSizeLimit)
+        {
+            FinishSegment();
+        }
+        return true;
+    }
+
+    /// Write a filled buffer into its segment file.
+    bool Recorder::WriteFilledBuffer()
+    {
+        std::unique_lock lock(BuffersMutex);
+        if (!BuffersCondition.wait_for(lock, std::chrono::milliseconds(100), [this]{
+            return !FilledBuffers.empty();
+        })) return false;
+        auto buffer = std::move(FilledBuffers.front());
+        FilledBuffers.pop_front();
+        ++WritingBuffersCount;
+        lock.unlock();
+
+        auto descriptor = buffer->File->Descriptor;
+        std::size_t written_size = 0;
+        while (written_size < buffer->Size)
+        {
+            auto result = pwrite(descriptor, buffer->Data + written_size, buffer->Size - written_size,
+                                 static_cast<off_t>(buffer->Offset + written_size));
+            if (result < 0)
+            {
+                auto error = errno;
+                if (error == EINTR) continue;
+                #ifdef O_DIRECT
+                // Some file systems accept O_DIRECT on open but reject direct writes.
+                auto flags = fcntl(descriptor, F_GETFL);
+                if (error == EINVAL && flags >= 0 && (flags & O_DIRECT))
+                {
+                    fcntl(descriptor, F_SETFL, flags & ~O_DIRECT);
+                    Logger->RecordWarning("Direct I/O is rejected by " + buffer->File->Path +
+                                          ", buffered I/O is used.");
+                    continue;
+                }
+                #endif
+                Logger->RecordError("Failed to write recording " + buffer->File->Path + ": " +
+                                    std::strerror(error));
+                RecordingFlag = false;
+                break;
+            }
+            written_size += static_cast<std::size_t>(result);
+        }
+
+        buffer->File.reset();
+        buffer->Size = 0;
+        lock.lock();
+        FreeBuffers.push_back(std::move(buffer));
+        --WritingBuffersCount;
+        lock.unlock();
+        BuffersCondition.notify_all();
+        return true;
+    }
+
+    /// Open a new segment file.
+    void Recorder::OpenSegment(const Session& session)
+    {
+        auto path = session.PathPrefix + "." + std::to_string(SegmentIndex) + ".gcr";
+        int descriptor = -1;
+        #ifdef O_DIRECT
+        descriptor = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        if (descriptor < 0 && errno == EINVAL)
+        {
+            Logger->RecordWarning("Direct I/O is not supported for " + path + ", buffered I/O is used.");
+        }
+        #endif
+        if (descriptor < 0)
+        {
+            descriptor = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        }
+        if (descriptor < 0)
+        {
+            auto message = "Failed to create recording " + path + ": " + std::strerror(errno);
+            Logger->RecordError(message);
+            throw std::runtime_error(message);
+        }
+
+        Segment = std::make_shared<SegmentFile>();
+        Segment->Descriptor = descriptor;
+        Segment->Path = path;
+        SegmentOffset = 0;
+        SegmentEntries.clear();
+
+        auto* block = ReserveBuffer(Recording::RecordAlignment);
+        std::memset(block, 0, Recording::RecordAlignment);
+        std::vector<std::tuple<std::string, std::string>> pictures;
+        for (std::size_t picture_index = 0; picture_index < session.Chains.size(); ++picture_index)
+        {
+            pictures.emplace_back(session.Chains[picture_index]->GetPictureName(), session.Formats[picture_index]);
+        }
+        Recording::FillSegmentHeader(*reinterpret_cast<Recording::SegmentHeader*>(block), SegmentIndex,
+                                     session.RecordingTimestamp, session.DeviceName, pictures);
+        FillingBuffer->Size += Recording::RecordAlignment;
+        SegmentOffset += Recording::RecordAlignment;
+    }
+
+    /// Append the index and the footer, and close the segment.
+    void Recorder::FinishSegment()
+    {
+        auto index_offset = SegmentOffset;
+        auto entries_size = SegmentEntries.size() * sizeof(Recording::IndexEntry);
+        auto index_size = Recording::AlignRecordSize(entries_size);
+        const auto* entries = reinterpret_cast<const std::uint8_t*>(SegmentEntries.data());
+        std::size_t appended_size = 0;
+        while (appended_size < index_size)
+        {
+            auto chunk_size = std::min(index_size - appended_size, BufferSize);
+            auto* chunk = ReserveBuffer(chunk_size);
+            auto copy_size = appended_size < entries_size ? std::min(chunk_size, entries_size - appended_size) : 0;
+            std::memcpy(chunk, entries + appended_size, copy_size);
+            std::memset(chunk + copy_size, 0, chunk_size - copy_size);
+            FillingBuffer->Size += chunk_size;
+            SegmentOffset += chunk_size;
+            appended_size += chunk_size;
+        }
+
+        auto* block = ReserveBuffer(Recording::RecordAlignment);
+        std::memset(block, 0, Recording::RecordAlignment);
+        auto* footer = reinterpret_cast<Recording::Footer*>(block);
+        footer->Magic = Recording::FooterMagic;
+        footer->Version = Recording::FormatVersion;
+        footer->IndexOffset = index_offset;
+        footer->EntriesCount = SegmentEntries.size();
+        FillingBuffer->Size += Recording::RecordAlignment;
+        SegmentOffset += Recording::RecordAlignment;
+
+        SubmitFillingBuffer();
+        Segment.reset();
+        SegmentEntries.clear();
+        ++SegmentIndex;
+    }
+
+    /// Reserve space in the filling buffer.
+    std::uint8_t* Recorder::ReserveBuffer(std::size_t size)
+    {
+        if (FillingBuffer && FillingBuffer->File == Segment && FillingBuffer->Capacity - FillingBuffer->Size >= size)
+        {
+            return FillingBuffer->Data + FillingBuffer->Size;
+        }
+        SubmitFillingBuffer();
+
+        std::unique_lock lock(BuffersMutex);
+        BuffersCondition.wait(lock, [this]{
+            return !FreeBuffers.empty();
+        });
+        FillingBuffer = std::move(FreeBuffers.back());
+        FreeBuffers.pop_back();
+        lock.unlock();
+
+        if (FillingBuffer->Capacity < size)
+        {
+            FillingBuffer = std::make_unique<AlignedBuffer>(size);
+        }
+        FillingBuffer->Size = 0;
+        FillingBuffer->Offset = SegmentOffset;
+        FillingBuffer->File = Segment;
+        return FillingBuffer->Data;
+    }
+
+    /// Hand the filling buffer to the writer thread.
+    void Recorder::SubmitFillingBuffer()
+    {
+        if (!FillingBuffer) return;
+        std::unique_lock lock(BuffersMutex);
+        if (FillingBuffer->Size == 0)
+        {
+            FillingBuffer->File.reset();
+            FreeBuffers.push_back(std::move(FillingBuffer));
+        }
+        else
+        {
+            FilledBuffers.push_back(std::move(FillingBuffer));
+        }
+        lock.unlock();
+        BuffersCondition.notify_all();
+    }
+}
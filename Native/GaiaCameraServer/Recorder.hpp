@@ -0,0 +1,199 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <GaiaBackground/GaiaBackground.hpp>
+#include <GaiaLogClient/GaiaLogClient.hpp>
+
+#include "SwapChain.hpp"
+#include "PictureObserver.hpp"
+#include "RecordingFormat.hpp"
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Recorder which appends committed frames of swap chains to segmented recording files.
+     * @details
+     *  Committing threads only enqueue the block ID of committed frames.
+     *  A copier thread copies frames out of swap chain blocks into large aligned buffers,
+     *  and a writer thread writes filled buffers to the segment file with direct I/O,
+     *  so capture is never blocked by the disk.
+     *  Frames whose blocks are overwritten before they are copied, or which can not be enqueued
+     *  because the recorder falls behind, are dropped and counted.
+     *  The layout of segment files is described in RecordingFormat.hpp.
+     */
+    class Recorder : public PictureObserver
+    {
+    private:
+        /// Frame waiting to be copied.
+        struct PendingFrame
+        {
+            unsigned int PictureIndex;
+            unsigned int BlockID;
+            unsigned long Sequence;
+            FrameMetadata Metadata;
+        };
+
+        /// Segment file shared by the buffers written into it, closed when the last buffer is written.
+        struct SegmentFile
+        {
+            int Descriptor {-1};
+            std::string Path;
+            ~SegmentFile();
+        };
+
+        /// Buffer aligned for direct I/O.
+        struct AlignedBuffer
+        {
+            std::uint8_t* Data {nullptr};
+            std::size_t Capacity {0};
+            std::size_t Size {0};
+            /// Offset of the buffer in the segment file.
+            std::uint64_t Offset {0};
+            std::shared_ptr<SegmentFile> File;
+
+            explicit AlignedBuffer(std::size_t capacity);
+            ~AlignedBuffer();
+            AlignedBuffer(const AlignedBuffer&) = delete;
+            AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+        };
+
+        /// Recording session, shared by the controlling thread, committing threads and the copier thread.
+        struct Session
+        {
+            /// Swap chains of recorded pictures, the index is the picture index in segment headers.
+            std::vector<SwapChain*> Chains;
+            /// Formats of recorded pictures.
+            std::vector<std::string> Formats;
+            /// Name of the recorded device.
+            std::string DeviceName;
+            /// Path prefix of segment files.
+            std::string PathPrefix;
+            /// Creation time of the recording in nanoseconds since epoch.
+            std::uint64_t RecordingTimestamp {0};
+            /// Max size of a segment file in bytes.
+            std::uint64_t SegmentSizeLimit {0};
+            /// Max count of pending frames.
+            std::size_t PendingCapacity {0};
+
+            /// Mutex for pending frames.
+            std::mutex PendingMutex;
+            /// Notified when a frame is enqueued.
+            std::condition_variable PendingCondition;
+            /// Frames waiting to be copied.
+            std::deque<PendingFrame> PendingFrames;
+        };
+
+        /// Logger of the host server.
+        LogService::LogClient* Logger;
+
+        /// Whether committed frames should be enqueued or not.
+        std::atomic_bool RecordingFlag {false};
+
+        /// Snapshot of the current session, nullptr if recording is not started, replaced by the controlling thread.
+        std::shared_ptr<Session> CurrentSession;
+
+        /// Mutex for buffers.
+        std::mutex BuffersMutex;
+        /// Notified when a buffer is filled or returned.
+        std::condition_variable BuffersCondition;
+        /// Default size of aligned buffers.
+        std::size_t BufferSize;
+        /// Buffers which are ready to be filled.
+        std::vector<std::unique_ptr<AlignedBuffer>> FreeBuffers;
+        /// Buffers which are waiting to be written.
+        std::deque<std::unique_ptr<AlignedBuffer>> FilledBuffers;
+        /// Count of buffers being written by the writer thread.
+        unsigned int WritingBuffersCount {0};
+
+        /// Buffer being filled by the copier thread.
+        std::unique_ptr<AlignedBuffer> FillingBuffer;
+        /// Segment file being filled.
+        std::shared_ptr<SegmentFile> Segment;
+        /// Index of the segment being filled.
+        std::uint32_t SegmentIndex {0};
+        /// Offset of the next record in the segment being filled.
+        std::uint64_t SegmentOffset {0};
+        /// Index entries of the segment being filled.
+        std::vector<Recording::IndexEntry> SegmentEntries;
+
+        /// Count of recorded frames.
+        std::atomic<unsigned long> RecordedFramesCount {0};
+        /// Count of dropped frames.
+        std::atomic<unsigned long> DroppedFramesCount {0};
+
+        /// Background thread which copies frames into buffers.
+        Background::BackgroundWorker Copier;
+        /// Background thread which writes buffers into files.
+        Background::BackgroundWorker Writer;
+
+        /// Copy a pending frame of the session, return false if no frame is pending.
+        bool CopyPendingFrame(Session& session);
+        /// Write a filled buffer, return false if no buffer is filled before the timeout.
+        bool WriteFilledBuffer();
+
+        /// Open a new segment file of the session and append its header.
+        void OpenSegment(const Session& session);
+        /// Append the index and the footer of the segment being filled.
+        void FinishSegment();
+        /// Reserve space in the filling buffer, and hand the filling buffer to the writer if it is not enough.
+        std::uint8_t* ReserveBuffer(std::size_t size);
+        /// Hand the filling buffer to the writer thread.
+        void SubmitFillingBuffer();
+
+    public:
+        /**
+         * @brief Construct the recorder.
+         * @param logger Logger of the host server.
+         * @param buffer_size Size of every aligned buffer in bytes, enlarged to fit a frame if it is too small.
+         * @param buffers_count Count of aligned buffers, at least 2.
+         */
+        explicit Recorder(LogService::LogClient* logger,
+                          std::size_t buffer_size = 16 * 1024 * 1024, unsigned int buffers_count = 4);
+        /// Stop recording.
+        ~Recorder() override;
+
+        Recorder(const Recorder&) = delete;
+        Recorder& operator=(const Recorder&) = delete;
+
+        /**
+         * @brief Start recording.
+         * @param path_prefix Path prefix of segment files, such as "/data/daheng_camera.0.20210101-120000".
+         * @param device_name Name of the camera device.
+         * @param pictures List of tuples, first is the swap chain of the picture, second is its color format.
+         * @param segment_size Max size of a segment file in bytes.
+         * @throw std::runtime_error If the first segment file can not be created.
+         */
+        void Start(const std::string& path_prefix, const std::string& device_name,
+                   const std::vector<std::tuple<SwapChain*, std::string>>& pictures, std::uint64_t segment_size);
+        /// Stop recording, pending frames will be written and the last segment will be finished.
+        void Stop();
+
+        /// Whether this recorder is recording or not.
+        [[nodiscard]] inline bool IsRecording() const noexcept
+        {
+            return RecordingFlag;
+        }
+
+        /// Enqueue a committed frame, frames of pictures not being recorded are ignored.
+        void OnPictureCommitted(SwapChain& chain, unsigned int block_id, const FrameMetadata& metadata) override;
+
+        /// Get the count of recorded frames since recording starts.
+        [[nodiscard]] inline unsigned long GetRecordedFramesCount() const noexcept
+        {
+            return RecordedFramesCount;
+        }
+        /// Get the count of dropped frames since recording starts.
+        [[nodiscard]] inline unsigned long GetDroppedFramesCount() const noexcept
+        {
+            return DroppedFramesCount;
+        }
+    };
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace Gaia::CameraService::Recording
+{
+    /**
+     * @brief Layout of recording segment files.
+     * @details
+     *  A segment file is a sequence of blocks aligned to RecordAlignment:
+     *  a segment header, frame records, an index of all frame records and a footer in the last aligned block.
+     *  Every frame record is a record header immediately followed by the raw pixels of the frame,
+     *  padded to the alignment, so records can be written with direct I/O and mapped without copying.
+     *  Readers locate the footer at (file size - RecordAlignment), and then the index through it.
+     *  A segment without a valid footer is truncated, its records can still be recovered by scanning headers.
+     */
+
+    /// Alignment of all blocks in a segment file, compatible with direct I/O on common devices.
+    constexpr std::size_t RecordAlignment = 4096;
+
+    /// Magic number of segment headers, "GCRS".
+    constexpr std::uint32_t SegmentMagic = 0x53524347;
+    /// Magic number of frame record headers, "GCRF".
+    constexpr std::uint32_t FrameMagic = 0x46524347;
+    /// Magic number of footers, "GCRI".
+    constexpr std::uint32_t FooterMagic = 0x49524347;
+    /// Version of the layout.
+    constexpr std::uint32_t FormatVersion = 2;
+
+    /// Max count of pictures in a recording.
+    constexpr std::size_t MaxPicturesCount = 16;
+    /// Max length of names, including the terminating zero.
+    constexpr std::size_t MaxNameLength = 64;
+
+    /// Description of a recorded picture.
+    struct PictureDescription
+    {
+        /// Name of the picture, zero terminated.
+        char Name[MaxNameLength];
+        /// Color format of the picture, such as "BGR", zero terminated.
+        char Format[MaxNameLength];
+    };
+
+    /// Header at the beginning of a segment file.
+    struct SegmentHeader
+    {
+        std::uint32_t Magic;
+        std::uint32_t Version;
+        /// Index of this segment in the recording, beginning from 0.
+        std::uint32_t SegmentIndex;
+        /// Count of valid entries in Pictures.
+        std::uint32_t PicturesCount;
+        /// Creation time of the recording in nanoseconds since epoch.
+        std::uint64_t RecordingTimestamp;
+        /// Name of the camera device, zero terminated.
+        char DeviceName[MaxNameLength];
+        /// Descriptions of recorded pictures, frame records refer to them by index.
+        PictureDescription Pictures[MaxPicturesCount];
+    };
+    static_assert(sizeof(SegmentHeader) <= RecordAlignment, "Segment header must fit in one aligned block.");
+
+    /// Header of a frame record, followed by the raw pixels.
+    struct FrameHeader
+    {
+        std::uint32_t Magic;
+        /// Index of the picture in the segment header.
+        std::uint32_t PictureIndex;
+        /// Sequence number of the frame in its swap chain.
+        std::uint64_t Sequence;
+        /// Capture time of the frame in nanoseconds since epoch.
+        std::uint64_t Timestamp;
+        /// Capture time of the frame in CLOCK_MONOTONIC_RAW nanoseconds of the recording host.
+        std::uint64_t MonotonicTimestamp;
+        /// Capture time stamped by the device in device ticks, 0 if the device does not provide one.
+        std::uint64_t DeviceTimestamp;
+        /// Exposure time in microseconds when the frame is captured.
+        std::uint32_t Exposure;
+        /// OpenCV type of the pixels, such as CV_8UC3.
+        std::int32_t PixelType;
+        /// Digital gain when the frame is captured.
+        double Gain;
+        std::uint32_t Width;
+        std::uint32_t Height;
+        /// Size of the raw pixels in bytes, rows are tightly packed.
+        std::uint64_t PayloadSize;
+    };
+
+    /// Entry of the trailing index.
+    struct IndexEntry
+    {
+        /// Offset of the frame record in the segment file.
+        std::uint64_t Offset;
+        std::uint64_t Sequence;
+        std::uint64_t Timestamp;
+        std::uint64_t MonotonicTimestamp;
+        std::uint64_t DeviceTimestamp;
+        std::uint32_t PictureIndex;
+        std::uint32_t Reserved;
+    };
+
+    /// Footer in the last aligned block of a segment file.
+    struct Footer
+    {
+        std::uint32_t Magic;
+        std::uint32_t Version;
+        /// Offset of the index in the segment file.
+        std::uint64_t IndexOffset;
+        /// Count of entries in the index.
+        std::uint64_t EntriesCount;
+    };
+
+    /// Copy the text into a fixed length zero terminated name field, longer text is truncated.
+    inline void CopyName(char (&field)[MaxNameLength], const std::string& text)
+    {
+        auto length = text.size() < MaxNameLength - 1 ? text.size() : MaxNameLength - 1;
+        std::memcpy(field, text.data(), length);
+        field[length] = '\0';
+    }
+
+    /**
+     * @brief Fill the header of a segment.
+     * @param header Header to fill, which should be zero initialized.
+     * @param pictures List of tuples, first is picture name, second is its color format.
+     */
+    inline void FillSegmentHeader(SegmentHeader& header, std::uint32_t segment_index,
+                                  std::uint64_t recording_timestamp, const std::string& device_name,
+                                  const std::vector<std::tuple<std::string, std::string>>& pictures)
+    {
+        header.Magic = SegmentMagic;
+        header.Version = FormatVersion;
+        header.SegmentIndex = segment_index;
+        header.PicturesCount = static_cast<std::uint32_t>(
+                pictures.size() < MaxPicturesCount ? pictures.size() : MaxPicturesCount);
+        header.RecordingTimestamp = recording_timestamp;
+        CopyName(header.DeviceName, device_name);
+        for (std::uint32_t picture_index = 0; picture_index < header.PicturesCount; ++picture_index)
+        {
+            CopyName(header.Pictures[picture_index].Name, std::get<0>(pictures[picture_index]));
+            CopyName(header.Pictures[picture_index].Format, std::get<1>(pictures[picture_index]));
+        }
+    }
+
+    /// Round the size up to the record alignment.
+    constexpr std::size_t AlignRecordSize(std::size_t size)
+    {
+        return (size + RecordAlignment - 1) / RecordAlignment * RecordAlignment;
+    }
+}
@@ -0,0 +1,155 @@
+#include "RecordingReader.hpp"
+
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace Gaia::CameraService
+{
+    namespace
+    {
+        /// Round the offset down to the page size, memory advices require page aligned addresses.
+        std::uint64_t AlignToPage(std::uint64_t offset)
+        {
+            static const auto page_size = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+            return offset / page_size * page_size;
+        }
+    }
+
+    /// Map the segment file.
+    RecordingReader::RecordingReader(std::string path) : Path(std::move(path))
+    {
+        Descriptor = open(Path.c_str(), O_RDONLY);
+        if (Descriptor < 0)
+            throw std::runtime_error("Failed to open recording " + Path + ": " + std::strerror(errno));
+        struct stat status {};
+        if (fstat(Descriptor, &status) != 0 ||
+            static_cast<std::size_t>(status.st_size) < Recording::RecordAlignment)
+        {
+            close(Descriptor);
+            throw std::runtime_error("Recording " + Path + " is too small.");
+        }
+        Size = static_cast<std::size_t>(status.st_size);
+
+        auto* address = mmap(nullptr, Size, PROT_READ, MAP_SHARED, Descriptor, 0);
+        if (address == MAP_FAILED)
+        {
+            auto error = errno;
+            close(Descriptor);
+            throw std::runtime_error("Failed to map recording " + Path + ": " + std::strerror(error));
+        }
+        Data = static_cast<const std::uint8_t*>(address);
+        madvise(address, Size, MADV_SEQUENTIAL);
+
+        Header = reinterpret_cast<const Recording::SegmentHeader*>(Data);
+        if (Header->Magic != Recording::SegmentMagic || Header->Version != Recording::FormatVersion ||
+            Header->PicturesCount > Recording::MaxPicturesCount)
+        {
+            munmap(address, Size);
+            close(Descriptor);
+            throw std::runtime_error("File " + Path + " is not a compatible recording segment.");
+        }
+
+        if (!LoadIndex())
+        {
+            ScanRecords();
+        }
+    }
+
+    /// Unmap the segment file.
+    RecordingReader::~RecordingReader()
+    {
+        munmap(const_cast<std::uint8_t*>(Data), Size);
+        close(Descriptor);
+    }
+
+    /// Find paths of all segments of a recording.
+    std::vector<std::string> RecordingReader::FindSegments(const std::string &path_prefix)
+    {
+        std::vector<std::string> paths;
+        for (unsigned int segment_index = 0;; ++segment_index)
+        {
+            auto path = path_prefix + "." + std::to_string(segment_index) + ".gcr";
+            struct stat status {};
+            if (stat(path.c_str(), &status) != 0) break;
+            paths.push_back(path);
+        }
+        return paths;
+    }
+
+    /// Load the trailing index.
+    bool RecordingReader::LoadIndex()
+    {
+        const auto* footer = reinterpret_cast<const Recording::Footer*>(Data + Size - Recording::RecordAlignment);
+        if (footer->Magic != Recording::FooterMagic || footer->Version != Recording::FormatVersion) return false;
+        if (footer->IndexOffset > Size ||
+            footer->EntriesCount > (Size - footer->IndexOffset) / sizeof(Recording::IndexEntry)) return false;
+
+        const auto* entries = reinterpret_cast<const Recording::IndexEntry*>(Data + footer->IndexOffset);
+        Entries.assign(entries, entries + footer->EntriesCount);
+        for (const auto& entry : Entries)
+        {
+            if (entry.Offset + sizeof(Recording::FrameHeader) > footer->IndexOffset) return false;
+        }
+        return true;
+    }
+
+    /// Index frames by scanning frame records.
+    void RecordingReader::ScanRecords()
+    {
+        Entries.clear();
+        std::uint64_t offset = Recording::RecordAlignment;
+        while (offset + sizeof(Recording::FrameHeader) <= Size)
+        {
+            const auto* frame = reinterpret_cast<const Recording::FrameHeader*>(Data + offset);
+            if (frame->Magic != Recording::FrameMagic || frame->PictureIndex >= Header->PicturesCount) break;
+            auto record_size = Recording::AlignRecordSize(sizeof(Recording::FrameHeader) + frame->PayloadSize);
+            if (offset + record_size > Size) break;
+            Entries.push_back({offset, frame->Sequence, frame->Timestamp, frame->MonotonicTimestamp,
+                               frame->DeviceTimestamp, frame->PictureIndex, 0});
+            offset += record_size;
+        }
+    }
+
+    /// Get the header of the frame record.
+    const Recording::FrameHeader& RecordingReader::GetFrameHeader(const Recording::IndexEntry &entry) const
+    {
+        return *reinterpret_cast<const Recording::FrameHeader*>(Data + entry.Offset);
+    }
+
+    /// Get raw pixels of the frame record.
+    const std::uint8_t* RecordingReader::GetFramePixels(const Recording::IndexEntry &entry) const
+    {
+        return Data + entry.Offset + sizeof(Recording::FrameHeader);
+    }
+
+    /// Advise the kernel to read frame records ahead.
+    void RecordingReader::Prefetch(std::size_t begin_entry, std::size_t end_entry) const
+    {
+        if (end_entry > Entries.size()) end_entry = Entries.size();
+        if (begin_entry >= end_entry) return;
+        auto begin_offset = AlignToPage(Entries[begin_entry].Offset);
+        const auto& last_entry = Entries[end_entry - 1];
+        auto end_offset = last_entry.Offset + Recording::AlignRecordSize(
+                sizeof(Recording::FrameHeader) + GetFrameHeader(last_entry).PayloadSize);
+        madvise(const_cast<std::uint8_t*>(Data) + begin_offset, end_offset - begin_offset, MADV_WILLNEED);
+    }
+
+    /// Advise the kernel that frame records will not be read soon.
+    void RecordingReader::Release(std::size_t begin_entry, std::size_t end_entry) const
+    {
+        if (end_entry > Entries.size()) end_entry = Entries.size();
+        if (begin_entry >= end_entry) return;
+        auto begin_offset = AlignToPage(Entries[begin_entry].Offset);
+        auto end_offset = AlignToPage(end_entry < Entries.size() ? Entries[end_entry].Offset : Entries.back().Offset);
+        if (end_offset <= begin_offset) return;
+        // Drop pages from the page cache as well, played frames of long recordings would otherwise evict others.
+        madvise(const_cast<std::uint8_t*>(Data) + begin_offset, end_offset - begin_offset, MADV_DONTNEED);
+        posix_fadvise(Descriptor, static_cast<off_t>(begin_offset), static_cast<off_t>(end_offset - begin_offset),
+                      POSIX_FADV_DONTNEED);
+    }
+}
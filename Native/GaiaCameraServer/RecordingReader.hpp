@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "RecordingFormat.hpp"
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Reader of a recording segment file, which is mapped into memory.
+     * @details
+     *  Frames are accessed through the trailing index of the segment,
+     *  a segment without a valid footer, for example left by a crashed recorder,
+     *  is indexed by scanning its frame records instead.
+     *  The mapping is advised to be read sequentially, and readers can prefetch frames ahead
+     *  and release frames behind, so long recordings stream through the page cache.
+     */
+    class RecordingReader
+    {
+    private:
+        /// Path of the segment file.
+        const std::string Path;
+        /// Descriptor of the segment file.
+        int Descriptor {-1};
+        /// Address of the mapped file.
+        const std::uint8_t* Data {nullptr};
+        /// Size of the mapped file in bytes.
+        std::size_t Size {0};
+        /// Header of the segment.
+        const Recording::SegmentHeader* Header {nullptr};
+        /// Index entries of all frames in the segment.
+        std::vector<Recording::IndexEntry> Entries;
+
+        /// Load the trailing index, return false if the footer or the index is invalid.
+        bool LoadIndex();
+        /// Index frames by scanning frame records.
+        void ScanRecords();
+
+    public:
+        /**
+         * @brief Map the segment file.
+         * @param path Path of the segment file.
+         * @throw std::runtime_error If the file can not be mapped or it is not a recording segment.
+         */
+        explicit RecordingReader(std::string path);
+        /// Unmap the segment file.
+        ~RecordingReader();
+
+        RecordingReader(const RecordingReader&) = delete;
+        RecordingReader& operator=(const RecordingReader&) = delete;
+
+        /**
+         * @brief Find paths of all segments of a recording.
+         * @param path_prefix Path prefix of segment files, segments are named "{path_prefix}.{index}.gcr".
+         * @return Paths of existing segments in order, stops at the first missing index.
+         */
+        static std::vector<std::string> FindSegments(const std::string& path_prefix);
+
+        /// Get the path of the segment file.
+        [[nodiscard]] inline const std::string& GetPath() const noexcept
+        {
+            return Path;
+        }
+
+        /// Get the header of the segment.
+        [[nodiscard]] inline const Recording::SegmentHeader& GetHeader() const noexcept
+        {
+            return *Header;
+        }
+
+        /// Get index entries of all frames in the segment, in recording order.
+        [[nodiscard]] inline const std::vector<Recording::IndexEntry>& GetEntries() const noexcept
+        {
+            return Entries;
+        }
+
+        /// Get the header of the frame record referred by the given entry.
+        [[nodiscard]] const Recording::FrameHeader& GetFrameHeader(const Recording::IndexEntry& entry) const;
+        /// Get raw pixels of the frame record referred by the given entry.
+        [[nodiscard]] const std::uint8_t* GetFramePixels(const Recording::IndexEntry& entry) const;
+
+        /// Advise the kernel to read frame records in the given range of entries ahead.
+        void Prefetch(std::size_t begin_entry, std::size_t end_entry) const;
+        /// Advise the kernel that frame records in the given range of entries will not be read soon.
+        void Release(std::size_t begin_entry, std::size_t end_entry) const;
+    };
+}
@@ -0,0 +1,148 @@
+#include "RegionCropper.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "ColorFormat.hpp"
+
+namespace Gaia::CameraService
+{
+    /// Bind the logger, the committer and the factory.
+    RegionCropper::RegionCropper(LogService::LogClient *logger, Committer committer, Factory factory) :
+        Logger(logger), Commit(std::move(committer)), MakeChain(std::move(factory)),
+        Regions(std::make_shared<const RegionList>())
+    {}
+
+    /// Add a region.
+    SwapChain& RegionCropper::AddRegion(const std::string &name, SwapChain &source, const std::string &source_format,
+                                        cv::Rect area, double scale)
+    {
+        std::unique_lock lock(RegionsMutex);
+        // Shared blocks of an existing region must not be recreated.
+        if (HasRegion(name)) throw std::invalid_argument("Region " + name + " already exists.");
+
+        const auto& source_header = source.GetHeader();
+        if (GetBayerLayout(source_format))
+        {
+            // Even offsets and sizes keep the quad layout, so the region has the same format as the source.
+            area.width += area.x % 2;
+            area.height += area.y % 2;
+            area.x -= area.x % 2;
+            area.y -= area.y % 2;
+            area.width -= area.width % 2;
+            area.height -= area.height % 2;
+            if (scale != 1.0)
+            {
+                Logger->RecordWarning("Region " + name + " of Bayer picture " + source.GetPictureName() +
+                                      " can not be scaled, it is cropped only.");
+                scale = 1.0;
+            }
+        }
+        area &= cv::Rect(0, 0, static_cast<int>(source_header.Width), static_cast<int>(source_header.Height));
+        if (area.empty())
+            throw std::invalid_argument("Region " + name + " is outside of picture " + source.GetPictureName() + ".");
+        if (scale <= 0.0) throw std::invalid_argument("Scale of region " + name + " must be positive.");
+
+        auto region = std::make_shared<Region>();
+        region->Name = name;
+        region->Source = &source;
+        region->Area = area;
+        region->Size = cv::Size(std::max(1, static_cast<int>(std::lround(area.width * scale))),
+                                std::max(1, static_cast<int>(std::lround(area.height * scale))));
+        auto header = source_header;
+        header.Width = static_cast<unsigned int>(region->Size.width);
+        header.Height = static_cast<unsigned int>(region->Size.height);
+        auto block_size = static_cast<long>(region->Size.area()) * CV_ELEM_SIZE(source.GetPixelType());
+        region->Chain = MakeChain(name, header, block_size, source.GetBlocksCount(), source.GetRowAlignment());
+        auto& chain = *region->Chain;
+
+        auto regions = std::make_shared<RegionList>(*Regions);
+        regions->push_back(std::move(region));
+        std::atomic_store(&Regions, std::shared_ptr<const RegionList>(std::move(regions)));
+        return chain;
+    }
+
+    /// Remove a region.
+    bool RegionCropper::RemoveRegion(const std::string &name)
+    {
+        std::unique_lock lock(RegionsMutex);
+        auto regions = std::make_shared<RegionList>(*Regions);
+        auto finder = std::find_if(regions->begin(), regions->end(),
+                                   [&name](const std::shared_ptr<Region>& region){
+            return region->Name == name;
+        });
+        if (finder == regions->end()) return false;
+        regions->erase(finder);
+        std::atomic_store(&Regions, std::shared_ptr<const RegionList>(std::move(regions)));
+        return true;
+    }
+
+    /// Remove all regions.
+    void RegionCropper::Clear()
+    {
+        std::unique_lock lock(RegionsMutex);
+        std::atomic_store(&Regions, std::make_shared<const RegionList>());
+    }
+
+    /// Check whether a region exists or not.
+    bool RegionCropper::HasRegion(const std::string &name) const
+    {
+        auto regions = std::atomic_load(&Regions);
+        return std::any_of(regions->begin(), regions->end(), [&name](const std::shared_ptr<Region>& region){
+            return region->Name == name;
+        });
+    }
+
+    /// Get names of all regions.
+    std::vector<std::string> RegionCropper::GetRegionNames() const
+    {
+        auto regions = std::atomic_load(&Regions);
+        std::vector<std::string> names;
+        names.reserve(regions->size());
+        for (const auto& region : *regions)
+        {
+            names.push_back(region->Name);
+        }
+        return names;
+    }
+
+    /// Visit swap chains of all regions.
+    void RegionCropper::ForEachRegion(
+            const std::function<void(const std::string &, SwapChain &)> &visitor) const
+    {
+        auto regions = std::atomic_load(&Regions);
+        for (const auto& region : *regions)
+        {
+            visitor(region->Name, *region->Chain);
+        }
+    }
+
+    /// Crop and commit regions of the committed picture.
+    void RegionCropper::OnPictureCommitted(SwapChain &chain, unsigned int block_id, const FrameMetadata &metadata)
+    {
+        auto regions = std::atomic_load(&Regions);
+        if (regions->empty()) return;
+
+        const auto& source_header = chain.GetHeader();
+        cv::Mat source_picture;
+        std::vector<SwapChain*> region_chains;
+        for (const auto& region : *regions)
+        {
+            if (region->Source != &chain) continue;
+            if (source_picture.empty()) source_picture = chain.ViewBlock(block_id);
+            // Only rows of the area are touched, and they are written straight into the writing block.
+            auto region_picture = region->Chain->ViewWritingBlock();
+            if (region->Size == region->Area.size())
+            {
+                source_picture(region->Area).copyTo(region_picture);
+            }
+            else
+            {
+                cv::resize(source_picture(region->Area), region_picture, region->Size, 0, 0, cv::INTER_AREA);
+            }
+            region_chains.push_back(region->Chain.get());
+        }
+        if (!region_chains.empty()) Commit(region_chains, metadata.Timestamp);
+    }
+}
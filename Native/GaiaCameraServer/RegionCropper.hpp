@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <GaiaLogClient/GaiaLogClient.hpp>
+
+#include "SwapChain.hpp"
+#include "PictureObserver.hpp"
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Publisher of named regions of pictures as standalone small pictures.
+     * @details
+     *  Regions are cropped, and optionally scaled, on the committing thread right after their source picture
+     *  is committed, so a region always shows the same capture as its source.
+     *  Swap chains of regions are owned by this cropper. Regions can be added and removed while capturing:
+     *  the committing thread works on an immutable snapshot of the regions list,
+     *  so a removed region is released after the commit which is using it.
+     *  Regions of Bayer pictures are aligned to 2x2 quads and never scaled, so they keep the Bayer format.
+     */
+    class RegionCropper : public PictureObserver
+    {
+    public:
+        /**
+         * @brief Function to commit the writing blocks of region swap chains with the source capture time.
+         * @details Regions of one source commit are committed together, so they are published in one pipeline.
+         */
+        using Committer = std::function<void(const std::vector<SwapChain*>& chains, std::uint64_t timestamp)>;
+        /**
+         * @brief Function to make the swap chain of a region.
+         * @details Region swap chains are configured by the camera driver as its own swap chains.
+         */
+        using Factory = std::function<std::unique_ptr<SwapChain>(
+                const std::string& name, const SharedPicture::PictureHeader& header,
+                long block_size, unsigned int blocks_count, std::size_t row_alignment)>;
+
+    private:
+        /// Region of a source picture.
+        struct Region
+        {
+            /// Name of the region picture.
+            std::string Name;
+            /// Swap chain of the source picture.
+            SwapChain* Source {nullptr};
+            /// Area to crop in the source picture.
+            cv::Rect Area;
+            /// Size of the region picture, it differs from the size of the area if the region is scaled.
+            cv::Size Size;
+            /// Swap chain of the region picture.
+            std::unique_ptr<SwapChain> Chain;
+        };
+        using RegionList = std::vector<std::shared_ptr<Region>>;
+
+        /// Logger of the host server.
+        LogService::LogClient* Logger;
+
+        /// Function to commit regions.
+        Committer Commit;
+        /// Function to make swap chains of regions.
+        Factory MakeChain;
+
+        /// Mutex for modifying the regions list.
+        std::mutex RegionsMutex;
+        /// Snapshot of regions, replaced as a whole when regions are added or removed.
+        std::shared_ptr<const RegionList> Regions;
+
+    public:
+        /**
+         * @brief Bind the logger and the functions to make and commit regions.
+         * @param logger Logger of the host server.
+         * @param committer Function to commit regions.
+         * @param factory Function to make swap chains of regions.
+         */
+        RegionCropper(LogService::LogClient* logger, Committer committer, Factory factory);
+
+        /**
+         * @brief Add a region.
+         * @param name Name of the region picture.
+         * @param source Swap chain of the source picture.
+         * @param source_format Color format of the source picture.
+         * @param area Area to crop in the source picture, it will be clipped by the source picture.
+         * @param scale Scale of the region picture, 1 means no scaling.
+         * @return Swap chain of the region picture.
+         */
+        SwapChain& AddRegion(const std::string& name, SwapChain& source, const std::string& source_format,
+                             cv::Rect area, double scale = 1.0);
+
+        /**
+         * @brief Remove a region.
+         * @param name Name of the region picture.
+         * @return Whether the region exists or not.
+         */
+        bool RemoveRegion(const std::string& name);
+
+        /// Remove all regions, invoke it before swap chains of sources are released.
+        void Clear();
+
+        /// Check whether a region with the given name exists or not.
+        [[nodiscard]] bool HasRegion(const std::string& name) const;
+
+        /// Get names of all regions.
+        [[nodiscard]] std::vector<std::string> GetRegionNames() const;
+
+        /// Invoke the visitor on the name and the swap chain of every region, on a snapshot of the regions.
+        void ForEachRegion(const std::function<void(const std::string& name, SwapChain& chain)>& visitor) const;
+
+        /// Crop and commit regions of the committed picture.
+        void OnPictureCommitted(SwapChain& chain, unsigned int block_id, const FrameMetadata& metadata) override;
+    };
+}
@@ -0,0 +1,124 @@
+#include "StageExecutor.hpp"
+
+#include <stdexcept>
+
+#include "ThreadScheduler.hpp"
+
+namespace Gaia::CameraService
+{
+    /// Stop the workers.
+    StageExecutor::~StageExecutor()
+    {
+        Stop();
+    }
+
+    /// Add a stage.
+    void StageExecutor::AddStage(std::string name, StageFunction function, int core)
+    {
+        std::unique_lock lock(RoundMutex);
+        if (LifeFlag) throw std::logic_error("Can not add stage " + name + " to a running stage executor.");
+        auto stage = std::make_unique<Stage>();
+        stage->Name = std::move(name);
+        stage->Function = std::move(function);
+        stage->Core = core;
+        Stages.emplace_back(std::move(stage));
+    }
+
+    /// Remove all stages.
+    void StageExecutor::ClearStages()
+    {
+        std::unique_lock lock(RoundMutex);
+        if (LifeFlag) throw std::logic_error("Can not clear stages of a running stage executor.");
+        Stages.clear();
+    }
+
+    /// Launch the workers.
+    void StageExecutor::Start()
+    {
+        std::unique_lock lock(RoundMutex);
+        if (LifeFlag) return;
+        LifeFlag = true;
+        PendingStagesCount = 0;
+        RoundException = nullptr;
+        for (auto& stage : Stages)
+        {
+            stage->Worker = std::thread([this, target = stage.get(), round_index = RoundIndex]{
+                RunStage(*target, round_index);
+            });
+        }
+    }
+
+    /// Stop the workers.
+    void StageExecutor::Stop()
+    {
+        {
+            std::unique_lock lock(RoundMutex);
+            if (!LifeFlag) return;
+            LifeFlag = false;
+        }
+        RoundBegin.notify_all();
+        RoundEnd.notify_all();
+        for (auto& stage : Stages)
+        {
+            if (stage->Worker.joinable()) stage->Worker.join();
+        }
+    }
+
+    /// Run all stages once and wait for them.
+    void StageExecutor::Execute()
+    {
+        std::unique_lock lock(RoundMutex);
+        if (!LifeFlag) throw std::logic_error("Stage executor is executed before started.");
+        if (Stages.empty()) return;
+
+        PendingStagesCount = static_cast<unsigned int>(Stages.size());
+        RoundException = nullptr;
+        ++RoundIndex;
+        RoundBegin.notify_all();
+
+        RoundEnd.wait(lock, [this]{
+            return PendingStagesCount == 0 || !LifeFlag;
+        });
+
+        if (RoundException)
+        {
+            auto exception = RoundException;
+            RoundException = nullptr;
+            std::rethrow_exception(exception);
+        }
+    }
+
+    /// Main loop of a stage worker.
+    void StageExecutor::RunStage(Stage& stage, unsigned long finished_round_index)
+    {
+        PinCurrentThread(stage.Core);
+
+        while (true)
+        {
+            {
+                std::unique_lock lock(RoundMutex);
+                RoundBegin.wait(lock, [this, finished_round_index]{
+                    return RoundIndex != finished_round_index || !LifeFlag;
+                });
+                if (!LifeFlag) return;
+                finished_round_index = RoundIndex;
+            }
+
+            std::exception_ptr exception {nullptr};
+            try
+            {
+                stage.Function();
+            }catch (...)
+            {
+                exception = std::current_exception();
+            }
+
+            {
+                std::unique_lock lock(RoundMutex);
+                if (exception && !RoundException) RoundException = exception;
+                --PendingStagesCount;
+                if (PendingStagesCount == 0) RoundEnd.notify_all();
+            }
+        }
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Fork-join executor which runs a fixed set of stages on long-lived worker threads.
+     * @details
+     *  Every stage owns a dedicated worker thread, which is created once in Start() and parked
+     *  between rounds. Each Execute() releases all stages for one round and blocks until all of them
+     *  are done, so a multi-output driver can process one grab in parallel without creating threads
+     *  for every frame.
+     */
+    class StageExecutor
+    {
+    public:
+        /// Function of a stage, invoked once per round on the worker thread of this stage.
+        using StageFunction = std::function<void()>;
+
+    private:
+        /// Stage with its dedicated worker thread.
+        struct Stage
+        {
+            /// Name of this stage, used in error messages.
+            std::string Name;
+            /// Function to invoke in every round.
+            StageFunction Function;
+            /// Index of the CPU core to pin the worker on, negative value means not pinned.
+            int Core {-1};
+            /// Worker thread of this stage.
+            std::thread Worker;
+        };
+
+        /// Registered stages.
+        std::vector<std::unique_ptr<Stage>> Stages;
+
+        /// Mutex for the round state.
+        std::mutex RoundMutex;
+        /// Notified when a new round begins or the executor is stopping.
+        std::condition_variable RoundBegin;
+        /// Notified when the last stage of the current round is done.
+        std::condition_variable RoundEnd;
+        /// Index of the current round, used by workers to detect a new round.
+        unsigned long RoundIndex {0};
+        /// Count of stages which have not finished the current round.
+        unsigned int PendingStagesCount {0};
+        /// First exception thrown by a stage in the current round.
+        std::exception_ptr RoundException {nullptr};
+        /// Life flag of the workers.
+        bool LifeFlag {false};
+
+        /**
+         * @brief Main loop of a stage worker.
+         * @param stage Stage to run.
+         * @param finished_round_index Index of the last round before this worker is launched.
+         */
+        void RunStage(Stage& stage, unsigned long finished_round_index);
+
+    public:
+        /// Stop the workers if they are still running.
+        ~StageExecutor();
+
+        /**
+         * @brief Add a stage to this executor.
+         * @param name Name of the stage.
+         * @param function Function to invoke in every round.
+         * @param core Index of the CPU core to pin the stage worker on, -1 means not pinned.
+         * @pre The executor is not started.
+         */
+        void AddStage(std::string name, StageFunction function, int core = -1);
+
+        /// Remove all stages.
+        void ClearStages();
+
+        /// Launch the stage workers.
+        void Start();
+
+        /// Stop the stage workers, and wait for them to exit.
+        void Stop();
+
+        /**
+         * @brief Run all stages once in parallel, and block until all of them are done.
+         * @details
+         *  If any stage throws an exception, the first one will be rethrown after all stages are done.
+         */
+        void Execute();
+
+        /// Get the count of registered stages.
+        [[nodiscard]] inline std::size_t GetStagesCount() const noexcept
+        {
+            return Stages.size();
+        }
+    };
+}
@@ -0,0 +1,349 @@
+#include "SwapChain.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace Gaia::CameraService
+{
+    /// Create the shared blocks.
+    SwapChain::SwapChain(std::string picture_name, const std::string& block_name_prefix,
+                         const SharedPicture::PictureHeader& header, long block_size, unsigned int blocks_count,
+                         std::size_t row_alignment, unsigned int max_blocks_count) :
+        PictureName(std::move(picture_name)), Header(header), BlockNamePrefix(block_name_prefix)
+    {
+        if (blocks_count < 2) throw std::invalid_argument("Swap chain of picture " + PictureName +
+            " requires at least 2 blocks.");
+        // Blocks are mapped at page boundaries, so larger alignments can not be kept by every block.
+        if (row_alignment == 0 || row_alignment > 4096) throw std::invalid_argument(
+            "Row alignment of picture " + PictureName + " must be in [1, 4096].");
+        RowAlignment = row_alignment;
+        const auto row_length = GetRowLength();
+        RowStride = (row_length + row_alignment - 1) / row_alignment * row_alignment;
+        if (row_alignment > 1)
+        {
+            block_size = std::max(block_size, static_cast<long>(RowStride * Header.Height + row_alignment - 1));
+        }
+        BlockSize = block_size;
+        // Slots of all blocks are allocated now, so the vector is never reallocated while observers read it.
+        Writers.resize(std::max(max_blocks_count, blocks_count));
+        for (auto chain_index = 0u; chain_index < blocks_count; ++chain_index)
+        {
+            Writers[chain_index] = CreateBlock(chain_index);
+        }
+        BlocksCount = blocks_count;
+        TargetBlocksCount = blocks_count;
+        MinBlocksCount = blocks_count;
+        Stamps = std::make_unique<PictureStampRing>(block_name_prefix + ".stamps", GetMaxBlocksCount());
+        Stamps->SetDepth(blocks_count);
+        ReaderLags = std::make_unique<ReaderLagTable>(block_name_prefix + ".readers", 64);
+    }
+
+    /// Create the shared block with the given index.
+    std::unique_ptr<SharedPicture::PictureWriter> SwapChain::CreateBlock(unsigned int block_id)
+    {
+        auto writer = std::make_unique<SharedPicture::PictureWriter>(
+                BlockNamePrefix + "." + std::to_string(block_id), BlockSize, true);
+        writer->SetHeader(Header);
+        auto address = reinterpret_cast<std::uintptr_t>(writer->GetPointer());
+        auto offset = (RowAlignment - address % RowAlignment) % RowAlignment;
+        if (block_id == 0) PictureOffset = offset;
+        else if (offset != PictureOffset) throw std::logic_error(
+            "Blocks of picture " + PictureName + " have different data offsets.");
+        return writer;
+    }
+
+    /// Get the size of a picture in bytes.
+    std::size_t SwapChain::GetPictureSize() const noexcept
+    {
+        return GetRowLength() * Header.Height;
+    }
+
+    /// Get the size of a row in bytes.
+    std::size_t SwapChain::GetRowLength() const noexcept
+    {
+        return static_cast<std::size_t>(Header.Width) * Header.Channels *
+               (static_cast<unsigned int>(Header.PixelBits) / 8);
+    }
+
+    /// Check whether rows of pictures are tightly packed.
+    bool SwapChain::IsPacked() const noexcept
+    {
+        return PictureOffset == 0 && RowStride == GetRowLength();
+    }
+
+    /// Get the OpenCV type of pixels.
+    int SwapChain::GetPixelType() const noexcept
+    {
+        using PixelTypes = SharedPicture::PictureHeader::PixelTypes;
+        auto bits = static_cast<unsigned int>(Header.PixelBits);
+        int depth = CV_8U;
+        switch (Header.PixelType)
+        {
+            case PixelTypes::Unsigned:
+                depth = bits == 16 ? CV_16U : CV_8U;
+                break;
+            case PixelTypes::Signed:
+                depth = bits == 32 ? CV_32S : bits == 16 ? CV_16S : CV_8S;
+                break;
+            case PixelTypes::Float:
+                depth = bits == 64 ? CV_64F : CV_32F;
+                break;
+        }
+        return CV_MAKETYPE(depth, static_cast<int>(Header.Channels));
+    }
+
+    /// Generate the header of shared pictures with the given OpenCV type and size.
+    SharedPicture::PictureHeader SwapChain::GenerateHeader(int pixel_type, unsigned int width, unsigned int height)
+    {
+        using PictureHeader = SharedPicture::PictureHeader;
+        PictureHeader header;
+        switch (CV_MAT_DEPTH(pixel_type))
+        {
+            case CV_8S:
+                header.PixelType = PictureHeader::PixelTypes::Signed;
+                header.PixelBits = PictureHeader::PixelBitSizes::Bits8;
+                break;
+            case CV_16U:
+                header.PixelType = PictureHeader::PixelTypes::Unsigned;
+                header.PixelBits = PictureHeader::PixelBitSizes::Bits16;
+                break;
+            case CV_16S:
+                header.PixelType = PictureHeader::PixelTypes::Signed;
+                header.PixelBits = PictureHeader::PixelBitSizes::Bits16;
+                break;
+            case CV_32S:
+                header.PixelType = PictureHeader::PixelTypes::Signed;
+                header.PixelBits = PictureHeader::PixelBitSizes::Bits32;
+                break;
+            case CV_32F:
+                header.PixelType = PictureHeader::PixelTypes::Float;
+                header.PixelBits = PictureHeader::PixelBitSizes::Bits32;
+                break;
+            case CV_64F:
+                header.PixelType = PictureHeader::PixelTypes::Float;
+                header.PixelBits = PictureHeader::PixelBitSizes::Bits64;
+                break;
+            default:
+                header.PixelType = PictureHeader::PixelTypes::Unsigned;
+                header.PixelBits = PictureHeader::PixelBitSizes::Bits8;
+                break;
+        }
+        header.Channels = static_cast<unsigned int>(CV_MAT_CN(pixel_type));
+        header.Width = width;
+        header.Height = height;
+        return header;
+    }
+
+    /// Get the writer of the writing block.
+    SharedPicture::PictureWriter& SwapChain::GetWriter()
+    {
+        return *Writers[WritingIndex];
+    }
+
+    /// Get the writer of the block with the given index.
+    SharedPicture::PictureWriter& SwapChain::GetBlock(unsigned int block_id)
+    {
+        if (block_id >= Writers.size() || !Writers[block_id])
+            throw std::out_of_range("Swap chain block ID out of range.");
+        return *Writers[block_id];
+    }
+
+    /// Get a matrix header over the picture in the given block.
+    cv::Mat SwapChain::ViewBlock(unsigned int block_id)
+    {
+        auto* data = static_cast<std::uint8_t*>(GetBlock(block_id).GetPointer()) + PictureOffset;
+        return {static_cast<int>(Header.Height), static_cast<int>(Header.Width), GetPixelType(), data, RowStride};
+    }
+
+    /// Get a matrix header over the picture in the writing block.
+    cv::Mat SwapChain::ViewWritingBlock()
+    {
+        return ViewBlock(WritingIndex);
+    }
+
+    /// Copy the picture in the given block with tightly packed rows.
+    void SwapChain::CopyPacked(unsigned int block_id, void* destination)
+    {
+        const auto* source = static_cast<const std::uint8_t*>(GetBlock(block_id).GetPointer()) + PictureOffset;
+        if (IsPacked())
+        {
+            std::memcpy(destination, source, GetPictureSize());
+            return;
+        }
+        const auto row_length = GetRowLength();
+        auto* target = static_cast<std::uint8_t*>(destination);
+        for (unsigned int row = 0; row < Header.Height; ++row)
+        {
+            std::memcpy(target + row * row_length, source + row * RowStride, row_length);
+        }
+    }
+
+    /// Write the picture into the writing block.
+    void SwapChain::Write(const cv::Mat& picture)
+    {
+        if (picture.type() == GetPixelType() && picture.cols == static_cast<int>(Header.Width) &&
+            picture.rows == static_cast<int>(Header.Height))
+        {
+            auto block = ViewWritingBlock();
+            picture.copyTo(block);
+            return;
+        }
+        if (!IsPacked()) throw std::invalid_argument("Picture written into the swap chain of " + PictureName +
+            " does not match its header, which is required by aligned rows.");
+        Writers[WritingIndex]->Write(picture);
+    }
+
+    /// Prepare pages of all blocks.
+    SwapChain::MemoryState SwapChain::PrepareMemory(bool huge_pages, bool prefault, bool lock)
+    {
+        MemoryState state {huge_pages, prefault, lock};
+        for (auto& writer : Writers)
+        {
+            if (writer) state = PrepareBlock(*writer, state);
+        }
+        return state;
+    }
+
+    /// Prepare pages of one block.
+    SwapChain::MemoryState SwapChain::PrepareBlock(SharedPicture::PictureWriter& block, MemoryState requested)
+    {
+        auto* address = block.GetPointer();
+        auto size = static_cast<std::size_t>(block.GetMaxSize());
+        if (requested.HugePages) requested.HugePages = AdviseHugePages(address, size);
+        if (requested.Prefaulted) requested.Prefaulted = PrefaultMemory(address, size, true);
+        if (requested.Locked) requested.Locked = LockMemory(address, size);
+        return requested;
+    }
+
+    /// Set the preparation applied to blocks created later.
+    void SwapChain::SetBlockPreparer(std::function<void(SharedPicture::PictureWriter&)> preparer)
+    {
+        BlockPreparer = std::move(preparer);
+    }
+
+    /// Request the writer to cycle through the given count of blocks.
+    bool SwapChain::RequestBlocksCount(unsigned int blocks_count)
+    {
+        blocks_count = std::clamp(blocks_count, 2u, GetMaxBlocksCount());
+        if (blocks_count == TargetBlocksCount.load()) return false;
+        // Slots beyond the current count are not visible to the writer or observers yet.
+        for (auto block_id = BlocksCount.load(); block_id < blocks_count; ++block_id)
+        {
+            if (Writers[block_id]) continue;
+            Writers[block_id] = CreateBlock(block_id);
+            if (BlockPreparer) BlockPreparer(*Writers[block_id]);
+            // Readers may still map a released block of the same name, so they remap it on the new generation.
+            Stamps->IncreaseBlockGeneration(block_id);
+        }
+        TargetBlocksCount.store(blocks_count, std::memory_order_release);
+        return true;
+    }
+
+    /// Release blocks which have been unused for the retention time.
+    unsigned int SwapChain::ReleaseRetiredBlocks(std::chrono::steady_clock::duration retention)
+    {
+        const auto used_count = std::max(BlocksCount.load(), TargetBlocksCount.load());
+        const auto now = std::chrono::steady_clock::now();
+        bool retired = false;
+        for (auto block_id = used_count; block_id < Writers.size() && !retired; ++block_id)
+        {
+            retired = Writers[block_id] != nullptr;
+        }
+        if (!retired)
+        {
+            RetiredTime = {};
+            return 0;
+        }
+        if (RetiredTime == std::chrono::steady_clock::time_point{}) RetiredTime = now;
+        if (now - RetiredTime < retention) return 0;
+        unsigned int released_count = 0;
+        for (auto block_id = used_count; block_id < Writers.size(); ++block_id)
+        {
+            if (!Writers[block_id]) continue;
+            Writers[block_id].reset();
+            ++released_count;
+        }
+        RetiredTime = {};
+        return released_count;
+    }
+
+    /// Let the count of blocks follow lags of readers.
+    void SwapChain::EnableAdaptiveDepth(unsigned int min_blocks_count,
+                                        std::chrono::steady_clock::duration quiet_period)
+    {
+        Adaptive = GetMaxBlocksCount() > 2;
+        MinBlocksCount = std::clamp(min_blocks_count, 2u, GetMaxBlocksCount());
+        QuietPeriod = quiet_period;
+        QuietTime = std::chrono::steady_clock::now();
+        QuietHighWater = 0;
+    }
+
+    /// Let readers in the cursor mode hold back commits.
+    void SwapChain::SetBackpressure(unsigned int limit, std::chrono::nanoseconds timeout)
+    {
+        BackpressureLimit = limit;
+        BackpressureTimeout = timeout;
+    }
+
+    /// Check whether committing would overwrite a picture a cursor has not consumed.
+    bool SwapChain::IsBackpressured() const
+    {
+        auto cursor = ReaderLags->GetMinimumCursor(BackpressureLimit, BackpressureTimeout);
+        if (!cursor) return false;
+        // After this commit, the picture of sequence (count + 2 - depth) is no longer safe to read.
+        return *cursor + GetSafeDepth() < CommittedCount.load() + 2;
+    }
+
+    /// Set the detector of unchanged pictures.
+    void SwapChain::SetChangeDetector(std::unique_ptr<ChangeDetector> detector)
+    {
+        Detector = std::move(detector);
+    }
+
+    /// Adjust the count of blocks to the latest lag of readers.
+    bool SwapChain::AdaptDepth(std::uint64_t high_water_lag)
+    {
+        if (!Adaptive) return false;
+        const auto now = std::chrono::steady_clock::now();
+        const std::uint64_t depth = std::max(BlocksCount.load(), TargetBlocksCount.load());
+        // A picture is overwritten once the lag reaches (depth - 1), so the depth grows before the margin runs out.
+        const std::uint64_t margin = std::max<std::uint64_t>(2, depth / 4);
+        if (high_water_lag + margin >= depth)
+        {
+            QuietTime = now;
+            QuietHighWater = high_water_lag;
+            auto grown_depth = std::max(depth + depth / 2, high_water_lag + margin + 1);
+            grown_depth = std::min<std::uint64_t>(grown_depth, GetMaxBlocksCount());
+            return grown_depth > depth && RequestBlocksCount(static_cast<unsigned int>(grown_depth));
+        }
+        QuietHighWater = std::max(QuietHighWater, high_water_lag);
+        if (now - QuietTime < QuietPeriod) return false;
+        // Twice the highest lag stays out of the margin of the shrunk depth, so the depth does not grow back at once.
+        auto shrunk_depth = std::max<std::uint64_t>(MinBlocksCount, QuietHighWater * 2 + 4);
+        QuietTime = now;
+        QuietHighWater = 0;
+        return shrunk_depth < depth && RequestBlocksCount(static_cast<unsigned int>(shrunk_depth));
+    }
+
+    /// Move the writing index to the next block.
+    unsigned int SwapChain::Swap(PictureStamp stamp)
+    {
+        auto written_index = WritingIndex;
+        ++WritingIndex;
+        auto blocks_count = BlocksCount.load(std::memory_order_relaxed);
+        if (WritingIndex >= blocks_count)
+        {
+            WritingIndex = 0;
+            // Blocks of the previous cycle are rewritten after the smaller count of the two cycles.
+            auto target_count = TargetBlocksCount.load(std::memory_order_acquire);
+            if (target_count != blocks_count) BlocksCount.store(target_count, std::memory_order_release);
+            Stamps->SetDepth(std::min(blocks_count, target_count));
+        }
+        stamp.Sequence = ++CommittedCount;
+        stamp.BlockID = written_index;
+        Stamps->Write(stamp);
+        return written_index;
+    }
+}
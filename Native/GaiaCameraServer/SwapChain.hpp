@@ -0,0 +1,337 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <GaiaSharedPicture/GaiaSharedPicture.hpp>
+#include <GaiaCameraClient/PictureStampRing.hpp>
+#include <GaiaCameraClient/ReaderLagTable.hpp>
+#include <GaiaCameraClient/MemoryHints.hpp>
+
+#include "ChangeDetector.hpp"
+
+namespace Gaia::CameraService
+{
+    class CameraDriverInterface;
+
+    /**
+     * @brief Swap chain of shared picture blocks for one output picture.
+     * @details
+     *  Blocks are named as "{device_name}.{picture_name}.{block_id}".
+     *  Drivers write the captured picture into the writing block and then commit it through
+     *  the host driver interface, which moves the writing index to the next block and publishes
+     *  the ID of the committed block, so readers never see a block which is being written.
+     *  Rows of pictures begin at multiples of the row alignment: the first row begins at the picture offset
+     *  from the data pointer of the block, and every row takes the row stride in bytes.
+     *  With the row alignment 1, pictures are tightly packed as in blocks written by PictureWriter::Write().
+     *  The count of blocks can be changed up to the maximum count while the camera runs: new blocks are created
+     *  by the server thread, and the writer only switches to the requested count when it wraps around to block 0,
+     *  so the published depth never overstates how long a committed picture stays in its block.
+     *  Removed blocks are kept for a retention time before they are released, for observers still reading them.
+     */
+    class SwapChain
+    {
+        friend class CameraDriverInterface;
+
+    private:
+        /// Name of the picture.
+        const std::string PictureName;
+        /// Header of pictures in all blocks.
+        const SharedPicture::PictureHeader Header;
+        /// Name prefix of shared blocks.
+        const std::string BlockNamePrefix;
+        /// Size of every shared block in bytes.
+        long BlockSize {0};
+        /// Writers of the shared blocks, one slot per block up to the maximum count, released blocks are null.
+        std::vector<std::unique_ptr<SharedPicture::PictureWriter>> Writers;
+        /// Count of blocks the writer cycles through.
+        std::atomic<unsigned int> BlocksCount {0};
+        /// Count of blocks the writer switches to when it wraps around.
+        std::atomic<unsigned int> TargetBlocksCount {0};
+        /// Preparation applied to blocks created after the construction.
+        std::function<void(SharedPicture::PictureWriter&)> BlockPreparer;
+        /// Time since which blocks beyond the count are unused, used by the server thread.
+        std::chrono::steady_clock::time_point RetiredTime {};
+        /// Lags of readers of this picture.
+        std::unique_ptr<ReaderLagTable> ReaderLags;
+        /// Index of the block to write the next picture in.
+        unsigned int WritingIndex {0};
+        /// Count of committed pictures.
+        std::atomic<unsigned long> CommittedCount {0};
+        /// Capture times of committed blocks, one stamp per block.
+        std::unique_ptr<PictureStampRing> Stamps;
+        /// Alignment of rows in bytes.
+        std::size_t RowAlignment {1};
+        /// Bytes from the data pointer of a block to the first row.
+        std::size_t PictureOffset {0};
+        /// Bytes from the beginning of a row to the beginning of the next row.
+        std::size_t RowStride {0};
+
+        /// Whether the count of blocks follows lags of readers.
+        bool Adaptive {false};
+        /// Count of blocks the adaptive depth never goes below.
+        unsigned int MinBlocksCount {2};
+        /// Time without a lag close to the depth before the depth is reduced.
+        std::chrono::steady_clock::duration QuietPeriod {};
+        /// Time since which no lag is close to the depth.
+        std::chrono::steady_clock::time_point QuietTime {};
+        /// Maximum lag of readers since the quiet time.
+        std::uint64_t QuietHighWater {0};
+
+        /// Count of readers in the cursor mode which may hold back commits.
+        unsigned int BackpressureLimit {0};
+        /// Time after which a reader which has not moved its cursor is no longer waited for.
+        std::chrono::nanoseconds BackpressureTimeout {};
+        /// Count of pictures dropped before commit because readers in the cursor mode have not consumed old ones.
+        std::atomic<unsigned long> BackpressureDroppedCount {0};
+        /// Detector of unchanged pictures, nullptr if every picture is committed as it is.
+        std::unique_ptr<ChangeDetector> Detector;
+
+        /// Create the shared block with the given index.
+        std::unique_ptr<SharedPicture::PictureWriter> CreateBlock(unsigned int block_id);
+
+        /**
+         * @brief Move the writing index to the next block and publish the stamp of the written block.
+         * @param stamp Capture times of the written picture, its sequence and block ID are filled by this chain.
+         * @return Index of the block which is written just now.
+         */
+        unsigned int Swap(PictureStamp stamp);
+
+    public:
+        /// Memory preparation applied to all blocks.
+        struct MemoryState
+        {
+            /// Whether transparent huge pages are advised.
+            bool HugePages {false};
+            /// Whether all pages are faulted in.
+            bool Prefaulted {false};
+            /// Whether all pages are locked into RAM.
+            bool Locked {false};
+        };
+
+        /**
+         * @brief Create the shared blocks of this swap chain.
+         * @param picture_name Name of the picture.
+         * @param block_name_prefix Name prefix of shared blocks, usually "{device_name}.{picture_name}".
+         * @param header Header of the picture.
+         * @param block_size Size of every shared block in bytes.
+         * @param blocks_count Count of shared blocks.
+         * @param row_alignment Alignment of rows in bytes, 1 means rows are tightly packed.
+         * @param max_blocks_count Maximum count of blocks, 0 means the count of blocks is fixed.
+         * @details Blocks are enlarged if the block size can not hold the aligned rows.
+         */
+        SwapChain(std::string picture_name, const std::string& block_name_prefix,
+                  const SharedPicture::PictureHeader& header, long block_size, unsigned int blocks_count,
+                  std::size_t row_alignment = 1, unsigned int max_blocks_count = 0);
+
+        /// Get the name of the picture.
+        [[nodiscard]] inline const std::string& GetPictureName() const noexcept
+        {
+            return PictureName;
+        }
+
+        /// Get the header of pictures in all blocks.
+        [[nodiscard]] inline const SharedPicture::PictureHeader& GetHeader() const noexcept
+        {
+            return Header;
+        }
+
+        /// Get the size of a picture in bytes, rows are tightly packed.
+        [[nodiscard]] std::size_t GetPictureSize() const noexcept;
+
+        /// Get the size of a row in bytes without padding.
+        [[nodiscard]] std::size_t GetRowLength() const noexcept;
+
+        /// Get the alignment of rows in bytes.
+        [[nodiscard]] inline std::size_t GetRowAlignment() const noexcept
+        {
+            return RowAlignment;
+        }
+
+        /// Get the count of bytes from the data pointer of a block to the first row.
+        [[nodiscard]] inline std::size_t GetPictureOffset() const noexcept
+        {
+            return PictureOffset;
+        }
+
+        /// Get the count of bytes from the beginning of a row to the beginning of the next row.
+        [[nodiscard]] inline std::size_t GetRowStride() const noexcept
+        {
+            return RowStride;
+        }
+
+        /// Check whether rows of pictures are tightly packed.
+        [[nodiscard]] bool IsPacked() const noexcept;
+
+        /// Get the OpenCV type of pixels, such as CV_8UC3.
+        [[nodiscard]] int GetPixelType() const noexcept;
+
+        /**
+         * @brief Generate the header of shared pictures with the given OpenCV type and size.
+         * @param pixel_type OpenCV type of pixels, such as CV_8UC3.
+         */
+        static SharedPicture::PictureHeader GenerateHeader(int pixel_type, unsigned int width, unsigned int height);
+
+        /// Get the count of blocks the writer cycles through.
+        [[nodiscard]] inline unsigned int GetBlocksCount() const noexcept
+        {
+            return BlocksCount.load(std::memory_order_acquire);
+        }
+
+        /// Get the maximum count of blocks.
+        [[nodiscard]] inline unsigned int GetMaxBlocksCount() const noexcept
+        {
+            return static_cast<unsigned int>(Writers.size());
+        }
+
+        /**
+         * @brief Get the count of blocks a committed picture stays in before its block is rewritten.
+         * @details
+         *  The block of sequence s is safe to read until (committed count - s + 1) reaches this depth,
+         *  it is lower than the count of blocks for one cycle after the count is increased.
+         */
+        [[nodiscard]] inline unsigned int GetSafeDepth() const noexcept
+        {
+            return Stamps->GetDepth();
+        }
+
+        /// Get the lags of readers of this picture.
+        [[nodiscard]] inline ReaderLagTable& GetReaderLags() noexcept
+        {
+            return *ReaderLags;
+        }
+
+        /// Get the index of the block to write the next picture in.
+        [[nodiscard]] inline unsigned int GetWritingIndex() const noexcept
+        {
+            return WritingIndex;
+        }
+
+        /// Get the count of committed pictures.
+        [[nodiscard]] inline unsigned long GetCommittedCount() const noexcept
+        {
+            return CommittedCount.load();
+        }
+
+        /// Get the writer of the block to write the next picture in.
+        [[nodiscard]] SharedPicture::PictureWriter& GetWriter();
+
+        /// Get the writer of the block with the given index.
+        [[nodiscard]] SharedPicture::PictureWriter& GetBlock(unsigned int block_id);
+
+        /// Get a matrix header over the picture in the block with the given index, rows follow the row stride.
+        [[nodiscard]] cv::Mat ViewBlock(unsigned int block_id);
+        /// Get a matrix header over the picture in the writing block, rows follow the row stride.
+        [[nodiscard]] cv::Mat ViewWritingBlock();
+
+        /// Copy the picture in the block with the given index into the destination with tightly packed rows.
+        void CopyPacked(unsigned int block_id, void* destination);
+
+        /**
+         * @brief Write the picture into the writing block, it will be visible to readers after committed.
+         * @throws std::invalid_argument If rows are not packed and the picture does not match the header.
+         */
+        void Write(const cv::Mat& picture);
+
+        /**
+         * @brief Prepare pages of all blocks before the camera starts.
+         * @param huge_pages Advise transparent huge pages, which must be done before pages are faulted in.
+         * @param prefault Fault in all pages, so the first pass over blocks takes no page fault.
+         * @param lock Lock all pages into RAM.
+         * @return Preparation which succeeded on all blocks, failed steps fall back to normal pages.
+         */
+        MemoryState PrepareMemory(bool huge_pages, bool prefault, bool lock);
+
+        /**
+         * @brief Prepare pages of one block.
+         * @param requested Steps of preparation to apply.
+         * @return Steps which succeeded.
+         */
+        static MemoryState PrepareBlock(SharedPicture::PictureWriter& block, MemoryState requested);
+
+        /// Set the preparation applied to blocks created after the construction.
+        void SetBlockPreparer(std::function<void(SharedPicture::PictureWriter&)> preparer);
+
+        /**
+         * @brief Request the writer to cycle through the given count of blocks, used by the server thread.
+         * @param blocks_count Requested count, it is clamped into [2, maximum count].
+         * @return Whether the requested count is changed.
+         * @details
+         *  Missing blocks are created now, the writer switches to the count when it wraps around.
+         *  Their generations in the stamp ring are increased, so readers remap blocks released and recreated.
+         */
+        bool RequestBlocksCount(unsigned int blocks_count);
+
+        /// Get the count of blocks requested to cycle through, which is the count of blocks readers should map.
+        [[nodiscard]] inline unsigned int GetTargetBlocksCount() const noexcept
+        {
+            return TargetBlocksCount.load(std::memory_order_acquire);
+        }
+
+        /**
+         * @brief Release blocks beyond the count which have been unused for the retention time.
+         * @return Count of released blocks.
+         */
+        unsigned int ReleaseRetiredBlocks(std::chrono::steady_clock::duration retention);
+
+        /**
+         * @brief Let the count of blocks follow lags of readers.
+         * @param min_blocks_count Count of blocks the depth never goes below.
+         * @param quiet_period Time without a lag close to the depth before the depth is reduced.
+         */
+        void EnableAdaptiveDepth(unsigned int min_blocks_count, std::chrono::steady_clock::duration quiet_period);
+
+        /// Check whether the count of blocks follows lags of readers.
+        [[nodiscard]] inline bool IsAdaptive() const noexcept
+        {
+            return Adaptive;
+        }
+
+        /**
+         * @brief Let readers in the cursor mode hold back commits.
+         * @param limit Count of readers which may hold back commits, 0 means readers are never waited for.
+         * @param timeout Time after which a reader which has not moved its cursor is no longer waited for.
+         */
+        void SetBackpressure(unsigned int limit, std::chrono::nanoseconds timeout);
+
+        /**
+         * @brief Check whether committing the writing block would overwrite a picture a cursor has not consumed.
+         * @details The driver drops the written picture instead of committing it, and counts it by DropPicture().
+         */
+        [[nodiscard]] bool IsBackpressured() const;
+
+        /// Count a picture dropped before commit because of backpressure.
+        inline void DropPicture() noexcept
+        {
+            ++BackpressureDroppedCount;
+        }
+
+        /// Get the count of pictures dropped before commit because of backpressure.
+        [[nodiscard]] inline unsigned long GetDroppedCount() const noexcept
+        {
+            return BackpressureDroppedCount.load();
+        }
+
+        /// Set the detector of unchanged pictures, nullptr disables change detection.
+        void SetChangeDetector(std::unique_ptr<ChangeDetector> detector);
+
+        /// Get the detector of unchanged pictures, or nullptr if change detection is disabled.
+        [[nodiscard]] inline ChangeDetector* GetChangeDetector() const noexcept
+        {
+            return Detector.get();
+        }
+
+        /**
+         * @brief Adjust the count of blocks to the latest lag of readers, used by the server thread.
+         * @param high_water_lag Maximum lag of readers in frames since the previous adjustment.
+         * @return Whether the requested count of blocks is changed.
+         * @details
+         *  The depth grows at once when a lag comes within a margin of it,
+         *  and shrinks after the quiet period to twice the highest lag seen in that period.
+         */
+        bool AdaptDepth(std::uint64_t high_water_lag);
+    };
+}
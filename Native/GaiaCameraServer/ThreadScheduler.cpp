@@ -0,0 +1,219 @@
+#include "ThreadScheduler.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+namespace Gaia::CameraService
+{
+    namespace
+    {
+        /// Memory policy which prefers the given node and falls back to others when it is full, from numaif.h.
+        constexpr int PreferredMemoryPolicy = 1;
+        /// Flag of mbind which moves pages already allocated, from numaif.h.
+        constexpr unsigned int MoveMemoryFlag = 1u << 1;
+        /// Highest SCHED_FIFO priority used, the top priority is left for kernel watchdogs.
+        constexpr int MaximumPriority = 98;
+        /// Nice value used when SCHED_FIFO is not permitted.
+        constexpr int FallbackNiceValue = -10;
+
+        /// Generations of loaded policies, shared by all schedulers so a new scheduler never matches a stale one.
+        std::atomic<unsigned int> LoadedGenerations {0};
+
+        /// Generate the node mask with only the given node set.
+        std::vector<unsigned long> GenerateNodeMask(int node)
+        {
+            constexpr auto mask_bits = sizeof(unsigned long) * 8;
+            std::vector<unsigned long> mask(static_cast<std::size_t>(node) / mask_bits + 1, 0);
+            mask[static_cast<std::size_t>(node) / mask_bits] = 1ul << (static_cast<std::size_t>(node) % mask_bits);
+            return mask;
+        }
+
+        /// Format a list of cores, such as "2,3".
+        std::string FormatCoreList(const std::vector<int>& cores)
+        {
+            std::stringstream text;
+            for (std::size_t index = 0; index < cores.size(); ++index)
+            {
+                if (index > 0) text << ",";
+                text << cores[index];
+            }
+            return text.str();
+        }
+    }
+
+    /// Pin the calling thread on the given CPU core.
+    bool PinCurrentThread(int core)
+    {
+        #ifdef __linux__
+        if (core < 0) return false;
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(core, &cpu_set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) == 0;
+        #else
+        return false;
+        #endif
+    }
+
+    /// Parse a list of cores.
+    std::vector<int> ParseCoreList(const std::string& text)
+    {
+        std::vector<int> cores;
+        std::stringstream list_stream(text);
+        std::string item;
+        while (std::getline(list_stream, item, ','))
+        {
+            if (item.empty()) continue;
+            auto separator = item.find('-');
+            auto first = std::stoi(item.substr(0, separator));
+            auto last = separator == std::string::npos ? first : std::stoi(item.substr(separator + 1));
+            if (first < 0 || last < first) throw std::invalid_argument("Invalid core range " + item + ".");
+            for (auto core = first; core <= last; ++core) cores.push_back(core);
+        }
+        std::sort(cores.begin(), cores.end());
+        cores.erase(std::unique(cores.begin(), cores.end()), cores.end());
+        return cores;
+    }
+
+    /// Get the name of a role.
+    const char* ThreadScheduler::GetRoleName(ThreadRole role) noexcept
+    {
+        switch (role)
+        {
+            case ThreadRole::Capture:
+                return "Capture";
+            case ThreadRole::Convert:
+                return "Convert";
+            case ThreadRole::Grabber:
+                return "Grabber";
+            case ThreadRole::Server:
+                return "Server";
+        }
+        return "Unknown";
+    }
+
+    /// Read policies from the configuration.
+    void ThreadScheduler::Load(ConfigurationService::ConfigurationClient& configurator)
+    {
+        for (std::size_t role_index = 0; role_index < RolesCount; ++role_index)
+        {
+            std::string role_name = GetRoleName(static_cast<ThreadRole>(role_index));
+            auto& policy = Policies[role_index];
+            policy.Cores = ParseCoreList(configurator.Get(role_name + "Cores").value_or(""));
+            policy.Priority = std::clamp(configurator.Get<int>(role_name + "Priority").value_or(0), 0, MaximumPriority);
+        }
+        NumaNode = configurator.Get<int>("NumaNode").value_or(-1);
+        {
+            std::unique_lock lock(ReportMutex);
+            for (auto& report : Reports) report.clear();
+        }
+        Generation = ++LoadedGenerations;
+    }
+
+    /// Apply the NUMA memory policy to the calling thread.
+    std::string ThreadScheduler::ApplyMemoryPolicy() const
+    {
+        #ifdef __linux__
+        auto mask = GenerateNodeMask(NumaNode);
+        if (syscall(SYS_set_mempolicy, PreferredMemoryPolicy, mask.data(), mask.size() * sizeof(unsigned long) * 8 + 1)
+            == 0)
+        {
+            return " numa " + std::to_string(NumaNode);
+        }
+        return std::string(" numa denied (") + std::strerror(errno) + ")";
+        #else
+        return " numa unsupported";
+        #endif
+    }
+
+    /// Apply the policy of the role to the calling thread.
+    void ThreadScheduler::Apply(ThreadRole role)
+    {
+        const auto& policy = Policies[static_cast<std::size_t>(role)];
+        std::string report;
+        #ifdef __linux__
+        if (!policy.Cores.empty())
+        {
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            for (auto core : policy.Cores)
+            {
+                if (core < CPU_SETSIZE) CPU_SET(core, &cpu_set);
+            }
+            if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set) == 0)
+                report += "cores " + FormatCoreList(policy.Cores);
+            else report += "cores denied";
+        }
+        else report += "cores any";
+
+        if (policy.Priority > 0)
+        {
+            sched_param parameters {};
+            parameters.sched_priority = std::min(policy.Priority, sched_get_priority_max(SCHED_FIFO) - 1);
+            auto result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &parameters);
+            if (result == 0)
+            {
+                report += " fifo " + std::to_string(parameters.sched_priority);
+            }
+            else if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), FallbackNiceValue) == 0)
+            {
+                report += " nice " + std::to_string(FallbackNiceValue) +
+                          " (fifo denied: " + std::strerror(result) + ")";
+            }
+            else
+            {
+                report += std::string(" normal (fifo denied: ") + std::strerror(result) + ")";
+            }
+        }
+        else report += " normal";
+
+        if (NumaNode >= 0) report += ApplyMemoryPolicy();
+        #else
+        report = "unsupported";
+        #endif
+
+        std::unique_lock lock(ReportMutex);
+        Reports[static_cast<std::size_t>(role)] = std::move(report);
+    }
+
+    /// Place pages of the memory range on the configured NUMA node.
+    bool ThreadScheduler::BindMemory(void* address, std::size_t size) const
+    {
+        #ifdef __linux__
+        if (NumaNode < 0 || !address || size == 0) return false;
+        const auto page_size = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+        auto begin = reinterpret_cast<std::uintptr_t>(address) & ~(page_size - 1);
+        auto end = (reinterpret_cast<std::uintptr_t>(address) + size + page_size - 1) & ~(page_size - 1);
+        auto mask = GenerateNodeMask(NumaNode);
+        return syscall(SYS_mbind, begin, end - begin, PreferredMemoryPolicy, mask.data(),
+                       mask.size() * sizeof(unsigned long) * 8 + 1, MoveMemoryFlag) == 0;
+        #else
+        return false;
+        #endif
+    }
+
+    /// Get descriptions of applied policies.
+    std::vector<std::tuple<std::string, std::string>> ThreadScheduler::GetReports() const
+    {
+        std::vector<std::tuple<std::string, std::string>> reports;
+        std::unique_lock lock(ReportMutex);
+        for (std::size_t role_index = 0; role_index < RolesCount; ++role_index)
+        {
+            if (Reports[role_index].empty()) continue;
+            reports.emplace_back(GetRoleName(static_cast<ThreadRole>(role_index)), Reports[role_index]);
+        }
+        return reports;
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <GaiaConfigurationClient/GaiaConfigurationClient.hpp>
+
+namespace Gaia::CameraService
+{
+    /// Roles of threads which serve a camera.
+    enum class ThreadRole : unsigned int
+    {
+        /// Threads which deliver captured pictures, such as callbacks of camera SDKs.
+        Capture = 0,
+        /// Threads which convert and upload pictures into swap chains.
+        Convert = 1,
+        /// Threads which poll the camera device for new pictures.
+        Grabber = 2,
+        /// Thread which runs the event loop of the camera server.
+        Server = 3
+    };
+
+    /**
+     * @brief Pin the calling thread on the given CPU core.
+     * @return True if the thread is pinned, false if the core is negative or pinning failed.
+     */
+    bool PinCurrentThread(int core);
+
+    /**
+     * @brief Parse a list of CPU cores or nodes, such as "2,3,8-11".
+     * @throws std::invalid_argument If the text is not a valid list.
+     */
+    std::vector<int> ParseCoreList(const std::string& text);
+
+    /**
+     * @brief Scheduling policy of threads and memory of a camera.
+     * @details
+     *  The policy of every role is read from the configuration of the camera when it is opened:
+     *  "{Role}Cores" lists the cores threads of the role may run on, such as "2,3" or "8-11",
+     *  and "{Role}Priority" is the SCHED_FIFO priority of them (1 to 98, default 0 means not real-time),
+     *  where the role is "Capture", "Convert", "Grabber" or "Server".
+     *  If the process is not permitted to use SCHED_FIFO, threads fall back to a raised nice value,
+     *  and stay at the normal priority if that is not permitted either.
+     *  "NumaNode" is the NUMA node which swap chain blocks and memory of policy applied threads are allocated on,
+     *  including stacks of worker threads which are touched after the policy is applied.
+     *  Threads enter their roles lazily, so the cost on the capture path is one thread local comparison.
+     */
+    class ThreadScheduler
+    {
+    public:
+        /// Count of thread roles.
+        static constexpr std::size_t RolesCount = 4;
+
+    private:
+        /// Policy of threads in a role.
+        struct RolePolicy
+        {
+            /// Cores to run on, empty means the affinity is not changed.
+            std::vector<int> Cores;
+            /// SCHED_FIFO priority, 0 means the scheduling policy is not changed.
+            int Priority {0};
+        };
+
+        /// Policies indexed by roles.
+        std::array<RolePolicy, RolesCount> Policies;
+        /// NUMA node to allocate memory on, negative value means no preference.
+        int NumaNode {-1};
+        /// Generation of the loaded policies, threads apply policies again once it is changed.
+        std::atomic<unsigned int> Generation {0};
+
+        /// Mutex for reports.
+        mutable std::mutex ReportMutex;
+        /// Descriptions of policies applied to threads of every role, empty if no thread entered the role.
+        std::array<std::string, RolesCount> Reports;
+
+        /// Apply the NUMA memory policy to the calling thread.
+        [[nodiscard]] std::string ApplyMemoryPolicy() const;
+
+    public:
+        /// Get the name of a role, as used in configuration keys.
+        static const char* GetRoleName(ThreadRole role) noexcept;
+
+        /**
+         * @brief Read policies from the configuration.
+         * @pre No thread of the camera is running in any role.
+         */
+        void Load(ConfigurationService::ConfigurationClient& configurator);
+
+        /// Apply the policy of the role to the calling thread.
+        void Apply(ThreadRole role);
+
+        /// Apply the policy of the role to the calling thread, unless it has been applied since the last loading.
+        inline void EnterThread(ThreadRole role)
+        {
+            thread_local const ThreadScheduler* entered_scheduler = nullptr;
+            thread_local unsigned int entered_generation = 0;
+            thread_local ThreadRole entered_role = ThreadRole::Capture;
+            auto generation = Generation.load(std::memory_order_relaxed);
+            if (entered_scheduler == this && entered_generation == generation && entered_role == role) return;
+            Apply(role);
+            entered_scheduler = this;
+            entered_generation = generation;
+            entered_role = role;
+        }
+
+        /**
+         * @brief Place pages of the given memory range on the configured NUMA node.
+         * @return True if the range is bound, false if no node is configured or binding failed.
+         * @details Pages are moved if they are already allocated.
+         */
+        bool BindMemory(void* address, std::size_t size) const;
+
+        /// Get the configured NUMA node, negative value means no preference.
+        [[nodiscard]] inline int GetNumaNode() const noexcept
+        {
+            return NumaNode;
+        }
+
+        /// Get descriptions of applied policies, first is the role name, second is the description.
+        [[nodiscard]] std::vector<std::tuple<std::string, std::string>> GetReports() const;
+    };
+}
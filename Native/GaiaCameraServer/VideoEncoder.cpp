@@ -0,0 +1,235 @@
+#include "VideoEncoder.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <sys/stat.h>
+
+#include "ColorFormat.hpp"
+
+namespace Gaia::CameraService
+{
+    /// Bind the logger.
+    VideoEncoder::VideoEncoder(LogService::LogClient *logger) : Logger(logger)
+    {}
+
+    /// Stop encoding.
+    VideoEncoder::~VideoEncoder()
+    {
+        Stop();
+    }
+
+    /// Start encoding pictures.
+    void VideoEncoder::Start(const std::string &path_prefix,
+                             const std::vector<std::tuple<SwapChain*, std::string>> &pictures,
+                             const Settings &settings)
+    {
+        if (std::atomic_load(&CurrentSession)) throw std::logic_error("Encoder is already started.");
+        if (settings.Codec.size() != 4) throw std::invalid_argument("Codec must be a FourCC code.");
+        if (settings.QueueCapacity == 0) throw std::invalid_argument("Queue capacity must be positive.");
+
+        auto session = std::make_shared<Session>();
+        auto& current_settings = session->CurrentSettings;
+        current_settings = settings;
+        current_settings.WorkersCount = std::max(1u, std::min<unsigned int>(
+                settings.WorkersCount, static_cast<unsigned int>(pictures.size())));
+
+        auto& streams = session->Streams;
+        for (const auto& [chain, format] : pictures)
+        {
+            if (CV_MAT_DEPTH(chain->GetPixelType()) != CV_8U)
+            {
+                Logger->RecordWarning("Picture " + chain->GetPictureName() +
+                                      " is not a 8 bits picture, it will not be encoded.");
+                continue;
+            }
+            auto stream = std::make_unique<Stream>();
+            stream->Chain = chain;
+            stream->Format = format;
+            stream->PathPrefix = path_prefix + "." + chain->GetPictureName();
+            streams.push_back(std::move(stream));
+        }
+        if (streams.empty()) throw std::invalid_argument("No picture to encode.");
+
+        // Workers are stopped before the controlling thread drops its reference, so the session outlives them.
+        auto* session_pointer = session.get();
+        for (unsigned int worker_index = 0; worker_index < current_settings.WorkersCount; ++worker_index)
+        {
+            auto worker = std::make_unique<Worker>();
+            auto* worker_pointer = worker.get();
+            worker->Thread = std::make_unique<Background::BackgroundWorker>(
+                    [this, session_pointer, worker_pointer](const std::atomic_bool& flag){
+                        while (flag)
+                        {
+                            this->EncodeQueuedFrame(*session_pointer, *worker_pointer);
+                        }
+                    });
+            session->Workers.push_back(std::move(worker));
+        }
+
+        EncodedFramesCount = 0;
+        DroppedFramesCount = 0;
+        for (auto& worker : session->Workers)
+        {
+            worker->Thread->Start();
+        }
+        std::atomic_store(&CurrentSession, session);
+        EncodingFlag = true;
+    }
+
+    /// Stop encoding.
+    void VideoEncoder::Stop()
+    {
+        auto session = std::atomic_exchange(&CurrentSession, std::shared_ptr<Session>());
+        if (!session) return;
+        EncodingFlag = false;
+        // Committing threads may still hold the session and enqueue frames, which are discarded with it.
+        for (auto& worker : session->Workers)
+        {
+            worker->Thread->Stop();
+        }
+        for (auto& stream : session->Streams)
+        {
+            if (stream->Writer.isOpened())
+            {
+                stream->Writer.release();
+                Logger->RecordMessage("Video file " + stream->SegmentPath + " closed.");
+            }
+        }
+    }
+
+    /// Enqueue a committed frame.
+    void VideoEncoder::OnPictureCommitted(SwapChain &chain, unsigned int block_id, const FrameMetadata &metadata)
+    {
+        if (!EncodingFlag) return;
+        auto session = std::atomic_load(&CurrentSession);
+        if (!session) return;
+        const auto& streams = session->Streams;
+        auto finder = std::find_if(streams.begin(), streams.end(), [&chain](const std::unique_ptr<Stream>& stream){
+            return stream->Chain == &chain;
+        });
+        if (finder == streams.end()) return;
+
+        auto picture_index = static_cast<unsigned int>(finder - streams.begin());
+        auto& worker = *session->Workers[picture_index % session->Workers.size()];
+        const auto& settings = session->CurrentSettings;
+        std::unique_lock lock(worker.QueueMutex);
+        if (worker.Queue.size() >= settings.QueueCapacity)
+        {
+            ++DroppedFramesCount;
+            if (settings.Policy == DropPolicy::SkipNewest) return;
+            worker.Queue.pop_front();
+        }
+        worker.Queue.push_back({picture_index, block_id, chain.GetCommittedCount(), metadata});
+        lock.unlock();
+        worker.QueueCondition.notify_one();
+    }
+
+    /// Encode a queued frame of the worker.
+    bool VideoEncoder::EncodeQueuedFrame(Session& session, Worker& worker)
+    {
+        std::unique_lock lock(worker.QueueMutex);
+        if (!worker.QueueCondition.wait_for(lock, std::chrono::milliseconds(100), [&worker]{
+            return !worker.Queue.empty();
+        })) return false;
+        auto frame = worker.Queue.front();
+        worker.Queue.pop_front();
+        lock.unlock();
+
+        auto& stream = *session.Streams[frame.PictureIndex];
+        const auto& settings = session.CurrentSettings;
+        if (stream.Failed)
+        {
+            ++DroppedFramesCount;
+            return true;
+        }
+        auto* chain = stream.Chain;
+
+        // Copy the frame out, so the block is released before encoding.
+        chain->ViewBlock(frame.BlockID).copyTo(stream.Frame);
+        // The writer starts to overwrite the block once the writing index wraps around to it.
+        if (chain->GetCommittedCount() - frame.Sequence + 1 >= chain->GetSafeDepth())
+        {
+            ++DroppedFramesCount;
+            return true;
+        }
+
+        if (!stream.Writer.isOpened() ||
+            (settings.SegmentDuration > 0 &&
+             frame.Metadata.Timestamp - stream.SegmentTimestamp >= settings.SegmentDuration))
+        {
+            OpenSegment(settings, stream);
+            stream.SegmentTimestamp = frame.Metadata.Timestamp;
+        }
+        else if (settings.SegmentSize > 0)
+        {
+            struct stat file_status {};
+            if (stat(stream.SegmentPath.c_str(), &file_status) == 0 &&
+                static_cast<std::uint64_t>(file_status.st_size) >= settings.SegmentSize)
+            {
+                OpenSegment(settings, stream);
+                stream.SegmentTimestamp = frame.Metadata.Timestamp;
+            }
+        }
+        if (stream.Failed)
+        {
+            ++DroppedFramesCount;
+            return true;
+        }
+
+        auto bayer_conversion = GetBayerConversion(stream.Format);
+        if (bayer_conversion >= 0)
+        {
+            cv::cvtColor(stream.Frame, stream.ConvertedFrame, bayer_conversion);
+            stream.Writer.write(stream.ConvertedFrame);
+        }
+        else if (stream.Frame.channels() == 4)
+        {
+            cv::cvtColor(stream.Frame, stream.ConvertedFrame, cv::COLOR_BGRA2BGR);
+            stream.Writer.write(stream.ConvertedFrame);
+        }
+        else
+        {
+            stream.Writer.write(stream.Frame);
+        }
+        ++EncodedFramesCount;
+        return true;
+    }
+
+    /// Close the current video file of the stream and open the next one.
+    void VideoEncoder::OpenSegment(const Settings& settings, Stream& stream)
+    {
+        if (stream.Writer.isOpened())
+        {
+            stream.Writer.release();
+            Logger->RecordMessage("Video file " + stream.SegmentPath + " closed.");
+        }
+        stream.SegmentPath = stream.PathPrefix + "." + std::to_string(stream.SegmentIndex++) +
+                settings.Extension;
+
+        const auto& header = stream.Chain->GetHeader();
+        auto is_color = GetBayerConversion(stream.Format) >= 0 || stream.Frame.channels() >= 3;
+        const auto& codec = settings.Codec;
+        if (!stream.Writer.open(stream.SegmentPath, cv::VideoWriter::fourcc(codec[0], codec[1], codec[2], codec[3]),
+                                settings.FrameRate,
+                                cv::Size(static_cast<int>(header.Width), static_cast<int>(header.Height)), is_color))
+        {
+            Logger->RecordError("Failed to open video file " + stream.SegmentPath + " with codec " + codec +
+                                ", picture " + stream.Chain->GetPictureName() + " will not be encoded.");
+            stream.Failed = true;
+        }
+    }
+
+    /// Get the total count of queued frames.
+    std::size_t VideoEncoder::GetQueueDepth()
+    {
+        auto session = std::atomic_load(&CurrentSession);
+        if (!session) return 0;
+        std::size_t depth = 0;
+        for (auto& worker : session->Workers)
+        {
+            std::unique_lock lock(worker->QueueMutex);
+            depth += worker->Queue.size();
+        }
+        return depth;
+    }
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <GaiaBackground/GaiaBackground.hpp>
+#include <GaiaLogClient/GaiaLogClient.hpp>
+
+#include "SwapChain.hpp"
+#include "PictureObserver.hpp"
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Encoder which compresses committed frames of swap chains into segmented video files.
+     * @details
+     *  Committing threads only enqueue the block ID of committed frames into a bounded queue.
+     *  Every picture is encoded by one worker of the pool with an OpenCV video writer,
+     *  a worker copies the frame out of the swap chain block and encodes the copy,
+     *  so the block is only leased until the copy is done.
+     *  When the queue of a worker is full, the oldest queued frame or the new frame is dropped
+     *  according to the drop policy, so capture is never blocked by encoding.
+     *  Video files are rolled when they reach the segment duration or the segment size.
+     *  Committing threads work on a snapshot of the encoding session, so stopping encoding while capturing
+     *  only releases the streams and the workers after the last commit which is using them.
+     */
+    class VideoEncoder : public PictureObserver
+    {
+    public:
+        /// Policy to apply when a frame is committed while the queue is full.
+        enum class DropPolicy
+        {
+            /// Drop the oldest queued frame, so the encoded video stays close to real time.
+            DropOldest,
+            /// Skip the new frame, so queued frames are encoded without gaps.
+            SkipNewest
+        };
+
+        /// Settings of an encoding session.
+        struct Settings
+        {
+            /// FourCC of the codec, such as "MJPG" or "avc1".
+            std::string Codec {"MJPG"};
+            /// Extension of video files, such as ".avi" or ".mp4".
+            std::string Extension {".avi"};
+            /// Frame rate written into video files.
+            double FrameRate {30.0};
+            /// Max duration of a video file in nanoseconds, 0 means unlimited.
+            std::uint64_t SegmentDuration {0};
+            /// Max size of a video file in bytes, 0 means unlimited.
+            std::uint64_t SegmentSize {0};
+            /// Count of encoding threads.
+            unsigned int WorkersCount {1};
+            /// Max count of queued frames of every worker.
+            std::size_t QueueCapacity {8};
+            /// Policy to apply when a queue is full.
+            DropPolicy Policy {DropPolicy::DropOldest};
+        };
+
+    private:
+        /// Frame waiting to be encoded.
+        struct PendingFrame
+        {
+            unsigned int PictureIndex;
+            unsigned int BlockID;
+            unsigned long Sequence;
+            FrameMetadata Metadata;
+        };
+
+        /// Encoding state of a picture, only accessed by the worker which encodes it.
+        struct Stream
+        {
+            SwapChain* Chain {nullptr};
+            /// Color format of the picture, such as "BGR" or "BayerRG".
+            std::string Format;
+            /// Path prefix of video files of this picture.
+            std::string PathPrefix;
+            cv::VideoWriter Writer;
+            /// Path of the video file being written.
+            std::string SegmentPath;
+            /// Index of the next video file.
+            unsigned int SegmentIndex {0};
+            /// Timestamp of the first frame in the video file being written.
+            std::uint64_t SegmentTimestamp {0};
+            /// Whether the video writer can not be opened, frames are dropped after that.
+            bool Failed {false};
+            /// Copy of the frame being encoded.
+            cv::Mat Frame;
+            /// Frame converted for the video writer.
+            cv::Mat ConvertedFrame;
+        };
+
+        /// Encoding thread with its own queue.
+        struct Worker
+        {
+            std::mutex QueueMutex;
+            std::condition_variable QueueCondition;
+            std::deque<PendingFrame> Queue;
+            std::unique_ptr<Background::BackgroundWorker> Thread;
+        };
+
+        /// Encoding session, shared by the controlling thread, committing threads and workers.
+        struct Session
+        {
+            /// Settings of the session.
+            Settings CurrentSettings;
+            /// Encoding states of pictures, picture i is encoded by worker (i % workers count).
+            std::vector<std::unique_ptr<Stream>> Streams;
+            /// Pool of encoding threads.
+            std::vector<std::unique_ptr<Worker>> Workers;
+        };
+
+        /// Logger of the host server.
+        LogService::LogClient* Logger;
+
+        /// Whether committed frames should be enqueued or not.
+        std::atomic_bool EncodingFlag {false};
+
+        /// Snapshot of the current session, nullptr if encoding is not started, replaced by the controlling thread.
+        std::shared_ptr<Session> CurrentSession;
+
+        /// Count of encoded frames.
+        std::atomic<unsigned long> EncodedFramesCount {0};
+        /// Count of frames dropped by the queue policy or overwritten before they are copied.
+        std::atomic<unsigned long> DroppedFramesCount {0};
+
+        /// Encode a queued frame of the worker, return false if no frame is queued.
+        bool EncodeQueuedFrame(Session& session, Worker& worker);
+        /// Close the current video file of the stream and open the next one.
+        void OpenSegment(const Settings& settings, Stream& stream);
+
+    public:
+        /// Bind the logger.
+        explicit VideoEncoder(LogService::LogClient* logger);
+        /// Stop encoding.
+        ~VideoEncoder() override;
+
+        VideoEncoder(const VideoEncoder&) = delete;
+        VideoEncoder& operator=(const VideoEncoder&) = delete;
+
+        /**
+         * @brief Start encoding pictures.
+         * @param path_prefix Path prefix of video files, such as "/data/daheng_camera.0.20220101-120000",
+         *                    files are named as "<prefix>.<picture>.<segment index><extension>".
+         * @param pictures List of tuples, first is the swap chain of the picture, second is its color format.
+         * @param settings Settings of the session.
+         */
+        void Start(const std::string& path_prefix, const std::vector<std::tuple<SwapChain*, std::string>>& pictures,
+                   const Settings& settings);
+        /// Stop encoding, queued frames are discarded and video files are closed.
+        void Stop();
+
+        /// Whether this encoder is encoding or not.
+        [[nodiscard]] inline bool IsEncoding() const noexcept
+        {
+            return EncodingFlag;
+        }
+
+        /// Enqueue a committed frame, frames of pictures not being encoded are ignored.
+        void OnPictureCommitted(SwapChain& chain, unsigned int block_id, const FrameMetadata& metadata) override;
+
+        /// Get the count of encoded frames.
+        [[nodiscard]] inline unsigned long GetEncodedFramesCount() const noexcept
+        {
+            return EncodedFramesCount;
+        }
+        /// Get the count of dropped frames.
+        [[nodiscard]] inline unsigned long GetDroppedFramesCount() const noexcept
+        {
+            return DroppedFramesCount;
+        }
+        /// Get the total count of queued frames of all workers.
+        [[nodiscard]] std::size_t GetQueueDepth();
+    };
+}
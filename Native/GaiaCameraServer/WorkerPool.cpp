@@ -0,0 +1,148 @@
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace Gaia::CameraService
+{
+    /// Launch the workers.
+    WorkerPool::WorkerPool(unsigned int workers_count)
+    {
+        if (workers_count == 0)
+        {
+            workers_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+        }
+        Workers.reserve(workers_count);
+        for (auto worker_index = 0u; worker_index < workers_count; ++worker_index)
+        {
+            Workers.emplace_back([this]{
+                RunWorker();
+            });
+        }
+    }
+
+    /// Stop the workers.
+    WorkerPool::~WorkerPool()
+    {
+        {
+            std::unique_lock lock(TaskMutex);
+            LifeFlag = false;
+        }
+        TaskNotifier.notify_all();
+        for (auto& worker : Workers)
+        {
+            if (worker.joinable()) worker.join();
+        }
+    }
+
+    /// Main loop of a worker.
+    void WorkerPool::RunWorker()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(TaskMutex);
+                TaskNotifier.wait(lock, [this]{
+                    return !Tasks.empty() || !LifeFlag;
+                });
+                if (Tasks.empty()) return;
+                task = std::move(Tasks.front());
+                Tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    /// Take a queued task.
+    bool WorkerPool::TryRunTask()
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(TaskMutex);
+            if (Tasks.empty()) return false;
+            task = std::move(Tasks.front());
+            Tasks.pop_front();
+        }
+        task();
+        return true;
+    }
+
+    /// Run bands on the workers and the invoker thread.
+    void WorkerPool::ParallelFor(std::size_t count, const RangeFunction& function, std::size_t minimum_band)
+    {
+        if (count == 0) return;
+        minimum_band = std::max<std::size_t>(minimum_band, 1);
+        const auto bands_count = std::min(Workers.size() + 1, (count + minimum_band - 1) / minimum_band);
+        if (bands_count <= 1)
+        {
+            function(0, count);
+            return;
+        }
+
+        /// State shared with queued bands, which may release it after the invoker returns.
+        struct Join
+        {
+            std::mutex Mutex;
+            std::condition_variable Notifier;
+            std::size_t PendingCount {0};
+            std::exception_ptr Exception {nullptr};
+        };
+        auto join = std::make_shared<Join>();
+        join->PendingCount = bands_count - 1;
+
+        auto run_band = [&function, count, bands_count](std::size_t band_index){
+            function(count * band_index / bands_count, count * (band_index + 1) / bands_count);
+        };
+
+        {
+            std::unique_lock lock(TaskMutex);
+            for (std::size_t band_index = 1; band_index < bands_count; ++band_index)
+            {
+                Tasks.emplace_back([join, run_band, band_index]{
+                    std::exception_ptr exception {nullptr};
+                    try
+                    {
+                        run_band(band_index);
+                    }catch (...)
+                    {
+                        exception = std::current_exception();
+                    }
+                    std::unique_lock join_lock(join->Mutex);
+                    if (exception && !join->Exception) join->Exception = exception;
+                    if (--join->PendingCount == 0) join->Notifier.notify_all();
+                });
+            }
+        }
+        TaskNotifier.notify_all();
+
+        std::exception_ptr exception {nullptr};
+        try
+        {
+            run_band(0);
+        }catch (...)
+        {
+            exception = std::current_exception();
+        }
+
+        // Help with queued bands instead of sleeping, they may belong to this invocation.
+        while (true)
+        {
+            {
+                std::unique_lock join_lock(join->Mutex);
+                if (join->PendingCount == 0) break;
+            }
+            if (!TryRunTask()) break;
+        }
+        {
+            std::unique_lock join_lock(join->Mutex);
+            join->Notifier.wait(join_lock, [&join]{
+                return join->PendingCount == 0;
+            });
+            if (!exception) exception = join->Exception;
+        }
+        if (exception) std::rethrow_exception(exception);
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Pool of long-lived worker threads shared by all cameras hosted in one process.
+     * @details
+     *  Drivers split per-picture conversions into bands with ParallelFor(), the invoker thread takes part in
+     *  the work, so a conversion never waits for a free worker and never deadlocks even if all workers are
+     *  busy with conversions of other cameras.
+     */
+    class WorkerPool
+    {
+    public:
+        /// Function of a band, invoked with the range [begin, end) of items.
+        using RangeFunction = std::function<void(std::size_t begin, std::size_t end)>;
+
+    private:
+        /// Worker threads.
+        std::vector<std::thread> Workers;
+
+        /// Mutex for the task queue.
+        std::mutex TaskMutex;
+        /// Notified when a task is queued or the pool is stopping.
+        std::condition_variable TaskNotifier;
+        /// Queued tasks.
+        std::deque<std::function<void()>> Tasks;
+        /// Life flag of the workers.
+        bool LifeFlag {true};
+
+        /// Main loop of a worker.
+        void RunWorker();
+
+        /// Take a queued task, returns false if the queue is empty.
+        bool TryRunTask();
+
+    public:
+        /**
+         * @brief Launch the workers.
+         * @param workers_count Count of worker threads, 0 means the count of hardware threads minus 1.
+         */
+        explicit WorkerPool(unsigned int workers_count = 0);
+
+        /// Stop the workers, queued tasks are still finished.
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        /**
+         * @brief Split [0, count) into bands and run them on the workers and the invoker thread.
+         * @param count Count of items.
+         * @param function Function invoked once for every band.
+         * @param minimum_band Minimum count of items in a band.
+         * @details
+         *  Blocks until all bands are done. If any band throws an exception, the first one will be rethrown.
+         */
+        void ParallelFor(std::size_t count, const RangeFunction& function, std::size_t minimum_band = 1);
+
+        /// Get the count of worker threads.
+        [[nodiscard]] inline std::size_t GetWorkersCount() const noexcept
+        {
+            return Workers.size();
+        }
+    };
+}
@@ -0,0 +1,255 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <GaiaBackground/GaiaBackground.hpp>
+#include <GaiaCameraClient/GaiaCameraClient.hpp>
+#include <GaiaCameraServer/GaiaCameraServer.hpp>
+#include <GaiaCameraBridge/BridgeServer.hpp>
+#include <GaiaMirrorServer/MirrorDriver.hpp>
+
+using namespace Gaia::CameraService;
+
+namespace
+{
+    /// Width of the test picture.
+    constexpr int PictureWidth = 64;
+    /// Height of the test picture.
+    constexpr int PictureHeight = 48;
+    /// Exposure stamped on every test frame.
+    constexpr unsigned int PictureExposure = 1234;
+    /// Gain stamped on every test frame.
+    constexpr double PictureGain = 2.5;
+
+    /// Driver which commits frames filled with their frame numbers, with capture times derived from them.
+    class PatternDriver : public CameraDriverInterface
+    {
+    private:
+        /// Background thread which generates frames.
+        Gaia::Background::BackgroundWorker Generator;
+        /// Swap chain of the picture "main".
+        SwapChain* Chain {nullptr};
+        /// Count of generated frames.
+        std::uint64_t FramesCount {0};
+
+        /// Fill and commit a frame.
+        void GenerateFrame()
+        {
+            ++FramesCount;
+            std::memset(Chain->GetWriter().GetPointer(), static_cast<int>(FramesCount % 251),
+                        static_cast<std::size_t>(PictureWidth) * PictureHeight * 3);
+            FrameMetadata metadata;
+            metadata.Timestamp = 1000000000000000000ull + FramesCount * 1000;
+            metadata.MonotonicTimestamp = FramesCount * 2000;
+            metadata.DeviceTimestamp = FramesCount * 3;
+            metadata.Exposure = PictureExposure;
+            metadata.Gain = PictureGain;
+            CommitPicture(*Chain, metadata);
+            ++RetrievedPicturesCount;
+        }
+
+    public:
+        PatternDriver() : CameraDriverInterface("loopback_source"),
+            Generator([this](const std::atomic_bool& flag){
+                while (flag)
+                {
+                    this->GenerateFrame();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                }
+            })
+        {}
+
+        ~PatternDriver() override
+        {
+            Close();
+        }
+
+        std::vector<std::tuple<std::string, std::string>> GetPictureNames() override
+        {
+            return {{"main", "BGR"}};
+        }
+
+        void Open() override
+        {
+            auto header = SwapChain::GenerateHeader(CV_8UC3, PictureWidth, PictureHeight);
+            Chain = &CreateSwapChain("main", header, static_cast<long>(PictureWidth) * PictureHeight * 3, 10, 1);
+            FramesCount = 0;
+            Generator.Start();
+        }
+
+        void Close() override
+        {
+            Generator.Stop();
+            Chain = nullptr;
+            ReleaseSwapChains();
+        }
+
+        bool IsAlive() override
+        {
+            return Chain != nullptr;
+        }
+
+        bool SetExposure(unsigned int microseconds) override
+        {
+            return false;
+        }
+
+        unsigned int GetExposure() override
+        {
+            return PictureExposure;
+        }
+
+        bool SetGain(double gain) override
+        {
+            return false;
+        }
+
+        double GetGain() override
+        {
+            return PictureGain;
+        }
+
+        bool SetWhiteBalanceRed(double ratio) override
+        {
+            return false;
+        }
+
+        double GetWhiteBalanceRed() override
+        {
+            return 0.0;
+        }
+
+        bool SetWhiteBalanceBlue(double ratio) override
+        {
+            return false;
+        }
+
+        double GetWhiteBalanceBlue() override
+        {
+            return 0.0;
+        }
+
+        bool SetWhiteBalanceGreen(double ratio) override
+        {
+            return false;
+        }
+
+        double GetWhiteBalanceGreen() override
+        {
+            return 0.0;
+        }
+    };
+
+    /// Wait until the condition holds, return false if it does not hold within the timeout.
+    bool WaitFor(const std::function<bool()>& condition,
+                 std::chrono::milliseconds timeout = std::chrono::milliseconds(5000))
+    {
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (std::chrono::steady_clock::now() < deadline)
+        {
+            try
+            {
+                if (condition()) return true;
+            }catch (std::exception& error)
+            {}
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return false;
+    }
+
+    /// Invoke the action when leaving the scope, so servers are shut down even if an assertion fails.
+    struct ScopeGuard
+    {
+        std::function<void()> Action;
+
+        ~ScopeGuard()
+        {
+            Action();
+        }
+    };
+}
+
+/// Frames of a camera bridged over 127.0.0.1 are mirrored with their pixels, sequences, capture times and settings.
+TEST(BridgeLoopbackTest, MirrorsFramesWithMetadata)
+{
+    auto connection = std::make_shared<sw::redis::Redis>("tcp://127.0.0.1:6379");
+    try
+    {
+        connection->ping();
+    }catch (sw::redis::Error& error)
+    {
+        GTEST_SKIP() << "Redis server is not available on 127.0.0.1:6379.";
+    }
+
+    const auto device_index = static_cast<unsigned int>(getpid());
+    const auto source_name = "loopback_source." + std::to_string(device_index);
+    const auto mirror_name = "mirror." + std::to_string(device_index);
+    const auto bridge_port = 20000 + device_index % 20000;
+    connection->set("configurations/" + mirror_name + "/Host", "127.0.0.1");
+    connection->set("configurations/" + mirror_name + "/Port", std::to_string(bridge_port));
+
+    CameraServer source_server(std::make_unique<PatternDriver>(), device_index);
+    CameraServer mirror_server(std::make_unique<MirrorDriver>(), device_index);
+    std::unique_ptr<BridgeServer> bridge;
+    std::thread source_thread, bridge_thread, mirror_thread;
+    // Servers are shut down from the mirror to the source, so no side waits for a stopped peer.
+    ScopeGuard shutdown_guard {[&]{
+        if (mirror_thread.joinable())
+        {
+            connection->publish("cameras/" + mirror_name + "/command", "shutdown");
+            mirror_thread.join();
+        }
+        if (bridge_thread.joinable())
+        {
+            bridge->Stop();
+            bridge_thread.join();
+        }
+        bridge.reset();
+        if (source_thread.joinable())
+        {
+            connection->publish("cameras/" + source_name + "/command", "shutdown");
+            source_thread.join();
+        }
+        connection->del("configurations/" + mirror_name + "/Host");
+        connection->del("configurations/" + mirror_name + "/Port");
+    }};
+
+    source_thread = std::thread([&source_server]{ source_server.Launch(); });
+    ASSERT_TRUE(WaitFor([&]{ return connection->sismember("cameras/" + source_name + "/pictures", "main"); }));
+
+    bridge = std::make_unique<BridgeServer>("loopback_source", device_index, bridge_port);
+    bridge_thread = std::thread([&bridge]{ bridge->Launch(); });
+
+    mirror_thread = std::thread([&mirror_server]{ mirror_server.Launch(); });
+    ASSERT_TRUE(WaitFor([&]{ return connection->sismember("cameras/" + mirror_name + "/pictures", "main"); }));
+
+    CameraClient mirror_client("mirror", device_index, connection);
+    auto reader = mirror_client.GetReader("main");
+    const auto* stamps = reader.GetStamps();
+    ASSERT_NE(stamps, nullptr);
+    ASSERT_TRUE(WaitFor([stamps]{ return stamps->GetCount() >= 10; }));
+
+    auto sequence = stamps->GetCount();
+    auto stamp = stamps->Read(sequence);
+    ASSERT_TRUE(stamp.has_value());
+    auto picture = reader.ViewBlock(stamp->BlockID).clone();
+    // The stamp is re-validated after the copy, so the pixels belong to it.
+    ASSERT_TRUE(stamps->Read(sequence).has_value());
+
+    const auto frame_number = stamp->DeviceTimestamp / 3;
+    EXPECT_GT(frame_number, 0u);
+    EXPECT_EQ(stamp->DeviceTimestamp % 3, 0u);
+    EXPECT_EQ(stamp->Timestamp, 1000000000000000000ull + frame_number * 1000);
+    EXPECT_EQ(stamp->MonotonicTimestamp, frame_number * 2000);
+    EXPECT_EQ(stamp->SourceSequence, frame_number);
+    EXPECT_EQ(stamp->Exposure, PictureExposure);
+    EXPECT_DOUBLE_EQ(stamp->Gain, PictureGain);
+    ASSERT_EQ(picture.cols, PictureWidth);
+    ASSERT_EQ(picture.rows, PictureHeight);
+    ASSERT_EQ(picture.type(), CV_8UC3);
+    EXPECT_EQ(picture.ptr(PictureHeight - 1)[PictureWidth * 3 - 1], static_cast<std::uint8_t>(frame_number % 251));
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include <GaiaCameraServer/CaptureClock.hpp>
+
+using namespace Gaia::CameraService;
+
+TEST(ClockMapperTest, FitsSlopeAndOffset)
+{
+    ClockMapper mapper;
+    // A device clock of 1 MHz, 50 ppm fast, with delivery latency jitter of up to 20 microseconds.
+    constexpr double slope = 1000.0 / 1.00005;
+    constexpr std::uint64_t host_origin = 5000000000000ull;
+    EXPECT_FALSE(mapper.Map(0));
+    for (std::uint64_t index = 0; index < 2000; ++index)
+    {
+        auto device_time = 1000000 + index * 33333;
+        auto latency = 100000 + (index * 7919) % 20000;
+        auto host_time = host_origin + static_cast<std::uint64_t>(static_cast<double>(device_time) * slope) + latency;
+        mapper.AddSample(device_time, host_time);
+    }
+    auto model = mapper.GetModel();
+    ASSERT_TRUE(model);
+    EXPECT_NEAR(model->Slope, slope, 1e-4);
+
+    // Mapped times are within the jitter of the true capture time plus the mean latency.
+    std::uint64_t device_time = 1000000 + 1500 * 33333;
+    auto mapped = mapper.Map(device_time);
+    ASSERT_TRUE(mapped);
+    auto expected = host_origin + static_cast<std::uint64_t>(static_cast<double>(device_time) * slope) + 110000;
+    EXPECT_NEAR(static_cast<double>(*mapped), static_cast<double>(expected), 20000.0);
+}
+
+TEST(ClockMapperTest, RestartsWhenDeviceClockGoesBack)
+{
+    ClockMapper mapper;
+    for (std::uint64_t index = 0; index < 100; ++index)
+    {
+        mapper.AddSample(1000000 + index * 1000, 2000000000 + index * 1000);
+    }
+    ASSERT_TRUE(mapper.GetModel());
+    mapper.AddSample(10, 3000000000);
+    EXPECT_FALSE(mapper.GetModel());
+    EXPECT_FALSE(mapper.Map(20));
+}
+
+TEST(ClockMapperTest, RejectsInvalidForgettingFactor)
+{
+    EXPECT_THROW(ClockMapper(0.0), std::invalid_argument);
+    EXPECT_THROW(ClockMapper(1.0), std::invalid_argument);
+}
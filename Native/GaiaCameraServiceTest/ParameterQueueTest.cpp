@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <GaiaCameraClient/ParameterQueue.hpp>
+
+using namespace Gaia::CameraService;
+
+namespace
+{
+    /// Generate a block name which is unique to this process.
+    std::string GenerateTestBlockName(const std::string& name)
+    {
+        return "test." + std::to_string(getpid()) + "." + name + ".parameters";
+    }
+}
+
+TEST(ParameterQueueTest, PushPopWrap)
+{
+    auto block_name = GenerateTestBlockName("wrap");
+    auto server = std::make_unique<ParameterQueue>(block_name, 3);
+    ParameterQueue client(block_name);
+    ASSERT_TRUE(client.IsProducer());
+    EXPECT_FALSE(server->IsProducer());
+
+    // Capacity is rounded up to 4.
+    for (int index = 0; index < 4; ++index) EXPECT_TRUE(client.PushGain(index));
+    EXPECT_FALSE(client.PushGain(4));
+    EXPECT_EQ(client.GetPendingCount(), 4u);
+
+    // Indices wrap around the ring many times, commands stay in order.
+    double expected = 0;
+    for (int index = 4; index < 100; ++index)
+    {
+        auto command = server->Pop();
+        ASSERT_TRUE(command);
+        EXPECT_EQ(command->Type, ParameterQueue::Command::Types::Gain);
+        EXPECT_EQ(command->Values[0], expected++);
+        server->Acknowledge(true, 10);
+        EXPECT_TRUE(client.PushGain(index));
+    }
+    while (auto command = server->Pop()) EXPECT_EQ(command->Values[0], expected++);
+    EXPECT_EQ(expected, 100);
+    EXPECT_EQ(client.GetPendingCount(), 0u);
+    EXPECT_EQ(client.GetAppliedCount(), 96u);
+    EXPECT_EQ(client.GetLastLatency(), 10u);
+}
+
+TEST(ParameterQueueTest, SingleProducer)
+{
+    auto block_name = GenerateTestBlockName("producer");
+    auto server = std::make_unique<ParameterQueue>(block_name, 4);
+    auto client = std::make_unique<ParameterQueue>(block_name);
+    EXPECT_THROW(ParameterQueue another_client(block_name), std::runtime_error);
+    client.reset();
+    ParameterQueue next_client(block_name);
+    EXPECT_TRUE(next_client.IsProducer());
+}
+
+TEST(ParameterQueueTest, RestartReuse)
+{
+    auto block_name = GenerateTestBlockName("restart");
+    auto server = std::make_unique<ParameterQueue>(block_name, 4);
+    ParameterQueue client(block_name);
+    auto epoch = client.GetServerEpoch();
+    EXPECT_TRUE(client.IsServerAlive());
+    EXPECT_TRUE(client.PushExposure(1000));
+
+    // Nothing is pushed while the server is stopped.
+    server.reset();
+    EXPECT_FALSE(client.IsServerAlive());
+    EXPECT_FALSE(client.PushExposure(2000));
+
+    // A restarted server consumes the same block, commands pushed before the restart are kept.
+    server = std::make_unique<ParameterQueue>(block_name, 4);
+    EXPECT_TRUE(client.IsServerAlive());
+    EXPECT_EQ(client.GetServerEpoch(), epoch + 1);
+    EXPECT_TRUE(client.PushExposure(3000));
+    auto first = server->Pop();
+    auto second = server->Pop();
+    ASSERT_TRUE(first && second);
+    EXPECT_EQ(first->Values[0], 1000);
+    EXPECT_EQ(second->Values[0], 3000);
+    EXPECT_FALSE(server->Pop());
+
+    // A server with another capacity replaces the block, the old producer has to reopen it.
+    server = std::make_unique<ParameterQueue>(block_name, 16);
+    EXPECT_FALSE(client.IsServerAlive());
+    EXPECT_FALSE(client.PushExposure(4000));
+    ParameterQueue reopened_client(block_name);
+    EXPECT_TRUE(reopened_client.PushExposure(5000));
+    auto command = server->Pop();
+    ASSERT_TRUE(command);
+    EXPECT_EQ(command->Values[0], 5000);
+
+    // Blocks of parameter queues outlive servers, so the test removes it.
+    server.reset();
+    shm_unlink(block_name.c_str());
+}
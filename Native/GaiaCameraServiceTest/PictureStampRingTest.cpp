@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+#include <GaiaCameraClient/PictureStampRing.hpp>
+
+using namespace Gaia::CameraService;
+
+TEST(PictureStampRingTest, OverwriteDetection)
+{
+    auto block_name = "test." + std::to_string(getpid()) + ".main.stamps";
+    PictureStampRing writer(block_name, 4);
+    PictureStampRing reader(block_name);
+    EXPECT_FALSE(reader.Read(0));
+    EXPECT_FALSE(reader.Read(1));
+
+    for (std::uint64_t sequence = 1; sequence <= 10; ++sequence)
+    {
+        PictureStamp stamp;
+        stamp.Sequence = sequence;
+        stamp.Timestamp = sequence * 1000;
+        stamp.BlockID = static_cast<std::uint32_t>(sequence % 4);
+        writer.Write(stamp);
+    }
+    EXPECT_EQ(reader.GetCount(), 10u);
+
+    // The slot after the latest stamp is the next to be written, so only capacity - 1 stamps are readable.
+    for (std::uint64_t sequence = 8; sequence <= 10; ++sequence)
+    {
+        auto stamp = reader.Read(sequence);
+        ASSERT_TRUE(stamp);
+        EXPECT_EQ(stamp->Sequence, sequence);
+        EXPECT_EQ(stamp->Timestamp, sequence * 1000);
+    }
+    for (std::uint64_t sequence = 1; sequence <= 7; ++sequence)
+    {
+        EXPECT_FALSE(reader.Read(sequence)) << "Sequence " << sequence << " is overwritten.";
+    }
+    EXPECT_FALSE(reader.Read(11));
+}
+
+TEST(PictureStampRingTest, BlockGenerations)
+{
+    auto block_name = "test." + std::to_string(getpid()) + ".generations.stamps";
+    PictureStampRing writer(block_name, 4);
+    PictureStampRing reader(block_name);
+    EXPECT_EQ(reader.GetBlockGeneration(1), 0u);
+    writer.IncreaseBlockGeneration(1);
+    EXPECT_EQ(reader.GetBlockGeneration(1), 1u);
+    EXPECT_EQ(reader.GetBlockGeneration(0), 0u);
+    EXPECT_EQ(reader.GetBlockGeneration(4), 0u);
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <GaiaCameraServer/RecordingReader.hpp>
+
+using namespace Gaia::CameraService;
+
+namespace
+{
+    /// Size of raw pixels of every test frame.
+    constexpr std::size_t PayloadSize = 6000;
+
+    /// Append a frame record with pixels filled by its sequence number.
+    void AppendFrame(std::vector<char>& file, std::uint64_t sequence)
+    {
+        Recording::FrameHeader header {};
+        header.Magic = Recording::FrameMagic;
+        header.PictureIndex = 0;
+        header.Sequence = sequence;
+        header.Timestamp = sequence * 1000000;
+        header.MonotonicTimestamp = sequence * 2000000;
+        header.DeviceTimestamp = sequence * 3;
+        header.Width = 100;
+        header.Height = 20;
+        header.PayloadSize = PayloadSize;
+        auto offset = file.size();
+        file.resize(offset + Recording::AlignRecordSize(sizeof(header) + PayloadSize), 0);
+        std::memcpy(file.data() + offset, &header, sizeof(header));
+        std::memset(file.data() + offset + sizeof(header), static_cast<int>(sequence), PayloadSize);
+    }
+
+    /// Write a segment without a footer, as left by a crashed recorder, and return its path.
+    std::string WriteSegment(std::uint64_t frames_count, std::size_t truncated_size)
+    {
+        std::vector<char> file(Recording::RecordAlignment, 0);
+        Recording::SegmentHeader header {};
+        Recording::FillSegmentHeader(header, 0, 1000, "test_camera.0", {{"main", "BGR"}});
+        std::memcpy(file.data(), &header, sizeof(header));
+        for (std::uint64_t sequence = 1; sequence <= frames_count; ++sequence) AppendFrame(file, sequence);
+        file.resize(file.size() - truncated_size);
+
+        auto path = testing::TempDir() + "recording_" + std::to_string(getpid()) + ".0.gcr";
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        stream.write(file.data(), static_cast<std::streamsize>(file.size()));
+        return path;
+    }
+}
+
+TEST(RecordingReaderTest, RecoversSegmentWithoutFooter)
+{
+    auto path = WriteSegment(5, 0);
+    {
+        RecordingReader reader(path);
+        EXPECT_EQ(reader.GetHeader().PicturesCount, 1u);
+        EXPECT_STREQ(reader.GetHeader().Pictures[0].Name, "main");
+        const auto& entries = reader.GetEntries();
+        ASSERT_EQ(entries.size(), 5u);
+        for (std::uint64_t index = 0; index < entries.size(); ++index)
+        {
+            const auto& entry = entries[index];
+            EXPECT_EQ(entry.Sequence, index + 1);
+            EXPECT_EQ(entry.Timestamp, (index + 1) * 1000000);
+            EXPECT_EQ(entry.MonotonicTimestamp, (index + 1) * 2000000);
+            EXPECT_EQ(entry.DeviceTimestamp, (index + 1) * 3);
+            EXPECT_EQ(reader.GetFrameHeader(entry).PayloadSize, PayloadSize);
+            EXPECT_EQ(reader.GetFramePixels(entry)[PayloadSize - 1], static_cast<std::uint8_t>(index + 1));
+        }
+    }
+    std::remove(path.c_str());
+}
+
+TEST(RecordingReaderTest, DropsTruncatedRecord)
+{
+    // The last record is cut in the middle of its pixels.
+    auto path = WriteSegment(4, 3000);
+    {
+        RecordingReader reader(path);
+        ASSERT_EQ(reader.GetEntries().size(), 3u);
+        EXPECT_EQ(reader.GetEntries().back().Sequence, 3u);
+    }
+    std::remove(path.c_str());
+}
+
+TEST(RecordingReaderTest, RejectsOtherFiles)
+{
+    auto path = testing::TempDir() + "not_recording_" + std::to_string(getpid());
+    {
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        std::vector<char> content(Recording::RecordAlignment * 2, 'x');
+        stream.write(content.data(), static_cast<std::streamsize>(content.size()));
+    }
+    EXPECT_THROW(RecordingReader reader(path), std::runtime_error);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,34 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+#include <GaiaCameraServer/WorkerPool.hpp>
+
+using namespace Gaia::CameraService;
+
+TEST(WorkerPoolTest, CoversAllItemsOnce)
+{
+    WorkerPool pool(3);
+    std::vector<std::atomic<int>> visits(1000);
+    pool.ParallelFor(visits.size(), [&visits](std::size_t begin, std::size_t end){
+        for (auto index = begin; index < end; ++index) ++visits[index];
+    }, 16);
+    for (const auto& count : visits) EXPECT_EQ(count.load(), 1);
+}
+
+TEST(WorkerPoolTest, PropagatesExceptions)
+{
+    WorkerPool pool(3);
+    std::atomic<std::size_t> visited_count {0};
+    EXPECT_THROW(pool.ParallelFor(64, [&visited_count](std::size_t begin, std::size_t end){
+        visited_count += end - begin;
+        if (begin == 0) throw std::runtime_error("Band failed.");
+    }), std::runtime_error);
+    // Other bands are still finished before the exception is rethrown.
+    EXPECT_EQ(visited_count.load(), 64u);
+
+    // The pool is still usable after an exception.
+    std::atomic<std::size_t> count {0};
+    pool.ParallelFor(64, [&count](std::size_t begin, std::size_t end){ count += end - begin; });
+    EXPECT_EQ(count.load(), 64u);
+}
@@ -83,6 +83,9 @@ int main(int arguments_count, char** arguments)
 
     auto title_name = camera_type + "-" + std::to_string(camera_index) + ": " + picture_name;
 
+    // Buffers are reused between frames.
+    cv::Mat picture;
+    cv::Mat resized_picture;
     // Max 60 FPS
     while (true)
     {
@@ -90,7 +93,7 @@ int main(int arguments_count, char** arguments)
 
         if (key == 27) break;
 
-        auto picture = reader.Read();
+        reader.ReadInto(picture);
 
         if (key == 's')
         {
@@ -109,9 +112,13 @@ int main(int arguments_count, char** arguments)
 
         if (resize)
         {
-            cv::resize(picture, picture,
+            cv::resize(picture, resized_picture,
                        cv::Size(static_cast<int>(resize_width), static_cast<int>(resize_height)));
+            cv::imshow(title_name, resized_picture);
+        }
+        else
+        {
+            cv::imshow(title_name, picture);
         }
-        cv::imshow(title_name, picture);
     }
 }
\ No newline at end of file
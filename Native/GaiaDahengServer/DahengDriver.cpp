@@ -2,6 +2,7 @@
 
 #include <GxIAPI.h>
 #include <DxImageProc.h>
+#include <cstring>
 
 namespace Gaia::CameraService
 {
@@ -30,6 +31,9 @@ namespace Gaia::CameraService
     void DahengDriver::OnPictureCapture(void *parameters_package)
     {
         auto* parameters = static_cast<GX_FRAME_CALLBACK_PARAM*>(parameters_package);
+        EnterThread(ThreadRole::Capture);
+        // Stamped before any conversion, so the capture time does not include the processing time.
+        auto capture_time = CaptureTime::Now(parameters->nTimestamp);
 
         auto pixel_type = static_cast<GX_PIXEL_FORMAT_ENTRY>(parameters->nPixelFormat);
         DX_PIXEL_COLOR_FILTER converter_id = BAYERRG;
@@ -49,28 +53,29 @@ namespace Gaia::CameraService
 
         RetrievedPicturesCount++;
 
+        // The raw picture is published as it is captured, so it is not flipped.
+        if (RawChain)
+        {
+            auto raw_size = static_cast<std::size_t>(parameters->nWidth) * parameters->nHeight;
+            auto& raw_writer = RawChain->GetWriter();
+            if (raw_size <= static_cast<std::size_t>(raw_writer.GetMaxSize()))
+            {
+                std::memcpy(raw_writer.GetPointer(), parameters->pImgBuf, raw_size);
+                CommitPicture(*RawChain, capture_time);
+            }
+        }
+
         cv::Mat picture(cv::Size(parameters->nWidth, parameters->nHeight), CV_8UC3);
         auto status = DxRaw8toRGB24(const_cast<void*>(parameters->pImgBuf), picture.data,
                       static_cast<VxUint32>(parameters->nWidth), static_cast<VxUint32>(parameters->nHeight),
                       RAW2RGB_NEIGHBOUR, converter_id, false);
-        if (IsRequiredFlip())
-        {
-            cv::flip(picture, picture, -1);
-        }
-        auto* writer = Writers[SwapChainReadyIndex].get();
-        writer->Write(picture);
-        UpdatePictureBlockID(std::string("main"), SwapChainReadyIndex);
-        ++SwapChainReadyIndex;
-        if (SwapChainReadyIndex >= SwapChainTotalCount)
-        {
-            SwapChainReadyIndex = 0;
-        }
+        WritePicture(*MainChain, picture, IsRequiredFlip());
         if (status != DX_STATUS::DX_OK)
         {
             GetLogger()->RecordError("Failed to convert captured picture to BGR, pixel type "
                 + std::to_string(pixel_type) + " , converter index " + std::to_string(converter_id));
         }
-        UpdatePictureTimestamp("main");
+        CommitPicture(*MainChain, capture_time);
 
         LastReceiveTimePoint = std::chrono::steady_clock::now();
     }
@@ -123,21 +128,52 @@ namespace Gaia::CameraService
         }
 
         // Prepare shared memory.
-        UpdatePictureBlocksCount("main", SwapChainTotalCount);
-        Writers.reserve(SwapChainTotalCount);
         SharedPicture::PictureHeader picture_header;
         picture_header.PixelType = SharedPicture::PictureHeader::PixelTypes::Unsigned;
         picture_header.PixelBits = SharedPicture::PictureHeader::PixelBitSizes::Bits8;
         picture_header.Channels = 3;
         picture_header.Width = GetPictureWidth();
         picture_header.Height = GetPictureHeight();
-        for (auto chain_index = 0; chain_index < SwapChainTotalCount; ++chain_index)
+        MainChain = &CreateSwapChain("main", picture_header,
+                                     static_cast<long>(GetPictureWidth() * GetPictureHeight() * 3),
+                                     SwapChainTotalCount);
+
+        // Publish the raw Bayer picture if required, one byte per pixel as it is captured.
+        if (GetConfigurator()->Get("PublishRaw").value_or("false") == "true")
         {
-            auto writer = std::make_unique<SharedPicture::PictureWriter>(
-                    DeviceName + ".main." + std::to_string(chain_index),
-                    static_cast<long>(GetPictureWidth() * GetPictureHeight() * 3), true);
-            writer->SetHeader(picture_header);
-            Writers.emplace_back(std::move(writer));
+            int64_t pixel_format = 0;
+            GXGetEnum(DeviceHandle, GX_ENUM_PIXEL_FORMAT, &pixel_format);
+            switch (pixel_format)
+            {
+                case GX_PIXEL_FORMAT_ENTRY::GX_PIXEL_FORMAT_BAYER_RG8:
+                    RawFormat = "BayerRG";
+                    break;
+                case GX_PIXEL_FORMAT_ENTRY::GX_PIXEL_FORMAT_BAYER_GR8:
+                    RawFormat = "BayerGR";
+                    break;
+                case GX_PIXEL_FORMAT_ENTRY::GX_PIXEL_FORMAT_BAYER_BG8:
+                    RawFormat = "BayerBG";
+                    break;
+                case GX_PIXEL_FORMAT_ENTRY::GX_PIXEL_FORMAT_BAYER_GB8:
+                    RawFormat = "BayerGB";
+                    break;
+                default:
+                    RawFormat.clear();
+            }
+            if (RawFormat.empty())
+            {
+                GetLogger()->RecordWarning("Raw picture is required, but pixel format " +
+                                           std::to_string(pixel_format) + " is not a 8 bits Bayer format.");
+            }
+            else
+            {
+                SharedPicture::PictureHeader raw_header = picture_header;
+                raw_header.Channels = 1;
+                // The raw frame is copied from the SDK buffer as a whole, so its rows are packed.
+                RawChain = &CreateSwapChain("raw", raw_header,
+                                            static_cast<long>(GetPictureWidth() * GetPictureHeight()),
+                                            SwapChainTotalCount, 1);
+            }
         }
 
         // Configure acquisition rate if given.
@@ -181,7 +217,10 @@ namespace Gaia::CameraService
         GXCloseDevice(DeviceHandle);
         DeviceHandle = nullptr;
 
-        if (!Writers.empty()) Writers.clear();
+        MainChain = nullptr;
+        RawChain = nullptr;
+        RawFormat.clear();
+        ReleaseSwapChains();
     }
 
     /// Check timestamp.
@@ -405,6 +444,7 @@ namespace Gaia::CameraService
     /// Get picture names list.
     std::vector<std::tuple<std::string, std::string>> DahengDriver::GetPictureNames()
     {
+        if (!RawFormat.empty()) return {{"main", "BGR"}, {"raw", RawFormat}};
         return {{"main", "BGR"}};
     }
 }
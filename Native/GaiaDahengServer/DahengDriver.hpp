@@ -12,13 +12,16 @@ namespace Gaia::CameraService
     {
     private:
         const unsigned int SwapChainTotalCount {10};
-        unsigned int SwapChainReadyIndex {0};
 
         // Camera handle gotten from SDK.
         void* DeviceHandle {nullptr};
 
-        /// Writer for writing shared picture.
-        std::vector<std::unique_ptr<SharedPicture::PictureWriter>> Writers;
+        /// Swap chain of the main picture.
+        SwapChain* MainChain {nullptr};
+        /// Swap chain of the raw Bayer picture, null if "PublishRaw" is not enabled.
+        SwapChain* RawChain {nullptr};
+        /// Color format of the raw picture, such as "BayerRG".
+        std::string RawFormat;
 
         /// Time point of last receive picture event, used for judging whether the camera is alive or not.
         std::atomic<std::chrono::steady_clock::time_point> LastReceiveTimePoint {std::chrono::steady_clock::now()};
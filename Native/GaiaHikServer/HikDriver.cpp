@@ -17,12 +17,12 @@ namespace Gaia::CameraService
     }
 
     /// Constructor.
-    HikDriver::VideoDriver() :
+    HikDriver::HikDriver() :
             CameraDriverInterface("hik")
     {}
 
     /// Destructor which will automatically close the device.
-    HikDriver::~VideoDriver()
+    HikDriver::~HikDriver()
     {
         Close();
     }
@@ -30,9 +30,12 @@ namespace Gaia::CameraService
     /// Invoked when a new picture is captured by the camera.
     void HikDriver::OnPictureCapture(unsigned char *data, void* parameters_package)
     {
-        RetrievedPicturesCount++;
-
         auto* parameters = static_cast<MV_FRAME_OUT_INFO_EX*>(parameters_package);
+        EnterThread(ThreadRole::Capture);
+        // Stamped before any conversion, so the capture time does not include the processing time.
+        auto capture_time = CaptureTime::Now(static_cast<std::uint64_t>(parameters->nDevTimeStampHigh) << 32 |
+                                             parameters->nDevTimeStampLow);
+        RetrievedPicturesCount++;
 
         cv::Mat picture(cv::Size(parameters->nWidth, parameters->nHeight), CV_8UC3);
         MV_CC_PIXEL_CONVERT_PARAM convert_package;
@@ -50,19 +53,8 @@ namespace Gaia::CameraService
             GetLogger()->RecordError("Failed to convert the captured picture into BGR, pixel type " +
                 std::to_string(parameters->enPixelType));
         }
-        if (IsRequiredFlip())
-        {
-            cv::flip(picture, picture, -1);
-        }
-        auto* writer = Writers[SwapChainReadyIndex].get();
-        writer->Write(picture);
-        UpdatePictureBlockID(std::string("main"), SwapChainReadyIndex);
-        ++SwapChainReadyIndex;
-        if (SwapChainReadyIndex >= SwapChainTotalCount)
-        {
-            SwapChainReadyIndex = 0;
-        }
-        UpdatePictureTimestamp("main");
+        WritePicture(*MainChain, picture, IsRequiredFlip());
+        CommitPicture(*MainChain, capture_time);
 
         LastReceiveTimePoint = std::chrono::steady_clock::now();
     }
@@ -112,22 +104,15 @@ namespace Gaia::CameraService
         }
 
         // Prepare shared memory.
-        UpdatePictureBlocksCount("main", SwapChainTotalCount);
-        Writers.reserve(SwapChainTotalCount);
         SharedPicture::PictureHeader picture_header;
         picture_header.PixelType = SharedPicture::PictureHeader::PixelTypes::Unsigned;
         picture_header.PixelBits = SharedPicture::PictureHeader::PixelBitSizes::Bits8;
         picture_header.Channels = 3;
         picture_header.Width = GetPictureWidth();
         picture_header.Height = GetPictureHeight();
-        for (auto chain_index = 0; chain_index < SwapChainTotalCount; ++chain_index)
-        {
-            auto writer = std::make_unique<SharedPicture::PictureWriter>(
-                    DeviceName + ".main." + std::to_string(chain_index),
-                    static_cast<long>(GetPictureWidth() * GetPictureHeight() * 3), true);
-            writer->SetHeader(picture_header);
-            Writers.emplace_back(std::move(writer));
-        }
+        MainChain = &CreateSwapChain("main", picture_header,
+                                     static_cast<long>(GetPictureWidth() * GetPictureHeight() * 3),
+                                     SwapChainTotalCount);
 
         // Configure acquisition frames if given.
         auto option_fps = GetConfigurator()->Get("FPS");
@@ -164,7 +149,8 @@ namespace Gaia::CameraService
         MV_CC_DestroyHandle(DeviceHandle);
         DeviceHandle = nullptr;
 
-        if (!Writers.empty()) Writers.clear();
+        MainChain = nullptr;
+        ReleaseSwapChains();
     }
 
     /// Check time point to judge whether this camera is alive or not.
@@ -0,0 +1,9 @@
+#include <GaiaCameraServer/GaiaCameraServer.hpp>
+#include "MirrorDriver.hpp"
+
+int main(int arguments_count, char** arguments)
+{
+    Gaia::CameraService::LaunchServer<Gaia::CameraService::MirrorDriver>(arguments_count, arguments);
+
+    return 0;
+}
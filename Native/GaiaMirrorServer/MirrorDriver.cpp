@@ -0,0 +1,305 @@
+#include "MirrorDriver.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <GaiaCameraClient/BridgeProtocol.hpp>
+
+namespace Gaia::CameraService
+{
+    /// Constructor.
+    MirrorDriver::MirrorDriver() : CameraDriverInterface("mirror"),
+        Receiver([this](const std::atomic_bool& flag){
+            while (flag)
+            {
+                if (!this->ReceiveFrame())
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+            }
+        })
+    {}
+
+    /// Destructor which will automatically close the connection.
+    MirrorDriver::~MirrorDriver()
+    {
+        Close();
+    }
+
+    /// Receive and commit a frame.
+    bool MirrorDriver::ReceiveFrame()
+    {
+        if (!Connected) return false;
+
+        pollfd receive_poll {Descriptor, POLLIN, 0};
+        if (poll(&receive_poll, 1, 100) <= 0) return false;
+
+        Bridge::FrameHeader header {};
+        if (!Bridge::ReceiveAll(Descriptor, &header, sizeof(header)))
+        {
+            GetLogger()->RecordError("Connection to the bridge is closed.");
+            Connected = false;
+            return false;
+        }
+        if (header.Magic != Bridge::FrameMagic || header.PictureIndex >= Chains.size() ||
+            header.PayloadSize > Chains[header.PictureIndex]->GetPictureSize())
+        {
+            GetLogger()->RecordError("Invalid frame is received from the bridge, the stream is out of sync.");
+            Connected = false;
+            return false;
+        }
+
+        // Pixels are received straight into the writing block.
+        auto& chain = *Chains[header.PictureIndex];
+        if (!Bridge::ReceiveAll(Descriptor, chain.GetWriter().GetPointer(), header.PayloadSize))
+        {
+            GetLogger()->RecordError("Connection to the bridge is closed.");
+            Connected = false;
+            return false;
+        }
+        Bridge::FrameTrailer trailer {};
+        if (!Bridge::ReceiveAll(Descriptor, &trailer, sizeof(trailer)))
+        {
+            GetLogger()->RecordError("Connection to the bridge is closed.");
+            Connected = false;
+            return false;
+        }
+        if (trailer.Magic != Bridge::TrailerMagic)
+        {
+            GetLogger()->RecordError("Invalid frame is received from the bridge, the stream is out of sync.");
+            Connected = false;
+            return false;
+        }
+        // Torn pixels stay in the writing block and are overwritten by the next frame.
+        if (trailer.Flags & Bridge::TornFlag)
+        {
+            ++TornFramesCount;
+        }
+        else
+        {
+            // Capture times and settings are the ones of the camera, the sequence of the camera is kept as well.
+            FrameMetadata metadata;
+            metadata.Timestamp = header.Timestamp;
+            metadata.MonotonicTimestamp = header.MonotonicTimestamp;
+            metadata.DeviceTimestamp = header.DeviceTimestamp;
+            metadata.SourceSequence = header.Sequence;
+            metadata.Flags = header.Flags;
+            metadata.Exposure = header.Exposure;
+            metadata.Gain = header.Gain;
+            CommitPicture(chain, metadata);
+            ++RetrievedPicturesCount;
+        }
+
+        // Frames between two decimated ones are not requested, so only gaps beyond the decimation are skips.
+        auto& last_sequence = LastSequences[header.PictureIndex];
+        if (last_sequence > 0 && header.Sequence > last_sequence)
+        {
+            SkippedFramesCount += (header.Sequence - last_sequence - 1) / Decimation;
+        }
+        last_sequence = header.Sequence;
+        auto current_time_point = std::chrono::steady_clock::now();
+        if ((SkippedFramesCount > 0 || TornFramesCount > 0) &&
+            current_time_point - LastReportTimePoint >= std::chrono::seconds(1))
+        {
+            GetLogger()->RecordWarning(std::to_string(SkippedFramesCount) + " frames are skipped and " +
+                                       std::to_string(TornFramesCount) +
+                                       " frames are torn by the bridge in the last second.");
+            SkippedFramesCount = 0;
+            TornFramesCount = 0;
+            LastReportTimePoint = current_time_point;
+        }
+        return true;
+    }
+
+    /// Connect to the bridge and subscribe pictures.
+    void MirrorDriver::Open()
+    {
+        Close();
+
+        auto host = GetConfigurator()->Get("Host").value_or("127.0.0.1");
+        auto port = GetConfigurator()->Get("Port").value_or("9700");
+
+        addrinfo hints {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0 || !addresses)
+        {
+            GetLogger()->RecordError("Failed to resolve the bridge address " + host + ":" + port + ".");
+            throw std::runtime_error("Failed to resolve the bridge address " + host + ":" + port + ".");
+        }
+        for (auto* address = addresses; address; address = address->ai_next)
+        {
+            Descriptor = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (Descriptor < 0) continue;
+            if (connect(Descriptor, address->ai_addr, address->ai_addrlen) == 0) break;
+            close(Descriptor);
+            Descriptor = -1;
+        }
+        freeaddrinfo(addresses);
+        if (Descriptor < 0)
+        {
+            GetLogger()->RecordError("Failed to connect to the bridge " + host + ":" + port + ".");
+            throw std::runtime_error("Failed to connect to the bridge " + host + ":" + port + ".");
+        }
+        int enabled = 1;
+        setsockopt(Descriptor, IPPROTO_TCP, TCP_NODELAY, &enabled, sizeof(enabled));
+        // A frame stalled in the middle means the bridge is gone.
+        timeval receive_timeout {5, 0};
+        setsockopt(Descriptor, SOL_SOCKET, SO_RCVTIMEO, &receive_timeout, sizeof(receive_timeout));
+
+        Bridge::SubscribeRequest request {};
+        request.Magic = Bridge::RequestMagic;
+        request.Version = Bridge::ProtocolVersion;
+        Decimation = std::max(GetConfigurator()->Get<unsigned int>("Decimation").value_or(1), 1u);
+        request.Decimation = Decimation;
+        auto option_pictures = GetConfigurator()->Get("Pictures");
+        if (option_pictures)
+        {
+            std::stringstream names_stream(*option_pictures);
+            std::string name;
+            while (std::getline(names_stream, name, ',') && request.PicturesCount < Bridge::MaxPicturesCount)
+            {
+                if (name.empty()) continue;
+                auto length = std::min(name.size(), Bridge::MaxNameLength - 1);
+                std::memcpy(request.Pictures[request.PicturesCount++], name.data(), length);
+            }
+        }
+        iovec request_buffer {&request, sizeof(request)};
+        Bridge::StreamDescription description {};
+        if (!Bridge::SendAll(Descriptor, &request_buffer, 1) ||
+            !Bridge::ReceiveAll(Descriptor, &description, sizeof(description)) ||
+            description.Magic != Bridge::DescriptionMagic || description.Version != Bridge::ProtocolVersion)
+        {
+            close(Descriptor);
+            Descriptor = -1;
+            GetLogger()->RecordError("Failed to subscribe pictures from the bridge " + host + ":" + port + ".");
+            throw std::runtime_error("Failed to subscribe pictures from the bridge " + host + ":" + port + ".");
+        }
+        if (description.PicturesCount == 0 || description.PicturesCount > Bridge::MaxPicturesCount)
+        {
+            close(Descriptor);
+            Descriptor = -1;
+            GetLogger()->RecordError("No picture is provided by the bridge " + host + ":" + port + ".");
+            throw std::runtime_error("No picture is provided by the bridge " + host + ":" + port + ".");
+        }
+
+        description.DeviceName[Bridge::MaxNameLength - 1] = '\0';
+        for (auto picture_index = 0u; picture_index < description.PicturesCount; ++picture_index)
+        {
+            auto& picture = description.Pictures[picture_index];
+            picture.Name[Bridge::MaxNameLength - 1] = '\0';
+            picture.Format[Bridge::MaxNameLength - 1] = '\0';
+            PictureNames.emplace_back(picture.Name, picture.Format);
+            auto header = SwapChain::GenerateHeader(picture.PixelType, picture.Width, picture.Height);
+            auto picture_size = static_cast<long>(picture.Width) * picture.Height *
+                    static_cast<long>(CV_ELEM_SIZE(picture.PixelType));
+            // Packed pixels are received straight into blocks, so rows are packed as well.
+            Chains.push_back(&CreateSwapChain(picture.Name, header, picture_size, SwapChainTotalCount, 1));
+        }
+        LastSequences.assign(Chains.size(), 0);
+        SkippedFramesCount = 0;
+        TornFramesCount = 0;
+        LastReportTimePoint = std::chrono::steady_clock::now();
+
+        GetLogger()->RecordMessage("Mirroring " + std::to_string(Chains.size()) + " pictures of camera " +
+                                   description.DeviceName + " from the bridge " + host + ":" + port + ".");
+        Connected = true;
+        Receiver.Start();
+    }
+
+    /// Disconnect from the bridge.
+    void MirrorDriver::Close()
+    {
+        Receiver.Stop();
+        Connected = false;
+        if (Descriptor >= 0)
+        {
+            shutdown(Descriptor, SHUT_RDWR);
+            close(Descriptor);
+            Descriptor = -1;
+        }
+        Chains.clear();
+        PictureNames.clear();
+        ReleaseSwapChains();
+    }
+
+    /// Get picture names.
+    std::vector<std::tuple<std::string, std::string>> MirrorDriver::GetPictureNames()
+    {
+        return PictureNames;
+    }
+
+    /// The mirror is alive as long as the connection is.
+    bool MirrorDriver::IsAlive()
+    {
+        return Connected;
+    }
+
+    /// Exposure can not be changed through the bridge.
+    bool MirrorDriver::SetExposure(unsigned int microseconds)
+    {
+        return false;
+    }
+
+    /// Exposure is unknown through the bridge.
+    unsigned int MirrorDriver::GetExposure()
+    {
+        return 0;
+    }
+
+    /// Gain can not be changed through the bridge.
+    bool MirrorDriver::SetGain(double gain)
+    {
+        return false;
+    }
+
+    /// Gain is unknown through the bridge.
+    double MirrorDriver::GetGain()
+    {
+        return 0.0;
+    }
+
+    /// White balance can not be changed through the bridge.
+    bool MirrorDriver::SetWhiteBalanceRed(double ratio)
+    {
+        return false;
+    }
+
+    /// Get white balance red channel value.
+    double MirrorDriver::GetWhiteBalanceRed()
+    {
+        return 0.0;
+    }
+
+    /// White balance can not be changed through the bridge.
+    bool MirrorDriver::SetWhiteBalanceBlue(double ratio)
+    {
+        return false;
+    }
+
+    /// Get white balance blue channel value.
+    double MirrorDriver::GetWhiteBalanceBlue()
+    {
+        return 0.0;
+    }
+
+    /// White balance can not be changed through the bridge.
+    bool MirrorDriver::SetWhiteBalanceGreen(double ratio)
+    {
+        return false;
+    }
+
+    /// Get white balance green channel value.
+    double MirrorDriver::GetWhiteBalanceGreen()
+    {
+        return 0.0;
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <GaiaSharedPicture/GaiaSharedPicture.hpp>
+#include <GaiaCameraServer/GaiaCameraServer.hpp>
+#include <GaiaBackground/GaiaBackground.hpp>
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Driver which republishes pictures streamed by a remote camera bridge as a local camera.
+     * @details
+     *  Frames are received straight into the writing blocks of swap chains and committed with the capture
+     *  times, flags, exposure and gain of the remote camera, and its sequence numbers as source sequences,
+     *  so readers of this camera work the same as readers of the remote one.
+     *  Monotonic capture times are the ones of the remote host.
+     *  Gaps in sequence numbers of the camera beyond the decimation are counted as skipped frames,
+     *  and frames torn while the bridge sent them are dropped, both are logged every second.
+     *  Configurations:
+     *  "Host": address of the bridge, default is "127.0.0.1";
+     *  "Port": port of the bridge, default is 9700;
+     *  "Pictures": comma separated names of pictures to subscribe, default is all pictures;
+     *  "Decimation": only frames whose sequences are multiples of N are streamed, default is 1.
+     */
+    class MirrorDriver : public CameraDriverInterface
+    {
+    private:
+        /// Background thread which receives frames.
+        Gaia::Background::BackgroundWorker Receiver;
+
+        const unsigned int SwapChainTotalCount {10};
+
+        /// Descriptor of the socket connected to the bridge.
+        int Descriptor {-1};
+        /// Whether the connection to the bridge is alive or not.
+        std::atomic_bool Connected {false};
+
+        /// Names and formats of mirrored pictures.
+        std::vector<std::tuple<std::string, std::string>> PictureNames;
+        /// Swap chains of mirrored pictures, in the order of the stream description.
+        std::vector<SwapChain*> Chains;
+        /// Sequence numbers of the latest received frames of pictures.
+        std::vector<std::uint64_t> LastSequences;
+        /// Only every N-th frame of each picture is requested.
+        unsigned int Decimation {1};
+        /// Count of frames skipped by the bridge since the last report.
+        std::uint64_t SkippedFramesCount {0};
+        /// Count of torn frames dropped since the last report.
+        std::uint64_t TornFramesCount {0};
+        /// Time point of the last report of skipped frames.
+        std::chrono::steady_clock::time_point LastReportTimePoint;
+
+        /// Receive and commit a frame, return false if no frame is received.
+        bool ReceiveFrame();
+
+    public:
+        /// Constructor.
+        MirrorDriver();
+        /// Destructor which will automatically close the connection.
+        ~MirrorDriver() override;
+
+        /// Get picture names.
+        std::vector<std::tuple<std::string, std::string>> GetPictureNames() override;
+
+        /// Connect to the bridge and subscribe pictures.
+        void Open() override;
+
+        /// Disconnect from the bridge.
+        void Close() override;
+
+        /// Check whether the connection to the bridge is alive or not.
+        bool IsAlive() override;
+
+        /// Exposure can not be changed through the bridge.
+        bool SetExposure(unsigned int microseconds) override;
+
+        /// Exposure is unknown through the bridge.
+        unsigned int GetExposure() override;
+
+        /// Gain can not be changed through the bridge.
+        bool SetGain(double gain) override;
+
+        /// Gain is unknown through the bridge.
+        double GetGain() override;
+
+        /// White balance can not be changed through the bridge.
+        bool SetWhiteBalanceRed(double ratio) override;
+
+        /// Get red channel value of the white balance.
+        double GetWhiteBalanceRed() override;
+
+        /// White balance can not be changed through the bridge.
+        bool SetWhiteBalanceBlue(double ratio) override;
+
+        /// Get blue channel value of the white balance.
+        double GetWhiteBalanceBlue() override;
+
+        /// White balance can not be changed through the bridge.
+        bool SetWhiteBalanceGreen(double ratio) override;
+
+        /// Get green channel value of the white balance.
+        double GetWhiteBalanceGreen() override;
+    };
+}
@@ -0,0 +1,9 @@
+#include <GaiaCameraServer/GaiaCameraServer.hpp>
+#include "PlaybackDriver.hpp"
+
+int main(int arguments_count, char** arguments)
+{
+    Gaia::CameraService::LaunchServer<Gaia::CameraService::PlaybackDriver>(arguments_count, arguments);
+
+    return 0;
+}
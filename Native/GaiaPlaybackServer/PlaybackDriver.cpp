@@ -0,0 +1,452 @@
+#include "PlaybackDriver.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <sys/stat.h>
+#include <opencv2/opencv.hpp>
+
+namespace Gaia::CameraService
+{
+    /// Constructor.
+    PlaybackDriver::PlaybackDriver() : CameraDriverInterface("playback"),
+        Publisher([this](const std::atomic_bool& flag){
+            while (flag)
+            {
+                this->PublishNextFrame(flag);
+            }
+        })
+    {}
+
+    /// Destructor which will automatically close the recording.
+    PlaybackDriver::~PlaybackDriver()
+    {
+        Close();
+    }
+
+    /// Get the reader and the index entry of the given frame.
+    std::tuple<const RecordingReader*, const Recording::IndexEntry*>
+    PlaybackDriver::LocateFrame(std::size_t frame_index) const
+    {
+        const auto& location = Frames[frame_index];
+        const auto* reader = Segments[location.Segment].get();
+        return {reader, &reader->GetEntries()[location.Entry]};
+    }
+
+    /// Advise the kernel to prefetch or release frames.
+    void PlaybackDriver::AdviseFrames(std::size_t begin_frame, std::size_t end_frame, bool prefetch)
+    {
+        end_frame = std::min(end_frame, Frames.size());
+        // Advise every run of frames in the same segment at once.
+        while (begin_frame < end_frame)
+        {
+            auto segment_index = Frames[begin_frame].Segment;
+            auto run_end = begin_frame;
+            while (run_end < end_frame && Frames[run_end].Segment == segment_index) ++run_end;
+            const auto& reader = *Segments[segment_index];
+            if (prefetch)
+            {
+                reader.Prefetch(Frames[begin_frame].Entry, Frames[run_end - 1].Entry + 1);
+            }
+            else
+            {
+                reader.Release(Frames[begin_frame].Entry, Frames[run_end - 1].Entry + 1);
+            }
+            begin_frame = run_end;
+        }
+    }
+
+    /// Publish the next frame when it is due.
+    void PlaybackDriver::PublishNextFrame(const std::atomic_bool& flag)
+    {
+        double rate_multiplier;
+        {
+            std::unique_lock lock(ControlMutex);
+            if (SeekTarget)
+            {
+                NextFrame = *SeekTarget;
+                PrefetchedFrame = NextFrame;
+                ReleasedFrame = NextFrame;
+                SeekTarget.reset();
+                ScheduleExpired = true;
+            }
+            rate_multiplier = RateMultiplier;
+        }
+
+        if (NextFrame >= Frames.size())
+        {
+            if (!Looping)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                return;
+            }
+            AdviseFrames(ReleasedFrame, Frames.size(), false);
+            NextFrame = 0;
+            PrefetchedFrame = 0;
+            ReleasedFrame = 0;
+            std::unique_lock lock(ControlMutex);
+            ScheduleExpired = true;
+        }
+
+        // Keep a window of frames ahead prefetched, and release frames behind in batches.
+        if (PrefetchedFrame < NextFrame + PrefetchFramesCount)
+        {
+            auto prefetch_begin = std::max(PrefetchedFrame, NextFrame);
+            PrefetchedFrame = NextFrame + PrefetchFramesCount * 2;
+            AdviseFrames(prefetch_begin, PrefetchedFrame, true);
+        }
+        if (NextFrame >= ReleasedFrame + PrefetchFramesCount * 2)
+        {
+            AdviseFrames(ReleasedFrame, NextFrame, false);
+            ReleasedFrame = NextFrame;
+        }
+
+        auto [reader, entry] = LocateFrame(NextFrame);
+        const auto& frame = reader->GetFrameHeader(*entry);
+
+        if (rate_multiplier > 0.0)
+        {
+            {
+                std::unique_lock lock(ControlMutex);
+                if (ScheduleExpired || frame.Timestamp < AnchorTimestamp)
+                {
+                    AnchorTimePoint = std::chrono::steady_clock::now();
+                    AnchorTimestamp = frame.Timestamp;
+                    ScheduleExpired = false;
+                }
+            }
+            auto due_time_point = AnchorTimePoint + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double, std::nano>(
+                            static_cast<double>(frame.Timestamp - AnchorTimestamp) / rate_multiplier));
+            // Sleep in slices, so stopping, seeking and rate changes take effect during long gaps.
+            while (std::chrono::steady_clock::now() < due_time_point)
+            {
+                std::this_thread::sleep_until(std::min(due_time_point,
+                                                       std::chrono::steady_clock::now() +
+                                                       std::chrono::milliseconds(100)));
+                std::unique_lock lock(ControlMutex);
+                if (!flag || SeekTarget || ScheduleExpired) return;
+            }
+        }
+
+        auto* chain = Chains[entry->PictureIndex];
+        auto& writer = chain->GetWriter();
+        if (frame.PayloadSize > static_cast<std::uint64_t>(writer.GetMaxSize()))
+        {
+            GetLogger()->RecordWarning("Frame " + std::to_string(frame.Sequence) + " of picture " +
+                                       chain->GetPictureName() + " exceeds the picture size, it is skipped.");
+            ++NextFrame;
+            return;
+        }
+        std::memcpy(writer.GetPointer(), reader->GetFramePixels(*entry), frame.PayloadSize);
+        CurrentExposure = frame.Exposure;
+        CurrentGain = frame.Gain;
+
+        RetrievedPicturesCount++;
+        FrameMetadata metadata;
+        metadata.Timestamp = frame.Timestamp;
+        metadata.MonotonicTimestamp = frame.MonotonicTimestamp;
+        metadata.DeviceTimestamp = frame.DeviceTimestamp;
+        metadata.SourceSequence = frame.Sequence;
+        metadata.Exposure = frame.Exposure;
+        metadata.Gain = frame.Gain;
+        CommitPicture(*chain, metadata);
+        PictureSequences[entry->PictureIndex].store(frame.Sequence + 1, std::memory_order_relaxed);
+        ++NextFrame;
+    }
+
+    /// Find the first frame whose timestamp is not less than the given one.
+    std::optional<std::size_t> PlaybackDriver::FindFrameByTimestamp(std::uint64_t timestamp) const
+    {
+        // Frames are recorded in commit order, so their timestamps are ascending.
+        auto finder = std::partition_point(Frames.begin(), Frames.end(), [this, timestamp](const FrameLocation& frame){
+            return Segments[frame.Segment]->GetEntries()[frame.Entry].Timestamp < timestamp;
+        });
+        if (finder == Frames.end()) return std::nullopt;
+        return static_cast<std::size_t>(finder - Frames.begin());
+    }
+
+    /// Find the first frame of the given picture whose sequence number is not less than the given one.
+    std::optional<std::size_t> PlaybackDriver::FindFrameBySequence(std::size_t picture_index,
+                                                                   std::uint64_t sequence) const
+    {
+        const auto& picture_frames = PictureFrames[picture_index];
+        auto finder = std::partition_point(picture_frames.begin(), picture_frames.end(),
+                                           [this, sequence](std::size_t frame_index){
+            const auto& frame = Frames[frame_index];
+            return Segments[frame.Segment]->GetEntries()[frame.Entry].Sequence < sequence;
+        });
+        if (finder == picture_frames.end()) return std::nullopt;
+        return *finder;
+    }
+
+    /// Handle seeking and rate commands.
+    bool PlaybackDriver::HandleCommand(const std::string &command)
+    {
+        if (command == "seek_timestamp")
+        {
+            auto timestamp = GetConfigurator()->Get<unsigned long long>("SeekTimestamp");
+            if (!timestamp)
+            {
+                GetLogger()->RecordWarning("Seeking is required, but configuration SeekTimestamp is missing.");
+                return true;
+            }
+            // The frames index is rebuilt by Open() and Close(), so it is only searched under the lock.
+            std::unique_lock lock(ControlMutex);
+            if (Frames.empty())
+            {
+                GetLogger()->RecordWarning("Seeking is required, but no recording is opened.");
+                return true;
+            }
+            auto target = FindFrameByTimestamp(static_cast<std::uint64_t>(*timestamp) * 1000000);
+            if (!target)
+            {
+                GetLogger()->RecordWarning("No frame is recorded after timestamp " + std::to_string(*timestamp) + ".");
+                return true;
+            }
+            SeekTarget = *target;
+            GetLogger()->RecordMessage("Seek to frame " + std::to_string(*target) + ".");
+            return true;
+        }
+        if (command == "seek_sequence")
+        {
+            auto sequence = GetConfigurator()->Get<unsigned long long>("SeekSequence");
+            if (!sequence)
+            {
+                GetLogger()->RecordWarning("Seeking is required, but configuration SeekSequence is missing.");
+                return true;
+            }
+            auto picture_name = GetConfigurator()->Get("SeekPicture");
+            std::unique_lock lock(ControlMutex);
+            if (Frames.empty())
+            {
+                GetLogger()->RecordWarning("Seeking is required, but no recording is opened.");
+                return true;
+            }
+            std::size_t picture_index = 0;
+            if (picture_name)
+            {
+                auto finder = std::find_if(PictureNames.begin(), PictureNames.end(),
+                                           [&picture_name](const std::tuple<std::string, std::string>& picture){
+                    return std::get<0>(picture) == *picture_name;
+                });
+                if (finder == PictureNames.end())
+                {
+                    GetLogger()->RecordWarning("Picture " + *picture_name + " is not recorded.");
+                    return true;
+                }
+                picture_index = static_cast<std::size_t>(finder - PictureNames.begin());
+            }
+            auto target = FindFrameBySequence(picture_index, static_cast<std::uint64_t>(*sequence));
+            if (!target)
+            {
+                GetLogger()->RecordWarning("No frame is recorded after sequence " + std::to_string(*sequence) + ".");
+                return true;
+            }
+            SeekTarget = *target;
+            GetLogger()->RecordMessage("Seek to frame " + std::to_string(*target) + ".");
+            return true;
+        }
+        if (command == "update_rate")
+        {
+            auto rate_multiplier = GetConfigurator()->Get<double>("RateMultiplier").value_or(1.0);
+            std::unique_lock lock(ControlMutex);
+            RateMultiplier = rate_multiplier;
+            ScheduleExpired = true;
+            GetLogger()->RecordMessage("Playback rate is updated to " + std::to_string(rate_multiplier));
+            return true;
+        }
+        return false;
+    }
+
+    /// Open the recording.
+    void PlaybackDriver::Open()
+    {
+        auto option_path = GetConfigurator()->Get("Path");
+        if (!option_path)
+        {
+            GetLogger()->RecordError("Configuration Path of the recording is missing.");
+            throw std::runtime_error("Missing recording path.");
+        }
+        auto segment_paths = RecordingReader::FindSegments(*option_path);
+        struct stat status {};
+        if (segment_paths.empty() && stat(option_path->c_str(), &status) == 0)
+        {
+            segment_paths.push_back(*option_path);
+        }
+        if (segment_paths.empty())
+        {
+            GetLogger()->RecordError("No recording segment is found at " + *option_path + ".");
+            throw std::runtime_error("Can not find recording " + *option_path);
+        }
+
+        std::unique_lock index_lock(ControlMutex);
+        Segments.clear();
+        Frames.clear();
+        for (const auto& segment_path : segment_paths)
+        {
+            Segments.emplace_back(std::make_unique<RecordingReader>(segment_path));
+        }
+
+        // Load pictures from the first segment, all segments of a recording share them.
+        const auto& segment_header = Segments.front()->GetHeader();
+        PictureNames.clear();
+        for (auto picture_index = 0u; picture_index < segment_header.PicturesCount; ++picture_index)
+        {
+            const auto& picture = segment_header.Pictures[picture_index];
+            PictureNames.emplace_back(std::string(picture.Name), std::string(picture.Format));
+        }
+        PictureFrames.assign(PictureNames.size(), {});
+        PictureSequences = std::make_unique<std::atomic<std::uint64_t>[]>(PictureNames.size());
+        for (std::uint32_t segment_index = 0; segment_index < Segments.size(); ++segment_index)
+        {
+            const auto& entries = Segments[segment_index]->GetEntries();
+            for (std::uint32_t entry_index = 0; entry_index < entries.size(); ++entry_index)
+            {
+                if (entries[entry_index].PictureIndex >= PictureNames.size()) continue;
+                PictureFrames[entries[entry_index].PictureIndex].push_back(Frames.size());
+                Frames.push_back({segment_index, entry_index});
+            }
+        }
+        if (Frames.empty())
+        {
+            GetLogger()->RecordError("Recording " + *option_path + " contains no frame.");
+            throw std::runtime_error("Empty recording " + *option_path);
+        }
+        index_lock.unlock();
+
+        // Prepare shared memory according to the first frame of every picture.
+        Chains.assign(PictureNames.size(), nullptr);
+        for (std::size_t picture_index = 0; picture_index < PictureNames.size(); ++picture_index)
+        {
+            if (PictureFrames[picture_index].empty()) continue;
+            auto [reader, entry] = LocateFrame(PictureFrames[picture_index].front());
+            const auto& frame = reader->GetFrameHeader(*entry);
+            auto header = SwapChain::GenerateHeader(frame.PixelType, frame.Width, frame.Height);
+            // Recorded pixels are packed and copied into blocks as a whole, so rows are packed as well.
+            Chains[picture_index] = &CreateSwapChain(std::get<0>(PictureNames[picture_index]), header,
+                                                     static_cast<long>(frame.PayloadSize), SwapChainTotalCount, 1);
+        }
+
+        {
+            std::unique_lock lock(ControlMutex);
+            RateMultiplier = GetConfigurator()->Get<double>("RateMultiplier").value_or(1.0);
+            SeekTarget.reset();
+            ScheduleExpired = true;
+        }
+        auto option_loop = GetConfigurator()->Get("Loop");
+        Looping = !(option_loop && (*option_loop == "false" || *option_loop == "0"));
+        PrefetchFramesCount = std::max(1u, GetConfigurator()->Get<unsigned int>("PrefetchFrames").value_or(16));
+        NextFrame = 0;
+        PrefetchedFrame = 0;
+        ReleasedFrame = 0;
+
+        GetLogger()->RecordMessage("Recording " + *option_path + " is opened, " +
+                                   std::to_string(Segments.size()) + " segments, " +
+                                   std::to_string(Frames.size()) + " frames.");
+        Publisher.Start();
+    }
+
+    /// Close the recording.
+    void PlaybackDriver::Close()
+    {
+        Publisher.Stop();
+        if (GetDatabase())
+        {
+            for (const auto& [picture_name, picture_format] : PictureNames)
+            {
+                GetDatabase()->del("cameras/" + DeviceName + "/pictures/" + picture_name + "/sequence");
+            }
+        }
+        Chains.clear();
+        ReleaseSwapChains();
+        std::unique_lock lock(ControlMutex);
+        Frames.clear();
+        PictureFrames.clear();
+        Segments.clear();
+    }
+
+    /// Get picture names.
+    std::vector<std::tuple<std::string, std::string>> PlaybackDriver::GetPictureNames()
+    {
+        return PictureNames;
+    }
+
+    /// The playback thread only stops when the recording is closed.
+    bool PlaybackDriver::IsAlive()
+    {
+        return !Segments.empty();
+    }
+
+    /// Publish recorded sequence numbers of the latest published frames.
+    void PlaybackDriver::UpdateStatus(sw::redis::Pipeline &pipeline)
+    {
+        for (std::size_t picture_index = 0; picture_index < PictureNames.size(); ++picture_index)
+        {
+            auto sequence = PictureSequences[picture_index].load(std::memory_order_relaxed);
+            if (sequence == 0) continue;
+            pipeline.set("cameras/" + DeviceName + "/pictures/" + std::get<0>(PictureNames[picture_index]) +
+                         "/sequence", std::to_string(sequence - 1));
+        }
+    }
+
+    /// Exposure can not be changed in playback.
+    bool PlaybackDriver::SetExposure(unsigned int microseconds)
+    {
+        return false;
+    }
+
+    /// Get the recorded exposure.
+    unsigned int PlaybackDriver::GetExposure()
+    {
+        return CurrentExposure;
+    }
+
+    /// Gain can not be changed in playback.
+    bool PlaybackDriver::SetGain(double gain)
+    {
+        return false;
+    }
+
+    /// Get the recorded gain.
+    double PlaybackDriver::GetGain()
+    {
+        return CurrentGain;
+    }
+
+    /// White balance can not be changed in playback.
+    bool PlaybackDriver::SetWhiteBalanceRed(double ratio)
+    {
+        return false;
+    }
+
+    /// Get white balance red channel value.
+    double PlaybackDriver::GetWhiteBalanceRed()
+    {
+        return 0.0;
+    }
+
+    /// White balance can not be changed in playback.
+    bool PlaybackDriver::SetWhiteBalanceBlue(double ratio)
+    {
+        return false;
+    }
+
+    /// Get white balance blue channel value.
+    double PlaybackDriver::GetWhiteBalanceBlue()
+    {
+        return 0.0;
+    }
+
+    /// White balance can not be changed in playback.
+    bool PlaybackDriver::SetWhiteBalanceGreen(double ratio)
+    {
+        return false;
+    }
+
+    /// Get white balance green channel value.
+    double PlaybackDriver::GetWhiteBalanceGreen()
+    {
+        return 0.0;
+    }
+}
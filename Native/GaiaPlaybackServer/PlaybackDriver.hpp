@@ -0,0 +1,164 @@
+#pragma once
+
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <GaiaSharedPicture/GaiaSharedPicture.hpp>
+#include <GaiaCameraServer/GaiaCameraServer.hpp>
+#include <GaiaBackground/GaiaBackground.hpp>
+
+namespace Gaia::CameraService
+{
+    /**
+     * @brief Driver which replays a recording of the built-in recorder as a camera.
+     * @details
+     *  Segment files are mapped into memory, and frames are copied from the mapping into swap chains
+     *  in recording order, while frames ahead are prefetched and frames behind are released.
+     *  Frames are committed with their recorded capture times, exposure and gain,
+     *  and stamps of replayed pictures carry their recorded sequence numbers as source sequences,
+     *  and the recorded sequence number of each picture is published once per second
+     *  as "cameras/playback.0/pictures/main/sequence".
+     *  Configurations:
+     *  "Path": path prefix of segment files, such as "/data/daheng_camera.0.20210101-120000",
+     *          or the path of a single segment file;
+     *  "RateMultiplier": multiplier of the original timing, 0 means as fast as possible, default is 1;
+     *  "Loop": "false" to stop at the end of the recording, default is looping;
+     *  "PrefetchFrames": count of frames to prefetch ahead, default is 16;
+     *  "SeekSequence" and "SeekPicture": target of the command "seek_sequence", the recorded sequence number
+     *          of the picture with the given name, default picture is the first recorded one;
+     *  "SeekTimestamp": target of the command "seek_timestamp", in milliseconds since epoch.
+     *  The command "update_rate" applies the configuration "RateMultiplier".
+     */
+    class PlaybackDriver : public CameraDriverInterface
+    {
+    private:
+        /// Location of a frame in the recording.
+        struct FrameLocation
+        {
+            /// Index of the segment.
+            std::uint32_t Segment;
+            /// Index of the entry in the segment index.
+            std::uint32_t Entry;
+        };
+
+        /// Background thread which publishes frames on schedule.
+        Gaia::Background::BackgroundWorker Publisher;
+
+        const unsigned int SwapChainTotalCount {10};
+
+        /// Readers of all segments.
+        std::vector<std::unique_ptr<RecordingReader>> Segments;
+        /// Locations of all frames in recording order.
+        std::vector<FrameLocation> Frames;
+        /// Indices in Frames of every picture, used for seeking by sequence numbers.
+        std::vector<std::vector<std::size_t>> PictureFrames;
+        /// Names and formats of recorded pictures.
+        std::vector<std::tuple<std::string, std::string>> PictureNames;
+        /// Swap chains of recorded pictures.
+        std::vector<SwapChain*> Chains;
+
+        /// Index of the next frame to publish.
+        std::size_t NextFrame {0};
+        /// Frames before this index have been advised to be prefetched.
+        std::size_t PrefetchedFrame {0};
+        /// Frames before this index have been released.
+        std::size_t ReleasedFrame {0};
+        /// Count of frames to prefetch ahead.
+        std::size_t PrefetchFramesCount {16};
+        /// Whether to replay from the beginning at the end of the recording or not.
+        bool Looping {true};
+
+        /// Mutex for the rate multiplier, the seeking target, and the frames index against seeking commands.
+        std::mutex ControlMutex;
+        /// Multiplier of the original timing, 0 means as fast as possible.
+        double RateMultiplier {1.0};
+        /// Index of the frame to seek to.
+        std::optional<std::size_t> SeekTarget;
+        /// Whether the schedule should be restarted from the next frame or not.
+        bool ScheduleExpired {true};
+
+        /// Steady time point when the anchor frame is published.
+        std::chrono::steady_clock::time_point AnchorTimePoint;
+        /// Recorded timestamp of the anchor frame.
+        std::uint64_t AnchorTimestamp {0};
+
+        /// Exposure of the latest published frame.
+        std::atomic<unsigned int> CurrentExposure {0};
+        /// Gain of the latest published frame.
+        std::atomic<double> CurrentGain {0.0};
+        /// Recorded sequence numbers plus 1 of the latest published frames of every picture, 0 means none.
+        std::unique_ptr<std::atomic<std::uint64_t>[]> PictureSequences;
+
+        /// Get the reader and the index entry of the given frame.
+        [[nodiscard]] std::tuple<const RecordingReader*, const Recording::IndexEntry*>
+        LocateFrame(std::size_t frame_index) const;
+
+        /// Advise the kernel to prefetch or release frames in the given range.
+        void AdviseFrames(std::size_t begin_frame, std::size_t end_frame, bool prefetch);
+
+        /// Publish the next frame when it is due.
+        void PublishNextFrame(const std::atomic_bool& flag);
+
+        /// Find the first frame whose timestamp is not less than the given one, in nanoseconds.
+        [[nodiscard]] std::optional<std::size_t> FindFrameByTimestamp(std::uint64_t timestamp) const;
+        /// Find the first frame of the given picture whose sequence number is not less than the given one.
+        [[nodiscard]] std::optional<std::size_t> FindFrameBySequence(std::size_t picture_index,
+                                                                     std::uint64_t sequence) const;
+
+    public:
+        /// Constructor.
+        PlaybackDriver();
+        /// Destructor which will automatically close the recording.
+        ~PlaybackDriver() override;
+
+        /// Get picture names.
+        std::vector<std::tuple<std::string, std::string>> GetPictureNames() override;
+
+        /// Handle seeking and rate commands.
+        bool HandleCommand(const std::string& command) override;
+
+        /// Open the recording and start playback.
+        void Open() override;
+
+        /// Close the recording and stop playback.
+        void Close() override;
+
+        /// Check whether this camera is alive or not.
+        bool IsAlive() override;
+
+        /// Publish recorded sequence numbers of the latest published frames.
+        void UpdateStatus(sw::redis::Pipeline& pipeline) override;
+
+        /// Exposure can not be changed in playback.
+        bool SetExposure(unsigned int microseconds) override;
+
+        /// Get the recorded exposure of the latest published frame.
+        unsigned int GetExposure() override;
+
+        /// Gain can not be changed in playback.
+        bool SetGain(double gain) override;
+
+        /// Get the recorded gain of the latest published frame.
+        double GetGain() override;
+
+        /// White balance can not be changed in playback.
+        bool SetWhiteBalanceRed(double ratio) override;
+
+        /// Get red channel value of the white balance.
+        double GetWhiteBalanceRed() override;
+
+        /// White balance can not be changed in playback.
+        bool SetWhiteBalanceBlue(double ratio) override;
+
+        /// Get blue channel value of the white balance.
+        double GetWhiteBalanceBlue() override;
+
+        /// White balance can not be changed in playback.
+        bool SetWhiteBalanceGreen(double ratio) override;
+
+        /// Get green channel value of the white balance.
+        double GetWhiteBalanceGreen() override;
+    };
+}
@@ -1,17 +1,24 @@
 #include "VideoDriver.hpp"
 
-#include <MvCameraControl.h>
+#include <thread>
 
 namespace Gaia::CameraService
 {
     /// Constructor.
     VideoDriver::VideoDriver() :
             CameraDriverInterface("hik"),
-            Updater([this](const std::atomic_bool& flag){
+            Decoder([this](const std::atomic_bool& flag){
+                this->EnterThread(ThreadRole::Capture);
+                while (flag)
+                {
+                    this->PrefetchPicture(flag);
+                }
+            }),
+            Publisher([this](const std::atomic_bool& flag){
+                this->EnterThread(ThreadRole::Convert);
                 while (flag)
                 {
                     this->OnPictureCapture();
-                    cv::waitKey(15);
                 }
             })
     {}
@@ -22,28 +29,108 @@ namespace Gaia::CameraService
         Close();
     }
 
-    /// Invoked when a new picture is captured by the camera.
-    void VideoDriver::OnPictureCapture()
+    /// Decode the next frame.
+    cv::Mat VideoDriver::DecodePicture()
     {
-        RetrievedPicturesCount++;
+        cv::Mat picture;
+        if (Video->read(picture) && !picture.empty()) return picture;
 
+        // Reach the end of the clip, replay it from the beginning.
+        Video->set(cv::CAP_PROP_POS_FRAMES, 0);
+        if (Video->read(picture) && !picture.empty()) return picture;
+        return {};
+    }
+
+    /// Decode a frame into the queue.
+    void VideoDriver::PrefetchPicture(const std::atomic_bool& flag)
+    {
+        auto picture = DecodePicture();
+        if (picture.empty())
+        {
+            GetLogger()->RecordError("Failed to decode video " + DeviceName + ".");
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+            return;
+        }
+
+        std::unique_lock lock(DecodedFramesMutex);
+        while (DecodedFrames.size() >= DecodedFramesCapacity)
+        {
+            DecodedFramesNotFull.wait_for(lock, std::chrono::milliseconds(100));
+            if (!flag) return;
+        }
+        DecodedFrames.emplace_back(std::move(picture));
+        lock.unlock();
+        DecodedFramesNotEmpty.notify_one();
+    }
+
+    /// Decode the whole clip into memory.
+    bool VideoDriver::PreloadPictures(std::size_t memory_limit)
+    {
+        PreloadedFrames.clear();
+        PreloadedFrameIndex = 0;
+
+        std::size_t total_size = 0;
+        cv::Mat picture;
+        Video->set(cv::CAP_PROP_POS_FRAMES, 0);
+        while (Video->read(picture) && !picture.empty())
+        {
+            total_size += picture.total() * picture.elemSize();
+            if (total_size > memory_limit)
+            {
+                PreloadedFrames.clear();
+                Video->set(cv::CAP_PROP_POS_FRAMES, 0);
+                return false;
+            }
+            PreloadedFrames.emplace_back(std::move(picture));
+            picture = cv::Mat();
+        }
+        Video->set(cv::CAP_PROP_POS_FRAMES, 0);
+        return !PreloadedFrames.empty();
+    }
+
+    /// Publish the next frame when it is due.
+    void VideoDriver::OnPictureCapture()
+    {
         cv::Mat picture;
-        (*Video) >> picture;
-        ++CurrentFrameIndex;
-        if (CurrentFrameIndex >= TotalFrameCount - 1)
+        if (!PreloadedFrames.empty())
         {
-            CurrentFrameIndex = 0;
-            Video->set(cv::CAP_PROP_POS_FRAMES, 0);
+            picture = PreloadedFrames[PreloadedFrameIndex];
+            ++PreloadedFrameIndex;
+            if (PreloadedFrameIndex >= PreloadedFrames.size())
+            {
+                PreloadedFrameIndex = 0;
+            }
         }
-        auto* writer = Writers[SwapChainReadyIndex].get();
-        writer->Write(picture);
-        UpdatePictureBlockID(std::string("main"), SwapChainReadyIndex);
-        ++SwapChainReadyIndex;
-        if (SwapChainReadyIndex >= SwapChainTotalCount)
+        else
         {
-            SwapChainReadyIndex = 0;
+            std::unique_lock lock(DecodedFramesMutex);
+            if (!DecodedFramesNotEmpty.wait_for(lock, std::chrono::milliseconds(100), [this]{
+                return !DecodedFrames.empty();
+            })) return;
+            picture = std::move(DecodedFrames.front());
+            DecodedFrames.pop_front();
+            lock.unlock();
+            DecodedFramesNotFull.notify_one();
         }
-        UpdatePictureTimestamp("main");
+
+        if (FrameInterval.count() > 0)
+        {
+            std::this_thread::sleep_until(NextPublishTimePoint);
+            NextPublishTimePoint += FrameInterval;
+            // Restart the schedule rather than bursting to catch up if the decoder has stalled.
+            auto current_time = std::chrono::steady_clock::now();
+            if (current_time - NextPublishTimePoint > FrameInterval)
+            {
+                NextPublishTimePoint = current_time + FrameInterval;
+            }
+        }
+
+        // The frame is captured when its turn in the schedule comes, not when it is written.
+        auto capture = CaptureTime::Now();
+        RetrievedPicturesCount++;
+
+        MainChain->Write(picture);
+        CommitPicture(*MainChain, capture);
 
         LastReceiveTimePoint = std::chrono::steady_clock::now();
     }
@@ -51,42 +138,83 @@ namespace Gaia::CameraService
     /// Open the camera.
     void VideoDriver::Open()
     {
-        Video = std::make_unique<cv::VideoCapture>(DeviceName);
+        auto video_path = GetConfigurator()->Get("Path").value_or(DeviceName);
+        Video = std::make_unique<cv::VideoCapture>(video_path);
 
         if (!Video->isOpened())
         {
-            throw std::runtime_error("Can not open video " + DeviceName);
+            throw std::runtime_error("Can not open video " + video_path);
+        }
+
+        // Prepare the publishing schedule.
+        auto frames_per_second = Video->get(cv::CAP_PROP_FPS);
+        if (frames_per_second <= 0.0)
+        {
+            GetLogger()->RecordWarning("Frame rate of video " + video_path + " is unknown, 30 FPS is used.");
+            frames_per_second = 30.0;
+        }
+        auto rate_multiplier = GetConfigurator()->Get<double>("RateMultiplier").value_or(1.0);
+        if (rate_multiplier > 0.0)
+        {
+            FrameInterval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                    std::chrono::duration<double>(1.0 / (frames_per_second * rate_multiplier)));
+        }
+        else
+        {
+            FrameInterval = std::chrono::steady_clock::duration::zero();
         }
+        NextPublishTimePoint = std::chrono::steady_clock::now();
 
-        CurrentFrameIndex = 0;
-        TotalFrameCount = Video->get(cv::CAP_PROP_FRAME_COUNT);
+        // Prepare decoded frames.
+        DecodedFrames.clear();
+        DecodedFramesCapacity = std::max(1u, GetConfigurator()->Get<unsigned int>("PrefetchFrames").value_or(8));
+        PreloadedFrames.clear();
+        auto option_preload = GetConfigurator()->Get("Preload");
+        if (option_preload && (*option_preload == "true" || *option_preload == "1"))
+        {
+            auto memory_limit = static_cast<std::size_t>(
+                    GetConfigurator()->Get<unsigned int>("PreloadLimit").value_or(1024)) * 1024 * 1024;
+            if (PreloadPictures(memory_limit))
+            {
+                GetLogger()->RecordMessage("Video " + video_path + " is preloaded, " +
+                                           std::to_string(PreloadedFrames.size()) + " frames.");
+            }
+            else
+            {
+                GetLogger()->RecordWarning("Video " + video_path + " exceeds the preload limit, it will be streamed.");
+            }
+        }
 
         // Prepare shared memory.
-        UpdatePictureBlocksCount("main", SwapChainTotalCount);
-        Writers.reserve(SwapChainTotalCount);
         SharedPicture::PictureHeader picture_header;
         picture_header.PixelType = SharedPicture::PictureHeader::PixelTypes::Unsigned;
         picture_header.PixelBits = SharedPicture::PictureHeader::PixelBitSizes::Bits8;
         picture_header.Channels = 3;
         picture_header.Width = GetPictureWidth();
         picture_header.Height = GetPictureHeight();
-        for (auto chain_index = 0; chain_index < SwapChainTotalCount; ++chain_index)
-        {
-            auto writer = std::make_unique<SharedPicture::PictureWriter>(
-                    DeviceName + ".main." + std::to_string(chain_index),
-                    static_cast<long>(GetPictureWidth() * GetPictureHeight() * 3), true);
-            writer->SetHeader(picture_header);
-            Writers.emplace_back(std::move(writer));
-        }
+        MainChain = &CreateSwapChain("main", picture_header,
+                                     static_cast<long>(GetPictureWidth() * GetPictureHeight() * 3),
+                                     SwapChainTotalCount);
 
         LastReceiveTimePoint = std::chrono::steady_clock::now();
+
+        if (PreloadedFrames.empty())
+        {
+            Decoder.Start();
+        }
+        Publisher.Start();
     }
 
     /// Close the opened camera device.
     void VideoDriver::Close()
     {
+        Publisher.Stop();
+        Decoder.Stop();
+        DecodedFrames.clear();
+        PreloadedFrames.clear();
         Video.reset();
-        if (!Writers.empty()) Writers.clear();
+        MainChain = nullptr;
+        ReleaseSwapChains();
     }
 
     /// Check time point to judge whether this camera is alive or not.
@@ -176,13 +304,17 @@ namespace Gaia::CameraService
     /// Get width of the picture.
     long VideoDriver::GetPictureWidth()
     {
-        return false;
+        if (!PreloadedFrames.empty()) return PreloadedFrames.front().cols;
+        if (Video) return static_cast<long>(Video->get(cv::CAP_PROP_FRAME_WIDTH));
+        return 0;
     }
 
     /// Get height of the picture.
     long VideoDriver::GetPictureHeight()
     {
-        return false;
+        if (!PreloadedFrames.empty()) return PreloadedFrames.front().rows;
+        if (Video) return static_cast<long>(Video->get(cv::CAP_PROP_FRAME_HEIGHT));
+        return 0;
     }
 
     /// Get picture names list.
@@ -2,6 +2,9 @@
 
 #include <memory>
 #include <chrono>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
 #include <GaiaSharedPicture/GaiaSharedPicture.hpp>
 #include <GaiaCameraServer/GaiaCameraServer.hpp>
 #include <GaiaBackground/GaiaBackground.hpp>
@@ -9,32 +12,76 @@
 
 namespace Gaia::CameraService
 {
+    /**
+     * @brief Driver which replays a video file as a camera.
+     * @details
+     *  Frames are decoded ahead of time by a decoder thread into a bounded queue,
+     *  and released by a publisher thread on a steady clock schedule derived from the frame rate of the file.
+     *  Configurations:
+     *  "Path": path of the video file, default is the device name;
+     *  "RateMultiplier": multiplier of the frame rate, 0 means as fast as possible, default is 1;
+     *  "PrefetchFrames": capacity of the decoded frames queue, default is 8;
+     *  "Preload": "true" to decode the whole clip into memory, so it loops without seeking;
+     *  "PreloadLimit": max megabytes of a preloaded clip, longer clips are streamed, default is 1024.
+     */
     class VideoDriver : public CameraDriverInterface
     {
     private:
-
-        Gaia::Background::BackgroundWorker Updater;
+        /// Background thread which decodes frames into the queue.
+        Gaia::Background::BackgroundWorker Decoder;
+        /// Background thread which publishes decoded frames on schedule.
+        Gaia::Background::BackgroundWorker Publisher;
 
         const unsigned int SwapChainTotalCount {10};
-        unsigned int SwapChainReadyIndex {0};
-
-        unsigned int CurrentFrameIndex {0};
-        unsigned int TotalFrameCount {0};
 
         std::unique_ptr<cv::VideoCapture> Video;
 
-        /// Writer for writing shared picture.
-        std::vector<std::unique_ptr<SharedPicture::PictureWriter>> Writers;
+        /// Swap chain of the main picture.
+        SwapChain* MainChain {nullptr};
+
+        /// Mutex for the decoded frames queue.
+        std::mutex DecodedFramesMutex;
+        /// Notified when a frame is pushed into the queue.
+        std::condition_variable DecodedFramesNotEmpty;
+        /// Notified when a frame is popped from the queue.
+        std::condition_variable DecodedFramesNotFull;
+        /// Frames decoded ahead of time.
+        std::deque<cv::Mat> DecodedFrames;
+        /// Capacity of the decoded frames queue.
+        std::size_t DecodedFramesCapacity {8};
+
+        /// All frames of the clip, if it is preloaded.
+        std::vector<cv::Mat> PreloadedFrames;
+        /// Index of the next preloaded frame to publish.
+        std::size_t PreloadedFrameIndex {0};
+
+        /// Interval between two frames, zero means publishing as fast as possible.
+        std::chrono::steady_clock::duration FrameInterval {0};
+        /// Time point to publish the next frame.
+        std::chrono::steady_clock::time_point NextPublishTimePoint;
 
         /// Time point of last receive picture event, used for judging whether this camera is alive or not.
         std::atomic<std::chrono::steady_clock::time_point> LastReceiveTimePoint {std::chrono::steady_clock::now()};
 
+        /**
+         * @brief Decode the next frame, and seek back to the beginning at the end of the clip.
+         * @return Decoded frame, or an empty matrix if the video can not be decoded.
+         */
+        cv::Mat DecodePicture();
+
+        /// Decode a frame and push it into the queue, block while the queue is full.
+        void PrefetchPicture(const std::atomic_bool& flag);
+
+        /// Decode the whole clip into memory, return false if it is too long.
+        bool PreloadPictures(std::size_t memory_limit);
+
     public:
         /// Default constructor.
         VideoDriver();
         /// Auto close the camera.
         ~VideoDriver() override;
 
+        /// Publish the next frame when it is due.
         void OnPictureCapture();
 
         /**
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "SensorsRing.hpp"
 #include "ZedClient.hpp"
 
 namespace Gaia::CameraService
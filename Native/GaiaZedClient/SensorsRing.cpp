@@ -0,0 +1,176 @@
+#include "SensorsRing.hpp"
+
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+namespace Gaia::CameraService
+{
+    /// Compute the size of the shared block for the given capacities.
+    std::size_t ComputeSensorsRingSize(std::uint32_t samples_capacity, std::uint32_t frames_capacity)
+    {
+        return sizeof(SensorsRing::Header) + sizeof(FrameStamp) * frames_capacity +
+               sizeof(SensorsSample) * samples_capacity;
+    }
+
+    /// Create a sensors ring.
+    SensorsRing::SensorsRing(const std::string &block_name,
+                             std::uint32_t samples_capacity, std::uint32_t frames_capacity)
+    {
+        if (samples_capacity == 0 || frames_capacity == 0)
+            throw std::invalid_argument("Capacities of sensors ring must be positive.");
+        Block = SharedBlock::Create(block_name, ComputeSensorsRingSize(samples_capacity, frames_capacity));
+        RingHeader = static_cast<Header*>(Block->GetPointer());
+        RingHeader->SamplesCapacity = samples_capacity;
+        RingHeader->FramesCapacity = frames_capacity;
+        RingHeader->SamplesCount.store(0);
+        RingHeader->FramesCount.store(0);
+        RingHeader->Version = LayoutVersion;
+        std::atomic_thread_fence(std::memory_order_release);
+        RingHeader->Magic = LayoutMagic;
+        BindLayout();
+    }
+
+    /// Open an existing sensors ring.
+    SensorsRing::SensorsRing(const std::string &block_name)
+    {
+        Block = SharedBlock::Open(block_name);
+        if (Block->GetSize() < sizeof(Header))
+            throw std::runtime_error("Shared block " + block_name + " is too small for a sensors ring.");
+        RingHeader = static_cast<Header*>(Block->GetPointer());
+        if (RingHeader->Magic != LayoutMagic || RingHeader->Version != LayoutVersion)
+            throw std::runtime_error("Shared block " + block_name + " is not a compatible sensors ring.");
+        if (Block->GetSize() < ComputeSensorsRingSize(RingHeader->SamplesCapacity, RingHeader->FramesCapacity))
+            throw std::runtime_error("Shared block " + block_name + " is smaller than its sensors ring layout.");
+        BindLayout();
+    }
+
+    /// Bind pointers to the layout.
+    void SensorsRing::BindLayout()
+    {
+        auto* address = static_cast<std::uint8_t*>(Block->GetPointer()) + sizeof(Header);
+        Frames = reinterpret_cast<FrameStamp*>(address);
+        address += sizeof(FrameStamp) * RingHeader->FramesCapacity;
+        Samples = reinterpret_cast<SensorsSample*>(address);
+    }
+
+    /// Append a sensors sample.
+    void SensorsRing::WriteSample(const SensorsSample &sample)
+    {
+        auto count = RingHeader->SamplesCount.load(std::memory_order_relaxed);
+        std::memcpy(&Samples[count % RingHeader->SamplesCapacity], &sample, sizeof(SensorsSample));
+        RingHeader->SamplesCount.store(count + 1, std::memory_order_release);
+    }
+
+    /// Append a frame stamp.
+    void SensorsRing::WriteFrame(const FrameStamp &stamp)
+    {
+        auto count = RingHeader->FramesCount.load(std::memory_order_relaxed);
+        std::memcpy(&Frames[count % RingHeader->FramesCapacity], &stamp, sizeof(FrameStamp));
+        RingHeader->FramesCount.store(count + 1, std::memory_order_release);
+    }
+
+    /// Copy samples in the given range, and drop those overwritten during the copy.
+    std::vector<SensorsSample> SensorsRing::CopySamples(std::uint64_t begin_index, std::uint64_t end_index) const
+    {
+        std::vector<SensorsSample> samples;
+        if (end_index <= begin_index) return samples;
+        samples.resize(end_index - begin_index);
+        for (auto index = begin_index; index < end_index; ++index)
+        {
+            std::memcpy(&samples[index - begin_index], &Samples[index % RingHeader->SamplesCapacity],
+                        sizeof(SensorsSample));
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // The slot of the sample being written is the one of (count - capacity), so it is also invalid.
+        auto latest_count = RingHeader->SamplesCount.load(std::memory_order_acquire);
+        if (latest_count >= RingHeader->SamplesCapacity)
+        {
+            auto first_valid_index = latest_count - RingHeader->SamplesCapacity + 1;
+            if (first_valid_index > begin_index)
+            {
+                auto invalid_count = std::min<std::uint64_t>(first_valid_index - begin_index, samples.size());
+                samples.erase(samples.begin(), samples.begin() + static_cast<std::ptrdiff_t>(invalid_count));
+            }
+        }
+        return samples;
+    }
+
+    /// Read the latest sample.
+    std::optional<SensorsSample> SensorsRing::ReadLatest() const
+    {
+        auto count = RingHeader->SamplesCount.load(std::memory_order_acquire);
+        if (count == 0) return std::nullopt;
+        auto samples = CopySamples(count - 1, count);
+        if (samples.empty()) return std::nullopt;
+        return samples.front();
+    }
+
+    /// Read samples after the given timestamp.
+    std::vector<SensorsSample> SensorsRing::ReadSince(std::uint64_t timestamp) const
+    {
+        auto count = RingHeader->SamplesCount.load(std::memory_order_acquire);
+        auto oldest_index = count > RingHeader->SamplesCapacity ? count - RingHeader->SamplesCapacity + 1 : 0;
+        // Samples are in chronological order, so search backwards for the first one after the timestamp.
+        auto begin_index = count;
+        while (begin_index > oldest_index &&
+               Samples[(begin_index - 1) % RingHeader->SamplesCapacity].Timestamp > timestamp)
+        {
+            --begin_index;
+        }
+        auto samples = CopySamples(begin_index, count);
+        while (!samples.empty() && samples.front().Timestamp <= timestamp)
+        {
+            samples.erase(samples.begin());
+        }
+        return samples;
+    }
+
+    /// Read the sample nearest to the given frame set.
+    std::optional<SensorsSample> SensorsRing::ReadNear(std::uint64_t frame_sequence) const
+    {
+        // Find the frame stamp.
+        auto frames_count = RingHeader->FramesCount.load(std::memory_order_acquire);
+        auto oldest_frame_index = frames_count > RingHeader->FramesCapacity ?
+                frames_count - RingHeader->FramesCapacity + 1 : 0;
+        std::optional<std::uint64_t> frame_timestamp;
+        for (auto index = frames_count; index > oldest_frame_index; --index)
+        {
+            FrameStamp stamp;
+            std::memcpy(&stamp, &Frames[(index - 1) % RingHeader->FramesCapacity], sizeof(FrameStamp));
+            if (stamp.Sequence == frame_sequence)
+            {
+                frame_timestamp = stamp.Timestamp;
+                break;
+            }
+            if (stamp.Sequence < frame_sequence) break;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (!frame_timestamp) return std::nullopt;
+
+        // Samples are in chronological order, so the nearest one is around the first sample after the frame.
+        auto count = RingHeader->SamplesCount.load(std::memory_order_acquire);
+        auto oldest_index = count > RingHeader->SamplesCapacity ? count - RingHeader->SamplesCapacity + 1 : 0;
+        auto after_index = count;
+        while (after_index > oldest_index &&
+               Samples[(after_index - 1) % RingHeader->SamplesCapacity].Timestamp > *frame_timestamp)
+        {
+            --after_index;
+        }
+        auto begin_index = after_index > oldest_index ? after_index - 1 : after_index;
+        auto end_index = std::min(after_index + 1, count);
+        auto candidates = CopySamples(begin_index, end_index);
+        if (candidates.empty()) return std::nullopt;
+
+        auto distance = [&frame_timestamp](const SensorsSample& sample){
+            return sample.Timestamp > *frame_timestamp ?
+                   sample.Timestamp - *frame_timestamp : *frame_timestamp - sample.Timestamp;
+        };
+        const SensorsSample* nearest = &candidates.front();
+        for (const auto& candidate : candidates)
+        {
+            if (distance(candidate) < distance(*nearest)) nearest = &candidate;
+        }
+        return *nearest;
+    }
+}
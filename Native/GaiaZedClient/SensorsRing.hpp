@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <GaiaCameraClient/SharedBlock.hpp>
+
+namespace Gaia::CameraService
+{
+    /// Sample of all Zed sensors in a fixed binary layout.
+    struct SensorsSample
+    {
+        /// Timestamp of the IMU measurement in nanoseconds, in the time reference of the Zed SDK.
+        std::uint64_t Timestamp {0};
+        /// Sequence number of the latest frame set committed before this sample.
+        std::uint64_t FrameSequence {0};
+        /// Linear acceleration on x, y and z axes, including the force of gravity.
+        float LinearAcceleration[3] {0.0f, 0.0f, 0.0f};
+        /// Angular velocity around x, y and z axes.
+        float AngularVelocity[3] {0.0f, 0.0f, 0.0f};
+        /// Orientation as rotation vector around x, y and z axes, in radians.
+        float Orientation[3] {0.0f, 0.0f, 0.0f};
+        /// Calibrated magnetic field on x, y and z axes in μT.
+        float MagneticField[3] {0.0f, 0.0f, 0.0f};
+        /// Atmospheric pressure in hPa.
+        float Pressure {0.0f};
+        /// Relative altitude from the initial position.
+        float RelativeAltitude {0.0f};
+    };
+
+    /// Capture timestamp of a committed frame set.
+    struct FrameStamp
+    {
+        /// Sequence number of the frame set.
+        std::uint64_t Sequence {0};
+        /// Timestamp of the images in nanoseconds, in the time reference of the Zed SDK.
+        std::uint64_t Timestamp {0};
+    };
+
+    /**
+     * @brief Ring buffer of sensors samples in a shared block, written by one server and read by any clients.
+     * @details
+     *  The block is laid out as a header, a ring of frame stamps and a ring of sensors samples.
+     *  The writer fills a slot and then publishes it by increasing the count with release semantics;
+     *  readers copy slots and then drop those which may have been overwritten during the copy.
+     */
+    class SensorsRing
+    {
+    public:
+        /// Header at the beginning of the shared block.
+        struct Header
+        {
+            /// Magic number to verify the layout.
+            std::uint32_t Magic;
+            /// Version of the layout.
+            std::uint32_t Version;
+            /// Capacity of the sensors samples ring.
+            std::uint32_t SamplesCapacity;
+            /// Capacity of the frame stamps ring.
+            std::uint32_t FramesCapacity;
+            /// Count of all samples written since the block is created.
+            std::atomic<std::uint64_t> SamplesCount;
+            /// Count of all frame stamps written since the block is created.
+            std::atomic<std::uint64_t> FramesCount;
+        };
+
+        static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+                "Sensors ring requires lock-free 64 bits atomic integers.");
+
+        /// Magic number of the layout, "GZSR".
+        static constexpr std::uint32_t LayoutMagic = 0x52535A47;
+        /// Version of the layout.
+        static constexpr std::uint32_t LayoutVersion = 1;
+
+    private:
+        /// Shared block which holds the ring.
+        std::unique_ptr<SharedBlock> Block;
+        /// Header in the shared block.
+        Header* RingHeader {nullptr};
+        /// Ring of frame stamps in the shared block.
+        FrameStamp* Frames {nullptr};
+        /// Ring of sensors samples in the shared block.
+        SensorsSample* Samples {nullptr};
+
+        /// Bind pointers to the layout in the shared block.
+        void BindLayout();
+
+        /**
+         * @brief Copy samples with the given indices range.
+         * @return Samples which are not overwritten during the copy.
+         */
+        std::vector<SensorsSample> CopySamples(std::uint64_t begin_index, std::uint64_t end_index) const;
+
+    public:
+        /**
+         * @brief Create a sensors ring, used by the server.
+         * @param block_name Name of the shared block.
+         * @param samples_capacity Count of samples to keep.
+         * @param frames_capacity Count of frame stamps to keep.
+         */
+        SensorsRing(const std::string& block_name, std::uint32_t samples_capacity, std::uint32_t frames_capacity);
+        /**
+         * @brief Open an existing sensors ring, used by clients.
+         * @param block_name Name of the shared block.
+         */
+        explicit SensorsRing(const std::string& block_name);
+
+        /// Append a sensors sample. Only one writer is allowed.
+        void WriteSample(const SensorsSample& sample);
+        /// Append a frame stamp. Only one writer is allowed.
+        void WriteFrame(const FrameStamp& stamp);
+
+        /// Read the latest sample.
+        [[nodiscard]] std::optional<SensorsSample> ReadLatest() const;
+        /**
+         * @brief Read all buffered samples whose timestamps are greater than the given one.
+         * @param timestamp Timestamp in nanoseconds, in the time reference of the Zed SDK.
+         * @return Samples in chronological order.
+         */
+        [[nodiscard]] std::vector<SensorsSample> ReadSince(std::uint64_t timestamp) const;
+        /**
+         * @brief Read the sample nearest in time to the frame set with the given sequence number.
+         * @return Nearest sample, or std::nullopt if the frame stamp or samples are no longer buffered.
+         */
+        [[nodiscard]] std::optional<SensorsSample> ReadNear(std::uint64_t frame_sequence) const;
+    };
+}
@@ -1,5 +1,4 @@
 #include "ZedClient.hpp"
-#include <sstream>
 
 namespace Gaia::CameraService
 {
@@ -7,25 +6,39 @@ namespace Gaia::CameraService
     ZedClient::ZedClient() : CameraClient("zed", 0)
     {}
 
-    /// Convert a string of float3 into  a float3 vector.
-    sl::float3 ConvertStringToFloat3(const std::string& text)
+    /// Convert an array of 3 floats into a float3 vector.
+    sl::float3 ConvertArrayToFloat3(const float (&values)[3])
     {
         sl::float3 data {0, 0, 0};
-        auto comma1_position = text.find(',');
-        data.x = std::stof(text.substr(0, comma1_position));
-        auto comma2_position = text.find(',', comma1_position + 1);
-        data.y = std::stof(text.substr(comma1_position + 1, comma2_position));
-        data.z = std::stof(text.substr(comma2_position + 1));
+        data.x = values[0];
+        data.y = values[1];
+        data.z = values[2];
         return data;
     }
 
+    /// Open the sensors ring on the first use.
+    SensorsRing* ZedClient::GetSensorsRing()
+    {
+        if (!Sensors)
+        {
+            try
+            {
+                Sensors = std::make_unique<SensorsRing>(DeviceName + ".sensors");
+            }catch (std::runtime_error& error)
+            {
+                return nullptr;
+            }
+        }
+        return Sensors.get();
+    }
+
     /// Get magnetometer data.
     sl::float3 ZedClient::GetMagneticField()
     {
-        auto value_text = Connection->get("cameras/" + DeviceName + "/status/magnetic_field");
-        if (value_text)
+        auto sample = ReadSensors();
+        if (sample)
         {
-            return ConvertStringToFloat3(*value_text);
+            return ConvertArrayToFloat3(sample->MagneticField);
         }
         return {0.0, 0.0, 0.0};
     }
@@ -33,10 +46,10 @@ namespace Gaia::CameraService
     /// Get relative altitude data.
     float ZedClient::GetRelativeAltitude()
     {
-        auto value_text = Connection->get("cameras/" + DeviceName + "/status/relative_altitude");
-        if (value_text)
+        auto sample = ReadSensors();
+        if (sample)
         {
-            return std::stof(*value_text);
+            return sample->RelativeAltitude;
         }
         return 0.0;
     }
@@ -44,10 +57,10 @@ namespace Gaia::CameraService
     /// Get linear acceleration applied to the camera.
     sl::float3 ZedClient::GetLinearAcceleration()
     {
-        auto value_text = Connection->get("cameras/" + DeviceName + "/status/linear_acceleration");
-        if (value_text)
+        auto sample = ReadSensors();
+        if (sample)
         {
-            return ConvertStringToFloat3(*value_text);
+            return ConvertArrayToFloat3(sample->LinearAcceleration);
         }
         return {0.0, 0.0, 0.0};
     }
@@ -55,10 +68,10 @@ namespace Gaia::CameraService
     /// Get angular velocity data.
     sl::float3 ZedClient::GetAngularVelocity()
     {
-        auto value_text = Connection->get("cameras/" + DeviceName + "/status/angular_velocity");
-        if (value_text)
+        auto sample = ReadSensors();
+        if (sample)
         {
-            return ConvertStringToFloat3(*value_text);
+            return ConvertArrayToFloat3(sample->AngularVelocity);
         }
         return {0.0, 0.0, 0.0};
     }
@@ -66,11 +79,35 @@ namespace Gaia::CameraService
     /// Get the orientation angle of this camera.
     sl::float3 ZedClient::GetOrientation()
     {
-        auto value_text = Connection->get("cameras/" + DeviceName + "/status/orientation");
-        if (value_text)
+        auto sample = ReadSensors();
+        if (sample)
         {
-            return ConvertStringToFloat3(*value_text);
+            return ConvertArrayToFloat3(sample->Orientation);
         }
         return {0.0, 0.0, 0.0};
     }
+
+    /// Read the latest sensors sample.
+    std::optional<SensorsSample> ZedClient::ReadSensors()
+    {
+        auto* ring = GetSensorsRing();
+        if (!ring) return std::nullopt;
+        return ring->ReadLatest();
+    }
+
+    /// Read buffered sensors samples after the given timestamp.
+    std::vector<SensorsSample> ZedClient::ReadSensorsSince(std::uint64_t timestamp)
+    {
+        auto* ring = GetSensorsRing();
+        if (!ring) return {};
+        return ring->ReadSince(timestamp);
+    }
+
+    /// Read the sensors sample nearest to the given frame set.
+    std::optional<SensorsSample> ZedClient::ReadSensorsNear(std::uint64_t frame_sequence)
+    {
+        auto* ring = GetSensorsRing();
+        if (!ring) return std::nullopt;
+        return ring->ReadNear(frame_sequence);
+    }
 }
\ No newline at end of file
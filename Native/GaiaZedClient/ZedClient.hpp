@@ -1,8 +1,13 @@
 #pragma once
 
+#include <memory>
+#include <optional>
+#include <vector>
 #include <sl/Camera.hpp>
 #include <GaiaCameraClient/GaiaCameraClient.hpp>
 
+#include "SensorsRing.hpp"
+
 namespace Gaia::CameraService
 {
     /**
@@ -10,6 +15,13 @@ namespace Gaia::CameraService
      */
     class ZedClient : public CameraClient
     {
+    private:
+        /// Ring of sensors samples shared by the Zed server.
+        std::unique_ptr<SensorsRing> Sensors;
+
+        /// Get the sensors ring, it will be opened on the first use.
+        SensorsRing* GetSensorsRing();
+
     public:
         /// Camera type is "zed" and only one zed is suppored by zed sdk, so index is 0.
         ZedClient();
@@ -44,6 +56,24 @@ namespace Gaia::CameraService
          */
         sl::float3 GetOrientation();
 
+        /**
+         * @brief Read the latest sensors sample.
+         * @return Latest sample, or std::nullopt if no sample is available.
+         */
+        std::optional<SensorsSample> ReadSensors();
+        /**
+         * @brief Read all buffered sensors samples after the given timestamp.
+         * @param timestamp Timestamp in nanoseconds, in the time reference of the Zed SDK.
+         * @return Samples at the native rate of the IMU, in chronological order.
+         */
+        std::vector<SensorsSample> ReadSensorsSince(std::uint64_t timestamp);
+        /**
+         * @brief Read the sensors sample nearest in time to the given frame set.
+         * @param frame_sequence Sequence number of the "stereo" frame set, see CameraClient::ReadFrameSet(...).
+         * @return Nearest sample, or std::nullopt if the frame set is no longer buffered.
+         */
+        std::optional<SensorsSample> ReadSensorsNear(std::uint64_t frame_sequence);
+
         /// Get reader for the right view picture, in color format of BGR.
         [[nodiscard]] inline CameraReader GetLeftViewReader()
         {
@@ -1,6 +1,7 @@
 #include "ZedDriver.hpp"
 
 #include <opencv2/opencv.hpp>
+#include <sstream>
 
 namespace Gaia::CameraService
 {
@@ -34,8 +35,9 @@ namespace Gaia::CameraService
 
     /// Retrieve and upload a view picture from the device to the shared memory.
     void UploadZedBGRAPicture(LogService::LogClient* logger, sl::Camera& device,
-                              sl::VIEW view, SharedPicture::PictureWriter& writer)
+                              sl::VIEW view, SwapChain& chain)
     {
+        auto& writer = chain.GetWriter();
         sl::Mat sl_matrix;
         device.retrieveImage(sl_matrix, view, sl::MEM::CPU);
         auto matrix = ConvertToOpenCVMat(sl_matrix);
@@ -47,15 +49,14 @@ namespace Gaia::CameraService
             return;
         }
         /// Function std::memcpy(...) can not function properly here.
-        cv::Mat shared_picture(cv::Size(matrix.cols, matrix.rows), matrix.type(),
-                               writer.GetPointer());
+        auto shared_picture = chain.ViewWritingBlock();
         matrix.copyTo(shared_picture);
     }
 
     /// Retrieve and update a point cloud from the device to the shared memory.
-    void UploadZedPointCloud(LogService::LogClient* logger, sl::Camera& device,
-                             SharedPicture::PictureWriter& writer)
+    void UploadZedPointCloud(LogService::LogClient* logger, sl::Camera& device, SwapChain& chain)
     {
+        auto& writer = chain.GetWriter();
         sl::Mat sl_matrix;
         // Channels are X,Y,Z, BGRA (8 * 4 merged int a single 32 channel).
         device.retrieveMeasure(sl_matrix, sl::MEASURE::XYZBGRA,sl::MEM::CPU);
@@ -65,25 +66,27 @@ namespace Gaia::CameraService
             logger->RecordError("Insufficient memory to upload Zed point cloud.");
             return;
         }
-        cv::Mat shared_picture(cv::Size(matrix.cols, matrix.rows), matrix.type(),
-                               writer.GetPointer());
+        auto shared_picture = chain.ViewWritingBlock();
         matrix.copyTo(shared_picture);
     }
 
-    /// Convert a float3 vector into string.
-    std::string ConvertFloat3ToString(const sl::float3& data)
-    {
-        return std::to_string(data.x) + "," + std::to_string(data.y) + "," + std::to_string(data.z);
-    }
-
     /// Constructor.
     ZedDriver::ZedDriver() :
         CameraDriverInterface("zed"),
         GrabberThread([this](const std::atomic_bool& flag){
+            this->EnterThread(ThreadRole::Grabber);
             while (flag)
             {
                 this->UpdatePicture();
             }
+        }),
+        SensorsSampler([this](const std::atomic_bool& flag){
+            this->EnterThread(ThreadRole::Grabber);
+            std::uint64_t last_timestamp = 0;
+            while (flag)
+            {
+                this->UpdateSensors(last_timestamp);
+            }
         })
     {}
 
@@ -103,49 +106,65 @@ namespace Gaia::CameraService
             GetLogger()->RecordError("A grab attempt is failed.");
             return;
         }
+        // The image timestamp of the Zed SDK is used as the device time of this grab.
+        auto capture_time = CaptureTime::Now(Device.getTimestamp(sl::TIME_REFERENCE::IMAGE).getNanoseconds());
 
-        auto left_view_task = std::async(std::launch::async, [this]{
-            if (!this->LeftViewWriter) return;
-            UploadZedBGRAPicture(this->GetLogger(), this->Device, sl::VIEW::LEFT, *this->LeftViewWriter);
-            this->UpdatePictureTimestamp("left");
-        });
-        auto right_view_task = std::async(std::launch::async, [this]{
-            if (!this->RightViewWriter) return;
-            UploadZedBGRAPicture(this->GetLogger(), this->Device, sl::VIEW::RIGHT, *this->RightViewWriter);
-            this->UpdatePictureTimestamp("right");
-        });
-        auto point_cloud_task = std::async(std::launch::async, [this]{
-            if (!this->PointCloudWriter) return;
-            UploadZedPointCloud(this->GetLogger(), this->Device, *this->PointCloudWriter);
-            this->UpdatePictureTimestamp("point_cloud");
-        });
-
-        // Update sensor data.
-        auto status_prefix = "cameras/" + DeviceName + "/status";
-        auto* database = GetDatabase();
+        // Block this thread until all pictures of this grab are uploaded.
+        try
+        {
+            UploadStages.Execute();
+        }catch (std::exception& error)
+        {
+            GetLogger()->RecordError(std::string("Failed to upload Zed pictures: ") + error.what());
+            return;
+        }
 
-        sl::SensorsData sensors_data;
-        Device.getSensorsData(sensors_data, sl::TIME_REFERENCE::IMAGE);
-
-        auto magnetic_field = sensors_data.magnetometer.magnetic_field_calibrated;
-        database->set(status_prefix + "/magnetic_field", ConvertFloat3ToString(magnetic_field));
-        auto relative_altitude = sensors_data.barometer.pressure;
-        database->set(status_prefix + "/relative_altitude", std::to_string(relative_altitude));
-        auto linear_acceleration = sensors_data.imu.linear_acceleration;
-        database->set(status_prefix + "/linear_acceleration", ConvertFloat3ToString(linear_acceleration));
-        auto angular_velocity = sensors_data.imu.angular_velocity;
-        database->set(status_prefix + "/angular_velocity", ConvertFloat3ToString(angular_velocity));
-        auto pose = sensors_data.imu.pose.getRotationVector();
-        database->set(status_prefix + "/orientation", ConvertFloat3ToString(pose));
-
-        // Block this thread until those tasks are done.
-        left_view_task.get();
-        right_view_task.get();
-        point_cloud_task.get();
+        // Publish pictures of this grab together, so readers never pair views from different grabs.
+        auto frame_sequence = CommitFrameSet("stereo", {LeftViewChain, RightViewChain, PointCloudChain},
+                                             capture_time);
+        LatestFrameSequence = frame_sequence;
+        if (Sensors)
+        {
+            FrameStamp stamp;
+            stamp.Sequence = frame_sequence;
+            stamp.Timestamp = capture_time.DeviceTimestamp;
+            Sensors->WriteFrame(stamp);
+        }
 
         LastReceiveTimePoint = std::chrono::steady_clock::now();
     }
 
+    /// Sample sensors and append new IMU measurements to the sensors ring.
+    void ZedDriver::UpdateSensors(std::uint64_t& last_timestamp)
+    {
+        sl::SensorsData sensors_data;
+        if (!Sensors ||
+            Device.getSensorsData(sensors_data, sl::TIME_REFERENCE::CURRENT) != sl::ERROR_CODE::SUCCESS ||
+            sensors_data.imu.timestamp.getNanoseconds() == last_timestamp)
+        {
+            // The IMU runs at hundreds of hertz, polling faster than that only burns the CPU.
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+            return;
+        }
+        last_timestamp = sensors_data.imu.timestamp.getNanoseconds();
+
+        SensorsSample sample;
+        sample.Timestamp = last_timestamp;
+        sample.FrameSequence = LatestFrameSequence;
+        auto copy_float3 = [](const sl::float3& source, float (&destination)[3]){
+            destination[0] = source.x;
+            destination[1] = source.y;
+            destination[2] = source.z;
+        };
+        copy_float3(sensors_data.imu.linear_acceleration, sample.LinearAcceleration);
+        copy_float3(sensors_data.imu.angular_velocity, sample.AngularVelocity);
+        copy_float3(sensors_data.imu.pose.getRotationVector(), sample.Orientation);
+        copy_float3(sensors_data.magnetometer.magnetic_field_calibrated, sample.MagneticField);
+        sample.Pressure = sensors_data.barometer.pressure;
+        sample.RelativeAltitude = sensors_data.barometer.relative_altitude;
+        Sensors->WriteSample(sample);
+    }
+
     /// Open the camera.
     void ZedDriver::Open()
     {
@@ -201,12 +220,10 @@ namespace Gaia::CameraService
         picture_header.Width = picture_resolution.width;
         picture_header.Height = picture_resolution.height;
 
-        LeftViewWriter = std::make_unique<SharedPicture::PictureWriter>(
-                DeviceName + ".left",static_cast<long>(picture_size * 4), true);
-        LeftViewWriter->SetHeader(picture_header);
-        RightViewWriter = std::make_unique<SharedPicture::PictureWriter>(
-                DeviceName + ".right",static_cast<long>(picture_size * 4), true);
-        RightViewWriter->SetHeader(picture_header);
+        LeftViewChain = &CreateSwapChain("left", picture_header,
+                                         static_cast<long>(picture_size * 4), SwapChainTotalCount);
+        RightViewChain = &CreateSwapChain("right", picture_header,
+                                          static_cast<long>(picture_size * 4), SwapChainTotalCount);
 
         SharedPicture::PictureHeader point_cloud_header;
         point_cloud_header.PixelType = SharedPicture::PictureHeader::PixelTypes::Float;
@@ -216,13 +233,48 @@ namespace Gaia::CameraService
         point_cloud_header.Height = picture_resolution.height;
 
         // 1 float equals 4 chars in size.
-        PointCloudWriter = std::make_unique<SharedPicture::PictureWriter>(
-                DeviceName + ".point_cloud",
-                static_cast<long>(picture_size * 4 * 4), true);
-        PointCloudWriter->SetHeader(point_cloud_header);
+        PointCloudChain = &CreateSwapChain("point_cloud", point_cloud_header,
+                                           static_cast<long>(picture_size * 4 * 4), SwapChainTotalCount);
+
+        // Prepare persistent upload stages, optionally pinned on the cores listed in "UploadCores".
+        // Stages enter the convert role on their first round, so "ConvertCores" replaces this pinning if it is set.
+        std::vector<int> upload_cores;
+        auto option_upload_cores = GetConfigurator()->Get("UploadCores");
+        if (option_upload_cores)
+        {
+            std::stringstream cores_stream(*option_upload_cores);
+            std::string core_text;
+            while (std::getline(cores_stream, core_text, ','))
+            {
+                if (!core_text.empty()) upload_cores.push_back(std::stoi(core_text));
+            }
+        }
+        auto get_upload_core = [&upload_cores](std::size_t stage_index){
+            return stage_index < upload_cores.size() ? upload_cores[stage_index] : -1;
+        };
+        UploadStages.Stop();
+        UploadStages.ClearStages();
+        UploadStages.AddStage("left", [this]{
+            this->EnterThread(ThreadRole::Convert);
+            UploadZedBGRAPicture(this->GetLogger(), this->Device, sl::VIEW::LEFT, *this->LeftViewChain);
+        }, get_upload_core(0));
+        UploadStages.AddStage("right", [this]{
+            this->EnterThread(ThreadRole::Convert);
+            UploadZedBGRAPicture(this->GetLogger(), this->Device, sl::VIEW::RIGHT, *this->RightViewChain);
+        }, get_upload_core(1));
+        UploadStages.AddStage("point_cloud", [this]{
+            this->EnterThread(ThreadRole::Convert);
+            UploadZedPointCloud(this->GetLogger(), this->Device, *this->PointCloudChain);
+        }, get_upload_core(2));
+        UploadStages.Start();
+
+        // About 10 seconds of samples for an IMU at 400 Hz.
+        Sensors = std::make_unique<SensorsRing>(DeviceName + ".sensors", 4096, 1024);
+        LatestFrameSequence = 0;
 
         LastReceiveTimePoint = std::chrono::steady_clock::now();
 
+        SensorsSampler.Start();
         GrabberThread.Start();
     }
 
@@ -230,13 +282,17 @@ namespace Gaia::CameraService
     void ZedDriver::Close()
     {
         GrabberThread.Stop();
+        UploadStages.Stop();
+        SensorsSampler.Stop();
+        Sensors.reset();
         if (Device.isOpened())
         {
             Device.close();
         }
-        if (LeftViewWriter) LeftViewWriter->Release();
-        if (RightViewWriter) RightViewWriter->Release();
-        if (PointCloudWriter) PointCloudWriter->Release();
+        LeftViewChain = nullptr;
+        RightViewChain = nullptr;
+        PointCloudChain = nullptr;
+        ReleaseSwapChains();
     };
 
     /// Check whether this camera is alive or not.
@@ -341,6 +397,12 @@ namespace Gaia::CameraService
         return {{"left", "BGR"}, {"right", "BGR"}, {"point_cloud", "XYZC"}};
     }
 
+    /// Get frame set names list.
+    std::vector<std::tuple<std::string, std::vector<std::string>>> ZedDriver::GetFrameSetNames()
+    {
+        return {{"stereo", {"left", "right", "point_cloud"}}};
+    }
+
 
     /// Set red channel value of the white balance.
     bool ZedDriver::SetWhiteBalanceRed(double ratio)
@@ -6,24 +6,35 @@
 #include <GaiaSharedPicture/GaiaSharedPicture.hpp>
 #include <GaiaCameraServer/GaiaCameraServer.hpp>
 #include <GaiaBackground/GaiaBackground.hpp>
+#include <GaiaZedClient/SensorsRing.hpp>
 #include <sl/Camera.hpp>
 
 namespace Gaia::CameraService
 {
-    // Todo: Add swap chain support.
     class ZedDriver : public CameraDriverInterface
     {
     private:
         /// Zed camera device.
         sl::Camera Device;
-        /// Shared memory for the captured left view picture.
-        std::unique_ptr<SharedPicture::PictureWriter> LeftViewWriter;
-        /// Shared memory for the captured right view picture.
-        std::unique_ptr<SharedPicture::PictureWriter> RightViewWriter;
-        /// Shared memory for the point cloud picture.
-        std::unique_ptr<SharedPicture::PictureWriter> PointCloudWriter;
+        const unsigned int SwapChainTotalCount {10};
+
+        /// Swap chain for the captured left view picture.
+        SwapChain* LeftViewChain {nullptr};
+        /// Swap chain for the captured right view picture.
+        SwapChain* RightViewChain {nullptr};
+        /// Swap chain for the point cloud picture.
+        SwapChain* PointCloudChain {nullptr};
         /// Background acquisition thread.
         Background::BackgroundWorker GrabberThread;
+        /// Persistent workers which upload left view, right view and point cloud in parallel for every grab.
+        StageExecutor UploadStages;
+
+        /// Background thread which samples sensors at the native rate of the IMU.
+        Background::BackgroundWorker SensorsSampler;
+        /// Shared ring of sensors samples and frame stamps.
+        std::unique_ptr<SensorsRing> Sensors;
+        /// Sequence number of the latest committed frame set.
+        std::atomic<std::uint64_t> LatestFrameSequence {0};
 
         /// Timestamp of the last receive event, used for judging whether this camera is alive or not.
         std::atomic<std::chrono::steady_clock::time_point> LastReceiveTimePoint {std::chrono::steady_clock::now()};
@@ -31,6 +42,12 @@ namespace Gaia::CameraService
         /// Grab a picture and write it into the shared memory.
         void UpdatePicture();
 
+        /**
+         * @brief Sample sensors and append the sample to the sensors ring if the IMU has a new measurement.
+         * @param last_timestamp Timestamp of the last appended sample, will be updated.
+         */
+        void UpdateSensors(std::uint64_t& last_timestamp);
+
     public:
         /// Default constructor.
         ZedDriver();
@@ -53,6 +70,9 @@ namespace Gaia::CameraService
         /// Get picture names.
         std::vector<std::tuple<std::string, std::string>> GetPictureNames() override;
 
+        /// Get frame set names, left view, right view and point cloud are committed as frame set "stereo".
+        std::vector<std::tuple<std::string, std::vector<std::string>>> GetFrameSetNames() override;
+
         /// Open the camera on the bound index and start acquisition.
         void Open() override;
 